@@ -0,0 +1,339 @@
+// Multi-hart ABACUS. One abacus_top profiles each hart, and every hart has the full single-hart
+// register map in its own 4 KiB window, hart h at ABACUS_BASE_ADDR + h * 0x1000, so software written
+// for one hart runs unchanged on hart 0. The global block at ABACUS_BASE_ADDR + 0xF000 snapshots every
+// hart on the same clock edge and presents the sum of their snapshot windows:
+//
+//   0x000 Number of Harts (R)
+//   0x004 Global Snapshot (R/W), bit 0 snapshots every hart now, bit 1 holds back their automatic snapshots
+//   0x008 Hart Interrupt Status (R), bit h is the interrupt of hart h
+//   0x00C Global Clear (W), clears the units of the mask on every hart, bits as in Unit Clear
+//   0x800 Aggregate Window (R), the layout of the snapshot window with every counter summed over the
+//         harts, the line fill minimums the smallest of any hart and the maximums the largest
+//
+// ABACUS_BASE_ADDR must be 64 KiB aligned. The bus is Wishbone only, and there is no snapshot ring.
+// The harts share one memory bus, so only the bus profiler of hart 0 snoops it.
+module abacus_smp
+#(
+    parameter integer NUM_HARTS                  = 2,     // 1 to 15
+    parameter logic WB_PIPELINED                 = 1'b0,  // Wishbone B4 pipelined mode instead of classic cycles
+    parameter [31:0] ABACUS_BASE_ADDR            = 32'hf0030000,
+    parameter logic INCLUDE_INSTRUCTION_PROFILER = 1'b1,
+    parameter logic INCLUDE_CACHE_PROFILER       = 1'b1,
+    parameter logic INCLUDE_STALL_UNIT           = 1'b1,
+    parameter logic INCLUDE_PC_SAMPLER           = 1'b1,
+    parameter logic INCLUDE_EVENT_COUNTERS       = 1'b1,
+    parameter integer NUM_EVENT_COUNTERS         = 4,     // 1 to 16 programmable counters per hart
+    parameter logic INCLUDE_BRANCH_HOTLIST       = 1'b1,
+    parameter integer BRANCH_HOTLIST_ENTRIES     = 8,     // 1 to 15 mispredicted branches tracked per hart
+    parameter logic INCLUDE_MISS_SKETCH          = 1'b1,
+    parameter integer MISS_SKETCH_WIDTH          = 1024,  // Counters per sketch row, power of two, 64 to 4096
+    parameter integer MISS_SKETCH_TOPK_ENTRIES   = 8,     // 1 to 16 most missed granules tracked per hart
+    parameter logic INCLUDE_BUS_PROFILER         = 1'b1,
+    parameter logic INCLUDE_RATE_ALARMS          = 1'b1,
+    parameter integer NUM_RATE_ALARMS            = 4,     // 1 to 8 rate threshold alarms per hart
+    parameter integer PC_SAMPLE_FIFO_DEPTH       = 256,   // Power of two
+    parameter [31:0] DEFAULT_SNAPSHOT_INTERVAL   = 32'd1, // Cycles between automatic snapshots out of reset, 0 = software snapshots only
+    parameter integer COUNTER_WIDTH              = 64     // 32 to 64 bits, upper bits are read through COUNTER_HI
+)
+(
+    input logic clk,
+    input logic rst,
+
+    output logic abacus_irq, // Interrupt of any hart, level sensitive
+
+    // Nets from the cores, element h from hart h
+    input [NUM_HARTS-1:0][31:0] abacus_instruction,
+    input [NUM_HARTS-1:0][31:0] abacus_instruction_pc,
+    input [NUM_HARTS-1:0] abacus_instruction_issued,
+
+    input logic [NUM_HARTS-1:0] abacus_icache_request,
+    input logic [NUM_HARTS-1:0] abacus_dcache_request,
+    input logic [NUM_HARTS-1:0] abacus_icache_miss,
+    input logic [NUM_HARTS-1:0] abacus_dcache_hit,
+    input logic [NUM_HARTS-1:0] abacus_icache_line_fill_in_progress,
+    input logic [NUM_HARTS-1:0] abacus_dcache_line_fill_in_progress,
+    input logic [NUM_HARTS-1:0][31:0] abacus_dcache_miss_addr,
+
+    // Memory bus shared by the harts
+    input logic abacus_idbus_cyc,
+    input logic abacus_idbus_stb,
+    input logic abacus_idbus_we,
+    input logic [3:0] abacus_idbus_sel,
+    input logic [2:0] abacus_idbus_cti,
+    input logic abacus_idbus_ack,
+    input logic abacus_idbus_err,
+
+    input logic [NUM_HARTS-1:0] abacus_branch_misprediction,
+    input logic [NUM_HARTS-1:0] abacus_ras_misprediction,
+    input logic [NUM_HARTS-1:0] abacus_branch_resolved,
+    input logic [NUM_HARTS-1:0][31:0] abacus_branch_pc,
+    input logic [NUM_HARTS-1:0] abacus_issue_no_instruction_stat,
+    input logic [NUM_HARTS-1:0] abacus_issue_no_id_stat,
+    input logic [NUM_HARTS-1:0] abacus_issue_flush_stat,
+    input logic [NUM_HARTS-1:0] abacus_issue_unit_busy_stat,
+    input logic [NUM_HARTS-1:0] abacus_issue_operands_not_ready_stat,
+    input logic [NUM_HARTS-1:0] abacus_issue_hold_stat,
+    input logic [NUM_HARTS-1:0] abacus_issue_multi_source_stat,
+    input logic [NUM_HARTS-1:0][1:0] abacus_privilege,
+    input logic [NUM_HARTS-1:0][8:0] abacus_asid,
+
+    // Wishbone signals
+    input logic wb_cyc,
+    input logic wb_stb,
+    input logic wb_we,
+    input logic [31:0] wb_adr,
+    input logic [31:0] wb_dat_i,
+    input logic [2:0] wb_cti,  // Cycle type, 3'b010 requests an incrementing burst
+    input logic [1:0] wb_bte,
+    output logic [31:0] wb_dat_o,
+    output logic wb_ack,
+    output logic wb_stall      // Pipelined mode only, always 0 as every request is taken at once
+);
+
+localparam logic [31:0] HART_STRIDE = 32'h1000;
+
+localparam logic [31:0] GLOBAL_BASE_ADDR = ABACUS_BASE_ADDR + 32'hF000;
+
+localparam logic [31:0] NUM_HARTS_ADDR                       = GLOBAL_BASE_ADDR + 16'h0000;
+localparam logic [31:0] GLOBAL_SNAPSHOT_ADDR                 = GLOBAL_BASE_ADDR + 16'h0004; // Bit 0: snapshot every hart, bit 1: hold
+localparam logic [31:0] HART_IRQ_STATUS_ADDR                 = GLOBAL_BASE_ADDR + 16'h0008;
+localparam logic [31:0] GLOBAL_CLEAR_ADDR                    = GLOBAL_BASE_ADDR + 16'h000C; // Write 1 to bit n to clear unit n of every hart, reads 0
+localparam logic [31:0] AGGREGATE_WINDOW_ADDR                = GLOBAL_BASE_ADDR + 16'h0800;
+
+// The snapshot window of abacus_top, 64-bit counters as pairs of words, then the four line fill extremes
+localparam integer SNAPSHOT_WINDOW_COUNTERS = 74;
+localparam integer SNAPSHOT_WINDOW_WORDS = 2 * SNAPSHOT_WINDOW_COUNTERS + 4;
+
+logic [NUM_HARTS-1:0] hart_sel;
+logic [NUM_HARTS-1:0] hart_ack;
+logic [31:0] hart_dat_o [NUM_HARTS];
+logic [NUM_HARTS-1:0] hart_irq;
+logic [63:0] hart_window_pair [NUM_HARTS];
+
+logic global_sel;
+logic global_ack;
+logic global_wr_en;
+logic [31:0] global_dat_o;
+logic [31:0] global_rd_data;
+reg global_hold_reg;
+logic global_snapshot;
+logic [7:0] global_clear;
+
+logic [7:0] window_index;
+logic [63:0] aggregate_sum;
+logic [31:0] aggregate_min;
+logic [31:0] aggregate_max;
+
+// Address decode, one 4 KiB window per hart and the global block in the last one
+always_comb begin
+    for (int h = 0; h < NUM_HARTS; h++) begin
+        hart_sel[h] = (wb_adr[31:12] == 20'((ABACUS_BASE_ADDR + HART_STRIDE * h) >> 12));
+    end
+end
+assign global_sel = (wb_adr[31:12] == GLOBAL_BASE_ADDR[31:12]);
+
+// Every slave acknowledges only its own requests, so the data of whichever one acknowledges is returned
+always_comb begin
+    wb_ack = global_ack;
+    wb_dat_o = global_ack ? global_dat_o : 32'h0;
+    for (int h = 0; h < NUM_HARTS; h++) begin
+        wb_ack = wb_ack | hart_ack[h];
+        if (hart_ack[h]) begin
+            wb_dat_o = hart_dat_o[h];
+        end
+    end
+end
+assign wb_stall = 1'b0;
+
+assign abacus_irq = |hart_irq;
+
+genvar h;
+generate for (h = 0; h < NUM_HARTS; h++) begin : gen_harts
+    abacus_top #(
+        .WITH_AXI(1'b0),
+        .WB_PIPELINED(WB_PIPELINED),
+        .ABACUS_BASE_ADDR(ABACUS_BASE_ADDR + HART_STRIDE * h),
+        .INCLUDE_INSTRUCTION_PROFILER(INCLUDE_INSTRUCTION_PROFILER),
+        .INCLUDE_CACHE_PROFILER(INCLUDE_CACHE_PROFILER),
+        .INCLUDE_STALL_UNIT(INCLUDE_STALL_UNIT),
+        .INCLUDE_PC_SAMPLER(INCLUDE_PC_SAMPLER),
+        .INCLUDE_SNAPSHOT_DMA(1'b0),
+        .INCLUDE_EVENT_COUNTERS(INCLUDE_EVENT_COUNTERS),
+        .NUM_EVENT_COUNTERS(NUM_EVENT_COUNTERS),
+        .INCLUDE_BRANCH_HOTLIST(INCLUDE_BRANCH_HOTLIST),
+        .BRANCH_HOTLIST_ENTRIES(BRANCH_HOTLIST_ENTRIES),
+        .INCLUDE_MISS_SKETCH(INCLUDE_MISS_SKETCH),
+        .MISS_SKETCH_WIDTH(MISS_SKETCH_WIDTH),
+        .MISS_SKETCH_TOPK_ENTRIES(MISS_SKETCH_TOPK_ENTRIES),
+        .INCLUDE_BUS_PROFILER(INCLUDE_BUS_PROFILER && (h == 0)),
+        .INCLUDE_RATE_ALARMS(INCLUDE_RATE_ALARMS),
+        .NUM_RATE_ALARMS(NUM_RATE_ALARMS),
+        .PC_SAMPLE_FIFO_DEPTH(PC_SAMPLE_FIFO_DEPTH),
+        .DEFAULT_SNAPSHOT_INTERVAL(DEFAULT_SNAPSHOT_INTERVAL),
+        .COUNTER_WIDTH(COUNTER_WIDTH)
+    )
+    hart_block (
+        .clk(clk),
+        .rst(rst),
+        .abacus_irq(hart_irq[h]),
+
+        .abacus_instruction(abacus_instruction[h]),
+        .abacus_instruction_pc(abacus_instruction_pc[h]),
+        .abacus_instruction_issued(abacus_instruction_issued[h]),
+        .abacus_icache_request(abacus_icache_request[h]),
+        .abacus_dcache_request(abacus_dcache_request[h]),
+        .abacus_icache_miss(abacus_icache_miss[h]),
+        .abacus_dcache_hit(abacus_dcache_hit[h]),
+        .abacus_icache_line_fill_in_progress(abacus_icache_line_fill_in_progress[h]),
+        .abacus_dcache_line_fill_in_progress(abacus_dcache_line_fill_in_progress[h]),
+        .abacus_dcache_miss_addr(abacus_dcache_miss_addr[h]),
+        .abacus_idbus_cyc(abacus_idbus_cyc),
+        .abacus_idbus_stb(abacus_idbus_stb),
+        .abacus_idbus_we(abacus_idbus_we),
+        .abacus_idbus_sel(abacus_idbus_sel),
+        .abacus_idbus_cti(abacus_idbus_cti),
+        .abacus_idbus_ack(abacus_idbus_ack),
+        .abacus_idbus_err(abacus_idbus_err),
+        .abacus_branch_misprediction(abacus_branch_misprediction[h]),
+        .abacus_ras_misprediction(abacus_ras_misprediction[h]),
+        .abacus_branch_resolved(abacus_branch_resolved[h]),
+        .abacus_branch_pc(abacus_branch_pc[h]),
+        .abacus_issue_no_instruction_stat(abacus_issue_no_instruction_stat[h]),
+        .abacus_issue_no_id_stat(abacus_issue_no_id_stat[h]),
+        .abacus_issue_flush_stat(abacus_issue_flush_stat[h]),
+        .abacus_issue_unit_busy_stat(abacus_issue_unit_busy_stat[h]),
+        .abacus_issue_operands_not_ready_stat(abacus_issue_operands_not_ready_stat[h]),
+        .abacus_issue_hold_stat(abacus_issue_hold_stat[h]),
+        .abacus_issue_multi_source_stat(abacus_issue_multi_source_stat[h]),
+        .abacus_privilege(abacus_privilege[h]),
+        .abacus_asid(abacus_asid[h]),
+
+        .S_AXI_AWADDR('0),
+        .S_AXI_AWVALID(1'b0),
+        .S_AXI_AWREADY(),
+        .S_AXI_WDATA('0),
+        .S_AXI_WSTRB('0),
+        .S_AXI_WVALID(1'b0),
+        .S_AXI_WREADY(),
+        .S_AXI_BRESP(),
+        .S_AXI_BVALID(),
+        .S_AXI_BREADY(1'b0),
+        .S_AXI_ARADDR('0),
+        .S_AXI_ARLEN(8'h0),
+        .S_AXI_ARBURST(2'b01),
+        .S_AXI_ARVALID(1'b0),
+        .S_AXI_ARREADY(),
+        .S_AXI_RDATA(),
+        .S_AXI_RRESP(),
+        .S_AXI_RLAST(),
+        .S_AXI_RVALID(),
+        .S_AXI_RREADY(1'b0),
+
+        .wb_cyc(wb_cyc & hart_sel[h]),
+        .wb_stb(wb_stb & hart_sel[h]),
+        .wb_we(wb_we),
+        .wb_adr(wb_adr),
+        .wb_dat_i(wb_dat_i),
+        .wb_cti(wb_cti),
+        .wb_bte(wb_bte),
+        .wb_dat_o(hart_dat_o[h]),
+        .wb_ack(hart_ack[h]),
+        .wb_stall(),
+
+        .dma_wb_cyc(),
+        .dma_wb_stb(),
+        .dma_wb_we(),
+        .dma_wb_adr(),
+        .dma_wb_dat_o(),
+        .dma_wb_sel(),
+        .dma_wb_ack(1'b0),
+        .dma_wb_err(1'b0),
+
+        .snapshot_sync(global_snapshot),
+        .snapshot_sync_hold(global_hold_reg),
+        .unit_clear_sync(global_clear),
+        .window_index(window_index),
+        .window_pair(hart_window_pair[h])
+    );
+end endgenerate
+
+// Global block, acknowledged with the same timing as the hart windows
+generate if (~WB_PIPELINED) begin : gen_global_wishbone_if
+    logic wb_burst;
+    assign wb_burst = ~wb_we & (wb_cti == 3'b010) & (wb_bte == 2'b00);
+
+    always_ff @(posedge clk or posedge rst) begin
+        if (rst) begin
+            global_ack <= 1'b0;
+        end else begin
+            global_ack <= wb_cyc & wb_stb & global_sel & (~global_ack | wb_burst);
+        end
+    end
+
+    assign global_wr_en = wb_cyc & wb_stb & global_sel & wb_we & ~global_ack;
+    assign global_dat_o = global_rd_data;
+end else begin : gen_global_wishbone_pipelined_if
+    always_ff @(posedge clk or posedge rst) begin
+        if (rst) begin
+            global_ack <= 1'b0;
+            global_dat_o <= 32'h0;
+        end else begin
+            global_ack <= wb_cyc & wb_stb & global_sel;
+            global_dat_o <= global_rd_data;
+        end
+    end
+
+    assign global_wr_en = wb_cyc & wb_stb & global_sel & wb_we;
+end endgenerate
+
+// A global snapshot reaches every hart on the same edge, and the hold keeps their automatic snapshots
+// back until software has read what it needs, so the harts can be compared counter for counter
+assign global_snapshot = global_wr_en & (wb_adr == GLOBAL_SNAPSHOT_ADDR) & wb_dat_i[0];
+
+// A global clear restarts the same units of every hart on the same edge
+assign global_clear = (global_wr_en & (wb_adr == GLOBAL_CLEAR_ADDR)) ? wb_dat_i[7:0] : 8'h0;
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        global_hold_reg <= 1'b0;
+    end else if (global_wr_en & (wb_adr == GLOBAL_SNAPSHOT_ADDR)) begin
+        global_hold_reg <= wb_dat_i[1];
+    end
+end
+
+// Aggregate window, the whole counter is summed so a carry between its words is never lost
+assign window_index = wb_adr[9:2] - AGGREGATE_WINDOW_ADDR[9:2];
+
+always_comb begin
+    aggregate_sum = 64'h0;
+    aggregate_min = 32'hffffffff;
+    aggregate_max = 32'h0;
+    for (int i = 0; i < NUM_HARTS; i++) begin
+        aggregate_sum = aggregate_sum + hart_window_pair[i];
+        if (hart_window_pair[i][31:0] < aggregate_min) begin
+            aggregate_min = hart_window_pair[i][31:0];
+        end
+        if (hart_window_pair[i][63:32] > aggregate_max) begin
+            aggregate_max = hart_window_pair[i][63:32];
+        end
+    end
+end
+
+always_comb begin
+    if ((wb_adr >= AGGREGATE_WINDOW_ADDR) && (wb_adr < AGGREGATE_WINDOW_ADDR + 4 * SNAPSHOT_WINDOW_WORDS)) begin
+        if (window_index < 8'(2 * SNAPSHOT_WINDOW_COUNTERS)) begin
+            global_rd_data = window_index[0] ? aggregate_sum[63:32] : aggregate_sum[31:0];
+        end else begin
+            global_rd_data = window_index[0] ? aggregate_max : aggregate_min;
+        end
+    end else begin
+        case (wb_adr)
+            NUM_HARTS_ADDR: global_rd_data = 32'(NUM_HARTS);
+            GLOBAL_SNAPSHOT_ADDR: global_rd_data = {30'h0, global_hold_reg, 1'b0};
+            HART_IRQ_STATUS_ADDR: global_rd_data = 32'(hart_irq);
+            default: global_rd_data = 32'h0;
+        endcase
+    end
+end
+
+endmodule
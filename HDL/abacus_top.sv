@@ -1,19 +1,37 @@
 module abacus_top
 #(
     parameter integer C_S_AXI_DATA_WIDTH	     = 32,
-    parameter integer C_S_AXI_ADDR_WIDTH	     = 8,
+    parameter integer C_S_AXI_ADDR_WIDTH	     = 12,    // Offset within the 4 KiB register map, ABACUS_BASE_ADDR must be aligned to it
     parameter logic WITH_AXI                     = 1'b0,
+    parameter logic WB_PIPELINED                 = 1'b0,  // Wishbone B4 pipelined mode instead of classic cycles
     parameter [31:0] ABACUS_BASE_ADDR            = 32'hf0030000,
     parameter logic INCLUDE_INSTRUCTION_PROFILER = 1'b1,
     parameter logic INCLUDE_CACHE_PROFILER       = 1'b1,
 	parameter logic INCLUDE_STALL_UNIT			 = 1'b1,
-    parameter unsigned CLOCK_FREQ                = 1000000 // 1MHz
+    parameter logic INCLUDE_PC_SAMPLER           = 1'b1,
+    parameter logic INCLUDE_SNAPSHOT_DMA         = 1'b0,  // Bus master that writes snapshots to a ring in memory
+    parameter logic INCLUDE_EVENT_COUNTERS       = 1'b1,
+    parameter integer NUM_EVENT_COUNTERS         = 4,     // 1 to 16 programmable counters
+    parameter logic INCLUDE_BRANCH_HOTLIST       = 1'b1,
+    parameter integer BRANCH_HOTLIST_ENTRIES     = 8,     // 1 to 15 mispredicted branches tracked
+    parameter logic INCLUDE_MISS_SKETCH          = 1'b1,
+    parameter integer MISS_SKETCH_WIDTH          = 1024,  // Counters per sketch row, power of two, 64 to 4096
+    parameter integer MISS_SKETCH_TOPK_ENTRIES   = 8,     // 1 to 16 most missed granules tracked
+    parameter logic INCLUDE_BUS_PROFILER         = 1'b1,
+    parameter logic INCLUDE_RATE_ALARMS          = 1'b1,
+    parameter integer NUM_RATE_ALARMS            = 4,     // 1 to 8 rate threshold alarms
+    parameter integer PC_SAMPLE_FIFO_DEPTH       = 256,   // Power of two
+    parameter [31:0] DEFAULT_SNAPSHOT_INTERVAL   = 32'd1, // Cycles between automatic snapshots out of reset, 0 = software snapshots only
+    parameter integer COUNTER_WIDTH              = 64     // 32 to 64 bits, upper bits are read through COUNTER_HI
 )
 (
     input logic clk,
     input logic rst,
 
+    output logic abacus_irq, // Counter overflow, snapshot ring and rate alarm interrupt, level sensitive
+
     input [31:0] abacus_instruction,
+    input [31:0] abacus_instruction_pc,
     input abacus_instruction_issued,
 	
     input logic abacus_icache_request,
@@ -22,9 +40,21 @@ module abacus_top
     input logic abacus_dcache_hit,
     input logic abacus_icache_line_fill_in_progress,
     input logic abacus_dcache_line_fill_in_progress,
+    input logic [31:0] abacus_dcache_miss_addr, // Address of the line being filled, valid when the fill starts
+
+    // Memory bus of the core, a classic Wishbone master snooped by the bus profiler
+    input logic abacus_idbus_cyc,
+    input logic abacus_idbus_stb,
+    input logic abacus_idbus_we,
+    input logic [3:0] abacus_idbus_sel,
+    input logic [2:0] abacus_idbus_cti,
+    input logic abacus_idbus_ack,
+    input logic abacus_idbus_err,
 
 	input logic abacus_branch_misprediction,
 	input logic abacus_ras_misprediction,
+	input logic abacus_branch_resolved,  // A branch resolved this cycle, abacus_branch_misprediction is high if it was mispredicted
+	input logic [31:0] abacus_branch_pc, // PC of the resolved branch
 	input logic abacus_issue_no_instruction_stat,
 	input logic abacus_issue_no_id_stat,
 	input logic abacus_issue_flush_stat,
@@ -32,6 +62,8 @@ module abacus_top
 	input logic abacus_issue_operands_not_ready_stat,
 	input logic abacus_issue_hold_stat,
 	input logic abacus_issue_multi_source_stat,
+	input logic [1:0] abacus_privilege, // Privilege mode of the hart, 0 user, 1 supervisor, 3 machine
+	input logic [8:0] abacus_asid,      // ASID field of satp, the address space being run
 
     // Modified AXI-Lite Interface from Vivado IP Generator
     input wire [C_S_AXI_ADDR_WIDTH-1 : 0] S_AXI_AWADDR,
@@ -45,10 +77,13 @@ module abacus_top
     output wire  S_AXI_BVALID,
     input wire  S_AXI_BREADY,
     input wire [C_S_AXI_ADDR_WIDTH-1 : 0] S_AXI_ARADDR,
+    input wire [7 : 0] S_AXI_ARLEN,   // AXI4 read bursts, tie to 0 for an AXI-Lite master
+    input wire [1 : 0] S_AXI_ARBURST,
     input wire  S_AXI_ARVALID,
     output wire  S_AXI_ARREADY,
     output wire [C_S_AXI_DATA_WIDTH-1 : 0] S_AXI_RDATA,
     output wire [1 : 0] S_AXI_RRESP,
+    output wire  S_AXI_RLAST,
     output wire  S_AXI_RVALID,
     input wire  S_AXI_RREADY,
     
@@ -58,36 +93,75 @@ module abacus_top
     input logic wb_we,
     input logic [31:0] wb_adr,
     input logic [31:0] wb_dat_i,
+    input logic [2:0] wb_cti,  // Cycle type, 3'b010 requests an incrementing burst
+    input logic [1:0] wb_bte,
     output logic [31:0] wb_dat_o,
-    output logic wb_ack
+    output logic wb_ack,
+    output logic wb_stall,     // Pipelined mode only, always 0 as every request is taken at once
+
+    // Wishbone classic master of the snapshot ring, byte addressed
+    output logic dma_wb_cyc,
+    output logic dma_wb_stb,
+    output logic dma_wb_we,
+    output logic [31:0] dma_wb_adr,
+    output logic [31:0] dma_wb_dat_o,
+    output logic [3:0] dma_wb_sel,
+    input logic dma_wb_ack,
+    input logic dma_wb_err,
+
+    // Multi-hart builds, driven by abacus_smp. Tie the inputs to 0 when abacus_top is used on its own.
+    input logic snapshot_sync,       // Take a snapshot on the same edge as every other hart
+    input logic snapshot_sync_hold,  // Hold back automatic snapshots, like bit 1 of Snapshot
+    input logic [7:0] unit_clear_sync, // Clear units on the same edge as every other hart, like Unit Clear
+    input logic [7:0] window_index,  // Word of the snapshot window to read through window_pair
+    output logic [63:0] window_pair  // The aligned pair of window words holding window_index, high word first
 );
 
 // All addresses must be 4-byte (dword) aligned
 localparam logic [31:0] INSTRUCTION_PROFILE_UNIT_ENABLE_ADDR  = ABACUS_BASE_ADDR + 16'h0004;
 localparam logic [31:0] CACHE_PROFILE_UNIT_ENABLE_ADDR       = ABACUS_BASE_ADDR + 16'h0008;
 localparam logic [31:0] STALL_UNIT_ENABLE_ADDR       = ABACUS_BASE_ADDR + 16'h000C;
+localparam logic [31:0] SNAPSHOT_ADDR                        = ABACUS_BASE_ADDR + 16'h0010; // Bit 0: latch every counter in the same cycle, bit 1: hold
+localparam logic [31:0] SNAPSHOT_INTERVAL_ADDR               = ABACUS_BASE_ADDR + 16'h0014; // Cycles between automatic snapshots, 0 disables
+localparam logic [31:0] COUNTER_HI_ADDR                      = ABACUS_BASE_ADDR + 16'h0018; // Upper 32 bits of the last counter read
+localparam logic [31:0] IRQ_ENABLE_ADDR                      = ABACUS_BASE_ADDR + 16'h001C; // Bit 0: interrupt on counter overflow, bit 1: on the snapshot ring, bit 2: on a rate alarm
+localparam logic [31:0] INSTRUCTION_PROFILE_UNIT_OVERFLOW_ADDR = ABACUS_BASE_ADDR + 16'h0020; // Sticky, write 1 to clear
+localparam logic [31:0] CACHE_PROFILE_UNIT_OVERFLOW_ADDR     = ABACUS_BASE_ADDR + 16'h0024; // Sticky, write 1 to clear
+localparam logic [31:0] STALL_UNIT_OVERFLOW_ADDR             = ABACUS_BASE_ADDR + 16'h0028; // Sticky, write 1 to clear
+localparam logic [31:0] PC_SAMPLER_ENABLE_ADDR               = ABACUS_BASE_ADDR + 16'h002C;
+localparam logic [31:0] STALL_UNIT_LEVEL_MODE_ADDR           = ABACUS_BASE_ADDR + 16'h0030; // Bit n: stall counter n counts cycles, not events
+localparam logic [31:0] EVENT_COUNTER_OVERFLOW_ADDR          = ABACUS_BASE_ADDR + 16'h0034; // Sticky, write 1 to clear
+localparam logic [31:0] BRANCH_HOTLIST_ENABLE_ADDR           = ABACUS_BASE_ADDR + 16'h0038;
+localparam logic [31:0] MISS_SKETCH_ENABLE_ADDR              = ABACUS_BASE_ADDR + 16'h003C;
+localparam logic [31:0] BUS_PROFILER_ENABLE_ADDR             = ABACUS_BASE_ADDR + 16'h0040;
+localparam logic [31:0] BUS_PROFILER_OVERFLOW_ADDR           = ABACUS_BASE_ADDR + 16'h0044; // Sticky, write 1 to clear
+localparam logic [31:0] UNIT_CLEAR_ADDR                      = ABACUS_BASE_ADDR + 16'h0048; // Write 1 to bit n to clear unit n, reads 0
+
+// Enable registers only gate counting: a disabled unit keeps its counters, so a region can be
+// measured over many calls with the profiler's own code paused out. Unit Clear empties units, bit 0
+// instruction profile unit, 1 cache profile unit, 2 stall unit, 3 PC sampler, 4 branch hot list,
+// 5 miss sketch, 6 bus profiler and 7 event counters, in the order of the ABACUS_UNIT_* bits.
+localparam integer UNIT_CLEAR_IP     = 0;
+localparam integer UNIT_CLEAR_CP     = 1;
+localparam integer UNIT_CLEAR_SU     = 2;
+localparam integer UNIT_CLEAR_PC     = 3;
+localparam integer UNIT_CLEAR_BH     = 4;
+localparam integer UNIT_CLEAR_MS     = 5;
+localparam integer UNIT_CLEAR_BUS    = 6;
+localparam integer UNIT_CLEAR_EVENTS = 7;
+
+logic [7:0] unit_clear;
 
 localparam logic [31:0] INSTRUCTION_PROFILE_UNIT_BASE_ADDR   = ABACUS_BASE_ADDR + 16'h0100;
 
-// Read-only counter base addresses
-localparam logic [31:0] LOAD_WORD_COUNTER_ADDR               = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h0000;
-localparam logic [31:0] STORE_WORD_COUNTER_ADDR              = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h0004;
-localparam logic [31:0] ADDITION_COUNTER_ADDR                = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h0008;
-localparam logic [31:0] SUBTRACTION_COUNTER_ADDR             = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h000C;
-localparam logic [31:0] BRANCH_COUNTER_ADDR                  = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h0010;
-localparam logic [31:0] JUMP_COUNTER_ADDR                    = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h0014;
-localparam logic [31:0] SYSTEM_PRIVILEGE_COUNTER_ADDR        = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h0018;
-localparam logic [31:0] ATOMIC_COUNTER_ADDR                  = INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 16'h001C;
+// Read-only instruction class counters, one every 4 bytes from the base address in the order of the
+// CLASS_* indices of instruction_profiler: load, store, addition, subtraction, branch, jump,
+// system privilege, atomic, logical, shift, compare, upper immediate, multiply, divide, CSR, fence,
+// FP load, FP store, FP arithmetic, FP fused multiply-add, FP divide/sqrt, other, total issued
+localparam integer INSTRUCTION_CLASSES = 23;
 
 reg [31:0] instruction_profile_unit_enable_reg;
-reg [31:0] load_word_counter_reg;
-reg [31:0] store_word_counter_reg;
-reg [31:0] addition_counter_reg;
-reg [31:0] subtraction_counter_reg;
-reg [31:0] branch_counter_reg;
-reg [31:0] jump_counter_reg;
-reg [31:0] system_privilege_counter_reg;
-reg [31:0] atomic_counter_reg;
+reg [COUNTER_WIDTH-1:0] instruction_class_counter_reg [INSTRUCTION_CLASSES];
 
 
 localparam logic [31:0] CACHE_PROFILE_UNIT_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0200;
@@ -102,15 +176,37 @@ localparam logic [31:0] DCACHE_HIT_COUNTER_ADDR              = CACHE_PROFILE_UNI
 localparam logic [31:0] DCACHE_MISS_COUNTER_ADDR             = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0018;
 localparam logic [31:0] DCACHE_LINE_FILL_LATENCY_ADDR        = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h001C;
 
+localparam logic [31:0] LINE_FILL_OCCUPANCY_ADDR             = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0020; // Outstanding fills summed per cycle
+localparam logic [31:0] LINE_FILL_ACTIVE_ADDR                = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0024; // Cycles with any fill outstanding
+
+// Line fill latency histograms, one counter every 4 bytes, bucket b counts fills of 2^b to 2^(b+1)-1 cycles
+localparam integer LATENCY_BUCKETS = 12;
+localparam logic [31:0] ICACHE_LINE_FILL_HISTOGRAM_ADDR      = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0028;
+localparam logic [31:0] DCACHE_LINE_FILL_HISTOGRAM_ADDR      = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0058;
+
+// Shortest and longest fill in cycles, 32 bits, the minimum reads all ones until the first fill completes
+localparam logic [31:0] ICACHE_LINE_FILL_MIN_ADDR            = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0088;
+localparam logic [31:0] ICACHE_LINE_FILL_MAX_ADDR            = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h008C;
+localparam logic [31:0] DCACHE_LINE_FILL_MIN_ADDR            = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0090;
+localparam logic [31:0] DCACHE_LINE_FILL_MAX_ADDR            = CACHE_PROFILE_UNIT_BASE_ADDR + 16'h0094;
+
 reg [31:0] cache_profile_unit_enable_reg;
-reg [31:0] icache_request_counter_reg;
-reg [31:0] icache_hit_counter_reg;
-reg [31:0] icache_miss_counter_reg;
-reg [31:0] icache_line_fill_latency_counter_reg;
-reg [31:0] dcache_request_counter_reg;
-reg [31:0] dcache_hit_counter_reg;
-reg [31:0] dcache_miss_counter_reg;
-reg [31:0] dcache_line_fill_latency_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_request_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_hit_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_miss_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_line_fill_latency_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_request_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_hit_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_miss_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_line_fill_latency_counter_reg;
+reg [COUNTER_WIDTH-1:0] line_fill_occupancy_counter_reg;
+reg [COUNTER_WIDTH-1:0] line_fill_active_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_line_fill_histogram_reg [LATENCY_BUCKETS];
+reg [COUNTER_WIDTH-1:0] dcache_line_fill_histogram_reg [LATENCY_BUCKETS];
+reg [31:0] icache_line_fill_min_reg;
+reg [31:0] icache_line_fill_max_reg;
+reg [31:0] dcache_line_fill_min_reg;
+reg [31:0] dcache_line_fill_max_reg;
 
 localparam logic [31:0] STALL_UNIT_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0300;
 
@@ -123,17 +219,292 @@ localparam logic [31:0] ISSUE_UNIT_BUSY_STAT_COUNTER_ADDR 	= STALL_UNIT_BASE_ADD
 localparam logic [31:0] ISSUE_OPERANDS_NOT_READY_STAT_COUNTER_ADDR 	= STALL_UNIT_BASE_ADDR + 16'h0018;
 localparam logic [31:0] ISSUE_HOLD_STAT_COUNTER_ADDR 		= STALL_UNIT_BASE_ADDR + 16'h001C;
 localparam logic [31:0] ISSUE_MULTI_SOURCE_STAT_ADDR 		= STALL_UNIT_BASE_ADDR + 16'h0020;
+localparam logic [31:0] CYCLE_COUNTER_ADDR 			= STALL_UNIT_BASE_ADDR + 16'h0024;
+localparam logic [31:0] INSTRUCTION_COUNTER_ADDR 		= STALL_UNIT_BASE_ADDR + 16'h0028; // Issued instructions
+
+// CPI stack, cycles that did not issue in the category of their first stall cause, one counter every
+// 4 bytes in the order flush, frontend empty, hold, operand dependency, unit busy, other
+localparam integer CPI_STALLS = 6;
+localparam logic [31:0] CPI_STALL_COUNTER_ADDR 			= STALL_UNIT_BASE_ADDR + 16'h002C;
 
 reg [31:0] stall_unit_enable_reg;
-reg [31:0] branch_misprediction_counter_reg;
-reg [31:0] ras_misprediction_counter_reg;
-reg [31:0] issue_no_instruction_stat_counter_reg;
-reg [31:0] issue_no_id_stat_counter_reg;
-reg [31:0] issue_flush_stat_counter_reg;
-reg [31:0] issue_unit_busy_stat_counter_reg;
-reg [31:0] issue_operands_not_ready_stat_counter_reg;
-reg [31:0] issue_hold_stat_counter_reg;
-reg [31:0] issue_multi_source_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] branch_misprediction_counter_reg;
+reg [COUNTER_WIDTH-1:0] ras_misprediction_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_no_instruction_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_no_id_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_flush_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_unit_busy_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_operands_not_ready_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_hold_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_multi_source_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] cycle_counter_reg;
+reg [COUNTER_WIDTH-1:0] instruction_counter_reg;
+reg [COUNTER_WIDTH-1:0] cpi_stall_counter_reg [CPI_STALLS];
+reg [31:0] stall_unit_level_mode_reg;
+
+localparam logic [31:0] PC_SAMPLER_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0400;
+
+localparam logic [31:0] PC_SAMPLE_PERIOD_ADDR                = PC_SAMPLER_BASE_ADDR + 16'h0000; // Cycles between samples, 0 stops sampling
+localparam logic [31:0] PC_SAMPLE_COUNT_ADDR                 = PC_SAMPLER_BASE_ADDR + 16'h0004; // Samples waiting in the FIFO
+localparam logic [31:0] PC_SAMPLE_DATA_ADDR                  = PC_SAMPLER_BASE_ADDR + 16'h0008; // Oldest sample, reading it pops the FIFO
+localparam logic [31:0] PC_SAMPLE_DROPPED_ADDR               = PC_SAMPLER_BASE_ADDR + 16'h000C; // Samples lost to a full FIFO
+
+reg [31:0] pc_sampler_enable_reg;
+reg [31:0] pc_sample_period_reg;
+logic [31:0] pc_sample;
+logic [31:0] pc_sample_count;
+logic [31:0] pc_sample_dropped;
+logic pc_sample_pop;
+
+// Region-of-interest triggers, gate counting in the instruction, cache and stall units
+localparam logic [31:0] TRIGGER_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0500;
+
+localparam logic [31:0] TRIGGER_CONTROL_ADDR                 = TRIGGER_BASE_ADDR + 16'h0000; // Bit 0: PC ranges, bit 1: markers, a write leaves the region
+localparam logic [31:0] TRIGGER_STATUS_ADDR                  = TRIGGER_BASE_ADDR + 16'h0004; // Bit 0: inside the region
+localparam logic [31:0] TRIGGER_REGION_COUNT_ADDR            = TRIGGER_BASE_ADDR + 16'h0008; // Regions entered since the last control write
+localparam logic [31:0] TRIGGER_START_PC_LOW_ADDR            = TRIGGER_BASE_ADDR + 16'h0010;
+localparam logic [31:0] TRIGGER_START_PC_HIGH_ADDR           = TRIGGER_BASE_ADDR + 16'h0014;
+localparam logic [31:0] TRIGGER_STOP_PC_LOW_ADDR             = TRIGGER_BASE_ADDR + 16'h0018;
+localparam logic [31:0] TRIGGER_STOP_PC_HIGH_ADDR            = TRIGGER_BASE_ADDR + 16'h001C;
+
+reg [31:0] trigger_control_reg;
+reg [31:0] trigger_start_pc_low_reg;
+reg [31:0] trigger_start_pc_high_reg;
+reg [31:0] trigger_stop_pc_low_reg;
+reg [31:0] trigger_stop_pc_high_reg;
+logic trigger_count_enable;
+logic trigger_active;
+logic [31:0] trigger_region_count;
+
+// Snapshot window, every snapshot counter as a little-endian pair of 32-bit words, packed in the order
+// of the instruction, cache profile and stall unit blocks, then the four 32-bit line fill extremes.
+// This is the layout of struct abacus_counters from its ip member on, and reads have no side effect,
+// so software can copy the whole snapshot with one burst instead of a low and high read per counter.
+localparam logic [31:0] SNAPSHOT_WINDOW_ADDR = ABACUS_BASE_ADDR + 16'h0800;
+localparam integer SNAPSHOT_WINDOW_COUNTERS = INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 11 + CPI_STALLS;
+localparam integer SNAPSHOT_WINDOW_WORDS = 2 * SNAPSHOT_WINDOW_COUNTERS + 4;
+
+logic [63:0] snapshot_window_counter [SNAPSHOT_WINDOW_COUNTERS];
+logic [31:0] snapshot_window [SNAPSHOT_WINDOW_WORDS];
+
+// Programmable event counters. Counter n counts the core event chosen by its select register: bits 7:0
+// are the event, in the order below, bit 8 counts rising edges instead of cycles, and bit 31 enables
+// it, the counter holding its count while the bit is clear. The events are the single-bit core nets in
+// port order, then every cycle.
+localparam logic [31:0] EVENT_COUNTER_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0700;
+
+localparam logic [31:0] EVENT_COUNTER_ADDR                   = EVENT_COUNTER_BASE_ADDR + 16'h0000; // One counter every 4 bytes
+localparam logic [31:0] EVENT_SELECT_ADDR                    = EVENT_COUNTER_BASE_ADDR + 16'h0040; // One select register every 4 bytes, a write clears the counter
+localparam logic [31:0] EVENT_NUM_COUNTERS_ADDR              = EVENT_COUNTER_BASE_ADDR + 16'h0080; // Counters in the bank, 0 without one
+localparam integer NUM_EVENTS = 17;
+
+reg [31:0] event_select_reg [NUM_EVENT_COUNTERS];
+reg [COUNTER_WIDTH-1:0] event_counter_reg [NUM_EVENT_COUNTERS];
+reg [NUM_EVENT_COUNTERS-1:0] event_counter_overflow_reg;
+logic [NUM_EVENT_COUNTERS-1:0] event_counter_overflow;
+logic [NUM_EVENT_COUNTERS-1:0] event_select_write;
+logic [NUM_EVENTS-1:0] core_events;
+
+// Branch misprediction hot list, the most mispredicted branches in a space-saving table, see
+// branch_hotlist. Entry n is four 32-bit registers from BRANCH_HOTLIST_ENTRY_ADDR + 16 * n: PC,
+// mispredictions, executions and error, all zero for an empty entry. Read after a snapshot like the counters.
+localparam logic [31:0] BRANCH_HOTLIST_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0B00;
+
+localparam logic [31:0] BRANCH_HOTLIST_ENTRIES_ADDR          = BRANCH_HOTLIST_BASE_ADDR + 16'h0000; // Entries in the table, 0 without one
+localparam logic [31:0] BRANCH_HOTLIST_MISPREDICTS_ADDR      = BRANCH_HOTLIST_BASE_ADDR + 16'h0004; // Every mispredicted branch, 32 bits
+localparam logic [31:0] BRANCH_HOTLIST_BRANCHES_ADDR         = BRANCH_HOTLIST_BASE_ADDR + 16'h0008; // Every resolved branch, 32 bits
+localparam logic [31:0] BRANCH_HOTLIST_ENTRY_ADDR            = BRANCH_HOTLIST_BASE_ADDR + 16'h0010;
+localparam integer BRANCH_HOTLIST_INDEX_WIDTH = BRANCH_HOTLIST_ENTRIES > 1 ? $clog2(BRANCH_HOTLIST_ENTRIES) : 1;
+
+reg [31:0] branch_hotlist_enable_reg;
+reg [31:0] branch_hotlist_pc_reg [BRANCH_HOTLIST_ENTRIES];
+reg [31:0] branch_hotlist_mispredicts_reg [BRANCH_HOTLIST_ENTRIES];
+reg [31:0] branch_hotlist_executions_reg [BRANCH_HOTLIST_ENTRIES];
+reg [31:0] branch_hotlist_error_reg [BRANCH_HOTLIST_ENTRIES];
+reg [31:0] branch_hotlist_total_mispredicts_reg;
+reg [31:0] branch_hotlist_total_branches_reg;
+logic [3:0] branch_hotlist_rd_offset;
+logic [BRANCH_HOTLIST_INDEX_WIDTH-1:0] branch_hotlist_rd_entry;
+logic branch_hotlist_rd_valid;
+logic [31:0] branch_hotlist_entry_word [4];
+
+// Data cache miss sketch, misses per address granule in a count-min sketch with a top-K table, see
+// miss_sketch. Set the granule and the filter, then clear it through Unit Clear, it sweeps itself
+// for MISS_SKETCH_WIDTH cycles after that, as it does out of reset. Top-K entry n is two 32-bit registers from
+// MISS_SKETCH_TOPK_ADDR + 8 * n, the first address of the granule and its estimated misses, read
+// after a snapshot like the counters. The sketch itself is read live: write the index of the first
+// counter, row * MISS_SKETCH_WIDTH + column, then every read of MISS_SKETCH_DATA returns a counter
+// and moves on to the next. Those reads must be single transfers, not bursts, since the counters are
+// in block RAM and the next one is only ready two cycles after a read.
+localparam logic [31:0] MISS_SKETCH_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0C00;
+
+localparam logic [31:0] MISS_SKETCH_WIDTH_ADDR               = MISS_SKETCH_BASE_ADDR + 16'h0000; // Counters per row, 0 without a sketch
+localparam logic [31:0] MISS_SKETCH_TOPK_ENTRIES_ADDR        = MISS_SKETCH_BASE_ADDR + 16'h0004; // Entries in the top-K table
+localparam logic [31:0] MISS_SKETCH_STATUS_ADDR              = MISS_SKETCH_BASE_ADDR + 16'h0008; // Bit 0: clearing
+localparam logic [31:0] MISS_SKETCH_GRANULE_SHIFT_ADDR       = MISS_SKETCH_BASE_ADDR + 16'h000C; // Granule = address >> shift, 6 for lines, 12 for pages
+localparam logic [31:0] MISS_SKETCH_FILTER_LOW_ADDR          = MISS_SKETCH_BASE_ADDR + 16'h0010; // Lowest address counted
+localparam logic [31:0] MISS_SKETCH_FILTER_HIGH_ADDR         = MISS_SKETCH_BASE_ADDR + 16'h0014; // Highest address counted
+localparam logic [31:0] MISS_SKETCH_TOTAL_ADDR               = MISS_SKETCH_BASE_ADDR + 16'h0018; // Misses counted, 32 bits
+localparam logic [31:0] MISS_SKETCH_INDEX_ADDR               = MISS_SKETCH_BASE_ADDR + 16'h001C; // Next counter read through MISS_SKETCH_DATA
+localparam logic [31:0] MISS_SKETCH_DATA_ADDR                = MISS_SKETCH_BASE_ADDR + 16'h0020;
+localparam logic [31:0] MISS_SKETCH_TOPK_ADDR                = MISS_SKETCH_BASE_ADDR + 16'h0040;
+
+reg [31:0] miss_sketch_enable_reg;
+reg [31:0] miss_sketch_granule_shift_reg;
+reg [31:0] miss_sketch_filter_low_reg;
+reg [31:0] miss_sketch_filter_high_reg;
+reg [31:0] miss_sketch_index_reg;
+reg [31:0] miss_sketch_topk_addr_reg [MISS_SKETCH_TOPK_ENTRIES];
+reg [31:0] miss_sketch_topk_count_reg [MISS_SKETCH_TOPK_ENTRIES];
+reg [31:0] miss_sketch_total_reg;
+logic [31:0] miss_sketch_data;
+logic miss_sketch_clearing;
+logic miss_sketch_pop;
+
+// Memory bus profiler, traffic and first word latency of the idbus, see bus_profiler. The 64-bit
+// counters are read like those of the cache profiler, after a snapshot.
+localparam logic [31:0] BUS_PROFILER_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0D00;
+
+localparam logic [31:0] BUS_CYCLE_COUNTER_ADDR               = BUS_PROFILER_BASE_ADDR + 16'h0000; // Cycles counted
+localparam logic [31:0] BUS_READ_COUNTER_ADDR                = BUS_PROFILER_BASE_ADDR + 16'h0004; // Read transactions, a burst counts once
+localparam logic [31:0] BUS_WRITE_COUNTER_ADDR               = BUS_PROFILER_BASE_ADDR + 16'h0008; // Write transactions
+localparam logic [31:0] BUS_READ_BYTES_COUNTER_ADDR          = BUS_PROFILER_BASE_ADDR + 16'h000C; // Bytes read, from the byte selects
+localparam logic [31:0] BUS_WRITE_BYTES_COUNTER_ADDR         = BUS_PROFILER_BASE_ADDR + 16'h0010; // Bytes written
+localparam logic [31:0] BUS_BUSY_COUNTER_ADDR                = BUS_PROFILER_BASE_ADDR + 16'h0014; // Cycles with cyc high
+localparam logic [31:0] BUS_OCCUPANCY_COUNTER_ADDR           = BUS_PROFILER_BASE_ADDR + 16'h0018; // Outstanding requests summed per cycle
+localparam logic [31:0] BUS_WAIT_COUNTER_ADDR                = BUS_PROFILER_BASE_ADDR + 16'h001C; // Cycles requested but not acknowledged
+localparam logic [31:0] BUS_LATENCY_COUNTER_ADDR             = BUS_PROFILER_BASE_ADDR + 16'h0020; // First word latencies summed
+
+// First word latency histogram, one counter every 4 bytes, then the extremes in cycles, 32 bits
+localparam logic [31:0] BUS_LATENCY_HISTOGRAM_ADDR           = BUS_PROFILER_BASE_ADDR + 16'h0028;
+localparam logic [31:0] BUS_LATENCY_MIN_ADDR                 = BUS_PROFILER_BASE_ADDR + 16'h0058;
+localparam logic [31:0] BUS_LATENCY_MAX_ADDR                 = BUS_PROFILER_BASE_ADDR + 16'h005C;
+
+reg [31:0] bus_profiler_enable_reg;
+reg [COUNTER_WIDTH-1:0] bus_cycle_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_read_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_write_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_read_bytes_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_write_bytes_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_busy_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_occupancy_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_wait_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_latency_counter_reg;
+reg [COUNTER_WIDTH-1:0] bus_latency_histogram_reg [LATENCY_BUCKETS];
+reg [31:0] bus_latency_min_reg;
+reg [31:0] bus_latency_max_reg;
+reg [9:0] bus_profiler_overflow_reg;
+logic [9:0] bus_profiler_overflow;
+
+// Rate alarms, each watches one core event over tumbling windows of counted cycles, see rate_alarm_bank.
+// Alarm n is four registers from RATE_ALARM_ADDR + 16 * n: select, encoded like the event selects with
+// bit 9 to freeze the snapshot, window, threshold and the count of the last full window. The first
+// crossing sets its status bit and latches the PC of the last issued instruction and the timestamp
+// until status is cleared. A crossing of a freezing alarm takes a snapshot, and automatic snapshots
+// are held back while the status bit of any freezing alarm is set, so the counters read after the
+// interrupt are those of the crossing cycle, or of the end of a snapshot hold in progress at the
+// crossing. Software snapshots are still taken, so read the frozen window before writing SNAPSHOT.
+localparam logic [31:0] RATE_ALARM_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0E00;
+
+localparam logic [31:0] RATE_ALARM_COUNT_ADDR                = RATE_ALARM_BASE_ADDR + 16'h0000; // Alarms in the bank, 0 without one
+localparam logic [31:0] RATE_ALARM_STATUS_ADDR               = RATE_ALARM_BASE_ADDR + 16'h0004; // Bit n: alarm n crossed, sticky, write 1 to clear
+localparam logic [31:0] RATE_ALARM_PC_ADDR                   = RATE_ALARM_BASE_ADDR + 16'h0008; // Last issued PC at the first crossing
+localparam logic [31:0] RATE_ALARM_TIMESTAMP_ADDR            = RATE_ALARM_BASE_ADDR + 16'h0010; // Cycles since reset at the first crossing, 64 bits
+localparam logic [31:0] RATE_ALARM_ADDR                      = RATE_ALARM_BASE_ADDR + 16'h0020;
+localparam integer RATE_ALARM_SELECT_FREEZE = 9;
+
+reg [31:0] rate_alarm_select_reg [NUM_RATE_ALARMS];
+reg [31:0] rate_alarm_window_reg [NUM_RATE_ALARMS];
+reg [31:0] rate_alarm_threshold_reg [NUM_RATE_ALARMS];
+reg [NUM_RATE_ALARMS-1:0] rate_alarm_status_reg;
+reg [31:0] rate_alarm_pc_reg;
+reg [63:0] rate_alarm_timestamp_reg;
+reg [31:0] last_issued_pc_reg;
+logic [31:0] rate_alarm_last [NUM_RATE_ALARMS];
+logic [NUM_RATE_ALARMS-1:0] rate_alarm_crossing;
+logic [NUM_RATE_ALARMS-1:0] rate_alarm_select_write;
+logic [NUM_RATE_ALARMS-1:0] rate_alarm_freeze_mask;
+logic [2:0] rate_alarm_rd_index;
+logic [31:0] rate_alarm_word [4];
+logic rate_alarm_frozen;
+logic rate_alarm_freeze;
+logic rate_alarm_snapshot;
+reg rate_alarm_snapshot_pending_reg;
+
+// Unit filters, one per unit in the order of the Unit Clear bits, the event counter filter also gates
+// the rate alarms. A unit counts only in the cycles its filter passes: bit m of bits 3:0 passes
+// privilege mode m, and with bit 31 set the ASID in bits 24:16 must also match abacus_asid. An event
+// belongs to the mode and address space of the cycle it is seen in. Out of reset every mode passes.
+localparam logic [31:0] UNIT_FILTER_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0F00;
+
+localparam logic [31:0] UNIT_FILTER_ADDR                     = UNIT_FILTER_BASE_ADDR + 16'h0000; // One filter every 4 bytes
+localparam logic [31:0] CORE_MODE_ADDR                       = UNIT_FILTER_BASE_ADDR + 16'h0020; // Bits 1:0 privilege, bits 24:16 ASID of the hart now
+localparam integer UNIT_FILTERS = 8;
+localparam integer UNIT_FILTER_ASID_MATCH = 31;
+
+reg [31:0] unit_filter_reg [UNIT_FILTERS];
+logic [UNIT_FILTERS-1:0] unit_filter_pass;
+
+// Snapshot ring, records of every automatic snapshot written to memory by a bus master
+localparam logic [31:0] RING_BASE_ADDR = ABACUS_BASE_ADDR + 16'h0600;
+
+localparam logic [31:0] RING_CONTROL_ADDR                    = RING_BASE_ADDR + 16'h0000; // Bit 0: enable, writing it as 1 starts from record 0
+localparam logic [31:0] RING_ADDRESS_ADDR                    = RING_BASE_ADDR + 16'h0004; // Bus address of record 0
+localparam logic [31:0] RING_ENTRIES_ADDR                    = RING_BASE_ADDR + 16'h0008; // Records in the ring, at least 2
+localparam logic [31:0] RING_HEAD_ADDR                       = RING_BASE_ADDR + 16'h000C; // Next record the hardware writes
+localparam logic [31:0] RING_TAIL_ADDR                       = RING_BASE_ADDR + 16'h0010; // Next record software consumes
+localparam logic [31:0] RING_DROPPED_ADDR                    = RING_BASE_ADDR + 16'h0014; // Snapshots lost to a full ring
+localparam logic [31:0] RING_IRQ_THRESHOLD_ADDR              = RING_BASE_ADDR + 16'h0018; // Records per interrupt
+localparam logic [31:0] RING_STATUS_ADDR                     = RING_BASE_ADDR + 16'h001C; // Bit 0: interrupt (W1C), bit 1: busy, bit 2: bus error
+
+reg [31:0] ring_control_reg;
+reg [31:0] ring_address_reg;
+reg [31:0] ring_entries_reg;
+reg [31:0] ring_tail_reg;
+reg [31:0] ring_irq_threshold_reg;
+reg [63:0] timestamp_counter; // Cycles since reset, stamped on every ring record
+logic ring_restart;
+logic ring_busy;
+logic [31:0] ring_head;
+logic [31:0] ring_dropped;
+logic ring_irq_pending;
+logic ring_bus_error;
+logic [7:0] ring_payload_index;
+logic [31:0] ring_payload_word;
+
+// Snapshot control. Every profiling unit copies its live counters to the registers read over the bus
+// when snapshot is high, so all counters seen by software were sampled on the same clock edge.
+reg [31:0] snapshot_interval_reg;
+reg [31:0] snapshot_timer;
+logic snapshot_cmd;
+logic snapshot_tick;
+logic snapshot;
+reg snapshot_hold_reg; // Pauses automatic snapshots while software reads a consistent set
+logic snapshot_timer_expired;
+
+// Register access, driven by whichever bus interface is generated below.
+// reg_wr_en is high for exactly one cycle per write transaction.
+logic reg_wr_en;
+logic [31:0] reg_wr_addr;
+logic [31:0] reg_wr_data;
+logic reg_rd_en; // High for exactly one cycle per read transaction or burst beat, in the cycle its data is taken
+logic [31:0] reg_rd_addr;
+logic [31:0] reg_rd_data;
+
+// Counters wider than the bus are read low word first. Reading the low word copies the upper word
+// of the same counter into counter_hi_reg, so the pair read back is never torn by a carry.
+logic [63:0] counter_rd_data;
+logic counter_rd_sel;
+reg [31:0] counter_hi_reg;
+
+// Overflow status, bit n is set when counter register n of the unit wraps
+reg [31:0] irq_enable_reg;
+reg [INSTRUCTION_CLASSES-1:0] instruction_profile_unit_overflow_reg;
+reg [11:0] cache_profile_unit_overflow_reg;
+reg [16:0] stall_unit_overflow_reg;
+logic [INSTRUCTION_CLASSES-1:0] instruction_profile_unit_overflow;
+logic [11:0] cache_profile_unit_overflow;
+logic [16:0] stall_unit_overflow;
 
 generate if (WITH_AXI) begin : gen_axi_if
 
@@ -151,7 +522,7 @@ generate if (WITH_AXI) begin : gen_axi_if
     
 	wire	 slv_reg_rden;
 	wire	 slv_reg_wren;
-	reg [C_S_AXI_DATA_WIDTH-1:0]	 reg_data_out;
+	wire [C_S_AXI_DATA_WIDTH-1:0]	 reg_data_out;
 	integer	 byte_index;
 	reg	 aw_en;
 
@@ -258,35 +629,10 @@ generate if (WITH_AXI) begin : gen_axi_if
 	// and the slave is ready to accept the write address and write data.
 	assign slv_reg_wren = axi_wready && S_AXI_WVALID && axi_awready && S_AXI_AWVALID;
 
-	always @( posedge clk )
-	begin
-	  if ( rst == 1'b1 ) // revert
-	    begin
-            instruction_profile_unit_enable_reg <= 0;
-            cache_profile_unit_enable_reg <= 0;
-	    end 
-	  else begin
-	    if (slv_reg_wren)
-	      begin
-	        case ( axi_awaddr )
-                INSTRUCTION_PROFILE_UNIT_ENABLE_ADDR:
-	                instruction_profile_unit_enable_reg <= S_AXI_WDATA;
-	                
-                CACHE_PROFILE_UNIT_ENABLE_ADDR:
-	                cache_profile_unit_enable_reg <= S_AXI_WDATA;
-
-				  STALL_UNIT_ENABLE_ADDR:
-					  stall_unit_enable_reg <= S_AXI_WDATA;
-
-	          default : begin
-                    instruction_profile_unit_enable_reg <= instruction_profile_unit_enable_reg;
-                    cache_profile_unit_enable_reg <= cache_profile_unit_enable_reg;
-					stall_unit_enable_reg <= stall_unit_enable_reg;
-                    end
-	        endcase
-	      end
-	  end
-	end    
+	assign reg_wr_en = slv_reg_wren;
+	// The AXI address is the offset within the register map, the upper bits come from the base address
+	assign reg_wr_addr = {ABACUS_BASE_ADDR[31:C_S_AXI_ADDR_WIDTH], axi_awaddr};
+	assign reg_wr_data = S_AXI_WDATA;
 
 	// Implement write response logic generation
 	// The write response and response valid signals are asserted by the slave 
@@ -321,228 +667,679 @@ generate if (WITH_AXI) begin : gen_axi_if
 	    end
 	end   
 
-	// Implement axi_arready generation
-	// axi_arready is asserted for one S_AXI_ACLK clock cycle when
-	// S_AXI_ARVALID is asserted. axi_awready is 
-	// de-asserted when reset (active low) is asserted. 
-	// The read address is also latched when S_AXI_ARVALID is 
-	// asserted. axi_araddr is reset to zero on reset assertion.
+	// Read channel, extended from AXI-Lite to AXI4 INCR and FIXED bursts of 32-bit beats so the
+	// snapshot window can be drained in one burst. WRAP bursts are served as INCR and there are no
+	// IDs, one burst is accepted at a time. An AXI-Lite master leaves ARLEN at 0, a single beat.
+	// A beat is fetched into axi_rdata whenever the output register is empty or being emptied, so
+	// reads stream at one beat per cycle while the master holds RREADY high.
+	reg [7:0] axi_rbeats;  // Beats left to fetch after the current one
+	reg [1:0] axi_arburst;
+	reg  	axi_rbusy;     // Burst accepted and not fully fetched
+	reg  	axi_rlast;
+	wire	 axi_rfetch;
+
+	assign S_AXI_RLAST	= axi_rlast;
 
 	always @( posedge clk )
 	begin
 	  if ( rst == 1'b1 ) // revert
 	    begin
 	      axi_arready <= 1'b0;
-	      axi_araddr  <= 32'b0;
+	      axi_araddr  <= 0;
+	      axi_arburst <= 2'b01;
+	      axi_rbeats  <= 8'h0;
+	      axi_rbusy   <= 1'b0;
 	    end 
 	  else
 	    begin    
-	      if (~axi_arready && S_AXI_ARVALID)
+	      if (axi_arready && S_AXI_ARVALID)
 	        begin
-	          // indicates that the slave has acceped the valid read address
-	          axi_arready <= 1'b1;
-	          // Read address latching
+	          // Read address and burst latching
+	          axi_arready <= 1'b0;
 	          axi_araddr  <= S_AXI_ARADDR;
+	          axi_arburst <= S_AXI_ARBURST;
+	          axi_rbeats  <= S_AXI_ARLEN;
+	          axi_rbusy   <= 1'b1;
 	        end
-	      else
+	      else if (~axi_arready && ~axi_rbusy && S_AXI_ARVALID)
 	        begin
-	          axi_arready <= 1'b0;
+	          // indicates that the slave can accept the valid read address
+	          axi_arready <= 1'b1;
+	        end
+	      else if (axi_rfetch)
+	        begin
+	          if (axi_rbeats == 8'h0)
+	            axi_rbusy <= 1'b0;
+	          axi_rbeats <= axi_rbeats - 1;
+	          if (axi_arburst != 2'b00)
+	            axi_araddr <= axi_araddr + 4;
 	        end
 	    end 
 	end       
 
-	// Implement axi_arvalid generation
-	// axi_rvalid is asserted for one S_AXI_ACLK clock cycle when both 
-	// S_AXI_ARVALID and axi_arready are asserted. The slave registers 
-	// data are available on the axi_rdata bus at this instance. The 
-	// assertion of axi_rvalid marks the validity of read data on the 
-	// bus and axi_rresp indicates the status of read transaction.axi_rvalid 
-	// is deasserted on reset (active low). axi_rresp and axi_rdata are 
-	// cleared to zero on reset (active low).  
+	assign axi_rfetch = axi_rbusy & (~axi_rvalid | S_AXI_RREADY);
+
+	// Output register, read data, response and last flag of the fetched beat
 	always @( posedge clk )
 	begin
 	  if ( rst == 1'b1 ) // revert
 	    begin
 	      axi_rvalid <= 0;
 	      axi_rresp  <= 0;
+	      axi_rlast  <= 0;
+	      axi_rdata  <= 0;
 	    end 
 	  else
 	    begin    
-	      if (axi_arready && S_AXI_ARVALID && ~axi_rvalid)
+	      if (axi_rfetch)
 	        begin
-	          // Valid read data is available at the read data bus
 	          axi_rvalid <= 1'b1;
 	          axi_rresp  <= 2'b0; // 'OKAY' response
+	          axi_rlast  <= (axi_rbeats == 8'h0);
+	          axi_rdata  <= reg_data_out;
 	        end   
 	      else if (axi_rvalid && S_AXI_RREADY)
 	        begin
 	          // Read data is accepted by the master
 	          axi_rvalid <= 1'b0;
+	          axi_rlast  <= 1'b0;
 	        end                
 	    end
 	end    
 
-	// Implement memory mapped register select and read logic generation
-	// Slave register read enable is asserted when valid address is available
-	// and the slave is ready to accept the read address.
-	assign slv_reg_rden = axi_arready & S_AXI_ARVALID & ~axi_rvalid;
-	always @(*)
-	begin
-	      // Address decoding for reading registers
-	      case ( axi_araddr )
-            INSTRUCTION_PROFILE_UNIT_ENABLE_ADDR   : reg_data_out <= instruction_profile_unit_enable_reg;
-            CACHE_PROFILE_UNIT_ENABLE_ADDR   : reg_data_out <= cache_profile_unit_enable_reg;
-			STALL_UNIT_ENABLE_ADDR	: reg_data_out <= stall_unit_enable_reg;
-
-            LOAD_WORD_COUNTER_ADDR   : reg_data_out <= load_word_counter_reg;
-            STORE_WORD_COUNTER_ADDR   : reg_data_out <= store_word_counter_reg;
-            ADDITION_COUNTER_ADDR   : reg_data_out <= addition_counter_reg;
-            SUBTRACTION_COUNTER_ADDR   : reg_data_out <= subtraction_counter_reg;
-            BRANCH_COUNTER_ADDR   : reg_data_out <= branch_counter_reg;
-            JUMP_COUNTER_ADDR   : reg_data_out <= jump_counter_reg;
-            SYSTEM_PRIVILEGE_COUNTER_ADDR   : reg_data_out <= system_privilege_counter_reg;
-            ATOMIC_COUNTER_ADDR   : reg_data_out <= atomic_counter_reg;
-
-            ICACHE_REQUEST_COUNTER_ADDR   : reg_data_out <= icache_request_counter_reg;
-            ICACHE_HIT_COUNTER_ADDR   : reg_data_out <= icache_hit_counter_reg;
-            ICACHE_MISS_COUNTER_ADDR   : reg_data_out <= icache_miss_counter_reg;
-            ICACHE_LINE_FILL_LATENCY_ADDR   : reg_data_out <= icache_line_fill_latency_counter_reg;
-            DCACHE_REQUEST_COUNTER_ADDR   : reg_data_out <= dcache_request_counter_reg;
-            DCACHE_HIT_COUNTER_ADDR   : reg_data_out <= dcache_hit_counter_reg;
-            DCACHE_MISS_COUNTER_ADDR   : reg_data_out <= dcache_miss_counter_reg;
-            DCACHE_LINE_FILL_LATENCY_ADDR   : reg_data_out <= dcache_line_fill_latency_counter_reg;
-
-			BRANCH_MISPREDICTION_COUNTER_ADDR	: reg_data_out <= branch_misprediction_counter_reg;
-			RAS_MISPREDICTION_COUNTER_ADDR	: reg_data_out <= ras_misprediction_counter_reg;
-			ISSUE_NO_INSTRUCTION_STAT_COUNTER_ADDR	: reg_data_out <= issue_no_instruction_stat_counter_reg;
-			ISSUE_NO_ID_STAT_COUNTER_ADDR	: reg_data_out <= issue_no_id_stat_counter_reg;
-			ISSUE_FLUSH_STAT_COUNTER_ADDR	: reg_data_out <= issue_flush_stat_counter_reg;
-			ISSUE_UNIT_BUSY_STAT_COUNTER_ADDR	: reg_data_out <= issue_unit_busy_stat_counter_reg;
-			ISSUE_OPERANDS_NOT_READY_STAT_COUNTER_ADDR	: reg_data_out <= issue_operands_not_ready_stat_counter_reg;
-			ISSUE_HOLD_STAT_COUNTER_ADDR	: reg_data_out <= issue_hold_stat_counter_reg;
-			ISSUE_MULTI_SOURCE_STAT_ADDR 	: reg_data_out <= issue_multi_source_stat_counter_reg;
-
-	        default : reg_data_out <= 0;
-	      endcase
-	end
-
-	// Output register or memory read data
-	always @( posedge clk )
-	begin
-	  if ( rst == 1'b1 ) // revert
-	    begin
-	      axi_rdata  <= 0;
-	    end 
-	  else
-	    begin    
-	      // When there is a valid read address (S_AXI_ARVALID) with 
-	      // acceptance of read address by the slave (axi_arready), 
-	      // output the read dada 
-	      if (slv_reg_rden)
-	        begin
-	          axi_rdata <= reg_data_out;     // register read data
-	        end   
-	    end
-	end    
+	// Read side effects, such as popping the PC sample FIFO, happen once per fetched beat
+	assign slv_reg_rden = axi_rfetch;
+	assign reg_rd_en = slv_reg_rden;
+	assign reg_rd_addr = {ABACUS_BASE_ADDR[31:C_S_AXI_ADDR_WIDTH], axi_araddr};
+	assign reg_data_out = reg_rd_data;
 
 end endgenerate
 
 
-generate if (~WITH_AXI) begin : gen_wishbone_if 
-    // Wishbone Acknowledgement and Data Handling
+generate if (~WITH_AXI & ~WB_PIPELINED) begin : gen_wishbone_if 
+    // Incrementing bursts with registered feedback: while a read carries CTI 3'b010 and linear BTE the
+    // acknowledge stays high, so every cycle after the first returns the next word. Other cycle types,
+    // and writes, are acknowledged every other cycle as classic cycles.
+    logic wb_burst;
+    assign wb_burst = ~wb_we & (wb_cti == 3'b010) & (wb_bte == 2'b00);
+    assign wb_stall = 1'b0;
+
+    // Wishbone Acknowledgement
     always_ff @(posedge clk or posedge rst) begin
         if (rst) begin
             wb_ack <= 1'b0;  // Clear acknowledge on reset
+        end else begin
+            // When a valid transaction is ongoing and acknowledged
+            wb_ack <= wb_cyc & wb_stb & (~wb_ack | wb_burst);  // One-cycle acknowledge, back to back in a burst
+        end
+    end
+
+    // Writes take effect in the first cycle of the transaction only, so command registers see a single pulse
+    assign reg_wr_en = wb_cyc & wb_stb & wb_we & ~wb_ack;
+    assign reg_wr_addr = wb_adr[31:0];
+    assign reg_wr_data = wb_dat_i;
 
-            instruction_profile_unit_enable_reg <= 32'h0;
-            cache_profile_unit_enable_reg <= 32'h0;
-			stall_unit_enable_reg <= 32'h0;
+    // Handle Read Data. Read side effects happen in the acknowledge cycle, after the data has been
+    // driven for the whole transaction, so popping the PC sample FIFO cannot change the word being read
+    assign reg_rd_en = wb_cyc & wb_stb & ~wb_we & wb_ack;
+    assign reg_rd_addr = wb_adr[31:0];
+    assign wb_dat_o = (wb_cyc & wb_stb & ~wb_we) ? reg_rd_data : 32'h0;
+end else if (~WITH_AXI) begin : gen_wishbone_pipelined_if
+    // Wishbone B4 pipelined mode. Every request is taken in the cycle it is made and acknowledged in
+    // the next with registered data, so a master can keep one request in flight per cycle.
+    assign wb_stall = 1'b0;
 
+    always_ff @(posedge clk or posedge rst) begin
+        if (rst) begin
+            wb_ack <= 1'b0;
+            wb_dat_o <= 32'h0;
         end else begin
-            // When a valid transaction is ongoing and acknowledged
-            wb_ack <= wb_cyc & wb_stb & ~wb_ack;  // One-cycle acknowledge
-
-            if (wb_cyc & wb_stb & wb_we) begin
-                // Write operation
-                case (wb_adr[31:0])
-                    INSTRUCTION_PROFILE_UNIT_ENABLE_ADDR: instruction_profile_unit_enable_reg <= wb_dat_i;
-                    CACHE_PROFILE_UNIT_ENABLE_ADDR: cache_profile_unit_enable_reg <= wb_dat_i;
-					STALL_UNIT_ENABLE_ADDR: stall_unit_enable_reg <= wb_dat_i;
-                endcase
+            wb_ack <= wb_cyc & wb_stb;
+            wb_dat_o <= reg_rd_data;
+        end
+    end
+
+    assign reg_wr_en = wb_cyc & wb_stb & wb_we;
+    assign reg_wr_addr = wb_adr[31:0];
+    assign reg_wr_data = wb_dat_i;
+
+    assign reg_rd_en = wb_cyc & wb_stb & ~wb_we;
+    assign reg_rd_addr = wb_adr[31:0];
+end endgenerate 
+
+assign unit_clear = ((reg_wr_en & (reg_wr_addr == UNIT_CLEAR_ADDR)) ? reg_wr_data[7:0] : 8'h0) | unit_clear_sync;
+
+// Control registers
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        instruction_profile_unit_enable_reg <= 32'h0;
+        cache_profile_unit_enable_reg <= 32'h0;
+        stall_unit_enable_reg <= 32'h0;
+        stall_unit_level_mode_reg <= 32'h0;
+        snapshot_interval_reg <= DEFAULT_SNAPSHOT_INTERVAL;
+        snapshot_hold_reg <= 1'b0;
+        irq_enable_reg <= 32'h0;
+        pc_sampler_enable_reg <= 32'h0;
+        branch_hotlist_enable_reg <= 32'h0;
+        miss_sketch_enable_reg <= 32'h0;
+        miss_sketch_granule_shift_reg <= 32'd6;
+        miss_sketch_filter_low_reg <= 32'h0;
+        miss_sketch_filter_high_reg <= 32'hffffffff;
+        bus_profiler_enable_reg <= 32'h0;
+        pc_sample_period_reg <= 32'd4096;
+        trigger_control_reg <= 32'h0;
+        trigger_start_pc_low_reg <= 32'hffffffff; // Empty ranges until programmed
+        trigger_start_pc_high_reg <= 32'h0;
+        trigger_stop_pc_low_reg <= 32'hffffffff;
+        trigger_stop_pc_high_reg <= 32'h0;
+        ring_control_reg <= 32'h0;
+        ring_address_reg <= 32'h0;
+        ring_entries_reg <= 32'h2;
+        ring_tail_reg <= 32'h0;
+        ring_irq_threshold_reg <= 32'h1;
+    end else if (reg_wr_en) begin
+        case (reg_wr_addr)
+            INSTRUCTION_PROFILE_UNIT_ENABLE_ADDR: instruction_profile_unit_enable_reg <= reg_wr_data;
+            CACHE_PROFILE_UNIT_ENABLE_ADDR: cache_profile_unit_enable_reg <= reg_wr_data;
+            STALL_UNIT_ENABLE_ADDR: stall_unit_enable_reg <= reg_wr_data;
+            STALL_UNIT_LEVEL_MODE_ADDR: stall_unit_level_mode_reg <= reg_wr_data;
+            SNAPSHOT_ADDR: snapshot_hold_reg <= reg_wr_data[1];
+            SNAPSHOT_INTERVAL_ADDR: snapshot_interval_reg <= reg_wr_data;
+            IRQ_ENABLE_ADDR: irq_enable_reg <= reg_wr_data;
+            PC_SAMPLER_ENABLE_ADDR: pc_sampler_enable_reg <= reg_wr_data;
+            PC_SAMPLE_PERIOD_ADDR: pc_sample_period_reg <= reg_wr_data;
+            BRANCH_HOTLIST_ENABLE_ADDR: branch_hotlist_enable_reg <= reg_wr_data;
+            MISS_SKETCH_ENABLE_ADDR: miss_sketch_enable_reg <= reg_wr_data;
+            MISS_SKETCH_GRANULE_SHIFT_ADDR: miss_sketch_granule_shift_reg <= {27'h0, reg_wr_data[4:0]};
+            MISS_SKETCH_FILTER_LOW_ADDR: miss_sketch_filter_low_reg <= reg_wr_data;
+            MISS_SKETCH_FILTER_HIGH_ADDR: miss_sketch_filter_high_reg <= reg_wr_data;
+            BUS_PROFILER_ENABLE_ADDR: bus_profiler_enable_reg <= reg_wr_data;
+            TRIGGER_CONTROL_ADDR: trigger_control_reg <= reg_wr_data;
+            TRIGGER_START_PC_LOW_ADDR: trigger_start_pc_low_reg <= reg_wr_data;
+            TRIGGER_START_PC_HIGH_ADDR: trigger_start_pc_high_reg <= reg_wr_data;
+            TRIGGER_STOP_PC_LOW_ADDR: trigger_stop_pc_low_reg <= reg_wr_data;
+            TRIGGER_STOP_PC_HIGH_ADDR: trigger_stop_pc_high_reg <= reg_wr_data;
+            RING_CONTROL_ADDR: begin
+                ring_control_reg <= reg_wr_data;
+                if (reg_wr_data[0]) begin
+                    ring_tail_reg <= 32'h0; // A new run starts empty
+                end
+            end
+            RING_ADDRESS_ADDR: ring_address_reg <= reg_wr_data;
+            RING_ENTRIES_ADDR: ring_entries_reg <= reg_wr_data;
+            RING_TAIL_ADDR: ring_tail_reg <= reg_wr_data;
+            RING_IRQ_THRESHOLD_ADDR: ring_irq_threshold_reg <= reg_wr_data;
+        endcase
+    end
+end
+
+// Event select registers, decoded by index like the counters they drive
+always_comb begin
+    for (int i = 0; i < NUM_EVENT_COUNTERS; i++) begin
+        event_select_write[i] = reg_wr_en & (reg_wr_addr == EVENT_SELECT_ADDR + 4 * i);
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        for (int i = 0; i < NUM_EVENT_COUNTERS; i++) begin
+            event_select_reg[i] <= 32'h0;
+        end
+    end else begin
+        for (int i = 0; i < NUM_EVENT_COUNTERS; i++) begin
+            if (event_select_write[i]) begin
+                event_select_reg[i] <= reg_wr_data;
             end
         end
     end
+end
 
-    // Handle Read Data
-    always_comb begin
-        wb_dat_o = 32'h0;  // Default value for the output
-
-        if (wb_cyc & wb_stb & ~wb_we) begin
-            // Read operation
-            case (wb_adr[31:0])
-                INSTRUCTION_PROFILE_UNIT_ENABLE_ADDR: wb_dat_o <= instruction_profile_unit_enable_reg;
-                CACHE_PROFILE_UNIT_ENABLE_ADDR: wb_dat_o <= cache_profile_unit_enable_reg;
-                STALL_UNIT_ENABLE_ADDR: wb_dat_o <= stall_unit_enable_reg;
-				LOAD_WORD_COUNTER_ADDR: wb_dat_o <= load_word_counter_reg;
-                STORE_WORD_COUNTER_ADDR: wb_dat_o <= store_word_counter_reg;
-                ADDITION_COUNTER_ADDR: wb_dat_o <= addition_counter_reg;
-                SUBTRACTION_COUNTER_ADDR: wb_dat_o <= subtraction_counter_reg;
-                BRANCH_COUNTER_ADDR: wb_dat_o <= branch_counter_reg;
-                JUMP_COUNTER_ADDR: wb_dat_o <= jump_counter_reg;
-                SYSTEM_PRIVILEGE_COUNTER_ADDR: wb_dat_o <= system_privilege_counter_reg;
-                ATOMIC_COUNTER_ADDR: wb_dat_o <= atomic_counter_reg;
-                ICACHE_REQUEST_COUNTER_ADDR: wb_dat_o <= icache_request_counter_reg;
-                ICACHE_HIT_COUNTER_ADDR: wb_dat_o <= icache_hit_counter_reg;
-                ICACHE_MISS_COUNTER_ADDR: wb_dat_o <= icache_miss_counter_reg;
-                ICACHE_LINE_FILL_LATENCY_ADDR: wb_dat_o <= icache_line_fill_latency_counter_reg;
-                DCACHE_REQUEST_COUNTER_ADDR: wb_dat_o <= dcache_request_counter_reg;
-                DCACHE_HIT_COUNTER_ADDR: wb_dat_o <= dcache_hit_counter_reg;
-                DCACHE_MISS_COUNTER_ADDR: wb_dat_o <= dcache_miss_counter_reg;
-                DCACHE_LINE_FILL_LATENCY_ADDR: wb_dat_o <= dcache_line_fill_latency_counter_reg;
-				BRANCH_MISPREDICTION_COUNTER_ADDR: wb_dat_o <= branch_misprediction_counter_reg;
-				RAS_MISPREDICTION_COUNTER_ADDR: wb_dat_o <= ras_misprediction_counter_reg;
-				ISSUE_NO_INSTRUCTION_STAT_COUNTER_ADDR: wb_dat_o <= issue_no_instruction_stat_counter_reg;
-				ISSUE_NO_ID_STAT_COUNTER_ADDR: wb_dat_o <= issue_no_id_stat_counter_reg;
-				ISSUE_FLUSH_STAT_COUNTER_ADDR: wb_dat_o <= issue_flush_stat_counter_reg;
-				ISSUE_UNIT_BUSY_STAT_COUNTER_ADDR: wb_dat_o <= issue_unit_busy_stat_counter_reg;
-				ISSUE_OPERANDS_NOT_READY_STAT_COUNTER_ADDR: wb_dat_o <= issue_operands_not_ready_stat_counter_reg;
-				ISSUE_HOLD_STAT_COUNTER_ADDR: wb_dat_o <= issue_hold_stat_counter_reg;
-				ISSUE_MULTI_SOURCE_STAT_ADDR: wb_dat_o <= issue_multi_source_stat_counter_reg;
-                default: wb_dat_o = 32'h0;   // Invalid address, return zero
-            endcase
+// Unit filter registers
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        for (int i = 0; i < UNIT_FILTERS; i++) begin
+            unit_filter_reg[i] <= 32'hF; // Every mode, any ASID
+        end
+    end else begin
+        for (int i = 0; i < UNIT_FILTERS; i++) begin
+            if (reg_wr_en & (reg_wr_addr == UNIT_FILTER_ADDR + 4 * i)) begin
+                unit_filter_reg[i] <= reg_wr_data;
+            end
         end
     end
-end endgenerate 
+end
+
+always_comb begin
+    for (int i = 0; i < UNIT_FILTERS; i++) begin
+        unit_filter_pass[i] = unit_filter_reg[i][abacus_privilege] &
+                              (~unit_filter_reg[i][UNIT_FILTER_ASID_MATCH] | (unit_filter_reg[i][24:16] == abacus_asid));
+    end
+end
+
+// Rate alarm registers, decoded by index like the event selects
+always_comb begin
+    for (int i = 0; i < NUM_RATE_ALARMS; i++) begin
+        rate_alarm_select_write[i] = reg_wr_en & (reg_wr_addr == RATE_ALARM_ADDR + 16 * i);
+        rate_alarm_freeze_mask[i] = rate_alarm_select_reg[i][RATE_ALARM_SELECT_FREEZE];
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        for (int i = 0; i < NUM_RATE_ALARMS; i++) begin
+            rate_alarm_select_reg[i] <= 32'h0;
+            rate_alarm_window_reg[i] <= 32'h0;
+            rate_alarm_threshold_reg[i] <= 32'hffffffff;
+        end
+    end else begin
+        for (int i = 0; i < NUM_RATE_ALARMS; i++) begin
+            if (rate_alarm_select_write[i]) begin
+                rate_alarm_select_reg[i] <= reg_wr_data;
+            end
+            if (reg_wr_en & (reg_wr_addr == RATE_ALARM_ADDR + 16 * i + 4)) begin
+                rate_alarm_window_reg[i] <= reg_wr_data;
+            end
+            if (reg_wr_en & (reg_wr_addr == RATE_ALARM_ADDR + 16 * i + 8)) begin
+                rate_alarm_threshold_reg[i] <= reg_wr_data;
+            end
+        end
+    end
+end
+
+// Sticky overflow status, a wrap in the same cycle as a clear wins so it is never lost
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        instruction_profile_unit_overflow_reg <= '0;
+        cache_profile_unit_overflow_reg <= 12'h0;
+        stall_unit_overflow_reg <= 17'h0;
+        event_counter_overflow_reg <= '0;
+        bus_profiler_overflow_reg <= 10'h0;
+    end else begin
+        instruction_profile_unit_overflow_reg <= instruction_profile_unit_overflow | (instruction_profile_unit_overflow_reg &
+            ~((reg_wr_en & (reg_wr_addr == INSTRUCTION_PROFILE_UNIT_OVERFLOW_ADDR)) ? reg_wr_data[INSTRUCTION_CLASSES-1:0] : '0));
+        cache_profile_unit_overflow_reg <= cache_profile_unit_overflow | (cache_profile_unit_overflow_reg &
+            ~((reg_wr_en & (reg_wr_addr == CACHE_PROFILE_UNIT_OVERFLOW_ADDR)) ? reg_wr_data[11:0] : 12'h0));
+        stall_unit_overflow_reg <= stall_unit_overflow | (stall_unit_overflow_reg &
+            ~((reg_wr_en & (reg_wr_addr == STALL_UNIT_OVERFLOW_ADDR)) ? reg_wr_data[16:0] : 17'h0));
+        event_counter_overflow_reg <= event_counter_overflow | (event_counter_overflow_reg &
+            ~((reg_wr_en & (reg_wr_addr == EVENT_COUNTER_OVERFLOW_ADDR)) ? reg_wr_data[NUM_EVENT_COUNTERS-1:0] : '0));
+        bus_profiler_overflow_reg <= bus_profiler_overflow | (bus_profiler_overflow_reg &
+            ~((reg_wr_en & (reg_wr_addr == BUS_PROFILER_OVERFLOW_ADDR)) ? reg_wr_data[9:0] : 10'h0));
+    end
+end
+
+assign abacus_irq = (irq_enable_reg[0] & (|instruction_profile_unit_overflow_reg | |cache_profile_unit_overflow_reg | |stall_unit_overflow_reg |
+                                          |event_counter_overflow_reg | |bus_profiler_overflow_reg)) |
+                    (irq_enable_reg[1] & ring_irq_pending) |
+                    (irq_enable_reg[2] & |rate_alarm_status_reg);
+
+// Rate alarm status, sticky like the overflows. The PC and timestamp are those of the first crossing
+// since status was last all clear, so they match the frozen snapshot.
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        rate_alarm_status_reg <= '0;
+        rate_alarm_pc_reg <= 32'h0;
+        rate_alarm_timestamp_reg <= 64'h0;
+    end else begin
+        rate_alarm_status_reg <= rate_alarm_crossing | (rate_alarm_status_reg &
+            ~((reg_wr_en & (reg_wr_addr == RATE_ALARM_STATUS_ADDR)) ? reg_wr_data[NUM_RATE_ALARMS-1:0] : '0));
+        if (|rate_alarm_crossing & ~|rate_alarm_status_reg) begin
+            rate_alarm_pc_reg <= abacus_instruction_issued ? abacus_instruction_pc : last_issued_pc_reg;
+            rate_alarm_timestamp_reg <= timestamp_counter;
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        last_issued_pc_reg <= 32'h0;
+    end else if (abacus_instruction_issued) begin
+        last_issued_pc_reg <= abacus_instruction_pc;
+    end
+end
+
+// Snapshot generation, either on a software command or every snapshot_interval_reg cycles. The hold bit
+// holds back automatic snapshots, so a burst read of the window after writing 3 to SNAPSHOT sees counters
+// taken on one edge. The timer runs on, and the held snapshot is taken as soon as software writes 0.
+// Automatic snapshots are held back the same way while the snapshot ring copies the counters, and
+// while a freezing rate alarm has crossed, after taking a snapshot of the crossing. That snapshot
+// waits for a hold like the automatic ones, so a burst read in progress is never torn.
+// In a multi-hart build, abacus_smp snapshots and holds every hart together through the snapshot_sync inputs.
+assign snapshot_cmd = (reg_wr_en & (reg_wr_addr == SNAPSHOT_ADDR) & reg_wr_data[0]) | snapshot_sync;
+assign snapshot_timer_expired = (snapshot_interval_reg != 32'h0) & (snapshot_timer >= snapshot_interval_reg - 1);
+assign rate_alarm_frozen = |(rate_alarm_status_reg & rate_alarm_freeze_mask);
+assign rate_alarm_freeze = (|(rate_alarm_crossing & rate_alarm_freeze_mask) & ~rate_alarm_frozen) | rate_alarm_snapshot_pending_reg;
+assign rate_alarm_snapshot = rate_alarm_freeze & ~snapshot_hold_reg & ~snapshot_sync_hold & ~ring_busy;
+assign snapshot_tick = snapshot_timer_expired & ~snapshot_hold_reg & ~snapshot_sync_hold & ~ring_busy & ~rate_alarm_frozen;
+assign snapshot = snapshot_cmd | snapshot_tick | rate_alarm_snapshot;
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        rate_alarm_snapshot_pending_reg <= 1'b0;
+    end else begin
+        rate_alarm_snapshot_pending_reg <= rate_alarm_freeze & ~rate_alarm_snapshot;
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        snapshot_timer <= 32'h0;
+    end else if (snapshot_tick | (reg_wr_en & (reg_wr_addr == SNAPSHOT_INTERVAL_ADDR))) begin
+        snapshot_timer <= 32'h0; // Restart the interval when it is reprogrammed
+    end else begin
+        snapshot_timer <= snapshot_timer + 1;
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        timestamp_counter <= 64'h0;
+    end else begin
+        timestamp_counter <= timestamp_counter + 1;
+    end
+end
+
+// Read address decoding, shared by both bus interfaces
+always_comb begin
+    counter_rd_sel = 1'b1;
+    case (reg_rd_addr) inside
+        [INSTRUCTION_PROFILE_UNIT_BASE_ADDR : INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 4 * INSTRUCTION_CLASSES - 1]: begin
+            // The instruction class counters are indexed, not decoded one by one
+            counter_rd_sel = (reg_rd_addr[1:0] == 2'b00);
+            counter_rd_data = instruction_class_counter_reg[reg_rd_addr[7:2]];
+        end
+
+        ICACHE_REQUEST_COUNTER_ADDR: counter_rd_data = icache_request_counter_reg;
+        ICACHE_HIT_COUNTER_ADDR: counter_rd_data = icache_hit_counter_reg;
+        ICACHE_MISS_COUNTER_ADDR: counter_rd_data = icache_miss_counter_reg;
+        ICACHE_LINE_FILL_LATENCY_ADDR: counter_rd_data = icache_line_fill_latency_counter_reg;
+        DCACHE_REQUEST_COUNTER_ADDR: counter_rd_data = dcache_request_counter_reg;
+        DCACHE_HIT_COUNTER_ADDR: counter_rd_data = dcache_hit_counter_reg;
+        DCACHE_MISS_COUNTER_ADDR: counter_rd_data = dcache_miss_counter_reg;
+        DCACHE_LINE_FILL_LATENCY_ADDR: counter_rd_data = dcache_line_fill_latency_counter_reg;
+        LINE_FILL_OCCUPANCY_ADDR: counter_rd_data = line_fill_occupancy_counter_reg;
+        LINE_FILL_ACTIVE_ADDR: counter_rd_data = line_fill_active_counter_reg;
+        [ICACHE_LINE_FILL_HISTOGRAM_ADDR : ICACHE_LINE_FILL_HISTOGRAM_ADDR + 4 * LATENCY_BUCKETS - 1]: begin
+            counter_rd_sel = (reg_rd_addr[1:0] == 2'b00);
+            counter_rd_data = icache_line_fill_histogram_reg[reg_rd_addr[7:2] - ICACHE_LINE_FILL_HISTOGRAM_ADDR[7:2]];
+        end
+        [DCACHE_LINE_FILL_HISTOGRAM_ADDR : DCACHE_LINE_FILL_HISTOGRAM_ADDR + 4 * LATENCY_BUCKETS - 1]: begin
+            counter_rd_sel = (reg_rd_addr[1:0] == 2'b00);
+            counter_rd_data = dcache_line_fill_histogram_reg[reg_rd_addr[7:2] - DCACHE_LINE_FILL_HISTOGRAM_ADDR[7:2]];
+        end
+
+        BRANCH_MISPREDICTION_COUNTER_ADDR: counter_rd_data = branch_misprediction_counter_reg;
+        RAS_MISPREDICTION_COUNTER_ADDR: counter_rd_data = ras_misprediction_counter_reg;
+        ISSUE_NO_INSTRUCTION_STAT_COUNTER_ADDR: counter_rd_data = issue_no_instruction_stat_counter_reg;
+        ISSUE_NO_ID_STAT_COUNTER_ADDR: counter_rd_data = issue_no_id_stat_counter_reg;
+        ISSUE_FLUSH_STAT_COUNTER_ADDR: counter_rd_data = issue_flush_stat_counter_reg;
+        ISSUE_UNIT_BUSY_STAT_COUNTER_ADDR: counter_rd_data = issue_unit_busy_stat_counter_reg;
+        ISSUE_OPERANDS_NOT_READY_STAT_COUNTER_ADDR: counter_rd_data = issue_operands_not_ready_stat_counter_reg;
+        ISSUE_HOLD_STAT_COUNTER_ADDR: counter_rd_data = issue_hold_stat_counter_reg;
+        ISSUE_MULTI_SOURCE_STAT_ADDR: counter_rd_data = issue_multi_source_stat_counter_reg;
+        CYCLE_COUNTER_ADDR: counter_rd_data = cycle_counter_reg;
+        INSTRUCTION_COUNTER_ADDR: counter_rd_data = instruction_counter_reg;
+        [CPI_STALL_COUNTER_ADDR : CPI_STALL_COUNTER_ADDR + 4 * CPI_STALLS - 1]: begin
+            counter_rd_sel = (reg_rd_addr[1:0] == 2'b00);
+            counter_rd_data = cpi_stall_counter_reg[reg_rd_addr[7:2] - CPI_STALL_COUNTER_ADDR[7:2]];
+        end
+
+        [EVENT_COUNTER_ADDR : EVENT_COUNTER_ADDR + 4 * NUM_EVENT_COUNTERS - 1]: begin
+            counter_rd_sel = (reg_rd_addr[1:0] == 2'b00);
+            counter_rd_data = 64'(event_counter_reg[reg_rd_addr[5:2]]);
+        end
+        [EVENT_SELECT_ADDR : EVENT_SELECT_ADDR + 4 * NUM_EVENT_COUNTERS - 1]: begin
+            counter_rd_sel = 1'b0;
+            counter_rd_data = {32'h0, event_select_reg[reg_rd_addr[5:2]]};
+        end
+
+        [BRANCH_HOTLIST_ENTRY_ADDR : BRANCH_HOTLIST_ENTRY_ADDR + 16 * BRANCH_HOTLIST_ENTRIES - 1]: begin
+            counter_rd_sel = 1'b0;
+            counter_rd_data = {32'h0, branch_hotlist_entry_word[reg_rd_addr[3:2]]};
+        end
+        [MISS_SKETCH_TOPK_ADDR : MISS_SKETCH_TOPK_ADDR + 8 * MISS_SKETCH_TOPK_ENTRIES - 1]: begin
+            counter_rd_sel = 1'b0;
+            counter_rd_data = {32'h0, reg_rd_addr[2] ? miss_sketch_topk_count_reg[reg_rd_addr[6:3]] : miss_sketch_topk_addr_reg[reg_rd_addr[6:3]]};
+        end
+
+        BUS_CYCLE_COUNTER_ADDR: counter_rd_data = bus_cycle_counter_reg;
+        BUS_READ_COUNTER_ADDR: counter_rd_data = bus_read_counter_reg;
+        BUS_WRITE_COUNTER_ADDR: counter_rd_data = bus_write_counter_reg;
+        BUS_READ_BYTES_COUNTER_ADDR: counter_rd_data = bus_read_bytes_counter_reg;
+        BUS_WRITE_BYTES_COUNTER_ADDR: counter_rd_data = bus_write_bytes_counter_reg;
+        BUS_BUSY_COUNTER_ADDR: counter_rd_data = bus_busy_counter_reg;
+        BUS_OCCUPANCY_COUNTER_ADDR: counter_rd_data = bus_occupancy_counter_reg;
+        BUS_WAIT_COUNTER_ADDR: counter_rd_data = bus_wait_counter_reg;
+        BUS_LATENCY_COUNTER_ADDR: counter_rd_data = bus_latency_counter_reg;
+        [BUS_LATENCY_HISTOGRAM_ADDR : BUS_LATENCY_HISTOGRAM_ADDR + 4 * LATENCY_BUCKETS - 1]: begin
+            counter_rd_sel = (reg_rd_addr[1:0] == 2'b00);
+            counter_rd_data = bus_latency_histogram_reg[reg_rd_addr[7:2] - BUS_LATENCY_HISTOGRAM_ADDR[7:2]];
+        end
+
+        [UNIT_FILTER_ADDR : UNIT_FILTER_ADDR + 4 * UNIT_FILTERS - 1]: begin
+            counter_rd_sel = 1'b0;
+            counter_rd_data = {32'h0, unit_filter_reg[reg_rd_addr[4:2]]};
+        end
+
+        RATE_ALARM_TIMESTAMP_ADDR: counter_rd_data = rate_alarm_timestamp_reg;
+        [RATE_ALARM_ADDR : RATE_ALARM_ADDR + 16 * NUM_RATE_ALARMS - 1]: begin
+            counter_rd_sel = 1'b0;
+            counter_rd_data = {32'h0, rate_alarm_word[reg_rd_addr[3:2]]};
+        end
+
+        // Both halves are in the window, so its reads leave COUNTER_HI alone
+        [SNAPSHOT_WINDOW_ADDR : SNAPSHOT_WINDOW_ADDR + 4 * SNAPSHOT_WINDOW_WORDS - 1]: begin
+            counter_rd_sel = 1'b0;
+            counter_rd_data = {32'h0, snapshot_window[reg_rd_addr[9:2] - SNAPSHOT_WINDOW_ADDR[9:2]]};
+        end
+
+        default: begin
+            counter_rd_sel = 1'b0;
+            counter_rd_data = 64'h0;
+        end
+    endcase
+end
+
+always_comb begin
+    case (reg_rd_addr)
+        INSTRUCTION_PROFILE_UNIT_ENABLE_ADDR: reg_rd_data = instruction_profile_unit_enable_reg;
+        CACHE_PROFILE_UNIT_ENABLE_ADDR: reg_rd_data = cache_profile_unit_enable_reg;
+        STALL_UNIT_ENABLE_ADDR: reg_rd_data = stall_unit_enable_reg;
+        SNAPSHOT_ADDR: reg_rd_data = {30'h0, snapshot_hold_reg, 1'b0};
+        SNAPSHOT_INTERVAL_ADDR: reg_rd_data = snapshot_interval_reg;
+        COUNTER_HI_ADDR: reg_rd_data = counter_hi_reg;
+        IRQ_ENABLE_ADDR: reg_rd_data = irq_enable_reg;
+        INSTRUCTION_PROFILE_UNIT_OVERFLOW_ADDR: reg_rd_data = 32'(instruction_profile_unit_overflow_reg);
+        CACHE_PROFILE_UNIT_OVERFLOW_ADDR: reg_rd_data = {20'h0, cache_profile_unit_overflow_reg};
+        ICACHE_LINE_FILL_MIN_ADDR: reg_rd_data = icache_line_fill_min_reg;
+        ICACHE_LINE_FILL_MAX_ADDR: reg_rd_data = icache_line_fill_max_reg;
+        DCACHE_LINE_FILL_MIN_ADDR: reg_rd_data = dcache_line_fill_min_reg;
+        DCACHE_LINE_FILL_MAX_ADDR: reg_rd_data = dcache_line_fill_max_reg;
+        STALL_UNIT_OVERFLOW_ADDR: reg_rd_data = {15'h0, stall_unit_overflow_reg};
+        STALL_UNIT_LEVEL_MODE_ADDR: reg_rd_data = stall_unit_level_mode_reg;
+        EVENT_COUNTER_OVERFLOW_ADDR: reg_rd_data = 32'(event_counter_overflow_reg);
+        EVENT_NUM_COUNTERS_ADDR: reg_rd_data = INCLUDE_EVENT_COUNTERS ? 32'(NUM_EVENT_COUNTERS) : 32'h0;
+        BRANCH_HOTLIST_ENABLE_ADDR: reg_rd_data = branch_hotlist_enable_reg;
+        BRANCH_HOTLIST_ENTRIES_ADDR: reg_rd_data = INCLUDE_BRANCH_HOTLIST ? 32'(BRANCH_HOTLIST_ENTRIES) : 32'h0;
+        BRANCH_HOTLIST_MISPREDICTS_ADDR: reg_rd_data = branch_hotlist_total_mispredicts_reg;
+        BRANCH_HOTLIST_BRANCHES_ADDR: reg_rd_data = branch_hotlist_total_branches_reg;
+        MISS_SKETCH_ENABLE_ADDR: reg_rd_data = miss_sketch_enable_reg;
+        MISS_SKETCH_WIDTH_ADDR: reg_rd_data = INCLUDE_MISS_SKETCH ? 32'(MISS_SKETCH_WIDTH) : 32'h0;
+        MISS_SKETCH_TOPK_ENTRIES_ADDR: reg_rd_data = INCLUDE_MISS_SKETCH ? 32'(MISS_SKETCH_TOPK_ENTRIES) : 32'h0;
+        MISS_SKETCH_STATUS_ADDR: reg_rd_data = {31'h0, miss_sketch_clearing};
+        MISS_SKETCH_GRANULE_SHIFT_ADDR: reg_rd_data = miss_sketch_granule_shift_reg;
+        MISS_SKETCH_FILTER_LOW_ADDR: reg_rd_data = miss_sketch_filter_low_reg;
+        MISS_SKETCH_FILTER_HIGH_ADDR: reg_rd_data = miss_sketch_filter_high_reg;
+        MISS_SKETCH_TOTAL_ADDR: reg_rd_data = miss_sketch_total_reg;
+        MISS_SKETCH_INDEX_ADDR: reg_rd_data = miss_sketch_index_reg;
+        MISS_SKETCH_DATA_ADDR: reg_rd_data = miss_sketch_data;
+        BUS_PROFILER_ENABLE_ADDR: reg_rd_data = bus_profiler_enable_reg;
+        BUS_PROFILER_OVERFLOW_ADDR: reg_rd_data = {22'h0, bus_profiler_overflow_reg};
+        BUS_LATENCY_MIN_ADDR: reg_rd_data = bus_latency_min_reg;
+        BUS_LATENCY_MAX_ADDR: reg_rd_data = bus_latency_max_reg;
+        PC_SAMPLER_ENABLE_ADDR: reg_rd_data = pc_sampler_enable_reg;
+        PC_SAMPLE_PERIOD_ADDR: reg_rd_data = pc_sample_period_reg;
+        PC_SAMPLE_COUNT_ADDR: reg_rd_data = pc_sample_count;
+        PC_SAMPLE_DATA_ADDR: reg_rd_data = pc_sample;
+        PC_SAMPLE_DROPPED_ADDR: reg_rd_data = pc_sample_dropped;
+        TRIGGER_CONTROL_ADDR: reg_rd_data = trigger_control_reg;
+        TRIGGER_STATUS_ADDR: reg_rd_data = {31'h0, trigger_active};
+        TRIGGER_REGION_COUNT_ADDR: reg_rd_data = trigger_region_count;
+        TRIGGER_START_PC_LOW_ADDR: reg_rd_data = trigger_start_pc_low_reg;
+        TRIGGER_START_PC_HIGH_ADDR: reg_rd_data = trigger_start_pc_high_reg;
+        TRIGGER_STOP_PC_LOW_ADDR: reg_rd_data = trigger_stop_pc_low_reg;
+        TRIGGER_STOP_PC_HIGH_ADDR: reg_rd_data = trigger_stop_pc_high_reg;
+        RATE_ALARM_COUNT_ADDR: reg_rd_data = INCLUDE_RATE_ALARMS ? 32'(NUM_RATE_ALARMS) : 32'h0;
+        RATE_ALARM_STATUS_ADDR: reg_rd_data = 32'(rate_alarm_status_reg);
+        RATE_ALARM_PC_ADDR: reg_rd_data = rate_alarm_pc_reg;
+        CORE_MODE_ADDR: reg_rd_data = {7'h0, abacus_asid, 14'h0, abacus_privilege};
+        RING_CONTROL_ADDR: reg_rd_data = ring_control_reg;
+        RING_ADDRESS_ADDR: reg_rd_data = ring_address_reg;
+        RING_ENTRIES_ADDR: reg_rd_data = ring_entries_reg;
+        RING_HEAD_ADDR: reg_rd_data = ring_head;
+        RING_TAIL_ADDR: reg_rd_data = ring_tail_reg;
+        RING_DROPPED_ADDR: reg_rd_data = ring_dropped;
+        RING_IRQ_THRESHOLD_ADDR: reg_rd_data = ring_irq_threshold_reg;
+        RING_STATUS_ADDR: reg_rd_data = {29'h0, ring_bus_error, ring_busy, ring_irq_pending};
+
+        default: reg_rd_data = counter_rd_data[31:0]; // Low word of a counter, zero for an invalid address
+    endcase
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        counter_hi_reg <= 32'h0;
+    end else if (reg_rd_en & counter_rd_sel) begin
+        counter_hi_reg <= counter_rd_data[63:32];
+    end
+end
+
+assign pc_sample_pop = reg_rd_en & (reg_rd_addr == PC_SAMPLE_DATA_ADDR);
+assign miss_sketch_pop = reg_rd_en & (reg_rd_addr == MISS_SKETCH_DATA_ADDR);
+
+// Sketch read index, advanced by every read of the data register
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        miss_sketch_index_reg <= 32'h0;
+    end else if (reg_wr_en & (reg_wr_addr == MISS_SKETCH_INDEX_ADDR)) begin
+        miss_sketch_index_reg <= reg_wr_data;
+    end else if (miss_sketch_pop) begin
+        miss_sketch_index_reg <= miss_sketch_index_reg + 1;
+    end
+end
+
+// The four registers of the hot list entry being read, zero for an address past the last entry
+assign branch_hotlist_rd_offset = reg_rd_addr[7:4] - BRANCH_HOTLIST_ENTRY_ADDR[7:4];
+assign branch_hotlist_rd_valid = branch_hotlist_rd_offset < BRANCH_HOTLIST_ENTRIES;
+assign branch_hotlist_rd_entry = branch_hotlist_rd_offset[BRANCH_HOTLIST_INDEX_WIDTH-1:0];
+assign branch_hotlist_entry_word[0] = branch_hotlist_rd_valid ? branch_hotlist_pc_reg[branch_hotlist_rd_entry] : 32'h0;
+assign branch_hotlist_entry_word[1] = branch_hotlist_rd_valid ? branch_hotlist_mispredicts_reg[branch_hotlist_rd_entry] : 32'h0;
+assign branch_hotlist_entry_word[2] = branch_hotlist_rd_valid ? branch_hotlist_executions_reg[branch_hotlist_rd_entry] : 32'h0;
+assign branch_hotlist_entry_word[3] = branch_hotlist_rd_valid ? branch_hotlist_error_reg[branch_hotlist_rd_entry] : 32'h0;
+
+// The four registers of the rate alarm being read
+assign rate_alarm_rd_index = 3'(reg_rd_addr[7:4] - RATE_ALARM_ADDR[7:4]);
+assign rate_alarm_word[0] = rate_alarm_select_reg[rate_alarm_rd_index];
+assign rate_alarm_word[1] = rate_alarm_window_reg[rate_alarm_rd_index];
+assign rate_alarm_word[2] = rate_alarm_threshold_reg[rate_alarm_rd_index];
+assign rate_alarm_word[3] = rate_alarm_last[rate_alarm_rd_index];
+
+// Snapshot window contents, in struct abacus_counters order
+always_comb begin
+    for (int i = 0; i < INSTRUCTION_CLASSES; i++) begin
+        snapshot_window_counter[i] = 64'(instruction_class_counter_reg[i]);
+    end
+    snapshot_window_counter[INSTRUCTION_CLASSES + 0] = 64'(icache_request_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 1] = 64'(icache_hit_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 2] = 64'(icache_miss_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 3] = 64'(icache_line_fill_latency_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 4] = 64'(dcache_request_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 5] = 64'(dcache_hit_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 6] = 64'(dcache_miss_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 7] = 64'(dcache_line_fill_latency_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 8] = 64'(line_fill_occupancy_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 9] = 64'(line_fill_active_counter_reg);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) begin
+        snapshot_window_counter[INSTRUCTION_CLASSES + 10 + i] = 64'(icache_line_fill_histogram_reg[i]);
+        snapshot_window_counter[INSTRUCTION_CLASSES + 10 + LATENCY_BUCKETS + i] = 64'(dcache_line_fill_histogram_reg[i]);
+    end
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 0] = 64'(branch_misprediction_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 1] = 64'(ras_misprediction_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 2] = 64'(issue_no_instruction_stat_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 3] = 64'(issue_no_id_stat_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 4] = 64'(issue_flush_stat_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 5] = 64'(issue_unit_busy_stat_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 6] = 64'(issue_operands_not_ready_stat_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 7] = 64'(issue_hold_stat_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 8] = 64'(issue_multi_source_stat_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 9] = 64'(cycle_counter_reg);
+    snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 10] = 64'(instruction_counter_reg);
+    for (int i = 0; i < CPI_STALLS; i++) begin
+        snapshot_window_counter[INSTRUCTION_CLASSES + 10 + 2 * LATENCY_BUCKETS + 11 + i] = 64'(cpi_stall_counter_reg[i]);
+    end
+
+    for (int i = 0; i < SNAPSHOT_WINDOW_COUNTERS; i++) begin
+        snapshot_window[2 * i] = snapshot_window_counter[i][31:0];
+        snapshot_window[2 * i + 1] = snapshot_window_counter[i][63:32];
+    end
+    snapshot_window[2 * SNAPSHOT_WINDOW_COUNTERS + 0] = icache_line_fill_min_reg;
+    snapshot_window[2 * SNAPSHOT_WINDOW_COUNTERS + 1] = icache_line_fill_max_reg;
+    snapshot_window[2 * SNAPSHOT_WINDOW_COUNTERS + 2] = dcache_line_fill_min_reg;
+    snapshot_window[2 * SNAPSHOT_WINDOW_COUNTERS + 3] = dcache_line_fill_max_reg;
+end
 
 // Profiling Units
 
 // Instruction Profiler
+roi_trigger roi_trigger_block (
+    .clk(clk),
+    .rst(rst),
+    .pc_range_enable(trigger_control_reg[0]),
+    .marker_enable(trigger_control_reg[1]),
+    .restart(reg_wr_en & (reg_wr_addr == TRIGGER_CONTROL_ADDR)),
+    .start_pc_low(trigger_start_pc_low_reg),
+    .start_pc_high(trigger_start_pc_high_reg),
+    .stop_pc_low(trigger_stop_pc_low_reg),
+    .stop_pc_high(trigger_stop_pc_high_reg),
+    .instruction(abacus_instruction),
+    .instruction_pc(abacus_instruction_pc),
+    .instruction_issued(abacus_instruction_issued),
+    .count_enable(trigger_count_enable),
+    .active(trigger_active),
+    .region_count(trigger_region_count)
+);
+
 generate if (INCLUDE_INSTRUCTION_PROFILER) begin : gen_instruction_profiler_if
-    instruction_profiler # ()
+    instruction_profiler #(
+        .COUNTER_WIDTH(COUNTER_WIDTH)
+    )
     instruction_profiler_block (
         .clk(clk),
         .rst(rst),
-        .enable(instruction_profile_unit_enable_reg[0]),
+        .clear(unit_clear[UNIT_CLEAR_IP]),
+        .snapshot(snapshot),
+        .count_enable(trigger_count_enable & instruction_profile_unit_enable_reg[0] & unit_filter_pass[UNIT_CLEAR_IP]),
         .instruction_issued(abacus_instruction_issued),
         .instruction(abacus_instruction),
-        .load_word_counter(load_word_counter_reg),
-        .store_word_counter(store_word_counter_reg),
-        .addition_counter(addition_counter_reg),
-        .subtraction_counter(subtraction_counter_reg),
-        .branch_counter(branch_counter_reg),
-        .jump_counter(jump_counter_reg),
-        .system_privilege_counter(system_privilege_counter_reg),
-        .atomic_counter(atomic_counter_reg)
+        .class_counter(instruction_class_counter_reg),
+        .overflow(instruction_profile_unit_overflow)
     );
+end else begin : gen_no_instruction_profiler_if
+    assign instruction_profile_unit_overflow = '0;
 end endgenerate
 
 // Cache Profiler
 generate if (INCLUDE_CACHE_PROFILER) begin : gen_cache_profiler_if
-    cache_profiler # ()
+    cache_profiler #(
+        .COUNTER_WIDTH(COUNTER_WIDTH),
+        .LATENCY_BUCKETS(LATENCY_BUCKETS)
+    )
     cache_profiler_block (
         .clk(clk),
         .rst(rst),
-        .enable(cache_profile_unit_enable_reg[0]),
+        .clear(unit_clear[UNIT_CLEAR_CP]),
+        .snapshot(snapshot),
+        .count_enable(trigger_count_enable & cache_profile_unit_enable_reg[0] & unit_filter_pass[UNIT_CLEAR_CP]),
         .icache_request(abacus_icache_request),
         .dcache_request(abacus_dcache_request),
         .icache_miss(abacus_icache_miss),
@@ -556,16 +1353,33 @@ generate if (INCLUDE_CACHE_PROFILER) begin : gen_cache_profiler_if
         .dcache_request_counter(dcache_request_counter_reg),
         .dcache_hit_counter(dcache_hit_counter_reg),
         .dcache_miss_counter(dcache_miss_counter_reg),
-        .dcache_line_fill_latency_counter(dcache_line_fill_latency_counter_reg)
+        .dcache_line_fill_latency_counter(dcache_line_fill_latency_counter_reg),
+        .line_fill_occupancy_counter(line_fill_occupancy_counter_reg),
+        .line_fill_active_counter(line_fill_active_counter_reg),
+        .icache_line_fill_histogram(icache_line_fill_histogram_reg),
+        .dcache_line_fill_histogram(dcache_line_fill_histogram_reg),
+        .icache_line_fill_min(icache_line_fill_min_reg),
+        .icache_line_fill_max(icache_line_fill_max_reg),
+        .dcache_line_fill_min(dcache_line_fill_min_reg),
+        .dcache_line_fill_max(dcache_line_fill_max_reg),
+        .overflow(cache_profile_unit_overflow)
     );
+end else begin : gen_no_cache_profiler_if
+    assign cache_profile_unit_overflow = 12'h0;
 end endgenerate
 
 generate if (INCLUDE_STALL_UNIT) begin : gen_stall_unit_if
-	stall_unit # ()
+	stall_unit #(
+		.COUNTER_WIDTH(COUNTER_WIDTH)
+	)
 	stall_unit_block (
 		.clk(clk),
 		.rst(rst),
-		.enable(stall_unit_enable_reg[0]),
+		.clear(unit_clear[UNIT_CLEAR_SU]),
+		.snapshot(snapshot),
+		.count_enable(trigger_count_enable & stall_unit_enable_reg[0] & unit_filter_pass[UNIT_CLEAR_SU]),
+		.level_mode(stall_unit_level_mode_reg[8:0]),
+		.instruction_issued(abacus_instruction_issued),
 		.branch_misprediction(abacus_branch_misprediction),
 		.ras_misprediction(abacus_ras_misprediction),
 		.issue_no_instruction_stat(abacus_issue_no_instruction_stat),
@@ -583,8 +1397,241 @@ generate if (INCLUDE_STALL_UNIT) begin : gen_stall_unit_if
 		.issue_unit_busy_stat_counter(issue_unit_busy_stat_counter_reg),
 		.issue_operands_not_ready_stat_counter(issue_operands_not_ready_stat_counter_reg),
 		.issue_hold_stat_counter(issue_hold_stat_counter_reg),
-		.issue_multi_source_stat_counter(issue_multi_source_stat_counter_reg)
+		.issue_multi_source_stat_counter(issue_multi_source_stat_counter_reg),
+		.cycle_counter(cycle_counter_reg),
+		.instruction_counter(instruction_counter_reg),
+		.cpi_counter(cpi_stall_counter_reg),
+		.overflow(stall_unit_overflow)
 	);
+end else begin : gen_no_stall_unit_if
+	assign stall_unit_overflow = 17'h0;
+end endgenerate
+
+// Programmable Event Counters
+assign core_events = {1'b1, abacus_issue_multi_source_stat, abacus_issue_hold_stat, abacus_issue_operands_not_ready_stat,
+                      abacus_issue_unit_busy_stat, abacus_issue_flush_stat, abacus_issue_no_id_stat,
+                      abacus_issue_no_instruction_stat, abacus_ras_misprediction, abacus_branch_misprediction,
+                      abacus_dcache_line_fill_in_progress, abacus_icache_line_fill_in_progress, abacus_dcache_hit,
+                      abacus_icache_miss, abacus_dcache_request, abacus_icache_request, abacus_instruction_issued};
+
+generate if (INCLUDE_EVENT_COUNTERS) begin : gen_event_counters_if
+    event_counter_bank #(
+        .NUM_COUNTERS(NUM_EVENT_COUNTERS),
+        .NUM_EVENTS(NUM_EVENTS),
+        .COUNTER_WIDTH(COUNTER_WIDTH)
+    )
+    event_counter_bank_block (
+        .clk(clk),
+        .rst(rst),
+        .clear(unit_clear[UNIT_CLEAR_EVENTS]),
+        .snapshot(snapshot),
+        .count_enable(trigger_count_enable & unit_filter_pass[UNIT_CLEAR_EVENTS]),
+        .event_select(event_select_reg),
+        .select_write(event_select_write),
+        .events(core_events),
+        .counter(event_counter_reg),
+        .overflow(event_counter_overflow)
+    );
+end else begin : gen_no_event_counters_if
+    assign event_counter_overflow = '0;
+end endgenerate
+
+// Branch Misprediction Hot List
+generate if (INCLUDE_BRANCH_HOTLIST) begin : gen_branch_hotlist_if
+    branch_hotlist #(
+        .ENTRIES(BRANCH_HOTLIST_ENTRIES)
+    )
+    branch_hotlist_block (
+        .clk(clk),
+        .rst(rst),
+        .clear(unit_clear[UNIT_CLEAR_BH]),
+        .snapshot(snapshot),
+        .count_enable(trigger_count_enable & branch_hotlist_enable_reg[0] & unit_filter_pass[UNIT_CLEAR_BH]),
+        .branch_resolved(abacus_branch_resolved),
+        .branch_misprediction(abacus_branch_misprediction),
+        .branch_pc(abacus_branch_pc),
+        .pc(branch_hotlist_pc_reg),
+        .mispredicts(branch_hotlist_mispredicts_reg),
+        .executions(branch_hotlist_executions_reg),
+        .error(branch_hotlist_error_reg),
+        .total_mispredicts(branch_hotlist_total_mispredicts_reg),
+        .total_branches(branch_hotlist_total_branches_reg)
+    );
+end else begin : gen_no_branch_hotlist_if
+    assign branch_hotlist_pc_reg = '{default: '0};
+    assign branch_hotlist_mispredicts_reg = '{default: '0};
+    assign branch_hotlist_executions_reg = '{default: '0};
+    assign branch_hotlist_error_reg = '{default: '0};
+    assign branch_hotlist_total_mispredicts_reg = '0;
+    assign branch_hotlist_total_branches_reg = '0;
+end endgenerate
+
+// Data Cache Miss Sketch
+generate if (INCLUDE_MISS_SKETCH) begin : gen_miss_sketch_if
+    miss_sketch #(
+        .WIDTH(MISS_SKETCH_WIDTH),
+        .TOPK_ENTRIES(MISS_SKETCH_TOPK_ENTRIES)
+    )
+    miss_sketch_block (
+        .clk(clk),
+        .rst(rst),
+        .clear(unit_clear[UNIT_CLEAR_MS]),
+        .snapshot(snapshot),
+        .count_enable(trigger_count_enable & miss_sketch_enable_reg[0] & unit_filter_pass[UNIT_CLEAR_MS]),
+        .granule_shift(miss_sketch_granule_shift_reg[4:0]),
+        .filter_low(miss_sketch_filter_low_reg),
+        .filter_high(miss_sketch_filter_high_reg),
+        .line_fill_in_progress(abacus_dcache_line_fill_in_progress),
+        .miss_addr(abacus_dcache_miss_addr),
+        .read_index(miss_sketch_index_reg[$clog2(MISS_SKETCH_WIDTH)+1:0]),
+        .read_data(miss_sketch_data),
+        .clearing(miss_sketch_clearing),
+        .topk_addr(miss_sketch_topk_addr_reg),
+        .topk_count(miss_sketch_topk_count_reg),
+        .total_misses(miss_sketch_total_reg)
+    );
+end else begin : gen_no_miss_sketch_if
+    assign miss_sketch_data = 32'h0;
+    assign miss_sketch_clearing = 1'b0;
+end endgenerate
+
+// Memory Bus Profiler
+generate if (INCLUDE_BUS_PROFILER) begin : gen_bus_profiler_if
+    bus_profiler #(
+        .COUNTER_WIDTH(COUNTER_WIDTH),
+        .LATENCY_BUCKETS(LATENCY_BUCKETS)
+    )
+    bus_profiler_block (
+        .clk(clk),
+        .rst(rst),
+        .clear(unit_clear[UNIT_CLEAR_BUS]),
+        .snapshot(snapshot),
+        .count_enable(trigger_count_enable & bus_profiler_enable_reg[0] & unit_filter_pass[UNIT_CLEAR_BUS]),
+        .bus_cyc(abacus_idbus_cyc),
+        .bus_stb(abacus_idbus_stb),
+        .bus_we(abacus_idbus_we),
+        .bus_sel(abacus_idbus_sel),
+        .bus_cti(abacus_idbus_cti),
+        .bus_ack(abacus_idbus_ack),
+        .bus_err(abacus_idbus_err),
+        .cycle_counter(bus_cycle_counter_reg),
+        .read_counter(bus_read_counter_reg),
+        .write_counter(bus_write_counter_reg),
+        .read_bytes_counter(bus_read_bytes_counter_reg),
+        .write_bytes_counter(bus_write_bytes_counter_reg),
+        .busy_counter(bus_busy_counter_reg),
+        .occupancy_counter(bus_occupancy_counter_reg),
+        .wait_counter(bus_wait_counter_reg),
+        .latency_counter(bus_latency_counter_reg),
+        .latency_histogram(bus_latency_histogram_reg),
+        .latency_min(bus_latency_min_reg),
+        .latency_max(bus_latency_max_reg),
+        .overflow(bus_profiler_overflow)
+    );
+end else begin : gen_no_bus_profiler_if
+    assign bus_profiler_overflow = 10'h0;
+end endgenerate
+
+// Rate Alarms
+generate if (INCLUDE_RATE_ALARMS) begin : gen_rate_alarms_if
+    rate_alarm_bank #(
+        .NUM_ALARMS(NUM_RATE_ALARMS),
+        .NUM_EVENTS(NUM_EVENTS)
+    )
+    rate_alarm_bank_block (
+        .clk(clk),
+        .rst(rst),
+        .count_enable(trigger_count_enable & unit_filter_pass[UNIT_CLEAR_EVENTS]),
+        .alarm_select(rate_alarm_select_reg),
+        .window(rate_alarm_window_reg),
+        .threshold(rate_alarm_threshold_reg),
+        .select_write(rate_alarm_select_write),
+        .events(core_events),
+        .last_count(rate_alarm_last),
+        .crossing(rate_alarm_crossing)
+    );
+end else begin : gen_no_rate_alarms_if
+    assign rate_alarm_crossing = '0;
+end endgenerate
+
+// PC Sampler
+generate if (INCLUDE_PC_SAMPLER) begin : gen_pc_sampler_if
+    pc_sampler #(
+        .FIFO_DEPTH(PC_SAMPLE_FIFO_DEPTH)
+    )
+    pc_sampler_block (
+        .clk(clk),
+        .rst(rst),
+        .enable(pc_sampler_enable_reg[0] & unit_filter_pass[UNIT_CLEAR_PC]),
+        .clear(unit_clear[UNIT_CLEAR_PC]),
+        .sample_period(pc_sample_period_reg),
+        .instruction_pc(abacus_instruction_pc),
+        .instruction_issued(abacus_instruction_issued),
+        .pop(pc_sample_pop),
+        .sample_pc(pc_sample),
+        .sample_count(pc_sample_count),
+        .dropped_counter(pc_sample_dropped)
+    );
+end else begin : gen_no_pc_sampler_if
+    assign pc_sample = 32'h0;
+    assign pc_sample_count = 32'h0;
+    assign pc_sample_dropped = 32'h0;
+end endgenerate
+
+// Second read port of the snapshot window, abacus_smp sums the counters of every hart through it
+assign window_pair = (window_index < SNAPSHOT_WINDOW_WORDS) ?
+                     {snapshot_window[{window_index[7:1], 1'b1}], snapshot_window[{window_index[7:1], 1'b0}]} : 64'h0;
+
+// Snapshot Ring
+assign ring_restart = reg_wr_en & (reg_wr_addr == RING_CONTROL_ADDR) & reg_wr_data[0];
+assign ring_payload_word = (ring_payload_index < SNAPSHOT_WINDOW_WORDS) ? snapshot_window[ring_payload_index] : 32'h0;
+
+generate if (INCLUDE_SNAPSHOT_DMA) begin : gen_snapshot_dma_if
+    snapshot_dma #(
+        .PAYLOAD_WORDS(SNAPSHOT_WINDOW_WORDS)
+    )
+    snapshot_dma_block (
+        .clk(clk),
+        .rst(rst),
+        .enable(ring_control_reg[0]),
+        .restart(ring_restart),
+        .ring_base(ring_address_reg),
+        .ring_entries(ring_entries_reg),
+        .ring_tail(ring_tail_reg),
+        .irq_threshold(ring_irq_threshold_reg),
+        .clear_irq(reg_wr_en & (reg_wr_addr == RING_STATUS_ADDR) & reg_wr_data[0]),
+        .snapshot_tick(snapshot_tick),
+        .snapshot_cmd(snapshot_cmd),
+        .timestamp(timestamp_counter),
+        .payload_index(ring_payload_index),
+        .payload_word(ring_payload_word),
+        .busy(ring_busy),
+        .ring_head(ring_head),
+        .dropped_counter(ring_dropped),
+        .irq_pending(ring_irq_pending),
+        .bus_error(ring_bus_error),
+        .dma_cyc(dma_wb_cyc),
+        .dma_stb(dma_wb_stb),
+        .dma_we(dma_wb_we),
+        .dma_adr(dma_wb_adr),
+        .dma_dat(dma_wb_dat_o),
+        .dma_sel(dma_wb_sel),
+        .dma_ack(dma_wb_ack),
+        .dma_err(dma_wb_err)
+    );
+end else begin : gen_no_snapshot_dma_if
+    assign ring_payload_index = 8'h0;
+    assign ring_busy = 1'b0;
+    assign ring_head = 32'h0;
+    assign ring_dropped = 32'h0;
+    assign ring_irq_pending = 1'b0;
+    assign ring_bus_error = 1'b0;
+    assign dma_wb_cyc = 1'b0;
+    assign dma_wb_stb = 1'b0;
+    assign dma_wb_we = 1'b0;
+    assign dma_wb_adr = 32'h0;
+    assign dma_wb_dat_o = 32'h0;
+    assign dma_wb_sel = 4'h0;
 end endgenerate
 
 endmodule
\ No newline at end of file
@@ -69,7 +69,7 @@ class CVA5(CPU):
         flags += "-D__riscv_plic__"
         return flags
 
-    def __init__(self, platform, variant="standard"):
+    def __init__(self, platform, variant="standard", with_abacus_irq=True, with_abacus_dma=True, num_harts=1):
         self.platform     = platform
         self.variant      = variant
         self.human_name   = f"CVA5-{variant.upper()}"
@@ -77,6 +77,9 @@ class CVA5(CPU):
         self.interrupt    = Signal(2)
         self.periph_buses = [] # Peripheral buses (Connected to main SoC's bus).
         self.memory_buses = [] # Memory buses (Connected directly to LiteDRAM).
+        self.with_abacus_irq = with_abacus_irq # Route the ABACUS counter overflow interrupt to the PLIC.
+        self.with_abacus_dma = with_abacus_dma and num_harts == 1 # Let ABACUS write snapshot records to main RAM as a bus master.
+        self.num_harts = num_harts # Above 1, one ABACUS per hart behind abacus_smp.
 
         # CPU Instance.
         self.cpu_params = dict(
@@ -106,6 +109,9 @@ class CVA5(CPU):
             i_idbus_ack   = idbus.ack,
             i_idbus_err   = idbus.err,
         )
+        # A multi-core wrapper of the cores takes the core count and packs the nets of each core by hart
+        if num_harts > 1:
+            self.cpu_params.update(p_NUM_CORES=num_harts)
         self.add_sources(platform)
 
     def set_reset_address(self, reset_address):
@@ -122,9 +128,19 @@ class CVA5(CPU):
                     platform.add_source(os.path.join(cva5_path, line.strip()))
         platform.add_source(os.path.join(cva5_path, "examples/litex/litex_wrapper.sv"))
         platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/abacus_top.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/abacus_smp.sv"))
         platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/instruction_profiler.sv"))
         platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/cache_profiler.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/latency_histogram.sv"))
         platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/stall_unit.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/pc_sampler.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/roi_trigger.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/snapshot_dma.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/event_counter_bank.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/branch_hotlist.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/miss_sketch.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/bus_profiler.sv"))
+        platform.add_source(os.path.join(cva5_path, "/localhome/rajneshj/USRA/ABACUS/HDL/profiling_units/rate_alarm_bank.sv"))
 
     def do_finalize(self):
         assert hasattr(self, "reset_address")
@@ -136,16 +152,20 @@ class CVA5(CPU):
         soc.csr.add("timer0", n=3)
         soc.csr.add("supervisor", n=4)
 
-        # PLIC
-        seip = Signal()
-        meip = Signal()
-        eip = Signal(2)
-        es = Signal(2, reset=0)
+        # ABACUS counter overflow interrupt, added as the PLIC source after the SoC interrupts
+        abacus_irq = Signal()
+        irq_srcs = Cat(self.interrupt, abacus_irq) if self.with_abacus_irq else self.interrupt
+
+        # PLIC, a machine and a supervisor target per hart
+        seip = Signal(self.num_harts)
+        meip = Signal(self.num_harts)
+        eip = Signal(2 * self.num_harts)
+        es = Signal(len(irq_srcs), reset=0)
 
         self.plicbus = plicbus = wishbone.Interface(data_width=32, address_width=32, addressing="word")
         self.specials += Instance("plic_wrapper",
-            p_NUM_SOURCES = 2,
-            p_NUM_TARGETS = 2,
+            p_NUM_SOURCES = len(irq_srcs),
+            p_NUM_TARGETS = 2 * self.num_harts,
             p_PRIORITY_W = 8,
             p_REG_STAGE = 1,
             p_AXI = 0,
@@ -158,7 +178,7 @@ class CVA5(CPU):
             i_wb_dat_i = plicbus.dat_w,
             o_wb_dat_o = plicbus.dat_r,
             o_wb_ack = plicbus.ack,
-            i_irq_srcs = self.interrupt,
+            i_irq_srcs = irq_srcs,
             i_edge_sensitive = es,
             o_eip = eip,
             i_axi_awvalid = Open(),
@@ -177,8 +197,8 @@ class CVA5(CPU):
             o_axi_rdata = Open()
         )
         self.comb += [
-            meip.eq(eip[0]),
-            seip.eq(eip[1])
+            meip.eq(Cat(*[eip[2 * h] for h in range(self.num_harts)])),
+            seip.eq(Cat(*[eip[2 * h + 1] for h in range(self.num_harts)]))
         ]
         self.cpu_params.update(
             i_seip = seip,
@@ -189,12 +209,12 @@ class CVA5(CPU):
 
         # CLINT
         mtime = Signal(64)
-        msip = Signal()
-        mtip = Signal()
+        msip = Signal(self.num_harts)
+        mtip = Signal(self.num_harts)
         
         self.clintbus = clintbus = wishbone.Interface(data_width=32, address_width=32, addressing="word")
         self.specials += Instance("clint_wrapper",
-            p_NUM_CORES = 1,
+            p_NUM_CORES = self.num_harts,
             p_AXI = 0,
             i_clk = ClockSignal("sys"),
             i_rst = ResetSignal("sys"),
@@ -232,31 +252,43 @@ class CVA5(CPU):
 
         soc.bus.add_slave("clint", clintbus, region=SoCRegion(origin=self.clint_base, size=0x1_0000, cached=False))
 
+        # Nets from the cores are packed by hart, hart 0 in the low bits
+        n = self.num_harts
+
         # Instruction Profiling Unit
-        abacus_instruction = Signal(32)
-        abacus_instruction_issued = Signal()
+        abacus_instruction = Signal(32 * n)
+        abacus_instruction_pc = Signal(32 * n) # PC of abacus_instruction, also used by the PC sampler
+        abacus_instruction_issued = Signal(n)
 
         # Cache Profiling Unit
-        abacus_icache_request = Signal()
-        abacus_icache_miss = Signal()
-        abacus_icache_line_fill_in_progress = Signal()
-        abacus_dcache_request = Signal()
-        abacus_dcache_hit = Signal()
-        abacus_dcache_line_fill_in_progress = Signal()
+        abacus_icache_request = Signal(n)
+        abacus_icache_miss = Signal(n)
+        abacus_icache_line_fill_in_progress = Signal(n)
+        abacus_dcache_request = Signal(n)
+        abacus_dcache_hit = Signal(n)
+        abacus_dcache_line_fill_in_progress = Signal(n)
+        abacus_dcache_miss_addr = Signal(32 * n) # Miss sketch, address of the line being filled
 
         # Stall Unit Profiling Unit
-        abacus_branch_misprediction = Signal()
-        abacus_ras_misprediction = Signal()
-        abacus_issue_no_instruction_stat = Signal()
-        abacus_issue_no_id_stat = Signal()
-        abacus_issue_flush_stat = Signal()
-        abacus_issue_unit_busy_stat = Signal()
-        abacus_issue_operands_not_ready_stat = Signal()
-        abacus_issue_hold_stat = Signal()
-        abacus_issue_multi_source_stat = Signal()
+        abacus_branch_misprediction = Signal(n)
+        abacus_ras_misprediction = Signal(n)
+        abacus_branch_resolved = Signal(n) # Branch hot list, every resolved branch and its PC
+        abacus_branch_pc = Signal(32 * n)
+        abacus_issue_no_instruction_stat = Signal(n)
+        abacus_issue_no_id_stat = Signal(n)
+        abacus_issue_flush_stat = Signal(n)
+        abacus_issue_unit_busy_stat = Signal(n)
+        abacus_issue_operands_not_ready_stat = Signal(n)
+        abacus_issue_hold_stat = Signal(n)
+        abacus_issue_multi_source_stat = Signal(n)
+
+        # Unit filters, the privilege mode and satp ASID of each hart
+        abacus_privilege = Signal(2 * n)
+        abacus_asid = Signal(9 * n)
 
         self.cpu_params.update (
             o_abacus_instruction = abacus_instruction,
+            o_abacus_instruction_pc = abacus_instruction_pc,
             o_abacus_instruction_issued = abacus_instruction_issued,
 
             o_abacus_icache_request = abacus_icache_request,
@@ -266,9 +298,12 @@ class CVA5(CPU):
 
             o_abacus_icache_line_fill_in_progress = abacus_icache_line_fill_in_progress,
             o_abacus_dcache_line_fill_in_progress = abacus_dcache_line_fill_in_progress,
+            o_abacus_dcache_miss_addr = abacus_dcache_miss_addr,
 
             o_abacus_branch_misprediction = abacus_branch_misprediction,
             o_abacus_ras_misprediction = abacus_ras_misprediction,
+            o_abacus_branch_resolved = abacus_branch_resolved,
+            o_abacus_branch_pc = abacus_branch_pc,
             o_abacus_issue_no_instruction_stat = abacus_issue_no_instruction_stat,
             o_abacus_issue_no_id_stat = abacus_issue_no_id_stat,
             o_abacus_issue_flush_stat = abacus_issue_flush_stat,
@@ -276,27 +311,41 @@ class CVA5(CPU):
             o_abacus_issue_operands_not_ready_stat = abacus_issue_operands_not_ready_stat,
             o_abacus_issue_hold_stat = abacus_issue_hold_stat,
             o_abacus_issue_multi_source_stat = abacus_issue_multi_source_stat,
+            o_abacus_privilege = abacus_privilege,
+            o_abacus_asid = abacus_asid,
 
         )
         self.testbus = testbus = wishbone.Interface(data_width=32, address_width=32, addressing="byte")
-        self.specials += Instance("abacus_top",
-            p_WITH_AXI         = 0x0, # Use Wishbone
+        # Snapshot ring master, records go to a buffer the driver allocates in main RAM
+        self.abacus_dmabus = dmabus = wishbone.Interface(data_width=32, address_width=32, addressing="byte")
+        abacus_params = dict(
             p_ABACUS_BASE_ADDR = 0xf0030000,
             p_INCLUDE_INSTRUCTION_PROFILER = 0x1,
             p_INCLUDE_CACHE_PROFILER = 0x1,
             p_INCLUDE_STALL_UNIT = 0x1,
+            p_INCLUDE_PC_SAMPLER = 0x1,
+            p_INCLUDE_EVENT_COUNTERS = 0x1,
+            p_NUM_EVENT_COUNTERS = 4,
+            p_INCLUDE_RATE_ALARMS = 0x1,
+            p_NUM_RATE_ALARMS = 4,
+            p_COUNTER_WIDTH = 64,
 
             i_clk = ClockSignal("sys"),
             i_rst = ResetSignal("sys"),
+            o_abacus_irq = abacus_irq,
             i_wb_cyc = testbus.cyc,
             i_wb_stb = testbus.stb,
             i_wb_we = testbus.we,
             i_wb_adr = testbus.adr,
             i_wb_dat_i = testbus.dat_w,
+            i_wb_cti = testbus.cti,
+            i_wb_bte = testbus.bte,
             o_wb_dat_o = testbus.dat_r,
             o_wb_ack = testbus.ack,
+            o_wb_stall = Open(),
 
             i_abacus_instruction = abacus_instruction,
+            i_abacus_instruction_pc = abacus_instruction_pc,
             i_abacus_instruction_issued = abacus_instruction_issued,
             i_abacus_icache_request = abacus_icache_request,
             i_abacus_icache_miss = abacus_icache_miss,
@@ -304,8 +353,11 @@ class CVA5(CPU):
             i_abacus_dcache_request = abacus_dcache_request,
             i_abacus_dcache_hit = abacus_dcache_hit,
             i_abacus_dcache_line_fill_in_progress = abacus_dcache_line_fill_in_progress,
+            i_abacus_dcache_miss_addr = abacus_dcache_miss_addr,
             i_abacus_branch_misprediction = abacus_branch_misprediction,
             i_abacus_ras_misprediction = abacus_ras_misprediction,
+            i_abacus_branch_resolved = abacus_branch_resolved,
+            i_abacus_branch_pc = abacus_branch_pc,
             i_abacus_issue_no_instruction_stat = abacus_issue_no_instruction_stat,
             i_abacus_issue_no_id_stat = abacus_issue_no_id_stat,
             i_abacus_issue_flush_stat = abacus_issue_flush_stat,
@@ -313,22 +365,66 @@ class CVA5(CPU):
             i_abacus_issue_operands_not_ready_stat = abacus_issue_operands_not_ready_stat,
             i_abacus_issue_hold_stat = abacus_issue_hold_stat,
             i_abacus_issue_multi_source_stat = abacus_issue_multi_source_stat,
-        
-            i_S_AXI_AWVALID = Open(),
-            i_S_AXI_AWADDR = Open(),
-            i_S_AXI_WVALID = Open(),
-            i_S_AXI_WDATA = Open(),
-            i_S_AXI_BREADY = Open(),
-            i_S_AXI_ARVALID = Open(),
-            i_S_AXI_ARADDR = Open(),
-            i_S_AXI_RREADY = Open(),
-            o_S_AXI_AWREADY = Open(),
-            o_S_AXI_WREADY = Open(),
-            o_S_AXI_BVALID = Open(),
-            o_S_AXI_ARREADY = Open(),
-            o_S_AXI_RVALID = Open(),
-            o_S_AXI_RDATA = Open()
+            i_abacus_privilege = abacus_privilege,
+            i_abacus_asid = abacus_asid,
+
+            # Bus profiler, snoops the memory bus of the cores
+            i_abacus_idbus_cyc = self.idbus.cyc,
+            i_abacus_idbus_stb = self.idbus.stb,
+            i_abacus_idbus_we = self.idbus.we,
+            i_abacus_idbus_sel = self.idbus.sel,
+            i_abacus_idbus_cti = self.idbus.cti,
+            i_abacus_idbus_ack = self.idbus.ack,
+            i_abacus_idbus_err = self.idbus.err,
+        )
 
+        if self.num_harts > 1:
+            # One ABACUS per hart in its own 4 KiB window, and a global block at 0xf003f000
+            self.specials += Instance("abacus_smp",
+                p_NUM_HARTS = self.num_harts,
+                **abacus_params
+            )
+        else:
+            self.specials += Instance("abacus_top",
+                p_WITH_AXI         = 0x0, # Use Wishbone
+                p_INCLUDE_SNAPSHOT_DMA = 0x1 if self.with_abacus_dma else 0x0,
+
+                o_dma_wb_cyc = dmabus.cyc,
+                o_dma_wb_stb = dmabus.stb,
+                o_dma_wb_we = dmabus.we,
+                o_dma_wb_adr = dmabus.adr,
+                o_dma_wb_dat_o = dmabus.dat_w,
+                o_dma_wb_sel = dmabus.sel,
+                i_dma_wb_ack = dmabus.ack,
+                i_dma_wb_err = dmabus.err,
+
+                i_snapshot_sync = 0,
+                i_snapshot_sync_hold = 0,
+                i_unit_clear_sync = 0,
+                i_window_index = 0,
+                o_window_pair = Open(),
+
+                i_S_AXI_AWVALID = Open(),
+                i_S_AXI_AWADDR = Open(),
+                i_S_AXI_WVALID = Open(),
+                i_S_AXI_WDATA = Open(),
+                i_S_AXI_BREADY = Open(),
+                i_S_AXI_ARVALID = Open(),
+                i_S_AXI_ARADDR = Open(),
+                i_S_AXI_ARLEN = Open(),
+                i_S_AXI_ARBURST = Open(),
+                i_S_AXI_RREADY = Open(),
+                o_S_AXI_AWREADY = Open(),
+                o_S_AXI_WREADY = Open(),
+                o_S_AXI_BVALID = Open(),
+                o_S_AXI_ARREADY = Open(),
+                o_S_AXI_RVALID = Open(),
+                o_S_AXI_RLAST = Open(),
+                o_S_AXI_RDATA = Open(),
+
+                **abacus_params
             )
         soc.bus.add_slave("test", testbus, region=SoCRegion(origin=self.test_base, size=0x1_0000, cached=False))
+        if self.with_abacus_dma:
+            soc.bus.add_master(name="abacus_dma", master=dmabus)
 
@@ -0,0 +1,115 @@
+// Hot list of mispredicted branches, the ENTRIES branches with the most mispredictions, kept with the
+// space-saving algorithm. A mispredicted branch already in the table increments its entry. Any other
+// takes over the entry with the fewest mispredictions, starting from that count plus one, and the
+// count it inherited is kept as the error of the entry. So mispredicts overstates a branch by at most
+// its error, mispredicts minus error is a lower bound, and any branch mispredicted more often than
+// total_mispredicts / ENTRIES times is guaranteed to be in the table.
+//
+// Executions counts every resolve of the branch since it took its entry, mispredicted or not, so the
+// misprediction rate of a branch is roughly (mispredicts - error) / executions.
+//
+// An entry with zero mispredicts is empty. Every counter is 32 bits and saturates.
+module branch_hotlist #(
+    parameter integer ENTRIES = 8 // 1 to 15
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic clear,        // Empties the unit, live counters and outputs alike
+    input logic snapshot,     // Copy the live table to the outputs
+    input logic count_enable, // Pauses the table while low, without clearing it
+
+    input logic branch_resolved,      // A branch resolved this cycle
+    input logic branch_misprediction, // It was mispredicted
+    input logic [31:0] branch_pc,
+
+    output logic [31:0] pc [ENTRIES],
+    output logic [31:0] mispredicts [ENTRIES],
+    output logic [31:0] executions [ENTRIES],
+    output logic [31:0] error [ENTRIES],
+    output logic [31:0] total_mispredicts,
+    output logic [31:0] total_branches
+);
+
+reg [31:0] pc_reg [ENTRIES];
+reg [31:0] mispredicts_reg [ENTRIES];
+reg [31:0] executions_reg [ENTRIES];
+reg [31:0] error_reg [ENTRIES];
+reg [31:0] total_mispredicts_reg;
+reg [31:0] total_branches_reg;
+
+logic hit;
+logic [3:0] hit_index;
+logic [3:0] victim_index; // Entry with the fewest mispredictions, the first empty one if any
+
+function automatic logic [31:0] saturating_increment(input logic [31:0] value);
+    return (&value) ? value : value + 1;
+endfunction
+
+// The PC is compared with every entry at once, and the victim found in the same cycle
+always_comb begin
+    hit = 1'b0;
+    hit_index = 4'h0;
+    victim_index = 4'h0;
+    for (int i = 0; i < ENTRIES; i++) begin
+        if (~hit & (mispredicts_reg[i] != 32'h0) & (pc_reg[i] == branch_pc)) begin
+            hit = 1'b1;
+            hit_index = 4'(i);
+        end
+        if (mispredicts_reg[i] < mispredicts_reg[victim_index]) begin
+            victim_index = 4'(i);
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < ENTRIES; i++) begin
+            pc_reg[i] <= 32'h0;
+            mispredicts_reg[i] <= 32'h0;
+            executions_reg[i] <= 32'h0;
+            error_reg[i] <= 32'h0;
+        end
+        total_mispredicts_reg <= 32'h0;
+        total_branches_reg <= 32'h0;
+    end else if (count_enable & branch_resolved) begin
+        total_branches_reg <= saturating_increment(total_branches_reg);
+        if (branch_misprediction) begin
+            total_mispredicts_reg <= saturating_increment(total_mispredicts_reg);
+        end
+
+        if (hit) begin
+            executions_reg[hit_index] <= saturating_increment(executions_reg[hit_index]);
+            if (branch_misprediction) begin
+                mispredicts_reg[hit_index] <= saturating_increment(mispredicts_reg[hit_index]);
+            end
+        end else if (branch_misprediction) begin
+            pc_reg[victim_index] <= branch_pc;
+            mispredicts_reg[victim_index] <= saturating_increment(mispredicts_reg[victim_index]);
+            executions_reg[victim_index] <= 32'h1;
+            error_reg[victim_index] <= mispredicts_reg[victim_index];
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < ENTRIES; i++) begin
+            pc[i] <= 32'h0;
+            mispredicts[i] <= 32'h0;
+            executions[i] <= 32'h0;
+            error[i] <= 32'h0;
+        end
+        total_mispredicts <= 32'h0;
+        total_branches <= 32'h0;
+    end else if (snapshot) begin
+        pc <= pc_reg;
+        mispredicts <= mispredicts_reg;
+        executions <= executions_reg;
+        error <= error_reg;
+        total_mispredicts <= total_mispredicts_reg;
+        total_branches <= total_branches_reg;
+    end
+end
+
+endmodule
@@ -0,0 +1,235 @@
+// Traffic on the memory bus of the core, the classic Wishbone idbus that carries every cache fill,
+// writeback and uncached access to memory. The unit only snoops the bus.
+//
+// A transaction is a single classic cycle or a whole incrementing burst: it starts with the first
+// request of a bus cycle and ends with the acknowledge of a beat that is not followed by another
+// (cti other than 3'b010), or when cyc falls. Its latency is the time to the first word, in cycles
+// from its first request up to and including the first acknowledge, and is counted in a log2
+// histogram like latency_histogram, bucket b holding latencies of 2^b to 2^(b+1)-1 cycles.
+//
+// Cycles with cyc high are busy, those with a beat requested are occupied, and the occupied cycles
+// that are not acknowledged are wait states. The idbus has at most one beat outstanding, so the
+// occupancy is the fraction of time a request is outstanding: near 1 the bus is saturated, while a
+// low occupancy with a long latency means the core waits on memory latency, not bandwidth.
+module bus_profiler #(
+    parameter integer COUNTER_WIDTH = 64,
+    parameter integer LATENCY_BUCKETS = 12
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic clear,        // Empties the unit, live counters and outputs alike
+    input logic snapshot,     // Copy the live counters to the outputs
+    input logic count_enable, // Pauses counting while low, without clearing the counters
+
+    input logic bus_cyc,
+    input logic bus_stb,
+    input logic bus_we,
+    input logic [3:0] bus_sel,
+    input logic [2:0] bus_cti,
+    input logic bus_ack,
+    input logic bus_err,
+
+    output logic [COUNTER_WIDTH-1:0] cycle_counter,
+    output logic [COUNTER_WIDTH-1:0] read_counter,       // Read transactions
+    output logic [COUNTER_WIDTH-1:0] write_counter,      // Write transactions
+    output logic [COUNTER_WIDTH-1:0] read_bytes_counter, // Byte lanes of acknowledged read beats
+    output logic [COUNTER_WIDTH-1:0] write_bytes_counter,
+    output logic [COUNTER_WIDTH-1:0] busy_counter,       // Cycles with cyc high
+    output logic [COUNTER_WIDTH-1:0] occupancy_counter,  // Cycles with a beat requested
+    output logic [COUNTER_WIDTH-1:0] wait_counter,       // Requested but not acknowledged
+    output logic [COUNTER_WIDTH-1:0] latency_counter,    // First word latencies summed
+
+    output logic [COUNTER_WIDTH-1:0] latency_histogram [LATENCY_BUCKETS],
+    output logic [31:0] latency_min, // All ones until the first transaction completes
+    output logic [31:0] latency_max,
+
+    // One cycle pulse when a counter wraps, in register order. Bit 9 flags any bucket of the histogram.
+    output logic [9:0] overflow
+);
+
+localparam integer BUCKET_WIDTH = $clog2(LATENCY_BUCKETS);
+
+reg [COUNTER_WIDTH-1:0] cycle_counter_reg;
+reg [COUNTER_WIDTH-1:0] read_counter_reg;
+reg [COUNTER_WIDTH-1:0] write_counter_reg;
+reg [COUNTER_WIDTH-1:0] read_bytes_counter_reg;
+reg [COUNTER_WIDTH-1:0] write_bytes_counter_reg;
+reg [COUNTER_WIDTH-1:0] busy_counter_reg;
+reg [COUNTER_WIDTH-1:0] occupancy_counter_reg;
+reg [COUNTER_WIDTH-1:0] wait_counter_reg;
+reg [COUNTER_WIDTH-1:0] latency_counter_reg;
+reg [COUNTER_WIDTH-1:0] latency_histogram_reg [LATENCY_BUCKETS];
+reg [31:0] latency_min_reg;
+reg [31:0] latency_max_reg;
+
+logic request;
+logic beat_done;
+logic transaction_start;
+logic in_transaction;     // Between the first request and the last acknowledge
+logic first_word_pending; // The first beat has not been acknowledged yet
+logic first_word_done;
+logic [31:0] latency;     // Cycles since the first request, saturating
+logic [31:0] first_word_latency;
+logic [2:0] beat_bytes;
+
+assign request = bus_cyc & bus_stb;
+assign beat_done = request & (bus_ack | bus_err);
+assign transaction_start = request & ~in_transaction;
+assign first_word_done = beat_done & (transaction_start | first_word_pending);
+assign first_word_latency = transaction_start ? 32'h1 : ((&latency) ? latency : latency + 1);
+assign beat_bytes = 3'(bus_sel[0]) + 3'(bus_sel[1]) + 3'(bus_sel[2]) + 3'(bus_sel[3]);
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        in_transaction <= 1'b0;
+        first_word_pending <= 1'b0;
+        latency <= 32'h0;
+    end else begin
+        if (~bus_cyc | (beat_done & (bus_cti != 3'b010))) begin
+            in_transaction <= 1'b0;
+        end else if (transaction_start) begin
+            in_transaction <= 1'b1;
+        end
+
+        if (~bus_cyc | first_word_done) begin
+            first_word_pending <= 1'b0;
+        end else if (transaction_start) begin
+            first_word_pending <= 1'b1;
+        end
+
+        latency <= first_word_latency;
+    end
+end
+
+// floor(log2(latency)) of the transaction whose first word arrives, clamped to the last bucket
+logic [BUCKET_WIDTH-1:0] bucket;
+
+always_comb begin
+    bucket = '0;
+    for (int i = 1; i < 32; i++) begin
+        if (first_word_latency[i]) begin
+            bucket = (i >= LATENCY_BUCKETS) ? BUCKET_WIDTH'(LATENCY_BUCKETS - 1) : BUCKET_WIDTH'(i);
+        end
+    end
+end
+
+// The counters increment by at most four, so an MSB falling means a wrap
+logic [8:0] counter_msb;
+logic [8:0] counter_msb_prev;
+logic [LATENCY_BUCKETS-1:0] bucket_msb;
+logic [LATENCY_BUCKETS-1:0] bucket_msb_prev;
+
+assign counter_msb = {latency_counter_reg[COUNTER_WIDTH-1], wait_counter_reg[COUNTER_WIDTH-1],
+                      occupancy_counter_reg[COUNTER_WIDTH-1], busy_counter_reg[COUNTER_WIDTH-1],
+                      write_bytes_counter_reg[COUNTER_WIDTH-1], read_bytes_counter_reg[COUNTER_WIDTH-1],
+                      write_counter_reg[COUNTER_WIDTH-1], read_counter_reg[COUNTER_WIDTH-1],
+                      cycle_counter_reg[COUNTER_WIDTH-1]};
+
+always_comb begin
+    for (int i = 0; i < LATENCY_BUCKETS; i++) begin
+        bucket_msb[i] = latency_histogram_reg[i][COUNTER_WIDTH-1];
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        counter_msb_prev <= '0;
+        bucket_msb_prev <= '0;
+        overflow <= 10'h0;
+    end else begin
+        counter_msb_prev <= counter_msb;
+        bucket_msb_prev <= bucket_msb;
+        overflow <= {|(bucket_msb_prev & ~bucket_msb), counter_msb_prev & ~counter_msb};
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        cycle_counter_reg <= '0;
+        read_counter_reg <= '0;
+        write_counter_reg <= '0;
+        read_bytes_counter_reg <= '0;
+        write_bytes_counter_reg <= '0;
+        busy_counter_reg <= '0;
+        occupancy_counter_reg <= '0;
+        wait_counter_reg <= '0;
+        latency_counter_reg <= '0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++) begin
+            latency_histogram_reg[i] <= '0;
+        end
+        latency_min_reg <= 32'hffffffff;
+        latency_max_reg <= 32'h0;
+    end else if (count_enable) begin
+        cycle_counter_reg <= cycle_counter_reg + 1;
+
+        if (transaction_start & ~bus_we) begin
+            read_counter_reg <= read_counter_reg + 1;
+        end
+        if (transaction_start & bus_we) begin
+            write_counter_reg <= write_counter_reg + 1;
+        end
+
+        if (request & bus_ack & ~bus_we) begin
+            read_bytes_counter_reg <= read_bytes_counter_reg + COUNTER_WIDTH'(beat_bytes);
+        end
+        if (request & bus_ack & bus_we) begin
+            write_bytes_counter_reg <= write_bytes_counter_reg + COUNTER_WIDTH'(beat_bytes);
+        end
+
+        if (bus_cyc) begin
+            busy_counter_reg <= busy_counter_reg + 1;
+        end
+        if (request) begin
+            occupancy_counter_reg <= occupancy_counter_reg + 1;
+        end
+        if (request & ~bus_ack & ~bus_err) begin
+            wait_counter_reg <= wait_counter_reg + 1;
+        end
+
+        if (first_word_done) begin
+            latency_counter_reg <= latency_counter_reg + COUNTER_WIDTH'(first_word_latency);
+            latency_histogram_reg[bucket] <= latency_histogram_reg[bucket] + 1;
+            if (first_word_latency < latency_min_reg) begin
+                latency_min_reg <= first_word_latency;
+            end
+            if (first_word_latency > latency_max_reg) begin
+                latency_max_reg <= first_word_latency;
+            end
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        cycle_counter <= '0;
+        read_counter <= '0;
+        write_counter <= '0;
+        read_bytes_counter <= '0;
+        write_bytes_counter <= '0;
+        busy_counter <= '0;
+        occupancy_counter <= '0;
+        wait_counter <= '0;
+        latency_counter <= '0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++) begin
+            latency_histogram[i] <= '0;
+        end
+        latency_min <= 32'hffffffff;
+        latency_max <= 32'h0;
+    end else if (snapshot) begin
+        cycle_counter <= cycle_counter_reg;
+        read_counter <= read_counter_reg;
+        write_counter <= write_counter_reg;
+        read_bytes_counter <= read_bytes_counter_reg;
+        write_bytes_counter <= write_bytes_counter_reg;
+        busy_counter <= busy_counter_reg;
+        occupancy_counter <= occupancy_counter_reg;
+        wait_counter <= wait_counter_reg;
+        latency_counter <= latency_counter_reg;
+        latency_histogram <= latency_histogram_reg;
+        latency_min <= latency_min_reg;
+        latency_max <= latency_max_reg;
+    end
+end
+
+endmodule
@@ -1,10 +1,13 @@
 module cache_profiler #(
-    parameter unsigned CLOCK_FREQ = 1000000 // 1MHz 
+    parameter integer COUNTER_WIDTH = 64,
+    parameter integer LATENCY_BUCKETS = 12 // Log2 line fill latency buckets per cache, see latency_histogram
 )
 (
     input logic clk,
     input logic rst,
-    input logic enable,
+    input logic clear,    // Empties the unit, live counters and outputs alike
+    input logic snapshot, // Copy the live counters to the outputs
+    input logic count_enable, // Pauses counting while low, without clearing the counters
 
     input logic icache_miss,
     input logic icache_request,
@@ -15,29 +18,47 @@ module cache_profiler #(
     input logic icache_line_fill_in_progress,
     input logic dcache_line_fill_in_progress,
 
-    output logic [31:0] icache_hit_counter,
-    output logic [31:0] icache_miss_counter,
-    output logic [31:0] icache_request_counter,
+    output logic [COUNTER_WIDTH-1:0] icache_hit_counter,
+    output logic [COUNTER_WIDTH-1:0] icache_miss_counter,
+    output logic [COUNTER_WIDTH-1:0] icache_request_counter,
 
-    output logic [31:0] dcache_hit_counter,
-    output logic [31:0] dcache_miss_counter,
-    output logic [31:0] dcache_request_counter,
+    output logic [COUNTER_WIDTH-1:0] dcache_hit_counter,
+    output logic [COUNTER_WIDTH-1:0] dcache_miss_counter,
+    output logic [COUNTER_WIDTH-1:0] dcache_request_counter,
 
-    output logic [31:0] icache_line_fill_latency_counter,
-    output logic [31:0] dcache_line_fill_latency_counter
+    output logic [COUNTER_WIDTH-1:0] icache_line_fill_latency_counter,
+    output logic [COUNTER_WIDTH-1:0] dcache_line_fill_latency_counter,
+
+    // Memory-level parallelism: outstanding fills summed over every cycle, and the cycles with at least
+    // one fill outstanding. Their ratio is the average number of overlapping fills while memory is busy.
+    output logic [COUNTER_WIDTH-1:0] line_fill_occupancy_counter,
+    output logic [COUNTER_WIDTH-1:0] line_fill_active_counter,
+
+    output logic [COUNTER_WIDTH-1:0] icache_line_fill_histogram [LATENCY_BUCKETS],
+    output logic [COUNTER_WIDTH-1:0] dcache_line_fill_histogram [LATENCY_BUCKETS],
+    output logic [31:0] icache_line_fill_min,
+    output logic [31:0] icache_line_fill_max,
+    output logic [31:0] dcache_line_fill_min,
+    output logic [31:0] dcache_line_fill_max,
+
+    // One cycle pulse when a counter wraps, in register order. Bits 10 and 11 flag any bucket of the
+    // icache and dcache histograms.
+    output logic [11:0] overflow
 );
 
-reg [31:0] icache_request_counter_reg;
-reg [31:0] dcache_request_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_request_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_request_counter_reg;
 
-reg [31:0] icache_miss_counter_reg;
-reg [31:0] dcache_miss_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_miss_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_miss_counter_reg;
 
-reg [31:0] icache_hit_counter_reg;
-reg [31:0] dcache_hit_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_hit_counter_reg;
 
-reg [31:0] icache_line_fill_latency_counter_reg;
-reg [31:0] dcache_line_fill_latency_counter_reg;
+reg [COUNTER_WIDTH-1:0] icache_line_fill_latency_counter_reg;
+reg [COUNTER_WIDTH-1:0] dcache_line_fill_latency_counter_reg;
+
+reg [COUNTER_WIDTH-1:0] line_fill_occupancy_counter_reg;
+reg [COUNTER_WIDTH-1:0] line_fill_active_counter_reg;
 
 logic icache_request_prev;
 logic dcache_request_prev;
@@ -45,80 +66,143 @@ logic icache_miss_prev;
 logic dcache_hit_prev;
 logic dcache_line_fill_in_progress_prev;
 
-int i;
+// A counter only ever increments by one or two, so its MSB falling means it wrapped.
+// The icache hit count is derived from the request count, so it is flagged along with it.
+logic [9:0] counter_msb;
+logic [9:0] counter_msb_prev;
+logic [1:0] histogram_overflow;
+
+assign counter_msb = {line_fill_active_counter_reg[COUNTER_WIDTH-1], line_fill_occupancy_counter_reg[COUNTER_WIDTH-1],
+                      dcache_line_fill_latency_counter_reg[COUNTER_WIDTH-1], dcache_miss_counter_reg[COUNTER_WIDTH-1],
+                      dcache_hit_counter_reg[COUNTER_WIDTH-1], dcache_request_counter_reg[COUNTER_WIDTH-1],
+                      icache_line_fill_latency_counter_reg[COUNTER_WIDTH-1], icache_miss_counter_reg[COUNTER_WIDTH-1],
+                      icache_request_counter_reg[COUNTER_WIDTH-1], icache_request_counter_reg[COUNTER_WIDTH-1]};
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        counter_msb_prev <= 10'b0;
+        overflow <= 12'b0;
+    end else begin
+        counter_msb_prev <= counter_msb;
+        overflow <= {histogram_overflow, counter_msb_prev & ~counter_msb};
+    end
+end
+
+latency_histogram #(
+    .COUNTER_WIDTH(COUNTER_WIDTH),
+    .BUCKETS(LATENCY_BUCKETS)
+) icache_latency_histogram (
+    .clk(clk),
+    .rst(rst),
+    .clear(clear),
+    .snapshot(snapshot),
+    .count_enable(count_enable),
+    .busy(icache_line_fill_in_progress),
+    .bucket_counter(icache_line_fill_histogram),
+    .latency_min(icache_line_fill_min),
+    .latency_max(icache_line_fill_max),
+    .overflow(histogram_overflow[0])
+);
+
+latency_histogram #(
+    .COUNTER_WIDTH(COUNTER_WIDTH),
+    .BUCKETS(LATENCY_BUCKETS)
+) dcache_latency_histogram (
+    .clk(clk),
+    .rst(rst),
+    .clear(clear),
+    .snapshot(snapshot),
+    .count_enable(count_enable),
+    .busy(dcache_line_fill_in_progress),
+    .bucket_counter(dcache_line_fill_histogram),
+    .latency_min(dcache_line_fill_min),
+    .latency_max(dcache_line_fill_max),
+    .overflow(histogram_overflow[1])
+);
 
 always_ff @(posedge clk or posedge rst) begin
-    if (rst | ~enable) begin
+    if (rst | clear) begin
 
         /*Internal Regs*/
-        icache_request_counter_reg <= 32'h0;
-        icache_miss_counter_reg <= 32'h0;
-        icache_hit_counter_reg <= 32'h0;
-        icache_line_fill_latency_counter_reg <= 32'h0;
+        icache_request_counter_reg <= '0;
+        icache_miss_counter_reg <= '0;
+        icache_line_fill_latency_counter_reg <= '0;
+
+        dcache_request_counter_reg <= '0;
+        dcache_miss_counter_reg <= '0;
+        dcache_hit_counter_reg <= '0;
+        dcache_line_fill_latency_counter_reg <= '0;
 
-        dcache_request_counter_reg <= 32'h0;
-        dcache_miss_counter_reg <= 32'h0;
-        dcache_hit_counter_reg <= 32'h0;
-        dcache_line_fill_latency_counter_reg <= 32'h0;
+        line_fill_occupancy_counter_reg <= '0;
+        line_fill_active_counter_reg <= '0;
 
         /*Output that internals regs drive*/
-        icache_request_counter <= 32'h0;
-        icache_miss_counter <= 32'h0;
-        icache_hit_counter <= 32'h0;
-        icache_line_fill_latency_counter <= 32'h0;
+        icache_request_counter <= '0;
+        icache_miss_counter <= '0;
+        icache_hit_counter <= '0;
+        icache_line_fill_latency_counter <= '0;
 
-        dcache_request_counter <= 32'h0;
-        dcache_miss_counter <= 32'h0;
-        dcache_hit_counter <= 32'h0;
-        dcache_line_fill_latency_counter <= 32'h0;
+        dcache_request_counter <= '0;
+        dcache_miss_counter <= '0;
+        dcache_hit_counter <= '0;
+        dcache_line_fill_latency_counter <= '0;
+
+        line_fill_occupancy_counter <= '0;
+        line_fill_active_counter <= '0;
 
         icache_request_prev <= 1'b0;
         dcache_request_prev <= 1'b0;
         icache_miss_prev <= 1'b0;
         dcache_hit_prev <= 1'b0;
         dcache_line_fill_in_progress_prev <= 1'b0;
-
-        i <= 0;  // Initialize counter
     end else begin
-        if (~icache_request_prev && icache_request) begin
+        if (count_enable & ~icache_request_prev & icache_request) begin
             icache_request_counter_reg <= icache_request_counter_reg + 1;
         end
         icache_request_prev <= icache_request;
 
-        if (~icache_miss_prev & icache_miss) begin
+        if (count_enable & ~icache_miss_prev & icache_miss) begin
             icache_miss_counter_reg <= icache_miss_counter_reg + 1;
         end
         icache_miss_prev <= icache_miss;
 
-        if (icache_line_fill_in_progress) begin
+        if (count_enable & icache_line_fill_in_progress) begin
             icache_line_fill_latency_counter_reg <= icache_line_fill_latency_counter_reg + 1;
         end
 
-        if (~dcache_request_prev & dcache_request) begin
+        if (count_enable & ~dcache_request_prev & dcache_request) begin
             dcache_request_counter_reg <= dcache_request_counter_reg + 1;
         end
         dcache_request_prev <= dcache_request;
 
-        if (~dcache_hit_prev & dcache_hit) begin
+        if (count_enable & ~dcache_hit_prev & dcache_hit) begin
             dcache_hit_counter_reg <= dcache_hit_counter_reg + 1;
         end
         dcache_hit_prev <= dcache_hit;
         
-        if (dcache_line_fill_in_progress) begin
+        if (count_enable & dcache_line_fill_in_progress) begin
             dcache_line_fill_latency_counter_reg <= dcache_line_fill_latency_counter_reg + 1;
         end
 
-        if (~dcache_line_fill_in_progress_prev & dcache_line_fill_in_progress) begin
+        if (count_enable & ~dcache_line_fill_in_progress_prev & dcache_line_fill_in_progress) begin
             dcache_miss_counter_reg <= dcache_miss_counter_reg + 1;
         end
         dcache_line_fill_in_progress_prev <= dcache_line_fill_in_progress;
 
-        icache_hit_counter_reg <= icache_request_counter_reg - icache_miss_counter_reg;
+        // The core has at most one fill outstanding per cache
+        if (count_enable) begin
+            line_fill_occupancy_counter_reg <= line_fill_occupancy_counter_reg +
+                                               COUNTER_WIDTH'(icache_line_fill_in_progress) + COUNTER_WIDTH'(dcache_line_fill_in_progress);
+        end
+        if (count_enable & (icache_line_fill_in_progress | dcache_line_fill_in_progress)) begin
+            line_fill_active_counter_reg <= line_fill_active_counter_reg + 1;
+        end
 
-        // Increment counter and update output registers at the specified interval
-        if (i == CLOCK_FREQ) begin  // Update all registers every second for data consistency
+        // Update output registers on a snapshot, for data consistency across all units.
+        // Hits are derived from the same request and miss values that are latched.
+        if (snapshot) begin
             icache_request_counter <= icache_request_counter_reg;
-            icache_hit_counter <= icache_hit_counter_reg;
+            icache_hit_counter <= icache_request_counter_reg - icache_miss_counter_reg;
             icache_miss_counter <= icache_miss_counter_reg;
             icache_line_fill_latency_counter <= icache_line_fill_latency_counter_reg;
 
@@ -126,9 +210,9 @@ always_ff @(posedge clk or posedge rst) begin
             dcache_hit_counter <= dcache_hit_counter_reg;
             dcache_miss_counter <= dcache_miss_counter_reg;
             dcache_line_fill_latency_counter <= dcache_line_fill_latency_counter_reg;
-            i <= 0;
-        end else begin
-            i <= i + 1;
+
+            line_fill_occupancy_counter <= line_fill_occupancy_counter_reg;
+            line_fill_active_counter <= line_fill_active_counter_reg;
         end
     end
 end
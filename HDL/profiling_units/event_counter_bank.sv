@@ -0,0 +1,92 @@
+// Bank of generic counters, each counting whichever core event its select register chooses. An event
+// is counted every cycle it is high (level mode) or on its rising edges (edge mode). A counter holds
+// its count while its enable bit is low and is cleared in the cycle its select register is written,
+// so software reprograms a counter and starts it from zero with one write.
+module event_counter_bank #(
+    parameter integer NUM_COUNTERS = 4,  // 1 to 16
+    parameter integer NUM_EVENTS = 17,
+    parameter integer COUNTER_WIDTH = 64
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic clear,        // Empties every counter, live counters and outputs alike
+    input logic snapshot,     // Copy the live counters to the outputs
+    input logic count_enable, // Pauses counting while low, without clearing the counters
+
+    input logic [31:0] event_select [NUM_COUNTERS], // Bits 7:0 event, bit 8 edge mode, bit 31 enable
+    input logic [NUM_COUNTERS-1:0] select_write,    // Select register n is being written
+
+    input logic [NUM_EVENTS-1:0] events,
+
+    output logic [COUNTER_WIDTH-1:0] counter [NUM_COUNTERS],
+    output logic [NUM_COUNTERS-1:0] overflow // One cycle pulse when a counter wraps
+);
+
+localparam integer SELECT_EDGE = 8;
+localparam integer SELECT_ENABLE = 31;
+
+reg [COUNTER_WIDTH-1:0] counter_reg [NUM_COUNTERS];
+logic [NUM_EVENTS-1:0] events_prev;
+logic [NUM_EVENTS-1:0] event_edges;
+logic [NUM_COUNTERS-1:0] increment;
+logic [NUM_COUNTERS-1:0] counter_clear;
+
+// Edges are detected once per event and shared by every counter that selects it
+assign event_edges = events & ~events_prev;
+
+always_comb begin
+    for (int i = 0; i < NUM_COUNTERS; i++) begin
+        counter_clear[i] = clear | select_write[i];
+        if (~event_select[i][SELECT_ENABLE] | (event_select[i][7:0] >= 8'(NUM_EVENTS))) begin
+            increment[i] = 1'b0; // Stopped counters and unknown events count nothing
+        end else if (event_select[i][SELECT_EDGE]) begin
+            increment[i] = count_enable & event_edges[event_select[i][7:0]];
+        end else begin
+            increment[i] = count_enable & events[event_select[i][7:0]];
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        events_prev <= '0;
+    end else begin
+        events_prev <= events;
+    end
+end
+
+// A counter wraps when it increments from all ones
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        overflow <= '0;
+    end else begin
+        for (int i = 0; i < NUM_COUNTERS; i++) begin
+            overflow[i] <= ~counter_clear[i] & increment[i] & (&counter_reg[i]);
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < NUM_COUNTERS; i++) begin
+            counter_reg[i] <= '0;
+            counter[i] <= '0;
+        end
+    end else begin
+        for (int i = 0; i < NUM_COUNTERS; i++) begin
+            if (counter_clear[i]) begin
+                counter_reg[i] <= '0;
+            end else if (increment[i]) begin
+                counter_reg[i] <= counter_reg[i] + 1;
+            end
+        end
+
+        // Update output registers on a snapshot, for data consistency across all units
+        if (snapshot) begin
+            counter <= counter_reg;
+        end
+    end
+end
+
+endmodule
@@ -1,97 +1,204 @@
-module instruction_profiler(
+module instruction_profiler #(
+    parameter integer COUNTER_WIDTH = 64,
+    localparam integer INSTRUCTION_CLASSES = 23 // Number of CLASS_* counters below
+)
+(
     input logic clk,
     input logic rst,
-    input logic enable,
+    input logic clear,    // Empties the unit, live counters and outputs alike
+    input logic snapshot, // Copy the live counters to the outputs
+    input logic count_enable, // Pauses counting while low, without clearing the counters
 
     input logic [31:0] instruction,
     input logic instruction_issued,
 
-    output logic [31:0] load_word_counter,  // LB, LH, LW, LB, LHU, LUI
-    output logic [31:0] store_word_counter, // SB, SH, SW
-    output logic [31:0] addition_counter,   // ADD, ADDI, AUIPC
-    output logic [31:0] subtraction_counter, // SUB
-    output logic [31:0] branch_counter,     // BEQ, BNE, BLT, BGE, BLTU, BGEU
-    output logic [31:0] jump_counter,       // JAL, JALR
-    output logic [31:0] system_privilege_counter, // ECALL, EBREAK
-    output logic [31:0] atomic_counter      // LR.W, SC.W, AMOSWAP.W, AMOADD.W, AMOAND.W, AMOOR.W, AMOXOR.W, AMOMAX.W, AMOMIN.W
+    // One counter per instruction class, in the order of the CLASS_* indices below
+    output logic [COUNTER_WIDTH-1:0] class_counter [INSTRUCTION_CLASSES],
+
+    output logic [INSTRUCTION_CLASSES-1:0] overflow // One cycle pulse when a counter wraps, in register order
 );
 
 // Source: https://www.cs.sfu.ca/~ashriram/Courses/CS295/assets/notebooks/RISCV/RISCV_CARD.pdf
+// and the RISC-V unprivileged ISA, chapter "RV32/64G Instruction Set Listings"
 
-// Counters for different instruction types, initialized to zero.
-reg [31:0] load_word_counter_reg;
-reg [31:0] store_word_counter_reg;
-reg [31:0] addition_counter_reg;
-reg [31:0] subtraction_counter_reg;
-reg [31:0] branch_counter_reg;
-reg [31:0] jump_counter_reg; 
-reg [31:0] system_privilege_counter_reg;
-reg [31:0] atomic_counter_reg;
+// Instruction classes, also the register index of each counter
+localparam logic [4:0] CLASS_LOAD                  = 5'd0;  // LB, LH, LW, LBU, LHU
+localparam logic [4:0] CLASS_STORE                 = 5'd1;  // SB, SH, SW
+localparam logic [4:0] CLASS_ADDITION              = 5'd2;  // ADD, ADDI
+localparam logic [4:0] CLASS_SUBTRACTION           = 5'd3;  // SUB
+localparam logic [4:0] CLASS_BRANCH                = 5'd4;  // BEQ, BNE, BLT, BGE, BLTU, BGEU
+localparam logic [4:0] CLASS_JUMP                  = 5'd5;  // JAL, JALR
+localparam logic [4:0] CLASS_SYSTEM_PRIVILEGE      = 5'd6;  // ECALL, EBREAK, SRET, MRET, WFI, SFENCE.VMA
+localparam logic [4:0] CLASS_ATOMIC                = 5'd7;  // LR.W, SC.W, AMO*.W
+localparam logic [4:0] CLASS_LOGICAL               = 5'd8;  // AND, OR, XOR, ANDI, ORI, XORI
+localparam logic [4:0] CLASS_SHIFT                 = 5'd9;  // SLL, SRL, SRA, SLLI, SRLI, SRAI
+localparam logic [4:0] CLASS_COMPARE               = 5'd10; // SLT, SLTU, SLTI, SLTIU
+localparam logic [4:0] CLASS_UPPER_IMMEDIATE       = 5'd11; // LUI, AUIPC
+localparam logic [4:0] CLASS_MULTIPLY              = 5'd12; // MUL, MULH, MULHSU, MULHU
+localparam logic [4:0] CLASS_DIVIDE                = 5'd13; // DIV, DIVU, REM, REMU
+localparam logic [4:0] CLASS_CSR                   = 5'd14; // CSRRW, CSRRS, CSRRC, CSRRWI, CSRRSI, CSRRCI
+localparam logic [4:0] CLASS_FENCE                 = 5'd15; // FENCE, FENCE.I
+localparam logic [4:0] CLASS_FP_LOAD               = 5'd16; // FLW, FLD
+localparam logic [4:0] CLASS_FP_STORE              = 5'd17; // FSW, FSD
+localparam logic [4:0] CLASS_FP_ARITHMETIC         = 5'd18; // FADD, FSUB, FMUL, FSGNJ*, FMIN, FMAX, FCVT*, FMV*, FEQ, FLT, FLE, FCLASS
+localparam logic [4:0] CLASS_FP_FUSED_MULTIPLY_ADD = 5'd19; // FMADD, FMSUB, FNMSUB, FNMADD
+localparam logic [4:0] CLASS_FP_DIVIDE_SQRT        = 5'd20; // FDIV, FSQRT
+localparam logic [4:0] CLASS_OTHER                 = 5'd21; // Anything else, so the classes add up to the total
+localparam logic [4:0] CLASS_TOTAL                 = 5'd22; // Every issued instruction
 
-reg [31:0] last_sampled_instruction;
+// Decode tables. The major opcode (instruction[6:2]) selects a class, and the opcodes that hold
+// several classes are refined by funct3, funct7 or funct5 through the tables that follow.
+localparam logic [4:0] REFINE = 5'h1f; // Class depends on the function fields
 
-// Procedure to increment counters
-always_ff @(posedge clk or posedge rst) begin
-    if (rst | ~enable) begin
-        // Reset all bit vectors
-        load_word_counter_reg        <= 32'b0;
-        store_word_counter_reg       <= 32'b0;
-        addition_counter_reg         <= 32'b0;
-        subtraction_counter_reg      <= 32'b0;
-        branch_counter_reg           <= 32'b0;
-        jump_counter_reg             <= 32'b0;
-        system_privilege_counter_reg <= 32'b0;
-        atomic_counter_reg           <= 32'b0;
-        last_sampled_instruction     <= 32'b0;
-    end else if (instruction_issued & (instruction != last_sampled_instruction)) begin
-
-        // Extract opcode from issued instruction (RISC-V, 7-bit opcode [6:0])
-        case (instruction[6:0])
-            7'b0000011: load_word_counter_reg <= load_word_counter_reg + 1;
-            7'b0100011: store_word_counter_reg <= store_word_counter_reg + 1;
-            7'b1100011: branch_counter_reg <= branch_counter_reg + 1;
-
-            7'b1101111: jump_counter_reg <= jump_counter_reg + 1; // JAL
-            7'b1100111: jump_counter_reg <= jump_counter_reg + 1;  // JALR
-
-            7'b1110011: system_privilege_counter_reg <= system_privilege_counter_reg + 1;
-            7'b0101111: atomic_counter_reg <= atomic_counter_reg + 1;
-
-            // R-type
-            7'b0110011: begin
-                case (instruction[14:12]) // Check funct3
-                    3'b000: begin
-                        case (instruction[31:25])
-                            7'b0000000: addition_counter_reg <= addition_counter_reg + 1;    // ADD
-                            7'b0100000: subtraction_counter_reg <= subtraction_counter_reg + 1; // SUB
-                        endcase
-                    end
-                endcase
-            end
+localparam logic [4:0] OPCODE_CLASS [32] = '{
+    CLASS_LOAD,                  // 00000 LOAD
+    CLASS_FP_LOAD,               // 00001 LOAD-FP
+    CLASS_OTHER,                 // 00010 custom-0
+    CLASS_FENCE,                 // 00011 MISC-MEM
+    REFINE,                      // 00100 OP-IMM
+    CLASS_UPPER_IMMEDIATE,       // 00101 AUIPC
+    CLASS_OTHER,                 // 00110 OP-IMM-32
+    CLASS_OTHER,                 // 00111 48-bit
+    CLASS_STORE,                 // 01000 STORE
+    CLASS_FP_STORE,              // 01001 STORE-FP
+    CLASS_OTHER,                 // 01010 custom-1
+    CLASS_ATOMIC,                // 01011 AMO
+    REFINE,                      // 01100 OP
+    CLASS_UPPER_IMMEDIATE,       // 01101 LUI
+    CLASS_OTHER,                 // 01110 OP-32
+    CLASS_OTHER,                 // 01111 64-bit
+    CLASS_FP_FUSED_MULTIPLY_ADD, // 10000 MADD
+    CLASS_FP_FUSED_MULTIPLY_ADD, // 10001 MSUB
+    CLASS_FP_FUSED_MULTIPLY_ADD, // 10010 NMSUB
+    CLASS_FP_FUSED_MULTIPLY_ADD, // 10011 NMADD
+    REFINE,                      // 10100 OP-FP
+    CLASS_OTHER,                 // 10101 reserved
+    CLASS_OTHER,                 // 10110 custom-2
+    CLASS_OTHER,                 // 10111 48-bit
+    CLASS_BRANCH,                // 11000 BRANCH
+    CLASS_JUMP,                  // 11001 JALR
+    CLASS_OTHER,                 // 11010 reserved
+    CLASS_JUMP,                  // 11011 JAL
+    REFINE,                      // 11100 SYSTEM
+    CLASS_OTHER,                 // 11101 reserved
+    CLASS_OTHER,                 // 11110 custom-3
+    CLASS_OTHER                  // 11111 80-bit
+};
+
+// OP and OP-IMM with funct7 = 0000000, indexed by funct3. SUB and SRA (funct7 = 0100000) are handled below.
+localparam logic [4:0] OP_CLASS [8] = '{
+    CLASS_ADDITION, // 000 ADD, ADDI
+    CLASS_SHIFT,    // 001 SLL, SLLI
+    CLASS_COMPARE,  // 010 SLT, SLTI
+    CLASS_COMPARE,  // 011 SLTU, SLTIU
+    CLASS_LOGICAL,  // 100 XOR, XORI
+    CLASS_SHIFT,    // 101 SRL, SRLI
+    CLASS_LOGICAL,  // 110 OR, ORI
+    CLASS_LOGICAL   // 111 AND, ANDI
+};
+
+// OP with funct7 = 0000001 (M extension), indexed by funct3
+localparam logic [4:0] MULDIV_CLASS [8] = '{
+    CLASS_MULTIPLY, CLASS_MULTIPLY, CLASS_MULTIPLY, CLASS_MULTIPLY, // MUL, MULH, MULHSU, MULHU
+    CLASS_DIVIDE, CLASS_DIVIDE, CLASS_DIVIDE, CLASS_DIVIDE          // DIV, DIVU, REM, REMU
+};
+
+logic [4:0] opcode;
+logic [2:0] funct3;
+logic [6:0] funct7;
+logic [4:0] instruction_class;
+
+assign opcode = instruction[6:2];
+assign funct3 = instruction[14:12];
+assign funct7 = instruction[31:25];
 
-            // I-type
-            7'b0010011: begin
-                case (instruction[14:12]) // Check funct3
-                    3'b000: addition_counter_reg <= addition_counter_reg + 1;
-                endcase
+always_comb begin
+    if (instruction[1:0] != 2'b11) begin
+        instruction_class = CLASS_OTHER; // Compressed encodings are not supported by the core
+    end else if (OPCODE_CLASS[opcode] != REFINE) begin
+        instruction_class = OPCODE_CLASS[opcode];
+    end else begin
+        case (opcode)
+            5'b00100: instruction_class = OP_CLASS[funct3]; // OP-IMM
+            5'b01100: begin // OP
+                if (funct7 == 7'b0000000) begin
+                    instruction_class = OP_CLASS[funct3];
+                end else if (funct7 == 7'b0000001) begin
+                    instruction_class = MULDIV_CLASS[funct3];
+                end else if (funct7 == 7'b0100000 && funct3 == 3'b000) begin
+                    instruction_class = CLASS_SUBTRACTION;
+                end else if (funct7 == 7'b0100000 && funct3 == 3'b101) begin
+                    instruction_class = CLASS_SHIFT; // SRA
+                end else begin
+                    instruction_class = CLASS_OTHER;
+                end
+            end
+            5'b10100: begin // OP-FP, funct5 selects the operation
+                if (funct7[6:2] == 5'b00011 || funct7[6:2] == 5'b01011) begin
+                    instruction_class = CLASS_FP_DIVIDE_SQRT;
+                end else begin
+                    instruction_class = CLASS_FP_ARITHMETIC;
+                end
+            end
+            5'b11100: begin // SYSTEM
+                if (funct3 == 3'b000) begin
+                    instruction_class = CLASS_SYSTEM_PRIVILEGE;
+                end else if (funct3 == 3'b100) begin
+                    instruction_class = CLASS_OTHER;
+                end else begin
+                    instruction_class = CLASS_CSR;
+                end
             end
+            default: instruction_class = CLASS_OTHER;
         endcase
-        
-        // Update last_sampled_instruction only after counting the instruction
-        last_sampled_instruction <= instruction;
     end
 end
 
+// Live counters
+reg [COUNTER_WIDTH-1:0] class_counter_reg [INSTRUCTION_CLASSES];
+
+// A counter only ever increments by one, so its MSB falling means it wrapped
+logic [INSTRUCTION_CLASSES-1:0] counter_msb;
+logic [INSTRUCTION_CLASSES-1:0] counter_msb_prev;
+
 always_comb begin
-    load_word_counter        <= load_word_counter_reg;
-    store_word_counter       <= store_word_counter_reg;
-    addition_counter         <= addition_counter_reg;
-    subtraction_counter      <= subtraction_counter_reg;
-    branch_counter           <= branch_counter_reg;
-    jump_counter             <= jump_counter_reg;
-    system_privilege_counter <= system_privilege_counter_reg;
-    atomic_counter           <= atomic_counter_reg;
+    for (int i = 0; i < INSTRUCTION_CLASSES; i++) begin
+        counter_msb[i] = class_counter_reg[i][COUNTER_WIDTH-1];
+    end
 end
 
-endmodule
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        counter_msb_prev <= '0;
+        overflow <= '0;
+    end else begin
+        counter_msb_prev <= counter_msb;
+        overflow <= counter_msb_prev & ~counter_msb;
+    end
+end
 
+// Every issue is counted once in its class and once in the total, including an instruction
+// that issues back to back with the same encoding, as in a tight loop
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < INSTRUCTION_CLASSES; i++) begin
+            class_counter_reg[i] <= '0;
+        end
+    end else if (instruction_issued & count_enable) begin
+        class_counter_reg[instruction_class] <= class_counter_reg[instruction_class] + 1;
+        class_counter_reg[CLASS_TOTAL] <= class_counter_reg[CLASS_TOTAL] + 1;
+    end
+end
+
+// Outputs only change on a snapshot, so they stay consistent with the other units
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < INSTRUCTION_CLASSES; i++) begin
+            class_counter[i] <= '0;
+        end
+    end else if (snapshot) begin
+        class_counter <= class_counter_reg;
+    end
+end
+
+endmodule
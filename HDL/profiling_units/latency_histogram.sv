@@ -0,0 +1,117 @@
+// Latency distribution of a busy signal, such as a cache line fill in progress. Each busy period
+// is timed and counted in a log2 bucket: bucket b counts periods of 2^b to 2^(b+1)-1 cycles, and
+// the last bucket also counts everything longer. The shortest and longest periods are kept as well.
+module latency_histogram #(
+    parameter integer COUNTER_WIDTH = 64,
+    parameter integer BUCKETS = 12
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic clear,    // Empties the buckets and the min and max
+    input logic snapshot, // Copy the live counters to the outputs
+    input logic count_enable, // A period is only recorded if it ends while this is high
+
+    input logic busy,
+
+    output logic [COUNTER_WIDTH-1:0] bucket_counter [BUCKETS],
+    output logic [31:0] latency_min, // All ones until the first period ends
+    output logic [31:0] latency_max,
+
+    output logic overflow // One cycle pulse when any bucket wraps
+);
+
+localparam integer BUCKET_WIDTH = $clog2(BUCKETS);
+
+// Length of the current busy period, saturating so a stuck signal does not wrap into a short bucket
+logic [31:0] latency;
+logic busy_prev;
+logic period_end;
+
+assign period_end = busy_prev & ~busy;
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        latency <= 32'h0;
+        busy_prev <= 1'b0;
+    end else begin
+        busy_prev <= busy;
+        if (busy) begin
+            latency <= (latency == 32'hffffffff) ? latency : latency + 1;
+        end else begin
+            latency <= 32'h0;
+        end
+    end
+end
+
+// floor(log2(latency)), clamped to the last bucket
+logic [BUCKET_WIDTH-1:0] bucket;
+
+always_comb begin
+    bucket = '0;
+    for (int i = 1; i < 32; i++) begin
+        if (latency[i]) begin
+            bucket = (i >= BUCKETS) ? BUCKET_WIDTH'(BUCKETS - 1) : BUCKET_WIDTH'(i);
+        end
+    end
+end
+
+// Live counters
+reg [COUNTER_WIDTH-1:0] bucket_counter_reg [BUCKETS];
+reg [31:0] latency_min_reg;
+reg [31:0] latency_max_reg;
+
+// A counter only ever increments by one, so its MSB falling means it wrapped
+logic [BUCKETS-1:0] counter_msb;
+logic [BUCKETS-1:0] counter_msb_prev;
+
+always_comb begin
+    for (int i = 0; i < BUCKETS; i++) begin
+        counter_msb[i] = bucket_counter_reg[i][COUNTER_WIDTH-1];
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        counter_msb_prev <= '0;
+        overflow <= 1'b0;
+    end else begin
+        counter_msb_prev <= counter_msb;
+        overflow <= |(counter_msb_prev & ~counter_msb);
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < BUCKETS; i++) begin
+            bucket_counter_reg[i] <= '0;
+        end
+        latency_min_reg <= 32'hffffffff;
+        latency_max_reg <= 32'h0;
+    end else if (period_end & count_enable) begin
+        bucket_counter_reg[bucket] <= bucket_counter_reg[bucket] + 1;
+        if (latency < latency_min_reg) begin
+            latency_min_reg <= latency;
+        end
+        if (latency > latency_max_reg) begin
+            latency_max_reg <= latency;
+        end
+    end
+end
+
+// Outputs only change on a snapshot, so they stay consistent with the other units
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < BUCKETS; i++) begin
+            bucket_counter[i] <= '0;
+        end
+        latency_min <= 32'hffffffff;
+        latency_max <= 32'h0;
+    end else if (snapshot) begin
+        bucket_counter <= bucket_counter_reg;
+        latency_min <= latency_min_reg;
+        latency_max <= latency_max_reg;
+    end
+end
+
+endmodule
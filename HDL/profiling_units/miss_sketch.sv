@@ -0,0 +1,229 @@
+// Data cache miss addresses in a count-min sketch, to show which data structures miss. The address
+// of every line fill is reduced to a granule, addr >> granule_shift (6 for 64-byte lines, 12 for
+// pages), and counted in one counter of each of the ROWS rows of WIDTH counters, the counter chosen
+// in row r by the multiplicative hash
+//
+//     index_r = (granule * HASH[r]) >> (32 - log2(WIDTH))   (32-bit product)
+//
+// Counters of different granules can collide, so the smallest of the ROWS counters of a granule is an
+// estimate that is never below its true count. Software that knows the hash sums the estimates over
+// the granules of an array or symbol to get its misses. The TOPK_ENTRIES granules with the largest
+// estimates are also kept in a table, updated with the estimate after every miss.
+//
+// Only misses with filter_low <= address <= filter_high are counted. The sketch is in block RAM and
+// is read live, one counter at a time through read_index, while the top-K table and the total are
+// copied on snapshot. Clearing the unit empties it; the sketch is then swept one column per cycle
+// and misses are not counted while clearing is high.
+module miss_sketch #(
+    parameter integer WIDTH = 1024,      // Counters per row, power of two, 64 to 4096
+    parameter integer TOPK_ENTRIES = 8,  // 1 to 16
+    localparam integer ROWS = 4,
+    localparam integer INDEX_BITS = $clog2(WIDTH)
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic clear,        // Empties the sketch, the table and the total
+    input logic snapshot,     // Copy the top-K table and the total to the outputs
+    input logic count_enable, // Pauses counting while low, without clearing
+
+    input logic [4:0] granule_shift,
+    input logic [31:0] filter_low,
+    input logic [31:0] filter_high,
+
+    input logic line_fill_in_progress, // A miss starts a fill, counted on its rising edge
+    input logic [31:0] miss_addr,      // Address of the line being filled, valid on that edge
+
+    input logic [INDEX_BITS+1:0] read_index, // Counter read through read_data, row * WIDTH + column
+    output logic [31:0] read_data,           // Valid two cycles after read_index changes
+
+    output logic clearing,
+    output logic [31:0] topk_addr [TOPK_ENTRIES],  // First address of the granule, all zero for an empty entry
+    output logic [31:0] topk_count [TOPK_ENTRIES], // Estimated misses
+    output logic [31:0] total_misses
+);
+
+localparam logic [31:0] HASH [ROWS] = '{32'h9e3779b1, 32'h85ebca77, 32'hc2b2ae3d, 32'h27d4eb2f};
+
+logic line_fill_in_progress_prev;
+logic miss;
+logic [INDEX_BITS-1:0] sweep_index;
+
+// Update pipeline. A miss is captured, its counters are read, written back incremented, and the
+// top-K table updated with the estimate, one stage per cycle. Misses are rising edges of the fill,
+// so they are at least two cycles apart and a counter is written before the next miss reads it.
+logic capture_valid;
+logic [31:0] capture_granule;
+logic [INDEX_BITS-1:0] hash_index [ROWS];
+
+logic read_valid;
+logic [31:0] read_granule;
+logic [INDEX_BITS-1:0] read_counter_index [ROWS];
+logic [31:0] update_data [ROWS];
+
+logic [31:0] incremented [ROWS];
+logic [31:0] estimate;
+logic write_enable;
+logic [31:0] write_data [ROWS];
+
+logic topk_valid;
+logic [31:0] topk_granule;
+logic [31:0] topk_estimate;
+
+reg [31:0] topk_granule_reg [TOPK_ENTRIES];
+reg [31:0] topk_count_reg [TOPK_ENTRIES];
+reg [31:0] total_misses_reg;
+logic topk_hit;
+logic [3:0] topk_hit_index;
+logic [3:0] topk_victim_index;
+
+logic [31:0] bus_data [ROWS];
+logic [1:0] bus_row;
+
+function automatic logic [31:0] saturating_increment(input logic [31:0] value);
+    return (&value) ? value : value + 1;
+endfunction
+
+assign miss = line_fill_in_progress & ~line_fill_in_progress_prev;
+
+always_comb begin
+    for (int r = 0; r < ROWS; r++) begin
+        hash_index[r] = INDEX_BITS'((capture_granule * HASH[r]) >> (32 - INDEX_BITS));
+    end
+end
+
+always_comb begin
+    estimate = 32'hffffffff;
+    for (int r = 0; r < ROWS; r++) begin
+        incremented[r] = saturating_increment(update_data[r]);
+        if (incremented[r] < estimate) begin
+            estimate = incremented[r];
+        end
+    end
+end
+
+// The sweep and the updates share the write port, updates are held off while clearing
+assign write_enable = clearing | read_valid;
+
+always_comb begin
+    for (int r = 0; r < ROWS; r++) begin
+        write_data[r] = clearing ? 32'h0 : incremented[r];
+    end
+end
+
+generate for (genvar r = 0; r < ROWS; r++) begin : gen_rows
+    logic [31:0] counters [WIDTH];
+
+    always_ff @(posedge clk) begin
+        if (write_enable) begin
+            counters[clearing ? sweep_index : read_counter_index[r]] <= write_data[r];
+        end
+        update_data[r] <= counters[hash_index[r]];
+    end
+
+    // Second port, for the bus
+    always_ff @(posedge clk) begin
+        bus_data[r] <= counters[read_index[INDEX_BITS-1:0]];
+    end
+end endgenerate
+
+always_ff @(posedge clk) begin
+    bus_row <= read_index[INDEX_BITS+1:INDEX_BITS];
+end
+
+assign read_data = bus_data[bus_row];
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        clearing <= 1'b1;
+        sweep_index <= '0;
+    end else if (clearing) begin
+        sweep_index <= sweep_index + 1;
+        if (&sweep_index) begin
+            clearing <= 1'b0;
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        line_fill_in_progress_prev <= 1'b0;
+        capture_valid <= 1'b0;
+        capture_granule <= 32'h0;
+        read_valid <= 1'b0;
+        read_granule <= 32'h0;
+        for (int r = 0; r < ROWS; r++) begin
+            read_counter_index[r] <= '0;
+        end
+        topk_valid <= 1'b0;
+        topk_granule <= 32'h0;
+        topk_estimate <= 32'h0;
+        total_misses_reg <= 32'h0;
+    end else begin
+        line_fill_in_progress_prev <= line_fill_in_progress;
+
+        capture_valid <= ~clearing & count_enable & miss & (miss_addr >= filter_low) & (miss_addr <= filter_high);
+        capture_granule <= miss_addr >> granule_shift;
+
+        read_valid <= capture_valid;
+        read_granule <= capture_granule;
+        read_counter_index <= hash_index;
+
+        topk_valid <= read_valid;
+        topk_granule <= read_granule;
+        topk_estimate <= estimate;
+        if (read_valid) begin
+            total_misses_reg <= saturating_increment(total_misses_reg);
+        end
+    end
+end
+
+// A granule in the table takes its new estimate, any other replaces the smallest entry if it is larger
+always_comb begin
+    topk_hit = 1'b0;
+    topk_hit_index = 4'h0;
+    topk_victim_index = 4'h0;
+    for (int i = 0; i < TOPK_ENTRIES; i++) begin
+        if (~topk_hit & (topk_count_reg[i] != 32'h0) & (topk_granule_reg[i] == topk_granule)) begin
+            topk_hit = 1'b1;
+            topk_hit_index = 4'(i);
+        end
+        if (topk_count_reg[i] < topk_count_reg[topk_victim_index]) begin
+            topk_victim_index = 4'(i);
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < TOPK_ENTRIES; i++) begin
+            topk_granule_reg[i] <= 32'h0;
+            topk_count_reg[i] <= 32'h0;
+        end
+    end else if (topk_valid) begin
+        if (topk_hit) begin
+            topk_count_reg[topk_hit_index] <= topk_estimate;
+        end else if (topk_estimate > topk_count_reg[topk_victim_index]) begin
+            topk_granule_reg[topk_victim_index] <= topk_granule;
+            topk_count_reg[topk_victim_index] <= topk_estimate;
+        end
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        for (int i = 0; i < TOPK_ENTRIES; i++) begin
+            topk_addr[i] <= 32'h0;
+            topk_count[i] <= 32'h0;
+        end
+        total_misses <= 32'h0;
+    end else if (snapshot) begin
+        for (int i = 0; i < TOPK_ENTRIES; i++) begin
+            topk_addr[i] <= topk_granule_reg[i] << granule_shift;
+        end
+        topk_count <= topk_count_reg;
+        total_misses <= total_misses_reg;
+    end
+end
+
+endmodule
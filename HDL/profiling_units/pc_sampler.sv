@@ -0,0 +1,91 @@
+module pc_sampler #(
+    parameter integer FIFO_DEPTH = 256 // Power of two
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic enable, // Pauses sampling while low, the FIFO can still be drained
+    input logic clear,  // Empties the FIFO and the dropped counter
+
+    input logic [31:0] sample_period, // Cycles between samples, 0 stops sampling
+
+    input logic [31:0] instruction_pc,
+    input logic instruction_issued,
+
+    input logic pop, // Remove the oldest sample from the FIFO
+
+    output logic [31:0] sample_pc,    // Oldest sample, valid while sample_count is non-zero
+    output logic [31:0] sample_count, // Samples waiting in the FIFO
+    output logic [31:0] dropped_counter // Samples lost because the FIFO was full
+);
+
+// Every sample_period cycles the sampler is armed, and the PC of the next instruction
+// to issue is pushed into the FIFO. Sampling on issue rather than on the exact cycle means
+// stalled cycles are attributed to the instruction that was waiting to issue.
+
+localparam integer PTR_WIDTH = $clog2(FIFO_DEPTH);
+
+logic [31:0] fifo [FIFO_DEPTH];
+logic [PTR_WIDTH:0] wr_ptr;
+logic [PTR_WIDTH:0] rd_ptr;
+
+logic [31:0] period_timer;
+logic sample_tick;
+logic armed;
+
+logic full;
+logic empty;
+logic push;
+
+assign sample_count = 32'(wr_ptr - rd_ptr);
+assign full = (wr_ptr - rd_ptr) == FIFO_DEPTH[PTR_WIDTH:0];
+assign empty = (wr_ptr == rd_ptr);
+
+assign sample_tick = enable & (sample_period != 32'h0) & (period_timer >= sample_period - 1);
+assign push = enable & armed & instruction_issued;
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+        period_timer <= 32'h0;
+        armed <= 1'b0;
+        wr_ptr <= '0;
+        rd_ptr <= '0;
+        dropped_counter <= 32'h0;
+    end else begin
+        if (sample_tick) begin
+            period_timer <= 32'h0;
+        end else if (enable) begin
+            period_timer <= period_timer + 1;
+        end
+
+        // A tick in the same cycle as a push arms the next sample
+        if (sample_tick) begin
+            armed <= 1'b1;
+        end else if (push) begin
+            armed <= 1'b0;
+        end
+
+        if (push) begin
+            if (~full) begin
+                wr_ptr <= wr_ptr + 1;
+            end else begin
+                dropped_counter <= dropped_counter + 1;
+            end
+        end
+
+        if (pop & ~empty) begin
+            rd_ptr <= rd_ptr + 1;
+        end
+    end
+end
+
+// FIFO storage, kept free of resets so it maps onto distributed RAM
+always_ff @(posedge clk) begin
+    if (push & ~full) begin
+        fifo[wr_ptr[PTR_WIDTH-1:0]] <= instruction_pc;
+    end
+end
+
+assign sample_pc = empty ? 32'h0 : fifo[rd_ptr[PTR_WIDTH-1:0]];
+
+endmodule
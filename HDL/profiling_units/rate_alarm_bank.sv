@@ -0,0 +1,106 @@
+// Bank of rate alarms. Alarm n counts the core event chosen by its select register, encoded like those
+// of event_counter_bank, over tumbling windows of a programmable number of counted cycles. The first
+// time the count of a window exceeds the threshold, crossing pulses for one cycle, and the alarm stays
+// quiet until the next window, so a burst raises one crossing per window however long it lasts. At the
+// end of every window the count is kept in last_count and a new window starts from zero. An alarm is
+// stopped while its enable bit is low or its window is 0, and restarts in the cycle its select register
+// is written.
+module rate_alarm_bank #(
+    parameter integer NUM_ALARMS = 4,  // 1 to 8
+    parameter integer NUM_EVENTS = 17
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic count_enable, // Pauses the windows and the counts while low
+
+    input logic [31:0] alarm_select [NUM_ALARMS], // Bits 7:0 event, bit 8 edge mode, bit 31 enable
+    input logic [31:0] window [NUM_ALARMS],       // Counted cycles per window, 0 stops the alarm
+    input logic [31:0] threshold [NUM_ALARMS],    // Crossing when a window counts more than this
+    input logic [NUM_ALARMS-1:0] select_write,    // Select register n is being written
+
+    input logic [NUM_EVENTS-1:0] events,
+
+    output logic [31:0] last_count [NUM_ALARMS], // Count of the last full window, saturating
+    output logic [NUM_ALARMS-1:0] crossing       // One cycle pulse when a window exceeds its threshold
+);
+
+localparam integer SELECT_EDGE = 8;
+localparam integer SELECT_ENABLE = 31;
+
+reg [31:0] count_reg [NUM_ALARMS];
+reg [31:0] window_timer [NUM_ALARMS];
+reg [NUM_ALARMS-1:0] armed;
+logic [NUM_EVENTS-1:0] events_prev;
+logic [NUM_EVENTS-1:0] event_edges;
+logic [NUM_ALARMS-1:0] increment;
+logic [NUM_ALARMS-1:0] alarm_clear;
+logic [NUM_ALARMS-1:0] window_end;
+logic [31:0] count_next [NUM_ALARMS];
+
+assign event_edges = events & ~events_prev;
+
+always_comb begin
+    for (int i = 0; i < NUM_ALARMS; i++) begin
+        alarm_clear[i] = ~alarm_select[i][SELECT_ENABLE] | (window[i] == 32'h0) | select_write[i];
+        if (alarm_select[i][7:0] >= 8'(NUM_EVENTS)) begin
+            increment[i] = 1'b0; // Unknown events count nothing
+        end else if (alarm_select[i][SELECT_EDGE]) begin
+            increment[i] = count_enable & event_edges[alarm_select[i][7:0]];
+        end else begin
+            increment[i] = count_enable & events[alarm_select[i][7:0]];
+        end
+        count_next[i] = count_reg[i] + {31'h0, increment[i] & ~(&count_reg[i])};
+        window_end[i] = count_enable & (window_timer[i] >= window[i] - 1);
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        events_prev <= '0;
+    end else begin
+        events_prev <= events;
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+        for (int i = 0; i < NUM_ALARMS; i++) begin
+            count_reg[i] <= 32'h0;
+            window_timer[i] <= 32'h0;
+            last_count[i] <= 32'h0;
+        end
+        armed <= '1;
+        crossing <= '0;
+    end else begin
+        for (int i = 0; i < NUM_ALARMS; i++) begin
+            if (alarm_clear[i]) begin
+                count_reg[i] <= 32'h0;
+                window_timer[i] <= 32'h0;
+                armed[i] <= 1'b1;
+                crossing[i] <= 1'b0;
+                if (select_write[i]) begin
+                    last_count[i] <= 32'h0;
+                end
+            end else begin
+                crossing[i] <= armed[i] & (count_next[i] > threshold[i]);
+                if (window_end[i]) begin
+                    last_count[i] <= count_next[i];
+                    count_reg[i] <= 32'h0;
+                    window_timer[i] <= 32'h0;
+                    armed[i] <= 1'b1;
+                end else begin
+                    count_reg[i] <= count_next[i];
+                    if (count_enable) begin
+                        window_timer[i] <= window_timer[i] + 1;
+                    end
+                    if (count_next[i] > threshold[i]) begin
+                        armed[i] <= 1'b0;
+                    end
+                end
+            end
+        end
+    end
+end
+
+endmodule
@@ -0,0 +1,66 @@
+// Region-of-interest trigger. Starts and stops counting in the profiling units from the instruction
+// stream, so a region can be measured without an MMIO write perturbing it. A region starts when an
+// instruction issues from the start PC range or a start marker issues, and stops on the stop PC range
+// or a stop marker. With no trigger mode selected, counting is never gated.
+//
+// Markers are SLTI hints with rd = x0, which the ISA leaves for custom use and which execute as NOPs:
+//   slti x0, x0, 1  start the region (0x00102013)
+//   slti x0, x0, 2  stop the region  (0x00202013)
+module roi_trigger (
+    input logic clk,
+    input logic rst,
+
+    input logic pc_range_enable, // Start and stop on the PC ranges
+    input logic marker_enable,   // Start and stop on the marker instructions
+    input logic restart,         // Leave the region, on a write to the trigger control register
+
+    // Inclusive ranges, a range whose start is above its end never matches
+    input logic [31:0] start_pc_low,
+    input logic [31:0] start_pc_high,
+    input logic [31:0] stop_pc_low,
+    input logic [31:0] stop_pc_high,
+
+    input logic [31:0] instruction,
+    input logic [31:0] instruction_pc,
+    input logic instruction_issued,
+
+    output logic count_enable, // Combinational, applies to the instruction issuing this cycle
+    output logic active,       // Inside the region
+    output logic [31:0] region_count // Regions entered since the last restart
+);
+
+localparam logic [31:0] START_MARKER = 32'h00102013;
+localparam logic [31:0] STOP_MARKER  = 32'h00202013;
+
+logic start_pc_hit;
+logic stop_pc_hit;
+logic start_marker_hit;
+logic stop_marker_hit;
+logic start_hit;
+logic stop_hit;
+
+assign start_pc_hit = pc_range_enable & instruction_issued & (instruction_pc >= start_pc_low) & (instruction_pc <= start_pc_high);
+assign stop_pc_hit = pc_range_enable & instruction_issued & (instruction_pc >= stop_pc_low) & (instruction_pc <= stop_pc_high);
+assign start_marker_hit = marker_enable & instruction_issued & (instruction == START_MARKER);
+assign stop_marker_hit = marker_enable & instruction_issued & (instruction == STOP_MARKER);
+
+assign start_hit = start_pc_hit | start_marker_hit;
+assign stop_hit = stop_pc_hit | stop_marker_hit;
+
+// The first instruction of a PC range region is counted, the instruction that ends it is not, and
+// neither marker is, so a region holds exactly the instructions between its boundaries
+assign count_enable = ~(pc_range_enable | marker_enable) | ((active | start_pc_hit) & ~stop_hit);
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | restart) begin
+        active <= 1'b0;
+        region_count <= 32'h0;
+    end else if (stop_hit) begin
+        active <= 1'b0;
+    end else if (start_hit & ~active) begin
+        active <= 1'b1;
+        region_count <= region_count + 1;
+    end
+end
+
+endmodule
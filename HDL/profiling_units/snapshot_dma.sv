@@ -0,0 +1,149 @@
+module snapshot_dma #(
+    parameter integer PAYLOAD_WORDS = 152 // Words of the snapshot window copied into each record
+)
+(
+    input logic clk,
+    input logic rst,
+    input logic enable,
+    input logic restart,              // Start a new run from record 0
+
+    input logic [31:0] ring_base,     // Bus address of record 0
+    input logic [31:0] ring_entries,  // Records in the ring, at least 2
+    input logic [31:0] ring_tail,     // Next record software will consume
+    input logic [31:0] irq_threshold, // Records per interrupt, 0 counts as 1
+    input logic clear_irq,
+
+    input logic snapshot_tick,        // Automatic snapshot, taken on this edge
+    input logic snapshot_cmd,         // Software snapshot, changes the counters under a record being copied
+    input logic [63:0] timestamp,     // Free-running cycle count
+
+    output logic [7:0] payload_index, // Word of the snapshot window to copy
+    input logic [31:0] payload_word,
+
+    output logic busy,                // A record is being written, hold the snapshot counters
+    output logic [31:0] ring_head,    // Next record the unit will write
+    output logic [31:0] dropped_counter, // Automatic snapshots lost to a full ring
+    output logic irq_pending,
+    output logic bus_error,
+
+    // Wishbone classic master, byte addressed
+    output logic dma_cyc,
+    output logic dma_stb,
+    output logic dma_we,
+    output logic [31:0] dma_adr,
+    output logic [31:0] dma_dat,
+    output logic [3:0] dma_sel,
+    input logic dma_ack,
+    input logic dma_err
+);
+
+// On every automatic snapshot while enabled, a record is written to the ring in memory: a 4 word
+// header, the snapshot window, and zero padding to a multiple of 64 bytes. The header words are
+// timestamp low and high, flags and sequence. The payload goes first and the sequence word last,
+// so software that sees the sequence it expects in a record knows the whole record has landed.
+// The ring is full when the record after ring_head is ring_tail, and snapshots are then dropped.
+
+localparam integer HEADER_WORDS = 4;
+localparam integer RECORD_WORDS = (HEADER_WORDS + PAYLOAD_WORDS + 15) / 16 * 16;
+localparam logic [7:0] LAST_WORD = 8'(RECORD_WORDS - 1);
+
+localparam integer FLAG_TORN = 0; // A software snapshot changed the counters while they were copied
+
+logic [31:0] next_head;
+logic full;
+logic start;
+
+logic [7:0] word;          // Word of the record being written
+logic [31:0] record_addr;
+logic [63:0] record_timestamp;
+logic [31:0] record_flags;
+logic [31:0] sequence;
+logic [15:0] drops_since_record;
+logic [31:0] records_since_irq;
+
+assign next_head = (ring_head == ring_entries - 1) ? 32'h0 : ring_head + 1;
+assign full = (next_head == ring_tail);
+assign start = enable & ~bus_error & ~busy & snapshot_tick;
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | restart) begin
+        busy <= 1'b0;
+        word <= 8'h0;
+        ring_head <= 32'h0;
+        sequence <= 32'h1;
+        dropped_counter <= 32'h0;
+        drops_since_record <= 16'h0;
+        records_since_irq <= 32'h0;
+        irq_pending <= 1'b0;
+        bus_error <= 1'b0;
+        record_addr <= 32'h0;
+        record_timestamp <= 64'h0;
+        record_flags <= 32'h0;
+    end else begin
+        if (start & full) begin
+            dropped_counter <= dropped_counter + 1;
+            if (drops_since_record != 16'hffff) begin
+                drops_since_record <= drops_since_record + 1;
+            end
+        end else if (start) begin
+            busy <= 1'b1;
+            word <= 8'(HEADER_WORDS);
+            record_addr <= ring_base + ring_head * (RECORD_WORDS * 4);
+            record_timestamp <= timestamp;
+            record_flags <= {drops_since_record, 16'h0};
+            drops_since_record <= 16'h0;
+        end
+
+        if (busy & snapshot_cmd & (word >= 8'(HEADER_WORDS))) begin
+            record_flags[FLAG_TORN] <= 1'b1;
+        end
+
+        if (busy & dma_err) begin
+            // The record is abandoned and the ring stays stopped until the next start
+            busy <= 1'b0;
+            bus_error <= 1'b1;
+        end else if (busy & dma_ack) begin
+            if (word == 8'(HEADER_WORDS - 1)) begin
+                busy <= 1'b0;
+                ring_head <= next_head;
+                sequence <= sequence + 1;
+            end else if (word == LAST_WORD) begin
+                word <= 8'h0;
+            end else begin
+                word <= word + 1;
+            end
+        end
+
+        // A drop wakes software as well, it is falling behind. Setting wins over a clear in the same cycle.
+        if ((busy & dma_ack & (word == 8'(HEADER_WORDS - 1)) & (records_since_irq + 1 >= irq_threshold)) | (start & full)) begin
+            irq_pending <= 1'b1;
+        end else if (clear_irq) begin
+            irq_pending <= 1'b0;
+        end
+
+        if (busy & dma_ack & (word == 8'(HEADER_WORDS - 1))) begin
+            records_since_irq <= (records_since_irq + 1 >= irq_threshold) ? 32'h0 : records_since_irq + 1;
+        end
+    end
+end
+
+assign payload_index = word - 8'(HEADER_WORDS);
+
+always_comb begin
+    case (word)
+        8'd0: dma_dat = record_timestamp[31:0];
+        8'd1: dma_dat = record_timestamp[63:32];
+        8'd2: dma_dat = record_flags;
+        8'd3: dma_dat = sequence;
+        default: dma_dat = (word < 8'(HEADER_WORDS + PAYLOAD_WORDS)) ? payload_word : 32'h0;
+    endcase
+end
+
+// One single write per word, the request is held until it is acknowledged
+assign dma_cyc = busy;
+assign dma_stb = busy;
+assign dma_we = busy;
+assign dma_adr = record_addr + {22'h0, word, 2'b00};
+assign dma_sel = 4'hf;
+
+endmodule
@@ -1,9 +1,25 @@
-module stall_unit # 
-    (parameter unsigned CLOCK_FREQ = 1000000) // 1MHz 
+// Issue stage stall causes, plus a cycle counter, an issued-instruction counter and a top-down
+// CPI stack. Each stall cause counter counts rising edges of its signal (stall events) by default,
+// or every cycle the signal is high when its bit of level_mode is set.
+//
+// The CPI stack puts every counted cycle in exactly one category: a cycle that issues an instruction
+// is an issue cycle, any other cycle goes to the first of its stall causes in the order flush,
+// frontend empty (no instruction), hold, operand dependency, unit busy, and cycles with none of
+// them go to other. The issued-instruction counter and the six stall categories therefore add up
+// to the cycle counter.
+module stall_unit #(
+    parameter integer COUNTER_WIDTH = 64,
+    localparam integer CPI_STALLS = 6 // Number of CPI_* categories below
+)
 (
     input logic clk,
     input logic rst,
-    input logic enable,
+    input logic clear,    // Empties the unit, live counters and outputs alike
+    input logic snapshot, // Copy the live counters to the outputs
+    input logic count_enable, // Pauses counting while low, without clearing the counters
+    input logic [8:0] level_mode, // Bit n: stall counter n counts cycles instead of events, in register order
+
+    input logic instruction_issued,
 
     input logic branch_misprediction,
     input logic ras_misprediction,
@@ -15,26 +31,43 @@ module stall_unit #
     input logic issue_hold_stat,
     input logic issue_multi_source_stat,
 
-    output logic [31:0] branch_misprediction_counter,
-    output logic [31:0] ras_misprediction_counter,
-    output logic [31:0] issue_no_instruction_stat_counter,
-    output logic [31:0] issue_no_id_stat_counter,
-    output logic [31:0] issue_flush_stat_counter,
-    output logic [31:0] issue_unit_busy_stat_counter,
-    output logic [31:0] issue_operands_not_ready_stat_counter,
-    output logic [31:0] issue_hold_stat_counter,
-    output logic [31:0] issue_multi_source_stat_counter
+    output logic [COUNTER_WIDTH-1:0] branch_misprediction_counter,
+    output logic [COUNTER_WIDTH-1:0] ras_misprediction_counter,
+    output logic [COUNTER_WIDTH-1:0] issue_no_instruction_stat_counter,
+    output logic [COUNTER_WIDTH-1:0] issue_no_id_stat_counter,
+    output logic [COUNTER_WIDTH-1:0] issue_flush_stat_counter,
+    output logic [COUNTER_WIDTH-1:0] issue_unit_busy_stat_counter,
+    output logic [COUNTER_WIDTH-1:0] issue_operands_not_ready_stat_counter,
+    output logic [COUNTER_WIDTH-1:0] issue_hold_stat_counter,
+    output logic [COUNTER_WIDTH-1:0] issue_multi_source_stat_counter,
+
+    output logic [COUNTER_WIDTH-1:0] cycle_counter,
+    output logic [COUNTER_WIDTH-1:0] instruction_counter,
+    output logic [COUNTER_WIDTH-1:0] cpi_counter [CPI_STALLS], // CPI stack stall categories, in CPI_* order
+
+    output logic [16:0] overflow // One cycle pulse when a counter wraps, in register order
 );
 
-reg [31:0] branch_misprediction_counter_reg;
-reg [31:0] ras_misprediction_counter_reg;
-reg [31:0] issue_no_instruction_stat_counter_reg;
-reg [31:0] issue_no_id_stat_counter_reg;
-reg [31:0] issue_flush_stat_counter_reg;
-reg [31:0] issue_unit_busy_stat_counter_reg;
-reg [31:0] issue_operands_not_ready_stat_counter_reg;
-reg [31:0] issue_hold_stat_counter_reg;
-reg [31:0] issue_multi_source_stat_counter_reg;
+// CPI stack stall categories, in priority and register order
+localparam integer CPI_FLUSH              = 0;
+localparam integer CPI_FRONTEND_EMPTY     = 1;
+localparam integer CPI_HOLD               = 2;
+localparam integer CPI_OPERAND_DEPENDENCY = 3;
+localparam integer CPI_UNIT_BUSY          = 4;
+localparam integer CPI_OTHER              = 5;
+
+reg [COUNTER_WIDTH-1:0] branch_misprediction_counter_reg;
+reg [COUNTER_WIDTH-1:0] ras_misprediction_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_no_instruction_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_no_id_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_flush_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_unit_busy_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_operands_not_ready_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_hold_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] issue_multi_source_stat_counter_reg;
+reg [COUNTER_WIDTH-1:0] cycle_counter_reg;
+reg [COUNTER_WIDTH-1:0] instruction_counter_reg;
+reg [COUNTER_WIDTH-1:0] cpi_counter_reg [CPI_STALLS];
 
 logic branch_misprediction_prev;
 logic ras_misprediction_prev;
@@ -46,31 +79,85 @@ logic issue_operands_not_ready_stat_prev;
 logic issue_hold_stat_prev;
 logic issue_multi_source_stat_prev;
 
-int i;
+// Category of the current cycle, one-hot, all zero on an issue cycle
+logic [CPI_STALLS-1:0] cpi_stall;
+
+always_comb begin
+    cpi_stall = '0;
+    if (~instruction_issued) begin
+        if (issue_flush_stat) begin
+            cpi_stall[CPI_FLUSH] = 1'b1;
+        end else if (issue_no_instruction_stat) begin
+            cpi_stall[CPI_FRONTEND_EMPTY] = 1'b1;
+        end else if (issue_hold_stat) begin
+            cpi_stall[CPI_HOLD] = 1'b1;
+        end else if (issue_operands_not_ready_stat) begin
+            cpi_stall[CPI_OPERAND_DEPENDENCY] = 1'b1;
+        end else if (issue_unit_busy_stat) begin
+            cpi_stall[CPI_UNIT_BUSY] = 1'b1;
+        end else begin
+            cpi_stall[CPI_OTHER] = 1'b1;
+        end
+    end
+end
+
+// A counter only ever increments by one, so its MSB falling means it wrapped
+logic [16:0] counter_msb;
+logic [16:0] counter_msb_prev;
+
+assign counter_msb = {cpi_counter_reg[CPI_OTHER][COUNTER_WIDTH-1], cpi_counter_reg[CPI_UNIT_BUSY][COUNTER_WIDTH-1],
+                      cpi_counter_reg[CPI_OPERAND_DEPENDENCY][COUNTER_WIDTH-1], cpi_counter_reg[CPI_HOLD][COUNTER_WIDTH-1],
+                      cpi_counter_reg[CPI_FRONTEND_EMPTY][COUNTER_WIDTH-1], cpi_counter_reg[CPI_FLUSH][COUNTER_WIDTH-1],
+                      instruction_counter_reg[COUNTER_WIDTH-1], cycle_counter_reg[COUNTER_WIDTH-1],
+                      issue_multi_source_stat_counter_reg[COUNTER_WIDTH-1], issue_hold_stat_counter_reg[COUNTER_WIDTH-1],
+                      issue_operands_not_ready_stat_counter_reg[COUNTER_WIDTH-1], issue_unit_busy_stat_counter_reg[COUNTER_WIDTH-1],
+                      issue_flush_stat_counter_reg[COUNTER_WIDTH-1], issue_no_id_stat_counter_reg[COUNTER_WIDTH-1],
+                      issue_no_instruction_stat_counter_reg[COUNTER_WIDTH-1], ras_misprediction_counter_reg[COUNTER_WIDTH-1],
+                      branch_misprediction_counter_reg[COUNTER_WIDTH-1]};
 
 always_ff @(posedge clk or posedge rst) begin
-    if (rst | ~enable) begin
-
-        branch_misprediction_counter_reg <= 32'h0;
-        ras_misprediction_counter_reg <= 32'h0;
-        issue_no_instruction_stat_counter_reg <= 32'h0;
-        issue_no_id_stat_counter_reg <= 32'h0;
-        issue_flush_stat_counter_reg <= 32'h0;
-        issue_unit_busy_stat_counter_reg <= 32'h0;
-        issue_operands_not_ready_stat_counter_reg <= 32'h0;
-        issue_hold_stat_counter_reg <= 32'h0;
-        issue_multi_source_stat_counter_reg <= 32'h0;
-
-        branch_misprediction_counter <= 32'h0;
-        ras_misprediction_counter <= 32'h0;
-        issue_no_instruction_stat_counter <= 32'h0;
-        issue_no_id_stat_counter <= 32'h0;
-        issue_flush_stat_counter <= 32'h0;
-        issue_unit_busy_stat_counter <= 32'h0;
-        issue_operands_not_ready_stat_counter <= 32'h0;
-        issue_hold_stat_counter <= 32'h0;
-        issue_multi_source_stat_counter <= 32'h0;
-        
+    if (rst | clear) begin
+        counter_msb_prev <= 17'b0;
+        overflow <= 17'b0;
+    end else begin
+        counter_msb_prev <= counter_msb;
+        overflow <= counter_msb_prev & ~counter_msb;
+    end
+end
+
+always_ff @(posedge clk or posedge rst) begin
+    if (rst | clear) begin
+
+        branch_misprediction_counter_reg <= '0;
+        ras_misprediction_counter_reg <= '0;
+        issue_no_instruction_stat_counter_reg <= '0;
+        issue_no_id_stat_counter_reg <= '0;
+        issue_flush_stat_counter_reg <= '0;
+        issue_unit_busy_stat_counter_reg <= '0;
+        issue_operands_not_ready_stat_counter_reg <= '0;
+        issue_hold_stat_counter_reg <= '0;
+        issue_multi_source_stat_counter_reg <= '0;
+        cycle_counter_reg <= '0;
+        instruction_counter_reg <= '0;
+        for (int i = 0; i < CPI_STALLS; i++) begin
+            cpi_counter_reg[i] <= '0;
+        end
+
+        branch_misprediction_counter <= '0;
+        ras_misprediction_counter <= '0;
+        issue_no_instruction_stat_counter <= '0;
+        issue_no_id_stat_counter <= '0;
+        issue_flush_stat_counter <= '0;
+        issue_unit_busy_stat_counter <= '0;
+        issue_operands_not_ready_stat_counter <= '0;
+        issue_hold_stat_counter <= '0;
+        issue_multi_source_stat_counter <= '0;
+        cycle_counter <= '0;
+        instruction_counter <= '0;
+        for (int i = 0; i < CPI_STALLS; i++) begin
+            cpi_counter[i] <= '0;
+        end
+
         branch_misprediction_prev <= 0;
         ras_misprediction_prev <= 0;
         issue_no_instruction_stat_prev <= 0;
@@ -81,63 +168,79 @@ always_ff @(posedge clk or posedge rst) begin
         issue_hold_stat_prev <= 0;
         issue_multi_source_stat_prev <= 0;
 
-        i <= 0; //Initialize counter
-
     end else begin
-        if (~branch_misprediction_prev && branch_misprediction) begin 
+        if (count_enable && branch_misprediction && (level_mode[0] || ~branch_misprediction_prev)) begin
             branch_misprediction_counter_reg <= branch_misprediction_counter_reg + 1;
         end
         branch_misprediction_prev <= branch_misprediction;
 
-        if (~ras_misprediction_prev && ras_misprediction) begin 
+        if (count_enable && ras_misprediction && (level_mode[1] || ~ras_misprediction_prev)) begin
             ras_misprediction_counter_reg <= ras_misprediction_counter_reg + 1;
         end
         ras_misprediction_prev <= ras_misprediction;
 
-        if (~issue_no_instruction_stat_prev && issue_no_instruction_stat) begin 
+        if (count_enable && issue_no_instruction_stat && (level_mode[2] || ~issue_no_instruction_stat_prev)) begin
             issue_no_instruction_stat_counter_reg <= issue_no_instruction_stat_counter_reg + 1;
         end
         issue_no_instruction_stat_prev <= issue_no_instruction_stat;
 
-        if (~issue_no_id_stat_prev && issue_no_id_stat) begin 
+        if (count_enable && issue_no_id_stat && (level_mode[3] || ~issue_no_id_stat_prev)) begin
             issue_no_id_stat_counter_reg <= issue_no_id_stat_counter_reg + 1;
         end
         issue_no_id_stat_prev <= issue_no_id_stat;
 
-        if (~issue_flush_stat_prev && issue_flush_stat) begin 
+        if (count_enable && issue_flush_stat && (level_mode[4] || ~issue_flush_stat_prev)) begin
             issue_flush_stat_counter_reg <= issue_flush_stat_counter_reg + 1;
         end
         issue_flush_stat_prev <= issue_flush_stat;
 
-        if (~issue_unit_busy_stat_prev && issue_unit_busy_stat) begin 
+        if (count_enable && issue_unit_busy_stat && (level_mode[5] || ~issue_unit_busy_stat_prev)) begin
             issue_unit_busy_stat_counter_reg <= issue_unit_busy_stat_counter_reg + 1;
         end
         issue_unit_busy_stat_prev <= issue_unit_busy_stat;
 
-        if (~issue_operands_not_ready_stat_prev && issue_operands_not_ready_stat) begin 
+        if (count_enable && issue_operands_not_ready_stat && (level_mode[6] || ~issue_operands_not_ready_stat_prev)) begin
             issue_operands_not_ready_stat_counter_reg <= issue_operands_not_ready_stat_counter_reg + 1;
         end
         issue_operands_not_ready_stat_prev <= issue_operands_not_ready_stat;
 
-        if (~issue_hold_stat_prev && issue_hold_stat) begin 
+        if (count_enable && issue_hold_stat && (level_mode[7] || ~issue_hold_stat_prev)) begin
             issue_hold_stat_counter_reg <= issue_hold_stat_counter_reg + 1;
         end
         issue_hold_stat_prev <= issue_hold_stat;
 
-        if (~issue_multi_source_stat_prev && issue_multi_source_stat) begin 
+        if (count_enable && issue_multi_source_stat && (level_mode[8] || ~issue_multi_source_stat_prev)) begin
             issue_multi_source_stat_counter_reg <= issue_multi_source_stat_counter_reg + 1;
         end
         issue_multi_source_stat_prev <= issue_multi_source_stat;
 
-        branch_misprediction_counter <= branch_misprediction_counter_reg;
-        ras_misprediction_counter <= ras_misprediction_counter_reg;
-        issue_no_instruction_stat_counter <= issue_no_instruction_stat_counter_reg;
-        issue_no_id_stat_counter <= issue_no_id_stat_counter_reg;
-        issue_flush_stat_counter <= issue_flush_stat_counter_reg;
-        issue_unit_busy_stat_counter <= issue_unit_busy_stat_counter_reg;
-        issue_operands_not_ready_stat_counter <= issue_operands_not_ready_stat_counter_reg;
-        issue_hold_stat_counter <= issue_hold_stat_counter_reg;
-        issue_multi_source_stat_counter <= issue_multi_source_stat_counter_reg;
+        if (count_enable) begin
+            cycle_counter_reg <= cycle_counter_reg + 1;
+            if (instruction_issued) begin
+                instruction_counter_reg <= instruction_counter_reg + 1;
+            end
+            for (int i = 0; i < CPI_STALLS; i++) begin
+                if (cpi_stall[i]) begin
+                    cpi_counter_reg[i] <= cpi_counter_reg[i] + 1;
+                end
+            end
+        end
+
+        // Update output registers on a snapshot, for data consistency across all units
+        if (snapshot) begin
+            branch_misprediction_counter <= branch_misprediction_counter_reg;
+            ras_misprediction_counter <= ras_misprediction_counter_reg;
+            issue_no_instruction_stat_counter <= issue_no_instruction_stat_counter_reg;
+            issue_no_id_stat_counter <= issue_no_id_stat_counter_reg;
+            issue_flush_stat_counter <= issue_flush_stat_counter_reg;
+            issue_unit_busy_stat_counter <= issue_unit_busy_stat_counter_reg;
+            issue_operands_not_ready_stat_counter <= issue_operands_not_ready_stat_counter_reg;
+            issue_hold_stat_counter <= issue_hold_stat_counter_reg;
+            issue_multi_source_stat_counter <= issue_multi_source_stat_counter_reg;
+            cycle_counter <= cycle_counter_reg;
+            instruction_counter <= instruction_counter_reg;
+            cpi_counter <= cpi_counter_reg;
+        end
     end
 end
 
@@ -0,0 +1,224 @@
+module tb_abacus_smp;
+
+    // Parameters
+    parameter integer NUM_HARTS = 2;
+    parameter [31:0] ABACUS_BASE_ADDR = 32'hf0030000;
+
+    // Signals
+    logic clk;
+    logic rst;
+
+    // Wishbone signals
+    logic wb_cyc = 0;
+    logic wb_stb = 0;
+    logic wb_we = 0;
+    logic [31:0] wb_adr = 0;
+    logic [31:0] wb_dat_i = 0;
+    logic [2:0] wb_cti = 3'b000;
+    logic [1:0] wb_bte = 2'b00;
+    logic [31:0] wb_dat_o;
+    logic wb_ack;
+    logic wb_stall;
+    logic abacus_irq;
+
+    // Nets from the cores, element h from hart h
+    logic [NUM_HARTS-1:0][31:0] abacus_instruction = '0;
+    logic [NUM_HARTS-1:0][31:0] abacus_instruction_pc = '0;
+    logic [NUM_HARTS-1:0] abacus_instruction_issued = '0;
+
+    logic [NUM_HARTS-1:0] abacus_icache_request = '0;
+    logic [NUM_HARTS-1:0] abacus_dcache_request = '0;
+    logic [NUM_HARTS-1:0] abacus_icache_miss = '0;
+    logic [NUM_HARTS-1:0] abacus_dcache_hit = '0;
+    logic [NUM_HARTS-1:0] abacus_icache_line_fill_in_progress = '0;
+    logic [NUM_HARTS-1:0] abacus_dcache_line_fill_in_progress = '0;
+    logic [NUM_HARTS-1:0][31:0] abacus_dcache_miss_addr = '0;
+
+    logic abacus_idbus_cyc = 1'b0;
+    logic abacus_idbus_stb = 1'b0;
+    logic abacus_idbus_we = 1'b0;
+    logic [3:0] abacus_idbus_sel = 4'h0;
+    logic [2:0] abacus_idbus_cti = 3'b000;
+    logic abacus_idbus_ack = 1'b0;
+    logic abacus_idbus_err = 1'b0;
+
+    logic [NUM_HARTS-1:0] abacus_branch_misprediction = '0;
+    logic [NUM_HARTS-1:0] abacus_ras_misprediction = '0;
+    logic [NUM_HARTS-1:0] abacus_branch_resolved = '0;
+    logic [NUM_HARTS-1:0][31:0] abacus_branch_pc = '0;
+    logic [NUM_HARTS-1:0] abacus_issue_no_instruction_stat = '0;
+    logic [NUM_HARTS-1:0] abacus_issue_no_id_stat = '0;
+    logic [NUM_HARTS-1:0] abacus_issue_flush_stat = '0;
+    logic [NUM_HARTS-1:0] abacus_issue_unit_busy_stat = '0;
+    logic [NUM_HARTS-1:0] abacus_issue_operands_not_ready_stat = '0;
+    logic [NUM_HARTS-1:0] abacus_issue_hold_stat = '0;
+    logic [NUM_HARTS-1:0] abacus_issue_multi_source_stat = '0;
+    logic [NUM_HARTS-1:0][1:0] abacus_privilege = '1;
+    logic [NUM_HARTS-1:0][8:0] abacus_asid = '0;
+
+    // DUT instance
+    abacus_smp #(
+        .NUM_HARTS(NUM_HARTS),
+        .ABACUS_BASE_ADDR(ABACUS_BASE_ADDR)
+    ) dut (
+        .clk(clk),
+        .rst(rst),
+        .abacus_irq(abacus_irq),
+
+        .wb_cyc(wb_cyc),
+        .wb_stb(wb_stb),
+        .wb_we(wb_we),
+        .wb_adr(wb_adr),
+        .wb_dat_i(wb_dat_i),
+        .wb_cti(wb_cti),
+        .wb_bte(wb_bte),
+        .wb_dat_o(wb_dat_o),
+        .wb_ack(wb_ack),
+        .wb_stall(wb_stall),
+
+        .abacus_instruction(abacus_instruction),
+        .abacus_instruction_pc(abacus_instruction_pc),
+        .abacus_instruction_issued(abacus_instruction_issued),
+        .abacus_icache_request(abacus_icache_request),
+        .abacus_dcache_request(abacus_dcache_request),
+        .abacus_icache_miss(abacus_icache_miss),
+        .abacus_dcache_hit(abacus_dcache_hit),
+        .abacus_icache_line_fill_in_progress(abacus_icache_line_fill_in_progress),
+        .abacus_dcache_line_fill_in_progress(abacus_dcache_line_fill_in_progress),
+        .abacus_dcache_miss_addr(abacus_dcache_miss_addr),
+        .abacus_idbus_cyc(abacus_idbus_cyc),
+        .abacus_idbus_stb(abacus_idbus_stb),
+        .abacus_idbus_we(abacus_idbus_we),
+        .abacus_idbus_sel(abacus_idbus_sel),
+        .abacus_idbus_cti(abacus_idbus_cti),
+        .abacus_idbus_ack(abacus_idbus_ack),
+        .abacus_idbus_err(abacus_idbus_err),
+        .abacus_branch_misprediction(abacus_branch_misprediction),
+        .abacus_ras_misprediction(abacus_ras_misprediction),
+        .abacus_branch_resolved(abacus_branch_resolved),
+        .abacus_branch_pc(abacus_branch_pc),
+        .abacus_issue_no_instruction_stat(abacus_issue_no_instruction_stat),
+        .abacus_issue_no_id_stat(abacus_issue_no_id_stat),
+        .abacus_issue_flush_stat(abacus_issue_flush_stat),
+        .abacus_issue_unit_busy_stat(abacus_issue_unit_busy_stat),
+        .abacus_issue_operands_not_ready_stat(abacus_issue_operands_not_ready_stat),
+        .abacus_issue_hold_stat(abacus_issue_hold_stat),
+        .abacus_issue_multi_source_stat(abacus_issue_multi_source_stat),
+        .abacus_privilege(abacus_privilege),
+        .abacus_asid(abacus_asid)
+    );
+
+    // Clock generation
+    always #5 clk = ~clk;
+
+    // Classic Wishbone cycles, driven between clock edges and ended in the cycle of the acknowledge
+    task automatic wb_write(input logic [31:0] addr, input logic [31:0] data);
+        @(negedge clk);
+        wb_cyc = 1;
+        wb_stb = 1;
+        wb_we = 1;
+        wb_adr = addr;
+        wb_dat_i = data;
+        @(negedge clk);
+        while (!wb_ack) @(negedge clk);
+        wb_cyc = 0;
+        wb_stb = 0;
+        wb_we = 0;
+    endtask
+
+    task automatic wb_read(input logic [31:0] addr, output logic [31:0] data);
+        @(negedge clk);
+        wb_cyc = 1;
+        wb_stb = 1;
+        wb_we = 0;
+        wb_adr = addr;
+        @(negedge clk);
+        while (!wb_ack) @(negedge clk);
+        data = wb_dat_o;
+        wb_cyc = 0;
+        wb_stb = 0;
+    endtask
+
+    // Offsets in the window of a hart and in the global block
+    localparam logic [31:0] HART_STRIDE = 32'h1000;
+    localparam logic [31:0] CP_ENABLE = 32'h008;
+    localparam logic [31:0] SU_ENABLE = 32'h00c;
+    localparam logic [31:0] DCACHE_REQUEST_COUNTER = 32'h210;
+    localparam logic [31:0] CYCLE_COUNTER = 32'h324;
+    localparam logic [31:0] NUM_HARTS_REG = 32'hf000;
+    localparam logic [31:0] GLOBAL_SNAPSHOT = 32'hf004;
+    localparam logic [31:0] AGGREGATE_WINDOW = 32'hf800;
+    localparam integer DCACHE_REQUEST_WORD = 2 * (23 + 4); // After the 23 instruction classes
+
+    logic [31:0] data;
+    logic [31:0] aggregate_lo;
+    logic [31:0] aggregate_hi;
+    logic [31:0] cycles [NUM_HARTS];
+
+    /* Multi-Hart Test */
+
+    initial begin
+        clk = 0;
+        rst = 1;
+        #10 rst = 0;
+
+        wb_read(ABACUS_BASE_ADDR + NUM_HARTS_REG, data);
+        assert(data == NUM_HARTS) else $fatal("Assertion failed for NUM_HARTS");
+
+        // Enable the cache profile and stall units of every hart through its own window
+        for (int h = 0; h < NUM_HARTS; h++) begin
+            wb_write(ABACUS_BASE_ADDR + HART_STRIDE * h + CP_ENABLE, 32'h1);
+            wb_write(ABACUS_BASE_ADDR + HART_STRIDE * h + SU_ENABLE, 32'h1);
+        end
+        for (int h = 0; h < NUM_HARTS; h++) begin
+            assert(dut.gen_harts[h].hart_block.cache_profile_unit_enable_reg == 32'h1) else $fatal("Assertion failed for CP_ENABLE of a hart");
+        end
+
+        // Hart 0 makes 2 dcache requests and hart 1 makes 5, so the load is unbalanced
+        for (int i = 0; i < 5; i++) begin
+            @(negedge clk);
+            abacus_dcache_request = {1'b1, i < 2};
+            @(negedge clk);
+            abacus_dcache_request = '0;
+        end
+        repeat (2) @(negedge clk);
+
+        wb_read(ABACUS_BASE_ADDR + DCACHE_REQUEST_COUNTER, data);
+        assert(data == 32'd2) else $fatal("Assertion failed for DCACHE_REQUEST_COUNTER of hart 0");
+        wb_read(ABACUS_BASE_ADDR + HART_STRIDE + DCACHE_REQUEST_COUNTER, data);
+        assert(data == 32'd5) else $fatal("Assertion failed for DCACHE_REQUEST_COUNTER of hart 1");
+
+        // Snapshot every hart on one edge and hold them
+        wb_write(ABACUS_BASE_ADDR + GLOBAL_SNAPSHOT, 32'h3);
+        for (int h = 0; h < NUM_HARTS; h++) begin
+            wb_read(ABACUS_BASE_ADDR + HART_STRIDE * h + CYCLE_COUNTER, cycles[h]);
+        end
+
+        // Requests made while the snapshots are held do not show in the aggregate
+        @(negedge clk);
+        abacus_dcache_request = '1;
+        @(negedge clk);
+        abacus_dcache_request = '0;
+
+        wb_read(ABACUS_BASE_ADDR + AGGREGATE_WINDOW + 4 * DCACHE_REQUEST_WORD, aggregate_lo);
+        wb_read(ABACUS_BASE_ADDR + AGGREGATE_WINDOW + 4 * (DCACHE_REQUEST_WORD + 1), aggregate_hi);
+        assert({aggregate_hi, aggregate_lo} == 64'd7) else $fatal("Assertion failed for the aggregate DCACHE_REQUEST_COUNTER");
+
+        // The held counters do not move, and the aggregate is their sum
+        wb_read(ABACUS_BASE_ADDR + CYCLE_COUNTER, data);
+        assert(data == cycles[0]) else $fatal("Assertion failed for CYCLE_COUNTER while snapshots are held");
+        wb_read(ABACUS_BASE_ADDR + AGGREGATE_WINDOW + 4 * (2 * (23 + 10 + 24 + 9)), aggregate_lo);
+        assert(aggregate_lo == cycles[0] + cycles[1]) else $fatal("Assertion failed for the aggregate CYCLE_COUNTER");
+
+        // Release the hold, automatic snapshots resume on every hart
+        wb_write(ABACUS_BASE_ADDR + GLOBAL_SNAPSHOT, 32'h0);
+        repeat (2) @(negedge clk);
+
+        wb_read(ABACUS_BASE_ADDR + AGGREGATE_WINDOW + 4 * DCACHE_REQUEST_WORD, aggregate_lo);
+        assert(aggregate_lo == 32'd9) else $fatal("Assertion failed for the aggregate DCACHE_REQUEST_COUNTER after the hold is released");
+
+        $display("Multi-hart test passed");
+        $finish;
+    end
+
+endmodule
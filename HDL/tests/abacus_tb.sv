@@ -15,11 +15,15 @@ module tb_abacus_top;
     logic wb_we;
     logic [31:0] wb_adr;
     logic [31:0] wb_dat_i;
+    logic [2:0] wb_cti = 3'b000;
+    logic [1:0] wb_bte = 2'b00;
     logic [31:0] wb_dat_o;
     logic wb_ack;
+    logic wb_stall;
 
     // Nets from the core
     logic [31:0] abacus_instruction;
+    logic [31:0] abacus_instruction_pc;
     logic abacus_instruction_issued;
 
     logic abacus_icache_request;
@@ -28,9 +32,20 @@ module tb_abacus_top;
     logic abacus_dcache_hit;
     logic abacus_icache_line_fill_in_progress;
     logic abacus_dcache_line_fill_in_progress;
+    logic [31:0] abacus_dcache_miss_addr = 32'h0;
+
+    logic abacus_idbus_cyc = 1'b0;
+    logic abacus_idbus_stb = 1'b0;
+    logic abacus_idbus_we = 1'b0;
+    logic [3:0] abacus_idbus_sel = 4'h0;
+    logic [2:0] abacus_idbus_cti = 3'b000;
+    logic abacus_idbus_ack = 1'b0;
+    logic abacus_idbus_err = 1'b0;
 
     logic abacus_branch_misprediction;
     logic abacus_ras_misprediction;
+    logic abacus_branch_resolved = 1'b0;
+    logic [31:0] abacus_branch_pc = 32'h0;
     logic abacus_issue_no_instruction_stat;
     logic abacus_issue_no_id_stat;
     logic abacus_issue_flush_stat;
@@ -38,6 +53,28 @@ module tb_abacus_top;
     logic abacus_issue_operands_not_ready_stat;
     logic abacus_issue_hold_stat;
     logic abacus_issue_multi_source_stat;
+    logic [1:0] abacus_privilege = 2'b11;
+    logic [8:0] abacus_asid = 9'h0;
+
+    // AXI4 slave signals of the second instance, addresses are offsets within the register map
+    logic [11:0] axi_awaddr = 12'h0;
+    logic axi_awvalid = 1'b0;
+    logic axi_awready;
+    logic [31:0] axi_wdata = 32'h0;
+    logic axi_wvalid = 1'b0;
+    logic axi_wready;
+    logic axi_bvalid;
+    logic axi_bready = 1'b1;
+    logic [11:0] axi_araddr = 12'h0;
+    logic [7:0] axi_arlen = 8'h0;
+    logic [1:0] axi_arburst = 2'b01;
+    logic axi_arvalid = 1'b0;
+    logic axi_arready;
+    logic [31:0] axi_rdata;
+    logic [1:0] axi_rresp;
+    logic axi_rlast;
+    logic axi_rvalid;
+    logic axi_rready = 1'b1;
     
     // DUT instance
     abacus_top #(
@@ -53,10 +90,14 @@ module tb_abacus_top;
         .wb_we(wb_we),
         .wb_adr(wb_adr),
         .wb_dat_i(wb_dat_i),
+        .wb_cti(wb_cti),
+        .wb_bte(wb_bte),
         .wb_dat_o(wb_dat_o),
         .wb_ack(wb_ack),
+        .wb_stall(wb_stall),
 
         .abacus_instruction(abacus_instruction),
+        .abacus_instruction_pc(abacus_instruction_pc),
         .abacus_instruction_issued(abacus_instruction_issued),
         .abacus_icache_request(abacus_icache_request),
         .abacus_dcache_request(abacus_dcache_request),
@@ -64,20 +105,132 @@ module tb_abacus_top;
         .abacus_dcache_hit(abacus_dcache_hit),
         .abacus_icache_line_fill_in_progress(abacus_icache_line_fill_in_progress),
         .abacus_dcache_line_fill_in_progress(abacus_dcache_line_fill_in_progress),
+        .abacus_dcache_miss_addr(abacus_dcache_miss_addr),
+        .abacus_idbus_cyc(abacus_idbus_cyc),
+        .abacus_idbus_stb(abacus_idbus_stb),
+        .abacus_idbus_we(abacus_idbus_we),
+        .abacus_idbus_sel(abacus_idbus_sel),
+        .abacus_idbus_cti(abacus_idbus_cti),
+        .abacus_idbus_ack(abacus_idbus_ack),
+        .abacus_idbus_err(abacus_idbus_err),
         .abacus_branch_misprediction(abacus_branch_misprediction),
         .abacus_ras_misprediction(abacus_ras_misprediction),
+        .abacus_branch_resolved(abacus_branch_resolved),
+        .abacus_branch_pc(abacus_branch_pc),
         .abacus_issue_no_instruction_stat(abacus_issue_no_instruction_stat),
         .abacus_issue_no_id_stat(issuabacus_issue_no_id_state_no_id_stat),
         .abacus_issue_flush_stat(abacus_issue_flush_stat),
         .abacus_issue_unit_busy_stat(abacus_issue_unit_busy_stat),
         .abacus_issue_operands_not_ready_stat(abacus_issue_operands_not_ready_stat),
-        .abacus_issue_hold_stat(abacus_issue_hold_stat)
+        .abacus_issue_hold_stat(abacus_issue_hold_stat),
+        .abacus_privilege(abacus_privilege),
+        .abacus_asid(abacus_asid),
+
+        .snapshot_sync(1'b0),
+        .snapshot_sync_hold(1'b0),
+        .unit_clear_sync(8'h0),
+        .window_index(8'h0),
+        .window_pair()
+    );
+
+    // Second instance on the AXI4 slave interface, seeing the same core nets
+    abacus_top #(
+        .ABACUS_BASE_ADDR(ABACUS_BASE_ADDR),
+        .WITH_AXI(1'b1),
+        .C_S_AXI_ADDR_WIDTH(12)
+    ) dut_axi (
+        .clk(clk),
+        .rst(rst),
+
+        .S_AXI_AWADDR(axi_awaddr),
+        .S_AXI_AWVALID(axi_awvalid),
+        .S_AXI_AWREADY(axi_awready),
+        .S_AXI_WDATA(axi_wdata),
+        .S_AXI_WSTRB(4'hF),
+        .S_AXI_WVALID(axi_wvalid),
+        .S_AXI_WREADY(axi_wready),
+        .S_AXI_BRESP(),
+        .S_AXI_BVALID(axi_bvalid),
+        .S_AXI_BREADY(axi_bready),
+        .S_AXI_ARADDR(axi_araddr),
+        .S_AXI_ARLEN(axi_arlen),
+        .S_AXI_ARBURST(axi_arburst),
+        .S_AXI_ARVALID(axi_arvalid),
+        .S_AXI_ARREADY(axi_arready),
+        .S_AXI_RDATA(axi_rdata),
+        .S_AXI_RRESP(axi_rresp),
+        .S_AXI_RLAST(axi_rlast),
+        .S_AXI_RVALID(axi_rvalid),
+        .S_AXI_RREADY(axi_rready),
+
+        .wb_cyc(1'b0),
+        .wb_stb(1'b0),
+        .wb_we(1'b0),
+        .wb_adr(32'h0),
+        .wb_dat_i(32'h0),
+        .wb_cti(3'b000),
+        .wb_bte(2'b00),
+        .wb_dat_o(),
+        .wb_ack(),
+        .wb_stall(),
+
+        .abacus_instruction(abacus_instruction),
+        .abacus_instruction_pc(abacus_instruction_pc),
+        .abacus_instruction_issued(abacus_instruction_issued),
+        .abacus_icache_request(abacus_icache_request),
+        .abacus_dcache_request(abacus_dcache_request),
+        .abacus_icache_miss(abacus_icache_miss),
+        .abacus_dcache_hit(abacus_dcache_hit),
+        .abacus_icache_line_fill_in_progress(abacus_icache_line_fill_in_progress),
+        .abacus_dcache_line_fill_in_progress(abacus_dcache_line_fill_in_progress),
+        .abacus_dcache_miss_addr(abacus_dcache_miss_addr),
+        .abacus_idbus_cyc(abacus_idbus_cyc),
+        .abacus_idbus_stb(abacus_idbus_stb),
+        .abacus_idbus_we(abacus_idbus_we),
+        .abacus_idbus_sel(abacus_idbus_sel),
+        .abacus_idbus_cti(abacus_idbus_cti),
+        .abacus_idbus_ack(abacus_idbus_ack),
+        .abacus_idbus_err(abacus_idbus_err),
+        .abacus_branch_misprediction(abacus_branch_misprediction),
+        .abacus_ras_misprediction(abacus_ras_misprediction),
+        .abacus_branch_resolved(abacus_branch_resolved),
+        .abacus_branch_pc(abacus_branch_pc),
+        .abacus_issue_no_instruction_stat(abacus_issue_no_instruction_stat),
+        .abacus_issue_no_id_stat(abacus_issue_no_id_stat),
+        .abacus_issue_flush_stat(abacus_issue_flush_stat),
+        .abacus_issue_unit_busy_stat(abacus_issue_unit_busy_stat),
+        .abacus_issue_operands_not_ready_stat(abacus_issue_operands_not_ready_stat),
+        .abacus_issue_hold_stat(abacus_issue_hold_stat),
+        .abacus_issue_multi_source_stat(abacus_issue_multi_source_stat),
+        .abacus_privilege(abacus_privilege),
+        .abacus_asid(abacus_asid),
+
+        .snapshot_sync(1'b0),
+        .snapshot_sync_hold(1'b0),
+        .unit_clear_sync(8'h0),
+        .window_index(8'h0),
+        .window_pair()
     );
 
+    // Single AXI write, address and data presented together
+    task automatic axi_write(input logic [11:0] offset, input logic [31:0] data);
+        axi_awaddr <= offset;
+        axi_wdata <= data;
+        axi_awvalid <= 1'b1;
+        axi_wvalid <= 1'b1;
+        do @(posedge clk); while (!axi_awready);
+        axi_awvalid <= 1'b0;
+        axi_wvalid <= 1'b0;
+        do @(posedge clk); while (!axi_bvalid);
+    endtask
+
     // Clock generation
     always #5 clk = ~clk;
 
     reg [31:0] instruction_memory [0:1023];  // Adjust size as needed
+    logic [31:0] pc_samples;
+    logic [31:0] pc_head;
+    logic [63:0] window_cycles;
     initial begin
         $readmemh("/localhome/rajneshj/USRA/ABACUS/HDL/tests/instructions.txt", instruction_memory);
     end
@@ -109,6 +262,7 @@ module tb_abacus_top;
         
         
         foreach (instruction_memory[i]) begin
+            if ($isunknown(instruction_memory[i])) break; // End of the loaded vectors
             abacus_instruction <= instruction_memory[i];
             abacus_instruction_issued <= 1;
             #10;
@@ -117,24 +271,34 @@ module tb_abacus_top;
         end
 
         $display("Instruction Profile Unit Registers:");
-        $display("LOAD_WORD_COUNT: %h", dut.load_word_counter_reg);
-        $display("STORE_WORD_COUNT: %h", dut.store_word_counter_reg);
-        $display("ADDITION_COUNT: %h", dut.addition_counter_reg);
-        $display("SUBTRACTION_COUNT: %h", dut.subtraction_counter_reg);
-        $display("BRANCH_COUNT: %h", dut.branch_counter_reg);
-        $display("JUMP_COUNT: %h", dut.jump_counter_reg);
-        $display("SYSTEM_PRIVILEGE_COUNT: %h", dut.system_privilege_counter_reg);
-        $display("ATOMIC_COUNT: %h", dut.atomic_counter_reg);
-    
-        // Assert values of internal registers
-        assert(dut.load_word_counter_reg == 32'd7) else $fatal("Assertion failed for LOAD_WORD_COUNT");
-        assert(dut.store_word_counter_reg == 32'd3) else $fatal("Assertion failed for STORE_WORD_COUNT");
-        assert(dut.addition_counter_reg == 32'd12) else $fatal("Assertion failed for ADD_COUNTER_COUNT");
-        assert(dut.subtraction_counter_reg == 32'd2) else $fatal("Assertion failed for SUBTRACTION_COUNTER");
-        assert(dut.branch_counter_reg == 32'd6) else $fatal("Assertion failed for BRANCH_COUNT");
-        assert(dut.jump_counter_reg == 32'd0) else $fatal("Assertion failed for JUMP_COUNT");
-        assert(dut.system_privilege_counter_reg == 32'd5) else $fatal("Assertion failed for SYSTEM_PRIVILEGE_COUNT");
-        assert(dut.atomic_counter_reg == 32'd7) else $fatal("Assertion failed for ATOMIC_COUNT");
+        foreach (dut.instruction_class_counter_reg[i]) begin
+            $display("CLASS_%0d_COUNT: %h", i, dut.instruction_class_counter_reg[i]);
+        end
+
+        // Assert values of internal registers, the expected counts are the section sizes of instructions.txt
+        assert(dut.instruction_class_counter_reg[0] == 64'd5) else $fatal("Assertion failed for LOAD_COUNT");
+        assert(dut.instruction_class_counter_reg[1] == 64'd3) else $fatal("Assertion failed for STORE_COUNT");
+        assert(dut.instruction_class_counter_reg[2] == 64'd5) else $fatal("Assertion failed for ADDITION_COUNT");
+        assert(dut.instruction_class_counter_reg[3] == 64'd2) else $fatal("Assertion failed for SUBTRACTION_COUNT");
+        assert(dut.instruction_class_counter_reg[4] == 64'd6) else $fatal("Assertion failed for BRANCH_COUNT");
+        assert(dut.instruction_class_counter_reg[5] == 64'd2) else $fatal("Assertion failed for JUMP_COUNT");
+        assert(dut.instruction_class_counter_reg[6] == 64'd5) else $fatal("Assertion failed for SYSTEM_PRIVILEGE_COUNT");
+        assert(dut.instruction_class_counter_reg[7] == 64'd11) else $fatal("Assertion failed for ATOMIC_COUNT");
+        assert(dut.instruction_class_counter_reg[8] == 64'd6) else $fatal("Assertion failed for LOGICAL_COUNT");
+        assert(dut.instruction_class_counter_reg[9] == 64'd6) else $fatal("Assertion failed for SHIFT_COUNT");
+        assert(dut.instruction_class_counter_reg[10] == 64'd4) else $fatal("Assertion failed for COMPARE_COUNT");
+        assert(dut.instruction_class_counter_reg[11] == 64'd2) else $fatal("Assertion failed for UPPER_IMMEDIATE_COUNT");
+        assert(dut.instruction_class_counter_reg[12] == 64'd4) else $fatal("Assertion failed for MULTIPLY_COUNT");
+        assert(dut.instruction_class_counter_reg[13] == 64'd4) else $fatal("Assertion failed for DIVIDE_COUNT");
+        assert(dut.instruction_class_counter_reg[14] == 64'd6) else $fatal("Assertion failed for CSR_COUNT");
+        assert(dut.instruction_class_counter_reg[15] == 64'd2) else $fatal("Assertion failed for FENCE_COUNT");
+        assert(dut.instruction_class_counter_reg[16] == 64'd2) else $fatal("Assertion failed for FP_LOAD_COUNT");
+        assert(dut.instruction_class_counter_reg[17] == 64'd2) else $fatal("Assertion failed for FP_STORE_COUNT");
+        assert(dut.instruction_class_counter_reg[18] == 64'd10) else $fatal("Assertion failed for FP_ARITHMETIC_COUNT");
+        assert(dut.instruction_class_counter_reg[19] == 64'd4) else $fatal("Assertion failed for FP_FUSED_MULTIPLY_ADD_COUNT");
+        assert(dut.instruction_class_counter_reg[20] == 64'd4) else $fatal("Assertion failed for FP_DIVIDE_SQRT_COUNT");
+        assert(dut.instruction_class_counter_reg[21] == 64'd3) else $fatal("Assertion failed for OTHER_COUNT");
+        assert(dut.instruction_class_counter_reg[22] == 64'd98) else $fatal("Assertion failed for TOTAL_COUNT");
 
         //Disable the profiling unit
         wb_cyc <= 1;
@@ -153,14 +317,33 @@ module tb_abacus_top;
         wb_adr <= 0;
         wb_dat_i <= 0;
 
-        assert(dut.load_word_counter_reg == 32'd0) else $fatal("Assertion failed for LOAD_WORD_COUNT");
-        assert(dut.store_word_counter_reg == 32'd0) else $fatal("Assertion failed for STORE_WORD_COUNT");
-        assert(dut.addition_counter_reg == 32'd0) else $fatal("Assertion failed for ADD_COUNTER_COUNT");
-        assert(dut.subtraction_counter_reg == 32'd0) else $fatal("Assertion failed for SUBTRACTION_COUNTER");
-        assert(dut.branch_counter_reg == 32'd0) else $fatal("Assertion failed for BRANCH_COUNT");
-        assert(dut.jump_counter_reg == 32'd0) else $fatal("Assertion failed for JUMP_COUNT");
-        assert(dut.system_privilege_counter_reg == 32'd0) else $fatal("Assertion failed for SYSTEM_PRIVILEGE_COUNT");
-        assert(dut.atomic_counter_reg == 32'd0) else $fatal("Assertion failed for ATOMIC_COUNT");
+        // A disabled unit keeps its counters and does not count
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction_issued <= 0;
+        #10;
+        assert(dut.instruction_class_counter_reg[22] == 64'd98) else $fatal("Assertion failed for TOTAL_COUNT after disable");
+
+        // Unit Clear empties it
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030048;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        foreach (dut.instruction_class_counter_reg[i]) begin
+            assert(dut.instruction_class_counter_reg[i] == 64'd0) else $fatal("Assertion failed for CLASS_%0d_COUNT after clear", i);
+        end
 
     /* Cache Profiler Test */
         #30
@@ -242,6 +425,30 @@ module tb_abacus_top;
         assert(dut.dcache_hit_counter_reg == 32'd1) else $fatal("Assertion failed for DCACHE_HIT_COUNTER");
         assert(dut.dcache_line_fill_latency_counter_reg == 32'd4) else $fatal("Assertion failed for DCACHE_LINE_FILL_LATENCY_COUNTER");
 
+        // Both fills land in the 4-7 cycle bucket, and they did not overlap
+        foreach (dut.icache_line_fill_histogram_reg[i]) begin
+            assert(dut.icache_line_fill_histogram_reg[i] == (i == 2 ? 64'd1 : 64'd0)) else $fatal("Assertion failed for ICACHE_LINE_FILL_HISTOGRAM[%0d]", i);
+            assert(dut.dcache_line_fill_histogram_reg[i] == (i == 2 ? 64'd1 : 64'd0)) else $fatal("Assertion failed for DCACHE_LINE_FILL_HISTOGRAM[%0d]", i);
+        end
+        assert(dut.icache_line_fill_min_reg == 32'd5 && dut.icache_line_fill_max_reg == 32'd5) else $fatal("Assertion failed for ICACHE_LINE_FILL_MIN/MAX");
+        assert(dut.dcache_line_fill_min_reg == 32'd4 && dut.dcache_line_fill_max_reg == 32'd4) else $fatal("Assertion failed for DCACHE_LINE_FILL_MIN/MAX");
+        assert(dut.line_fill_occupancy_counter_reg == 64'd9) else $fatal("Assertion failed for LINE_FILL_OCCUPANCY");
+        assert(dut.line_fill_active_counter_reg == 64'd9) else $fatal("Assertion failed for LINE_FILL_ACTIVE");
+
+        // Overlapping fills of 3 and 6 cycles, memory is busy for 6 cycles with 9 fill cycles in flight
+        abacus_icache_line_fill_in_progress <= 1;
+        abacus_dcache_line_fill_in_progress <= 1;
+        #30
+        abacus_icache_line_fill_in_progress <= 0;
+        #30
+        abacus_dcache_line_fill_in_progress <= 0;
+        #20
+
+        assert(dut.line_fill_occupancy_counter_reg == 64'd18) else $fatal("Assertion failed for LINE_FILL_OCCUPANCY with overlap");
+        assert(dut.line_fill_active_counter_reg == 64'd15) else $fatal("Assertion failed for LINE_FILL_ACTIVE with overlap");
+        assert(dut.icache_line_fill_histogram_reg[1] == 64'd1 && dut.icache_line_fill_min_reg == 32'd3) else $fatal("Assertion failed for ICACHE_LINE_FILL_HISTOGRAM with overlap");
+        assert(dut.dcache_line_fill_histogram_reg[2] == 64'd2 && dut.dcache_line_fill_max_reg == 32'd6) else $fatal("Assertion failed for DCACHE_LINE_FILL_HISTOGRAM with overlap");
+
         // Disable the profiling unit
         wb_cyc <= 1;
         wb_stb <= 1;
@@ -259,6 +466,30 @@ module tb_abacus_top;
         wb_adr <= 0;
         wb_dat_i <= 0;
 
+        // Paused, a request is not counted and the counters are kept
+        abacus_icache_request <= 1;
+        #20
+        abacus_icache_request <= 0;
+        assert(dut.icache_request_counter_reg == 32'd1) else $fatal("Assertion failed for ICACHE_REQUEST_COUNTER after disable");
+        assert(dut.line_fill_occupancy_counter_reg == 64'd18) else $fatal("Assertion failed for LINE_FILL_OCCUPANCY after disable");
+
+        // Clear the cache profile unit
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030048;
+        wb_dat_i <= 32'h2;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
         // Ensure counters are reset
         assert(dut.icache_request_counter_reg == 32'd0) else $fatal("Assertion failed for ICACHE_REQUEST_COUNTER");
         assert(dut.icache_miss_counter_reg == 32'd0) else $fatal("Assertion failed for ICACHE_MISS_COUNTER");
@@ -360,7 +591,848 @@ module tb_abacus_top;
         abacus_issue_flush_stat <= 1;
         #10
 
-        
+        /* Snapshot Test */
+        abacus_issue_flush_stat <= 0;
+
+        // Stop automatic snapshots, the visible counters must then hold still
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030014;
+        wb_dat_i <= 0;
+
+        #20
+
+        wb_adr <= 32'hf0030004;
+        wb_dat_i <= 1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        abacus_instruction <= 32'h00110023; // SB x1, 0(x2)
+        abacus_instruction_issued <= 1;
+        #10
+        abacus_instruction_issued <= 0;
+        abacus_issue_flush_stat <= 1;
+        #10
+        abacus_issue_flush_stat <= 0;
+        #20
+
+        assert(dut.instruction_class_counter_reg[1] == 64'd0) else $fatal("Assertion failed for STORE_COUNT before snapshot");
+        assert(dut.issue_flush_stat_counter_reg == 32'd0) else $fatal("Assertion failed for ISSUE_FLUSH before snapshot");
+
+        // Latch every unit in the same cycle
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030010;
+        wb_dat_i <= 1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        assert(dut.instruction_class_counter_reg[1] == 64'd1) else $fatal("Assertion failed for STORE_COUNT after snapshot");
+        assert(dut.issue_flush_stat_counter_reg == 32'd2) else $fatal("Assertion failed for ISSUE_FLUSH after snapshot");
+
+        /* PC Sampler Test */
+
+        // Sample every 4 cycles
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030400;
+        wb_dat_i <= 4;
+
+        #20
+
+        wb_adr <= 32'hf003002C;
+        wb_dat_i <= 1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        for (int i = 0; i < 64; i++) begin
+            abacus_instruction <= 32'h00000013; // NOP
+            abacus_instruction_pc <= 32'h80000000 + i * 4;
+            abacus_instruction_issued <= 1;
+            #10;
+        end
+        abacus_instruction_issued <= 0;
+        #10
+
+        pc_samples = dut.pc_sample_count;
+        pc_head = dut.pc_sample;
+        assert(pc_samples >= 32'd15 && pc_samples <= 32'd17) else $fatal("Assertion failed for PC_SAMPLE_COUNT");
+        assert(pc_head >= 32'h80000000 && pc_head < 32'h80000100 && pc_head[1:0] == 2'b00) else $fatal("Assertion failed for PC_SAMPLE_DATA");
+
+        // Reading the sample returns the head of the FIFO and pops it exactly once
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 0;
+
+        wb_adr <= 32'hf0030408;
+
+        #10
+        assert(wb_ack && wb_dat_o == pc_head) else $fatal("Assertion failed for PC_SAMPLE_DATA read");
+        #10
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+
+        wb_adr <= 0;
+
+        #10
+        assert(dut.pc_sample_count == pc_samples - 1) else $fatal("Assertion failed for PC_SAMPLE_COUNT after pop");
+        assert(dut.pc_sample == pc_head + 32'd16) else $fatal("Assertion failed for PC_SAMPLE_DATA after pop");
+
+        /* Region-of-Interest Trigger Test */
+
+        // Restart the instruction profiler from zero, then count only between the marker instructions.
+        // Automatic snapshots are turned back on first, the snapshot test above stopped them.
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030014;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_adr <= 32'hf0030004;
+        wb_dat_i <= 32'h0;
+
+        #20
+
+        wb_adr <= 32'hf0030004;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_adr <= 32'hf0030500;
+        wb_dat_i <= 32'h2;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        abacus_instruction <= 32'h003100b3; // ADD, before the region
+        abacus_instruction_pc <= 32'h80000000;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h00102013; // start marker
+        abacus_instruction_pc <= 32'h80000004;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD
+        abacus_instruction_pc <= 32'h80000008;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD
+        abacus_instruction_pc <= 32'h8000000c;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD
+        abacus_instruction_pc <= 32'h80000010;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h00202013; // stop marker
+        abacus_instruction_pc <= 32'h80000014;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD, after the region
+        abacus_instruction_pc <= 32'h80000018;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction_issued <= 0;
+        #20
+
+        assert(dut.instruction_class_counter_reg[2] == 64'd3) else $fatal("Assertion failed for ADDITION_COUNT inside the marker region");
+        assert(dut.instruction_class_counter_reg[10] == 64'd0) else $fatal("Assertion failed for COMPARE_COUNT, markers are not counted");
+        assert(dut.instruction_class_counter_reg[22] == 64'd3) else $fatal("Assertion failed for TOTAL_COUNT inside the marker region");
+        assert(dut.trigger_region_count == 32'd1 && !dut.trigger_active) else $fatal("Assertion failed for TRIGGER_STATUS after the marker region");
+
+        // Start on the instruction at 0x1000, stop on the one at 0x2000
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030510;
+        wb_dat_i <= 32'h1000;
+
+        #20
+
+        wb_adr <= 32'hf0030514;
+        wb_dat_i <= 32'h1000;
+
+        #20
+
+        wb_adr <= 32'hf0030518;
+        wb_dat_i <= 32'h2000;
+
+        #20
+
+        wb_adr <= 32'hf003051c;
+        wb_dat_i <= 32'h2000;
+
+        #20
+
+        wb_adr <= 32'hf0030500;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        abacus_instruction <= 32'h003100b3; // ADD, before the region
+        abacus_instruction_pc <= 32'h00000ff0;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD, starts the region
+        abacus_instruction_pc <= 32'h00001000;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD
+        abacus_instruction_pc <= 32'h00001004;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD, stops the region
+        abacus_instruction_pc <= 32'h00002000;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction <= 32'h003100b3; // ADD, after the region
+        abacus_instruction_pc <= 32'h00002004;
+        abacus_instruction_issued <= 1;
+        #10;
+        abacus_instruction_issued <= 0;
+        #20
+
+        assert(dut.instruction_class_counter_reg[2] == 64'd5) else $fatal("Assertion failed for ADDITION_COUNT inside the PC range region");
+        assert(dut.instruction_class_counter_reg[22] == 64'd5) else $fatal("Assertion failed for TOTAL_COUNT inside the PC range region");
+        assert(dut.trigger_region_count == 32'd1 && !dut.trigger_active) else $fatal("Assertion failed for TRIGGER_STATUS after the PC range region");
+
+        /* CPI Stack Test */
+
+        abacus_issue_no_instruction_stat <= 0;
+        abacus_issue_flush_stat <= 0;
+        abacus_issue_unit_busy_stat <= 0;
+        abacus_issue_operands_not_ready_stat <= 0;
+        abacus_issue_hold_stat <= 0;
+
+        // Count everywhere again, count operands not ready (stall counter 6) in cycles, and restart the stall unit from zero
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030500;
+        wb_dat_i <= 32'h0;
+
+        #20
+
+        wb_adr <= 32'hf0030030;
+        wb_dat_i <= 32'h40;
+
+        #20
+
+        wb_adr <= 32'hf003000C;
+        wb_dat_i <= 32'h0;
+
+        #20
+
+        wb_adr <= 32'hf003000C;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        abacus_instruction_issued <= 1; // 3 issue cycles
+        #30
+        abacus_instruction_issued <= 0;
+        abacus_issue_operands_not_ready_stat <= 1; // 4 operand dependency cycles
+        #40
+        abacus_issue_operands_not_ready_stat <= 0;
+        abacus_issue_flush_stat <= 1; // 2 flush cycles, flush takes priority over the empty frontend
+        abacus_issue_no_instruction_stat <= 1;
+        #20
+        abacus_issue_flush_stat <= 0;
+        abacus_issue_no_instruction_stat <= 0;
+        abacus_issue_hold_stat <= 1; // 2 hold cycles, hold takes priority over the busy unit
+        abacus_issue_unit_busy_stat <= 1;
+        #20
+        abacus_issue_hold_stat <= 0;
+        abacus_issue_unit_busy_stat <= 0;
+        #20
+
+        assert(dut.instruction_counter_reg == 64'd3) else $fatal("Assertion failed for INSTRUCTION_COUNTER");
+        assert(dut.cpi_stall_counter_reg[0] == 64'd2) else $fatal("Assertion failed for CPI_FLUSH");
+        assert(dut.cpi_stall_counter_reg[1] == 64'd0) else $fatal("Assertion failed for CPI_FRONTEND_EMPTY");
+        assert(dut.cpi_stall_counter_reg[2] == 64'd2) else $fatal("Assertion failed for CPI_HOLD");
+        assert(dut.cpi_stall_counter_reg[3] == 64'd4) else $fatal("Assertion failed for CPI_OPERAND_DEPENDENCY");
+        assert(dut.cpi_stall_counter_reg[4] == 64'd0) else $fatal("Assertion failed for CPI_UNIT_BUSY");
+        assert(dut.cycle_counter_reg == dut.instruction_counter_reg + dut.cpi_stall_counter_reg[0] + dut.cpi_stall_counter_reg[1] +
+               dut.cpi_stall_counter_reg[2] + dut.cpi_stall_counter_reg[3] + dut.cpi_stall_counter_reg[4] +
+               dut.cpi_stall_counter_reg[5]) else $fatal("Assertion failed for CYCLE_COUNTER, the CPI stack must add up to it");
+        assert(dut.issue_operands_not_ready_stat_counter_reg == 64'd4) else $fatal("Assertion failed for ISSUE_OPERANDS_NOT_READY in cycle mode");
+        assert(dut.issue_hold_stat_counter_reg == 64'd1) else $fatal("Assertion failed for ISSUE_HOLD in event mode");
+
+        /* Snapshot Window Burst Test */
+
+        // Snapshot now and hold automatic snapshots
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030010;
+        wb_dat_i <= 32'h3;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        #40
+
+        // Incrementing burst over the cycle and instruction counters, words 132 to 135 of the window,
+        // acknowledged in every cycle after the first. Each beat is checked just before the clock edge
+        // that ends it
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_cti <= 3'b010;
+
+        wb_adr <= 32'hf0030800 + 4 * 132;
+
+        #14
+        assert(wb_ack && wb_dat_o == dut.cycle_counter_reg[31:0]) else $fatal("Assertion failed for the first beat of the window burst");
+        window_cycles[31:0] = wb_dat_o;
+        #6
+        wb_adr <= 32'hf0030800 + 4 * 133;
+
+        #4
+        assert(wb_ack && wb_dat_o == dut.cycle_counter_reg[63:32]) else $fatal("Assertion failed for the second beat of the window burst");
+        window_cycles[63:32] = wb_dat_o;
+        #6
+        wb_adr <= 32'hf0030800 + 4 * 134;
+
+        #4
+        assert(wb_ack && wb_dat_o == dut.instruction_counter_reg[31:0]) else $fatal("Assertion failed for the third beat of the window burst");
+        #6
+        wb_adr <= 32'hf0030800 + 4 * 135;
+        wb_cti <= 3'b111; // End of burst
+
+        #4
+        assert(wb_ack && wb_dat_o == dut.instruction_counter_reg[63:32]) else $fatal("Assertion failed for the last beat of the window burst");
+        #6
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_cti <= 3'b000;
+
+        wb_adr <= 0;
+
+        #4
+        assert(!wb_ack) else $fatal("Assertion failed for the end of the window burst");
+        assert(dut.cycle_counter_reg == window_cycles) else $fatal("Assertion failed for CYCLE_COUNTER while snapshots are held");
+        #6
+
+        // Release the hold, automatic snapshots resume
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030010;
+        wb_dat_i <= 32'h0;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        #20
+
+        assert(dut.cycle_counter_reg > window_cycles) else $fatal("Assertion failed for CYCLE_COUNTER after the hold is released");
+
+        /* Event Counter Bank Test */
+
+        // Counter 0 counts the rising edges of the dcache requests, counter 1 the cycles they are high
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030740;
+        wb_dat_i <= 32'h80000102;
+
+        #20
+
+        wb_adr <= 32'hf0030744;
+        wb_dat_i <= 32'h80000002;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        #20
+        abacus_dcache_request <= 1; // Two requests of 2 cycles each
+        #20
+        abacus_dcache_request <= 0;
+        #10
+        abacus_dcache_request <= 1;
+        #20
+        abacus_dcache_request <= 0;
+        #20
+
+        assert(dut.event_counter_reg[0] == 64'd2) else $fatal("Assertion failed for EVENT_COUNTER 0 in edge mode");
+        assert(dut.event_counter_reg[1] == 64'd4) else $fatal("Assertion failed for EVENT_COUNTER 1 in level mode");
+
+        // Writing the select register restarts the counter from zero
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030744;
+        wb_dat_i <= 32'h80000002;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        #20
+
+        assert(dut.event_counter_reg[1] == 64'd0) else $fatal("Assertion failed for EVENT_COUNTER 1 after its select is written");
+
+        /* Branch Misprediction Hot List Test */
+
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030038;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        // One branch resolves 5 times, mispredicted 3 of them
+        abacus_branch_pc <= 32'h80000100;
+        for (int i = 0; i < 5; i++) begin
+            abacus_branch_resolved <= 1;
+            abacus_branch_misprediction <= (i < 3);
+            #10;
+            abacus_branch_resolved <= 0;
+            abacus_branch_misprediction <= 0;
+            #10;
+        end
+
+        // Seven more fill the table with one misprediction each
+        for (int i = 0; i < 7; i++) begin
+            abacus_branch_pc <= 32'h80000200 + 32'(16 * i);
+            abacus_branch_resolved <= 1;
+            abacus_branch_misprediction <= 1;
+            #10;
+            abacus_branch_resolved <= 0;
+            abacus_branch_misprediction <= 0;
+            #10;
+        end
+
+        // A new branch replaces the first entry with the fewest, inheriting its count as the error
+        abacus_branch_pc <= 32'h80000300;
+        abacus_branch_resolved <= 1;
+        abacus_branch_misprediction <= 1;
+        #10;
+        abacus_branch_resolved <= 0;
+        abacus_branch_misprediction <= 0;
+        #20;
+
+        assert(dut.branch_hotlist_pc_reg[0] == 32'h80000100) else $fatal("Assertion failed for BRANCH_HOTLIST entry 0 PC");
+        assert(dut.branch_hotlist_mispredicts_reg[0] == 32'd3) else $fatal("Assertion failed for BRANCH_HOTLIST entry 0 MISPREDICTS");
+        assert(dut.branch_hotlist_executions_reg[0] == 32'd5) else $fatal("Assertion failed for BRANCH_HOTLIST entry 0 EXECUTIONS");
+        assert(dut.branch_hotlist_error_reg[0] == 32'd0) else $fatal("Assertion failed for BRANCH_HOTLIST entry 0 ERROR");
+        assert(dut.branch_hotlist_pc_reg[1] == 32'h80000300) else $fatal("Assertion failed for BRANCH_HOTLIST entry 1 PC after the eviction");
+        assert(dut.branch_hotlist_mispredicts_reg[1] == 32'd2) else $fatal("Assertion failed for BRANCH_HOTLIST entry 1 MISPREDICTS after the eviction");
+        assert(dut.branch_hotlist_executions_reg[1] == 32'd1) else $fatal("Assertion failed for BRANCH_HOTLIST entry 1 EXECUTIONS after the eviction");
+        assert(dut.branch_hotlist_error_reg[1] == 32'd1) else $fatal("Assertion failed for BRANCH_HOTLIST entry 1 ERROR after the eviction");
+        assert(dut.branch_hotlist_pc_reg[7] == 32'h80000260) else $fatal("Assertion failed for BRANCH_HOTLIST entry 7 PC");
+        assert(dut.branch_hotlist_total_mispredicts_reg == 32'd11) else $fatal("Assertion failed for BRANCH_HOTLIST_MISPREDICTS");
+        assert(dut.branch_hotlist_total_branches_reg == 32'd13) else $fatal("Assertion failed for BRANCH_HOTLIST_BRANCHES");
+
+        // The executions of entry 0 over the bus
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 0;
+
+        wb_adr <= 32'hf0030b18;
+
+        #10
+        assert(wb_ack && wb_dat_o == 32'd5) else $fatal("Assertion failed for the BRANCH_HOTLIST entry 0 EXECUTIONS read");
+        #10
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+
+        wb_adr <= 0;
+
+        #10
+
+        // Miss sketch test, line granules within 0x80000000 to 0x8000ffff
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030c10;
+        wb_dat_i <= 32'h80000000;
+
+        #20
+
+        wb_adr <= 32'hf0030c14;
+        wb_dat_i <= 32'h8000ffff;
+
+        #20
+
+        wb_adr <= 32'hf003003c;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_adr <= 32'hf0030048;
+        wb_dat_i <= 32'h20;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        // The sketch is swept clear for MISS_SKETCH_WIDTH cycles after being cleared
+        assert(dut.miss_sketch_clearing == 1'b1) else $fatal("Assertion failed for MISS_SKETCH_STATUS after a clear");
+        #10300
+        assert(dut.miss_sketch_clearing == 1'b0) else $fatal("Assertion failed for MISS_SKETCH_STATUS clearing");
+
+        // Three misses in one line, one in another and one outside the filter
+        for (int i = 0; i < 5; i++) begin
+            abacus_dcache_miss_addr <= (i < 3) ? 32'h80001000 + 32'(20 * i) : (i == 3) ? 32'h80002040 : 32'h90000000;
+            abacus_dcache_line_fill_in_progress <= 1;
+            #10;
+            abacus_dcache_line_fill_in_progress <= 0;
+            #30;
+        end
+        #20;
+
+        assert(dut.miss_sketch_topk_addr_reg[0] == 32'h80001000) else $fatal("Assertion failed for MISS_SKETCH entry 0 address");
+        assert(dut.miss_sketch_topk_count_reg[0] == 32'd3) else $fatal("Assertion failed for MISS_SKETCH entry 0 count");
+        assert(dut.miss_sketch_topk_addr_reg[1] == 32'h80002040) else $fatal("Assertion failed for MISS_SKETCH entry 1 address");
+        assert(dut.miss_sketch_topk_count_reg[1] == 32'd1) else $fatal("Assertion failed for MISS_SKETCH entry 1 count");
+        assert(dut.miss_sketch_topk_count_reg[2] == 32'd0) else $fatal("Assertion failed for MISS_SKETCH entry 2 count");
+        assert(dut.miss_sketch_total_reg == 32'd4) else $fatal("Assertion failed for MISS_SKETCH_TOTAL");
+
+        // Counter 419 of row 1 holds the line at 0x80001000, read through the index
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030c1c;
+        wb_dat_i <= 32'd1024 + 32'd419;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        #10
+
+        wb_cyc <= 1;
+        wb_stb <= 1;
+
+        wb_adr <= 32'hf0030c20;
+
+        #10
+        assert(wb_ack && wb_dat_o == 32'd3) else $fatal("Assertion failed for the MISS_SKETCH_DATA read");
+        #10
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+
+        wb_adr <= 0;
+
+        #10
+        assert(dut.miss_sketch_index_reg == 32'd1024 + 32'd420) else $fatal("Assertion failed for MISS_SKETCH_INDEX after a read");
+
+        // Bus profiler test
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030040;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        #10
+
+        // A word read acknowledged in its third cycle
+        abacus_idbus_cyc <= 1;
+        abacus_idbus_stb <= 1;
+        abacus_idbus_we <= 0;
+        abacus_idbus_sel <= 4'hf;
+        abacus_idbus_cti <= 3'b000;
+
+        #20
+
+        abacus_idbus_ack <= 1;
+
+        #10
+
+        abacus_idbus_cyc <= 0;
+        abacus_idbus_stb <= 0;
+        abacus_idbus_ack <= 0;
+
+        #10
+
+        // A two beat write burst acknowledged at once, a word then a halfword
+        abacus_idbus_cyc <= 1;
+        abacus_idbus_stb <= 1;
+        abacus_idbus_we <= 1;
+        abacus_idbus_cti <= 3'b010;
+        abacus_idbus_ack <= 1;
+
+        #10
+
+        abacus_idbus_sel <= 4'h3;
+        abacus_idbus_cti <= 3'b111;
+
+        #10
+
+        abacus_idbus_cyc <= 0;
+        abacus_idbus_stb <= 0;
+        abacus_idbus_we <= 0;
+        abacus_idbus_sel <= 4'h0;
+        abacus_idbus_cti <= 3'b000;
+        abacus_idbus_ack <= 0;
+
+        #20
+
+        assert(dut.bus_read_counter_reg == 64'd1) else $fatal("Assertion failed for BUS_READ_COUNTER");
+        assert(dut.bus_write_counter_reg == 64'd1) else $fatal("Assertion failed for BUS_WRITE_COUNTER");
+        assert(dut.bus_read_bytes_counter_reg == 64'd4) else $fatal("Assertion failed for BUS_READ_BYTES_COUNTER");
+        assert(dut.bus_write_bytes_counter_reg == 64'd6) else $fatal("Assertion failed for BUS_WRITE_BYTES_COUNTER");
+        assert(dut.bus_busy_counter_reg == 64'd5) else $fatal("Assertion failed for BUS_BUSY_COUNTER");
+        assert(dut.bus_occupancy_counter_reg == 64'd5) else $fatal("Assertion failed for BUS_OCCUPANCY_COUNTER");
+        assert(dut.bus_wait_counter_reg == 64'd2) else $fatal("Assertion failed for BUS_WAIT_COUNTER");
+        assert(dut.bus_latency_counter_reg == 64'd4) else $fatal("Assertion failed for BUS_LATENCY_COUNTER");
+        assert(dut.bus_latency_histogram_reg[0] == 64'd1) else $fatal("Assertion failed for BUS_LATENCY_HISTOGRAM bucket 0");
+        assert(dut.bus_latency_histogram_reg[1] == 64'd1) else $fatal("Assertion failed for BUS_LATENCY_HISTOGRAM bucket 1");
+        assert(dut.bus_latency_min_reg == 32'd1) else $fatal("Assertion failed for BUS_LATENCY_MIN");
+        assert(dut.bus_latency_max_reg == 32'd3) else $fatal("Assertion failed for BUS_LATENCY_MAX");
+
+        // Rate alarm test, more than 5 cycles in a window of 10 crosses in every window
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf003001C;
+        wb_dat_i <= 32'h4; // Interrupt on a rate alarm
+
+        #20
+
+        wb_adr <= 32'hf0030E24;
+        wb_dat_i <= 32'd10;
+
+        #20
+
+        wb_adr <= 32'hf0030E28;
+        wb_dat_i <= 32'd5;
+
+        #20
+
+        wb_adr <= 32'hf0030E20;
+        wb_dat_i <= 32'h80000210; // Cycle event, freeze, enable
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        #150
+
+        assert(dut.rate_alarm_last[0] == 32'd10) else $fatal("Assertion failed for RATE_ALARM_LAST");
+        assert(dut.rate_alarm_status_reg == 4'b0001) else $fatal("Assertion failed for RATE_ALARM_STATUS");
+        assert(dut.abacus_irq) else $fatal("Assertion failed for the rate alarm interrupt");
+        assert(dut.rate_alarm_frozen && !dut.snapshot_tick) else $fatal("Assertion failed for the frozen snapshot");
+
+        // Stopping the alarm and clearing its status releases the freeze
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030E20;
+        wb_dat_i <= 32'h0;
+
+        #20
+
+        wb_adr <= 32'hf0030E04;
+        wb_dat_i <= 32'h1;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        #10
+        assert(dut.rate_alarm_status_reg == 4'b0000) else $fatal("Assertion failed for RATE_ALARM_STATUS after a clear");
+        assert(!dut.rate_alarm_frozen && !dut.abacus_irq) else $fatal("Assertion failed for the released snapshot");
+
+        /* Unit Filter Test */
+
+        // Event counter 1 restarts on the dcache request cycles, and the event filter passes user mode with ASID 5 only
+        wb_cyc <= 1;
+        wb_stb <= 1;
+        wb_we <= 1;
+
+        wb_adr <= 32'hf0030744;
+        wb_dat_i <= 32'h80000002;
+
+        #20
+
+        wb_adr <= 32'hf0030F1C;
+        wb_dat_i <= 32'h80050001;
+
+        #20
+
+        wb_cyc <= 0;
+        wb_stb <= 0;
+        wb_we <= 0;
+
+        wb_adr <= 0;
+        wb_dat_i <= 0;
+
+        // Machine mode is filtered out
+        abacus_dcache_request <= 1;
+        #20
+        abacus_dcache_request <= 0;
+        #10
+        assert(dut.event_counter_reg[1] == 64'd0) else $fatal("Assertion failed for EVENT_COUNTER 1 in machine mode");
+
+        // User mode in the selected address space is counted
+        abacus_privilege <= 2'b00;
+        abacus_asid <= 9'h5;
+        abacus_dcache_request <= 1;
+        #20
+        abacus_dcache_request <= 0;
+        #10
+        assert(dut.event_counter_reg[1] == 64'd2) else $fatal("Assertion failed for EVENT_COUNTER 1 in user mode");
+
+        // Another address space is not
+        abacus_asid <= 9'h6;
+        abacus_dcache_request <= 1;
+        #20
+        abacus_dcache_request <= 0;
+        #10
+        assert(dut.event_counter_reg[1] == 64'd2) else $fatal("Assertion failed for EVENT_COUNTER 1 in another address space");
+
+        /* AXI Burst Read Test */
+
+        // Count cycles on the AXI instance, then snapshot and hold so the window stays put
+        axi_write(12'h00C, 32'h1);
+        repeat (8) @(posedge clk);
+        axi_write(12'h010, 32'h3);
+        repeat (2) @(posedge clk);
+
+        // INCR burst of 16 beats over words 128 to 143 of the snapshot window, the cycle counter is 132 and 133
+        axi_araddr <= 12'h800 + 4 * 128;
+        axi_arlen <= 8'd15;
+        axi_arburst <= 2'b01;
+        axi_arvalid <= 1'b1;
+        do @(posedge clk); while (!axi_arready);
+        axi_arvalid <= 1'b0;
+
+        for (int beat = 0; beat < 16; beat++) begin
+            do @(posedge clk); while (!axi_rvalid);
+            assert(axi_rdata == dut_axi.snapshot_window[128 + beat] && axi_rresp == 2'b00) else $fatal("Assertion failed for beat %0d of the AXI window burst", beat);
+            assert(axi_rlast == (beat == 15)) else $fatal("Assertion failed for RLAST on beat %0d of the AXI window burst", beat);
+            if (beat == 4) window_cycles[31:0] = axi_rdata;
+            if (beat == 5) window_cycles[63:32] = axi_rdata;
+        end
+        assert(window_cycles == 64'(dut_axi.cycle_counter_reg) && window_cycles != 64'd0) else $fatal("Assertion failed for CYCLE_COUNTER in the AXI window burst");
+
+        // Release the hold
+        axi_write(12'h010, 32'h0);
+
         $finish;
     end
 
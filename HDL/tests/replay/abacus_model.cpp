@@ -0,0 +1,415 @@
+// Reference model of instruction_profiler, cache_profiler and stall_unit over a trace (abacus_trace.h).
+//
+// Computes, without simulating the RTL, the counter registers abacus_replay reads back after the
+// same trace: the units enabled on the first trace cycle, no region-of-interest trigger, and a
+// software snapshot on the edge that ends the cycle after the last one. It follows the RTL cycle
+// for cycle: stall and cache events count on the rising edge of their net, with the net taken as
+// low before the first cycle, and a line fill period is recorded in its histogram in the cycle after
+// it ends, so a fill still in progress at the end of the trace is not in the histograms. The output
+// is in the format of abacus_replay --dump and --expect:
+//
+//   abacus_model trace > expected.txt && abacus_replay --expect expected.txt trace
+//
+// The trace is memory mapped and split into one shard per thread. Every shard is counted on its
+// own, starting from the nets of the record before it, and the shards are then reduced in order.
+// Only the line fill periods that cross a shard boundary need the order, so they are kept apart
+// and joined during the reduction.
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "abacus_trace_tools.hpp"
+
+namespace {
+
+// Instruction classes of instruction_profiler, also the register index of each counter
+enum : uint8_t {
+    CLASS_LOAD, CLASS_STORE, CLASS_ADDITION, CLASS_SUBTRACTION, CLASS_BRANCH, CLASS_JUMP, CLASS_SYSTEM_PRIVILEGE,
+    CLASS_ATOMIC, CLASS_LOGICAL, CLASS_SHIFT, CLASS_COMPARE, CLASS_UPPER_IMMEDIATE, CLASS_MULTIPLY, CLASS_DIVIDE,
+    CLASS_CSR, CLASS_FENCE, CLASS_FP_LOAD, CLASS_FP_STORE, CLASS_FP_ARITHMETIC, CLASS_FP_FUSED_MULTIPLY_ADD,
+    CLASS_FP_DIVIDE_SQRT, CLASS_OTHER, CLASS_TOTAL,
+    REFINE = 0x1f,
+};
+
+const uint8_t OPCODE_CLASS[32] = {
+    CLASS_LOAD, CLASS_FP_LOAD, CLASS_OTHER, CLASS_FENCE, REFINE, CLASS_UPPER_IMMEDIATE, CLASS_OTHER, CLASS_OTHER,
+    CLASS_STORE, CLASS_FP_STORE, CLASS_OTHER, CLASS_ATOMIC, REFINE, CLASS_UPPER_IMMEDIATE, CLASS_OTHER, CLASS_OTHER,
+    CLASS_FP_FUSED_MULTIPLY_ADD, CLASS_FP_FUSED_MULTIPLY_ADD, CLASS_FP_FUSED_MULTIPLY_ADD, CLASS_FP_FUSED_MULTIPLY_ADD,
+    REFINE, CLASS_OTHER, CLASS_OTHER, CLASS_OTHER, CLASS_BRANCH, CLASS_JUMP, CLASS_OTHER, CLASS_JUMP,
+    REFINE, CLASS_OTHER, CLASS_OTHER, CLASS_OTHER,
+};
+
+const uint8_t OP_CLASS[8] = {
+    CLASS_ADDITION, CLASS_SHIFT, CLASS_COMPARE, CLASS_COMPARE, CLASS_LOGICAL, CLASS_SHIFT, CLASS_LOGICAL, CLASS_LOGICAL,
+};
+
+const uint8_t MULDIV_CLASS[8] = {
+    CLASS_MULTIPLY, CLASS_MULTIPLY, CLASS_MULTIPLY, CLASS_MULTIPLY, CLASS_DIVIDE, CLASS_DIVIDE, CLASS_DIVIDE, CLASS_DIVIDE,
+};
+
+// The decode of instruction_profiler, table for table
+uint8_t instruction_class(uint32_t instruction) {
+    uint32_t opcode = (instruction >> 2) & 0x1f;
+    uint32_t funct3 = (instruction >> 12) & 0x7;
+    uint32_t funct7 = instruction >> 25;
+
+    if ((instruction & 0x3) != 0x3) {
+        return CLASS_OTHER;
+    }
+    if (OPCODE_CLASS[opcode] != REFINE) {
+        return OPCODE_CLASS[opcode];
+    }
+    switch (opcode) {
+    case 0x04: // OP-IMM
+        return OP_CLASS[funct3];
+    case 0x0c: // OP
+        if (funct7 == 0x00) {
+            return OP_CLASS[funct3];
+        } else if (funct7 == 0x01) {
+            return MULDIV_CLASS[funct3];
+        } else if (funct7 == 0x20 && funct3 == 0x0) {
+            return CLASS_SUBTRACTION;
+        } else if (funct7 == 0x20 && funct3 == 0x5) {
+            return CLASS_SHIFT;
+        }
+        return CLASS_OTHER;
+    case 0x14: // OP-FP
+        return ((funct7 >> 2) == 0x03 || (funct7 >> 2) == 0x0b) ? CLASS_FP_DIVIDE_SQRT : CLASS_FP_ARITHMETIC;
+    default: // SYSTEM
+        if (funct3 == 0x0) {
+            return CLASS_SYSTEM_PRIVILEGE;
+        }
+        return (funct3 == 0x4) ? CLASS_OTHER : CLASS_CSR;
+    }
+}
+
+// CPI stack category of a cycle that did not issue, in the priority order of stall_unit
+unsigned cpi_category(uint32_t signals) {
+    if (signals & ABACUS_TRACE_ISSUE_FLUSH) {
+        return 0;
+    } else if (signals & ABACUS_TRACE_ISSUE_NO_INSTRUCTION) {
+        return 1;
+    } else if (signals & ABACUS_TRACE_ISSUE_HOLD) {
+        return 2;
+    } else if (signals & ABACUS_TRACE_ISSUE_OPERANDS_NOT_READY) {
+        return 3;
+    } else if (signals & ABACUS_TRACE_ISSUE_UNIT_BUSY) {
+        return 4;
+    }
+    return 5;
+}
+
+// Trace bit of each stall unit event counter, in register and level mode bit order
+const uint32_t STALL_SIGNALS[9] = {
+    ABACUS_TRACE_BRANCH_MISPREDICTION, ABACUS_TRACE_RAS_MISPREDICTION, ABACUS_TRACE_ISSUE_NO_INSTRUCTION,
+    ABACUS_TRACE_ISSUE_NO_ID, ABACUS_TRACE_ISSUE_FLUSH, ABACUS_TRACE_ISSUE_UNIT_BUSY,
+    ABACUS_TRACE_ISSUE_OPERANDS_NOT_READY, ABACUS_TRACE_ISSUE_HOLD, ABACUS_TRACE_ISSUE_MULTI_SOURCE,
+};
+
+// Line fill periods of one cache, as latency_histogram records them
+struct Periods {
+    uint64_t buckets[ABACUS_LATENCY_BUCKETS];
+    uint32_t min = 0xffffffff;
+    uint32_t max = 0;
+
+    // Within a shard, the busy cycles before the first idle one and after the last idle one.
+    // Those periods may continue in the neighbouring shards, so they are recorded in the reduction.
+    uint64_t lead = 0;
+    uint64_t trail = 0;
+    bool all_busy = true;
+
+    Periods() { memset(buckets, 0, sizeof(buckets)); }
+
+    void record(uint64_t cycles) {
+        // The latency register saturates instead of wrapping
+        uint32_t latency = (uint32_t)std::min<uint64_t>(cycles, 0xffffffff);
+        unsigned bucket = 0;
+
+        for (unsigned i = 1; i < 32; i++) {
+            if (latency & (1u << i)) {
+                bucket = std::min(i, (unsigned)ABACUS_LATENCY_BUCKETS - 1);
+            }
+        }
+        buckets[bucket]++;
+        min = std::min(min, latency);
+        max = std::max(max, latency);
+    }
+
+    void merge(const Periods &other) {
+        for (unsigned i = 0; i < ABACUS_LATENCY_BUCKETS; i++) {
+            buckets[i] += other.buckets[i];
+        }
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+// Live counters of a shard, in the order of each unit's register block
+struct Shard {
+    uint64_t ip[ABACUS_IP_NUM_COUNTERS] = {};
+    uint64_t cp[10] = {}; // cp[1], the icache hits, is derived at the snapshot
+    uint64_t su[ABACUS_SU_NUM_COUNTERS] = {};
+    Periods fills[2]; // icache, dcache
+};
+
+// Per-record lookups, filled before the shards are counted so the hot loop has no decode branches.
+// The instruction class of every combination of instruction[31:25], [14:12] and [6:0], the fields
+// instruction_class() decodes.
+uint8_t class_table[1 << 17];
+// Stall unit counter of the cycle, instructions or a CPI stack category, for every combination of nets
+uint8_t cycle_slot_table[1 << ABACUS_TRACE_SIGNALS];
+
+inline uint32_t class_index(uint32_t instruction) {
+    return ((instruction >> 25) << 10) | (((instruction >> 12) & 0x7) << 7) | (instruction & 0x7f);
+}
+
+void fill_tables() {
+    for (uint32_t i = 0; i < (1u << 17); i++) {
+        class_table[i] = instruction_class(((i >> 10) << 25) | (((i >> 7) & 0x7) << 12) | (i & 0x7f));
+    }
+    for (uint32_t signals = 0; signals < (1u << ABACUS_TRACE_SIGNALS); signals++) {
+        cycle_slot_table[signals] = (signals & ABACUS_TRACE_INSTRUCTION_ISSUED) ? 10 : 11 + cpi_category(signals);
+    }
+}
+
+// 1 if any of the nets in mask is set
+inline uint64_t bit(uint32_t signals, uint32_t mask) {
+    return (signals & mask) ? 1 : 0;
+}
+
+// cycles if any of the nets in mask is set, else 0
+inline uint64_t held(uint32_t signals, uint32_t mask, uint64_t cycles) {
+    return cycles & (0 - bit(signals, mask));
+}
+
+void count(const abacus_trace_record *records, size_t n, uint32_t prev, uint32_t level_mode, Shard &shard) {
+    const uint32_t fill_signals[2] = { ABACUS_TRACE_ICACHE_LINE_FILL_IN_PROGRESS, ABACUS_TRACE_DCACHE_LINE_FILL_IN_PROGRESS };
+    uint64_t run[2] = { 0, 0 };
+    uint64_t level[9]; // All ones for the stall counters that count cycles
+
+    for (unsigned i = 0; i < 9; i++) {
+        level[i] = 0 - (uint64_t)((level_mode >> i) & 1);
+    }
+
+    for (size_t r = 0; r < n; r++) {
+        uint32_t signals = records[r].signals & ((1u << ABACUS_TRACE_SIGNALS) - 1);
+        uint64_t cycles = records[r].cycles;
+        // A net can only rise in the first cycle of a record, it holds its value for the others
+        uint32_t rising = signals & ~prev;
+        uint64_t issued = held(signals, ABACUS_TRACE_INSTRUCTION_ISSUED, cycles);
+
+        prev = signals;
+
+        shard.ip[class_table[class_index(records[r].instruction)]] += issued;
+        shard.ip[CLASS_TOTAL] += issued;
+
+        shard.cp[0] += bit(rising, ABACUS_TRACE_ICACHE_REQUEST);
+        shard.cp[2] += bit(rising, ABACUS_TRACE_ICACHE_MISS);
+        shard.cp[3] += held(signals, fill_signals[0], cycles);
+        shard.cp[4] += bit(rising, ABACUS_TRACE_DCACHE_REQUEST);
+        shard.cp[5] += bit(rising, ABACUS_TRACE_DCACHE_HIT);
+        shard.cp[6] += bit(rising, fill_signals[1]); // A dcache miss starts a fill
+        shard.cp[7] += held(signals, fill_signals[1], cycles);
+        shard.cp[8] += held(signals, fill_signals[0], cycles) + held(signals, fill_signals[1], cycles);
+        shard.cp[9] += held(signals, fill_signals[0] | fill_signals[1], cycles);
+
+        for (unsigned f = 0; f < 2; f++) {
+            Periods &periods = shard.fills[f];
+
+            if (signals & fill_signals[f]) {
+                run[f] += cycles;
+            } else if (periods.all_busy) {
+                periods.lead = run[f];
+                periods.all_busy = false;
+                run[f] = 0;
+            } else if (run[f]) {
+                periods.record(run[f]);
+                run[f] = 0;
+            }
+        }
+
+        for (unsigned i = 0; i < 9; i++) {
+            shard.su[i] += (held(signals, STALL_SIGNALS[i], cycles) & level[i]) | (bit(rising, STALL_SIGNALS[i]) & ~level[i]);
+        }
+        shard.su[9] += cycles;
+        shard.su[cycle_slot_table[signals]] += cycles;
+    }
+
+    for (unsigned f = 0; f < 2; f++) {
+        if (shard.fills[f].all_busy) {
+            shard.fills[f].lead = run[f];
+        }
+        shard.fills[f].trail = run[f];
+    }
+}
+
+// Registers in the order of counter_registers()
+std::vector<uint64_t> reduce(const std::vector<Shard> &shards) {
+    Shard total;
+    uint64_t carry[2] = { 0, 0 }; // Busy cycles of the fill in progress at the start of the next shard
+    std::vector<uint64_t> registers;
+
+    for (const Shard &shard : shards) {
+        for (unsigned i = 0; i < ABACUS_IP_NUM_COUNTERS; i++) {
+            total.ip[i] += shard.ip[i];
+        }
+        for (unsigned i = 0; i < 10; i++) {
+            total.cp[i] += shard.cp[i];
+        }
+        for (unsigned i = 0; i < ABACUS_SU_NUM_COUNTERS; i++) {
+            total.su[i] += shard.su[i];
+        }
+        for (unsigned f = 0; f < 2; f++) {
+            const Periods &periods = shard.fills[f];
+
+            total.fills[f].merge(periods);
+            if (periods.all_busy) {
+                carry[f] += periods.lead;
+            } else {
+                if (carry[f] + periods.lead) {
+                    total.fills[f].record(carry[f] + periods.lead);
+                }
+                carry[f] = periods.trail;
+            }
+        }
+    }
+
+    total.cp[1] = total.cp[0] - total.cp[2]; // As latched by the snapshot, wrapping like the RTL
+
+    registers.insert(registers.end(), total.ip, total.ip + ABACUS_IP_NUM_COUNTERS);
+    registers.insert(registers.end(), total.cp, total.cp + 10);
+    registers.insert(registers.end(), total.fills[0].buckets, total.fills[0].buckets + ABACUS_LATENCY_BUCKETS);
+    registers.insert(registers.end(), total.fills[1].buckets, total.fills[1].buckets + ABACUS_LATENCY_BUCKETS);
+    registers.push_back(total.fills[0].min);
+    registers.push_back(total.fills[0].max);
+    registers.push_back(total.fills[1].min);
+    registers.push_back(total.fills[1].max);
+    registers.insert(registers.end(), total.su, total.su + ABACUS_SU_NUM_COUNTERS);
+    return registers;
+}
+
+void usage() {
+    fprintf(stderr,
+            "Usage: abacus_model [options] <trace>\n"
+            "       abacus_model [options] --random <cycles> [seed]\n"
+            "Options:\n"
+            "  -j <threads>          Shards to count in parallel, default one per core\n"
+            "  --level-mode <mask>   Stall unit level mode, ABACUS_REG_SU_LEVEL_MODE\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *trace_path = NULL;
+    uint64_t random_cycles = 0;
+    uint64_t random_seed = 1;
+    bool random_trace = false;
+    uint32_t level_mode = 0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const abacus_trace_record *records;
+    size_t record_count;
+    std::vector<abacus_trace_record> generated;
+    void *mapping = MAP_FAILED;
+    size_t mapping_size = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            threads = std::max(1ul, strtoul(argv[++i], NULL, 0));
+        } else if (!strcmp(argv[i], "--level-mode") && i + 1 < argc) {
+            level_mode = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--random") && i + 1 < argc) {
+            random_trace = true;
+            random_cycles = strtoull(argv[++i], NULL, 0);
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                random_seed = strtoull(argv[++i], NULL, 0);
+            }
+        } else if (argv[i][0] != '-' && !trace_path) {
+            trace_path = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (random_trace == (trace_path != NULL)) {
+        usage();
+        return 2;
+    }
+
+    if (random_trace) {
+        RandomTrace trace(random_cycles, random_seed);
+        abacus_trace_record record;
+
+        while (trace.next(&record, 1)) {
+            generated.push_back(record);
+        }
+        records = generated.data();
+        record_count = generated.size();
+    } else {
+        int fd = open(trace_path, O_RDONLY);
+        struct stat st;
+        const abacus_trace_header *header;
+
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            perror(trace_path);
+            return 2;
+        }
+        mapping_size = st.st_size;
+        if (mapping_size >= sizeof(abacus_trace_header)) {
+            mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        header = (const abacus_trace_header *)mapping;
+        if (mapping == MAP_FAILED || header->magic != ABACUS_TRACE_MAGIC || header->version != ABACUS_TRACE_VERSION ||
+            header->record_size != sizeof(abacus_trace_record)) {
+            fprintf(stderr, "%s: not a version %u ABACUS trace\n", trace_path, ABACUS_TRACE_VERSION);
+            return 2;
+        }
+        madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+        records = (const abacus_trace_record *)(header + 1);
+        record_count = (mapping_size - sizeof(abacus_trace_header)) / sizeof(abacus_trace_record);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    fill_tables();
+    threads = (unsigned)std::min<size_t>(threads, std::max<size_t>(record_count, 1));
+    std::vector<Shard> shards(threads);
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < threads; t++) {
+        size_t first = record_count * t / threads;
+        size_t last = record_count * (t + 1) / threads;
+        // The nets are idle before the trace, so the edge detectors of the first shard start from low nets
+        uint32_t prev = first ? records[first - 1].signals : 0;
+
+        workers.emplace_back(count, records + first, last - first, prev, level_mode, std::ref(shards[t]));
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    std::vector<uint64_t> values = reduce(shards);
+    std::vector<Register> registers = counter_registers();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; i < registers.size(); i++) {
+        printf("0x%03x %llu # %s\n", registers[i].offset, (unsigned long long)values[i], registers[i].name.c_str());
+    }
+    fprintf(stderr, "Modelled %llu cycles, %zu records, in %.3f s with %u threads, %.2f GB/s\n",
+            (unsigned long long)values[registers.size() - ABACUS_SU_NUM_COUNTERS + 9], record_count, elapsed, threads,
+            elapsed > 0 ? record_count * sizeof(abacus_trace_record) / elapsed / 1e9 : 0.0);
+
+    if (mapping != MAP_FAILED) {
+        munmap(mapping, mapping_size);
+    }
+    return 0;
+}
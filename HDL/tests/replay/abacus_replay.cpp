@@ -0,0 +1,421 @@
+// Trace replay harness for abacus_top, built with Verilator (see the Makefile).
+//
+// Drives the core-side nets of abacus_top from a binary trace (abacus_trace.h), then reads every
+// counter back through the Wishbone port, the same way the driver does, and checks it against a
+// file of expected totals. The units are enabled just before the first trace cycle and a software
+// snapshot is taken in the cycle after the last one, so the counters cover exactly the trace.
+//
+//   abacus_replay [options] <trace>
+//   abacus_replay [options] --random <cycles> [seed]
+//
+// Whatever the expected file says, the harness also checks what it knows from the trace itself:
+// the cycle counter equals the trace length, the issued instruction counters equal the issue
+// cycles of the trace, and the CPI stack adds up to the cycle counter. The snapshot window is then
+// read in one Wishbone burst and has to hold the same values as the per-counter registers.
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Vabacus_top.h"
+#include "verilated.h"
+
+#include "abacus_trace_tools.hpp"
+
+#define ABACUS_BASE_ADDR 0xf0030000u
+
+namespace {
+
+class Harness {
+public:
+    Harness() : top_(&context_) {}
+
+    ~Harness() { top_.final(); }
+
+    void reset() {
+        top_.rst = 1;
+        tick();
+        tick();
+        top_.rst = 0;
+        tick();
+    }
+
+    // Holds the nets of a record for one cycle
+    void drive(const abacus_trace_record &record) {
+        top_.abacus_instruction = record.instruction;
+        top_.abacus_instruction_pc = record.pc;
+        top_.abacus_instruction_issued = (record.signals & ABACUS_TRACE_INSTRUCTION_ISSUED) != 0;
+        top_.abacus_icache_request = (record.signals & ABACUS_TRACE_ICACHE_REQUEST) != 0;
+        top_.abacus_dcache_request = (record.signals & ABACUS_TRACE_DCACHE_REQUEST) != 0;
+        top_.abacus_icache_miss = (record.signals & ABACUS_TRACE_ICACHE_MISS) != 0;
+        top_.abacus_dcache_hit = (record.signals & ABACUS_TRACE_DCACHE_HIT) != 0;
+        top_.abacus_icache_line_fill_in_progress = (record.signals & ABACUS_TRACE_ICACHE_LINE_FILL_IN_PROGRESS) != 0;
+        top_.abacus_dcache_line_fill_in_progress = (record.signals & ABACUS_TRACE_DCACHE_LINE_FILL_IN_PROGRESS) != 0;
+        top_.abacus_branch_misprediction = (record.signals & ABACUS_TRACE_BRANCH_MISPREDICTION) != 0;
+        top_.abacus_ras_misprediction = (record.signals & ABACUS_TRACE_RAS_MISPREDICTION) != 0;
+        top_.abacus_issue_no_instruction_stat = (record.signals & ABACUS_TRACE_ISSUE_NO_INSTRUCTION) != 0;
+        top_.abacus_issue_no_id_stat = (record.signals & ABACUS_TRACE_ISSUE_NO_ID) != 0;
+        top_.abacus_issue_flush_stat = (record.signals & ABACUS_TRACE_ISSUE_FLUSH) != 0;
+        top_.abacus_issue_unit_busy_stat = (record.signals & ABACUS_TRACE_ISSUE_UNIT_BUSY) != 0;
+        top_.abacus_issue_operands_not_ready_stat = (record.signals & ABACUS_TRACE_ISSUE_OPERANDS_NOT_READY) != 0;
+        top_.abacus_issue_hold_stat = (record.signals & ABACUS_TRACE_ISSUE_HOLD) != 0;
+        top_.abacus_issue_multi_source_stat = (record.signals & ABACUS_TRACE_ISSUE_MULTI_SOURCE) != 0;
+    }
+
+    void tick() {
+        top_.clk = 0;
+        top_.eval();
+        top_.clk = 1;
+        top_.eval();
+        ticks_++;
+    }
+
+    uint64_t ticks() const { return ticks_; }
+
+    // Starts a Wishbone write, which takes effect on the edge that raises wb_ack
+    void start_write(uint32_t offset, uint32_t data) {
+        top_.wb_cyc = 1;
+        top_.wb_stb = 1;
+        top_.wb_we = 1;
+        top_.wb_adr = ABACUS_BASE_ADDR + offset;
+        top_.wb_dat_i = data;
+    }
+
+    void write(uint32_t offset, uint32_t data) {
+        start_write(offset, data);
+        wait_ack();
+        tick();
+        end_cycle();
+    }
+
+    uint32_t read(uint32_t offset) {
+        uint32_t data;
+
+        top_.wb_cyc = 1;
+        top_.wb_stb = 1;
+        top_.wb_we = 0;
+        top_.wb_adr = ABACUS_BASE_ADDR + offset;
+        wait_ack();
+        // Sampled on the edge that ends the acknowledge cycle, which is also when the read takes
+        // its side effects, such as latching ABACUS_REG_COUNTER_HI
+        data = top_.wb_dat_o;
+        tick();
+        end_cycle();
+        return data;
+    }
+
+    // Clocks until wb_ack is high, the bus cycle is still asserted on return
+    void wait_ack() {
+        do {
+            tick();
+        } while (!top_.wb_ack);
+    }
+
+    void end_cycle() {
+        top_.wb_cyc = 0;
+        top_.wb_stb = 0;
+        top_.wb_we = 0;
+    }
+
+    // Classic incrementing burst of words from offset. With registered feedback every beat after
+    // the first is acknowledged in the cycle its address is presented.
+    std::vector<uint32_t> read_burst(uint32_t offset, size_t words) {
+        std::vector<uint32_t> data;
+
+        top_.wb_cyc = 1;
+        top_.wb_stb = 1;
+        top_.wb_we = 0;
+        top_.wb_bte = 0; // Linear
+        for (size_t i = 0; i < words; i++) {
+            top_.wb_adr = ABACUS_BASE_ADDR + offset + 4 * i;
+            top_.wb_cti = (i + 1 < words) ? 2 : 7; // Incrementing, then end of burst
+            top_.clk = 0;
+            top_.eval();
+            while (!top_.wb_ack) {
+                tick();
+            }
+            data.push_back(top_.wb_dat_o);
+            tick();
+        }
+        top_.wb_cti = 0;
+        end_cycle();
+        return data;
+    }
+
+    uint64_t read_counter(const Register &reg) {
+        uint64_t value = read(reg.offset);
+
+        if (reg.wide) {
+            value |= (uint64_t)read(ABACUS_REG_COUNTER_HI) << 32;
+        }
+        return value;
+    }
+
+private:
+    VerilatedContext context_;
+    Vabacus_top top_;
+    uint64_t ticks_ = 0;
+};
+
+class FileTrace : public TraceSource {
+public:
+    explicit FileTrace(FILE *file) : file_(file) {}
+    ~FileTrace() { fclose(file_); }
+
+    size_t next(abacus_trace_record *records, size_t count) override {
+        return fread(records, sizeof(abacus_trace_record), count, file_);
+    }
+
+private:
+    FILE *file_;
+};
+
+struct Expected {
+    uint32_t offset;
+    uint64_t value;
+};
+
+// Lines of "<register offset> <value>", # starts a comment. The --dump output is in this format.
+bool read_expected(const char *path, std::vector<Expected> &expected) {
+    FILE *file = fopen(path, "r");
+    char line[256];
+    unsigned number = 0;
+
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        char *comment = strchr(line, '#');
+        char *end;
+        Expected entry;
+
+        number++;
+        if (comment) {
+            *comment = '\0';
+        }
+        if (strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        entry.offset = (uint32_t)strtoul(line, &end, 0);
+        if (end == line) {
+            fprintf(stderr, "%s:%u: expected a register offset\n", path, number);
+            fclose(file);
+            return false;
+        }
+        entry.value = strtoull(end, &end, 0);
+        expected.push_back(entry);
+    }
+    fclose(file);
+    return true;
+}
+
+void usage() {
+    fprintf(stderr,
+            "Usage: abacus_replay [options] <trace>\n"
+            "       abacus_replay [options] --random <cycles> [seed]\n"
+            "Options:\n"
+            "  --expect <file>       Compare the counters to the totals in file\n"
+            "  --level-mode <mask>   Stall unit level mode, ABACUS_REG_SU_LEVEL_MODE\n"
+            "  --dump                Print every counter, in the format of the expected file\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *trace_path = NULL;
+    const char *expected_path = NULL;
+    uint64_t random_cycles = 0;
+    uint64_t random_seed = 1;
+    bool random_trace = false;
+    bool dump = false;
+    uint32_t level_mode = 0;
+    std::vector<Expected> expected;
+    TraceSource *source;
+    int failures = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--expect") && i + 1 < argc) {
+            expected_path = argv[++i];
+        } else if (!strcmp(argv[i], "--level-mode") && i + 1 < argc) {
+            level_mode = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--dump")) {
+            dump = true;
+        } else if (!strcmp(argv[i], "--random") && i + 1 < argc) {
+            random_trace = true;
+            random_cycles = strtoull(argv[++i], NULL, 0);
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                random_seed = strtoull(argv[++i], NULL, 0);
+            }
+        } else if (argv[i][0] != '-' && !trace_path) {
+            trace_path = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (random_trace == (trace_path != NULL)) {
+        usage();
+        return 2;
+    }
+    if (expected_path && !read_expected(expected_path, expected)) {
+        return 2;
+    }
+
+    if (random_trace) {
+        source = new RandomTrace(random_cycles, random_seed);
+    } else {
+        FILE *file = fopen(trace_path, "rb");
+        abacus_trace_header header;
+
+        if (!file) {
+            perror(trace_path);
+            return 2;
+        }
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != ABACUS_TRACE_MAGIC ||
+            header.version != ABACUS_TRACE_VERSION || header.record_size != sizeof(abacus_trace_record)) {
+            fprintf(stderr, "%s: not a version %u ABACUS trace\n", trace_path, ABACUS_TRACE_VERSION);
+            fclose(file);
+            return 2;
+        }
+        source = new FileTrace(file);
+    }
+
+    Harness harness;
+    abacus_trace_record idle = {};
+    std::vector<abacus_trace_record> records(4096);
+    uint64_t cycles = 0;
+    uint64_t issue_cycles = 0;
+    size_t count;
+
+    harness.drive(idle);
+    harness.reset();
+
+    // Software snapshots only, and the stall unit enabled last: it is the only unit that counts
+    // idle cycles, so none of the setup writes are counted
+    harness.write(ABACUS_REG_SNAPSHOT_INTERVAL, 0);
+    harness.write(ABACUS_REG_SU_LEVEL_MODE, level_mode);
+    harness.write(ABACUS_REG_IP_ENABLE, 1);
+    harness.write(ABACUS_REG_CP_ENABLE, 1);
+
+    // A write has taken effect once it is acknowledged, so the bus is released in the acknowledge
+    // cycle and that cycle is already the first one of the trace
+    harness.start_write(ABACUS_REG_SU_ENABLE, 1);
+    harness.wait_ack();
+    harness.end_cycle();
+
+    auto start = std::chrono::steady_clock::now();
+
+    while ((count = source->next(records.data(), records.size())) > 0) {
+        for (size_t r = 0; r < count; r++) {
+            harness.drive(records[r]);
+            for (uint32_t c = 0; c < records[r].cycles; c++) {
+                harness.tick();
+            }
+            cycles += records[r].cycles;
+            if (records[r].signals & ABACUS_TRACE_INSTRUCTION_ISSUED) {
+                issue_cycles += records[r].cycles;
+            }
+        }
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    delete source;
+
+    // The snapshot is taken on the edge that ends the first cycle after the trace, before that
+    // cycle is counted
+    harness.drive(idle);
+    harness.write(ABACUS_REG_SNAPSHOT, 1);
+
+    std::vector<Register> registers = counter_registers();
+    std::vector<uint64_t> values;
+    uint64_t readout_start = harness.ticks();
+
+    for (const Register &reg : registers) {
+        values.push_back(harness.read_counter(reg));
+    }
+
+    uint64_t register_readout = harness.ticks() - readout_start;
+
+    readout_start = harness.ticks();
+    std::vector<uint32_t> window = harness.read_burst(ABACUS_REG_SNAPSHOT_WINDOW, ABACUS_SNAPSHOT_WINDOW_SIZE / 4);
+    uint64_t window_readout = harness.ticks() - readout_start;
+
+    auto value_of = [&](uint32_t offset) {
+        for (size_t i = 0; i < registers.size(); i++) {
+            if (registers[i].offset == offset) {
+                return values[i];
+            }
+        }
+        return (uint64_t)0;
+    };
+    auto check = [&](const char *what, uint64_t actual, uint64_t wanted) {
+        if (actual != wanted) {
+            printf("MISMATCH %s: %llu, expected %llu\n", what, (unsigned long long)actual, (unsigned long long)wanted);
+            failures++;
+        }
+    };
+
+    uint32_t su_cycles = ABACUS_REG_SU_BASE + 4 * 9;
+    uint32_t su_instructions = ABACUS_REG_SU_BASE + 4 * 10;
+    uint64_t stack = value_of(su_instructions);
+
+    for (unsigned i = 0; i < ABACUS_CPI_STALLS; i++) {
+        stack += value_of(ABACUS_REG_SU_BASE + 4 * (11 + i));
+    }
+    check("su.cycles", value_of(su_cycles), cycles);
+    check("su.instructions", value_of(su_instructions), issue_cycles);
+    check("ip.total", value_of(ABACUS_REG_IP_BASE + 4 * (ABACUS_IP_NUM_COUNTERS - 1)), issue_cycles);
+    check("su.instructions + CPI stack", stack, value_of(su_cycles));
+
+    // The window has the 64-bit counters in address order, then the 32-bit line fill extremes
+    size_t counter_word = 0;
+    size_t extreme_word = 0;
+
+    for (const Register &reg : registers) {
+        if (reg.wide) {
+            extreme_word += 2;
+        }
+    }
+    for (size_t i = 0; i < registers.size(); i++) {
+        std::string what = "window " + registers[i].name;
+
+        if (registers[i].wide) {
+            check(what.c_str(), window[counter_word] | (uint64_t)window[counter_word + 1] << 32, values[i]);
+            counter_word += 2;
+        } else {
+            check(what.c_str(), window[extreme_word++], values[i]);
+        }
+    }
+
+    for (const Expected &entry : expected) {
+        bool found = false;
+
+        for (size_t i = 0; i < registers.size(); i++) {
+            if (registers[i].offset == entry.offset) {
+                check(registers[i].name.c_str(), values[i], entry.value);
+                found = true;
+            }
+        }
+        if (!found) {
+            printf("MISMATCH 0x%03x: not a counter register\n", entry.offset);
+            failures++;
+        }
+    }
+
+    if (dump) {
+        for (size_t i = 0; i < registers.size(); i++) {
+            printf("0x%03x %llu # %s\n", registers[i].offset, (unsigned long long)values[i], registers[i].name.c_str());
+        }
+    }
+
+    printf("Read %zu counters in %llu bus cycles, the snapshot window in %llu\n", registers.size(),
+           (unsigned long long)register_readout, (unsigned long long)window_readout);
+    printf("Replayed %llu cycles in %.3f s, %.2f Mcycles/s\n", (unsigned long long)cycles, elapsed,
+           elapsed > 0 ? cycles / elapsed / 1e6 : 0.0);
+    printf("%s, %zu expected totals, %d mismatches\n", failures ? "FAIL" : "PASS", expected.size(), failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+// Binary signal trace of the core-side nets of abacus_top, written by abacus_trace_recorder.sv
+// and replayed by abacus_replay.
+//
+// A trace is a header followed by records. Each record holds the value of every core-side net
+// and the number of consecutive cycles the nets kept that value, so stalls and idle loops take
+// one record however long they last. Every field is a little-endian 32-bit word.
+
+#ifndef ABACUS_TRACE_H
+#define ABACUS_TRACE_H
+
+#include <stdint.h>
+
+#define ABACUS_TRACE_MAGIC 0x52544241 // "ABTR"
+#define ABACUS_TRACE_VERSION 1
+
+struct abacus_trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size; // sizeof(struct abacus_trace_record)
+    uint32_t reserved;
+};
+
+struct abacus_trace_record {
+    uint32_t instruction; // abacus_instruction
+    uint32_t pc;          // abacus_instruction_pc
+    uint32_t signals;     // ABACUS_TRACE_* bits, the single-bit nets in abacus_top port order
+    uint32_t cycles;      // Cycles these values were held, at least 1
+};
+
+#define ABACUS_TRACE_INSTRUCTION_ISSUED (1u << 0)
+#define ABACUS_TRACE_ICACHE_REQUEST (1u << 1)
+#define ABACUS_TRACE_DCACHE_REQUEST (1u << 2)
+#define ABACUS_TRACE_ICACHE_MISS (1u << 3)
+#define ABACUS_TRACE_DCACHE_HIT (1u << 4)
+#define ABACUS_TRACE_ICACHE_LINE_FILL_IN_PROGRESS (1u << 5)
+#define ABACUS_TRACE_DCACHE_LINE_FILL_IN_PROGRESS (1u << 6)
+#define ABACUS_TRACE_BRANCH_MISPREDICTION (1u << 7)
+#define ABACUS_TRACE_RAS_MISPREDICTION (1u << 8)
+#define ABACUS_TRACE_ISSUE_NO_INSTRUCTION (1u << 9)
+#define ABACUS_TRACE_ISSUE_NO_ID (1u << 10)
+#define ABACUS_TRACE_ISSUE_FLUSH (1u << 11)
+#define ABACUS_TRACE_ISSUE_UNIT_BUSY (1u << 12)
+#define ABACUS_TRACE_ISSUE_OPERANDS_NOT_READY (1u << 13)
+#define ABACUS_TRACE_ISSUE_HOLD (1u << 14)
+#define ABACUS_TRACE_ISSUE_MULTI_SOURCE (1u << 15)
+#define ABACUS_TRACE_SIGNALS 16
+
+#endif // ABACUS_TRACE_H
@@ -0,0 +1,103 @@
+// Records the core-side nets of abacus_top into a binary trace for abacus_replay, in the format of
+// abacus_trace.h. Every cycle out of reset is recorded, and cycles whose nets did not change are
+// merged into one record. The ports have the names of the abacus_top ports, so in a CVA5 simulation
+// the recorder can be attached without editing the SoC:
+//
+//   bind abacus_top abacus_trace_recorder #(.FILENAME("cva5.trace")) trace_recorder (.*);
+module abacus_trace_recorder #(
+    parameter string FILENAME = "abacus.trace"
+)
+(
+    input logic clk,
+    input logic rst,
+
+    input logic [31:0] abacus_instruction,
+    input logic [31:0] abacus_instruction_pc,
+    input logic abacus_instruction_issued,
+
+    input logic abacus_icache_request,
+    input logic abacus_dcache_request,
+    input logic abacus_icache_miss,
+    input logic abacus_dcache_hit,
+    input logic abacus_icache_line_fill_in_progress,
+    input logic abacus_dcache_line_fill_in_progress,
+
+    input logic abacus_branch_misprediction,
+    input logic abacus_ras_misprediction,
+    input logic abacus_issue_no_instruction_stat,
+    input logic abacus_issue_no_id_stat,
+    input logic abacus_issue_flush_stat,
+    input logic abacus_issue_unit_busy_stat,
+    input logic abacus_issue_operands_not_ready_stat,
+    input logic abacus_issue_hold_stat,
+    input logic abacus_issue_multi_source_stat
+);
+
+localparam logic [31:0] TRACE_MAGIC = 32'h52544241; // "ABTR"
+localparam logic [31:0] TRACE_VERSION = 32'd1;
+localparam logic [31:0] RECORD_SIZE = 32'd16;
+
+// ABACUS_TRACE_* bit order
+logic [15:0] signals;
+
+assign signals = {abacus_issue_multi_source_stat, abacus_issue_hold_stat, abacus_issue_operands_not_ready_stat,
+                  abacus_issue_unit_busy_stat, abacus_issue_flush_stat, abacus_issue_no_id_stat,
+                  abacus_issue_no_instruction_stat, abacus_ras_misprediction, abacus_branch_misprediction,
+                  abacus_dcache_line_fill_in_progress, abacus_icache_line_fill_in_progress, abacus_dcache_hit,
+                  abacus_icache_miss, abacus_dcache_request, abacus_icache_request, abacus_instruction_issued};
+
+integer fd;
+
+// Record being merged
+logic [31:0] record_instruction;
+logic [31:0] record_pc;
+logic [15:0] record_signals;
+logic [31:0] record_cycles;
+
+// Little endian whatever the host, one byte at a time
+task automatic write_word(input logic [31:0] word);
+    $fwrite(fd, "%c%c%c%c", word[7:0], word[15:8], word[23:16], word[31:24]);
+endtask
+
+task automatic write_record();
+    if (record_cycles != 32'h0) begin
+        write_word(record_instruction);
+        write_word(record_pc);
+        write_word({16'h0, record_signals});
+        write_word(record_cycles);
+    end
+endtask
+
+initial begin
+    fd = $fopen(FILENAME, "wb");
+    if (fd == 0) begin
+        $fatal(1, "abacus_trace_recorder: cannot open %s", FILENAME);
+    end
+    write_word(TRACE_MAGIC);
+    write_word(TRACE_VERSION);
+    write_word(RECORD_SIZE);
+    write_word(32'h0);
+    record_cycles = 32'h0;
+end
+
+always_ff @(posedge clk) begin
+    if (~rst) begin
+        if (record_cycles != 32'h0 && record_cycles != 32'hffffffff && abacus_instruction == record_instruction &&
+            abacus_instruction_pc == record_pc && signals == record_signals) begin
+            record_cycles <= record_cycles + 1;
+        end else begin
+            write_record();
+            record_instruction <= abacus_instruction;
+            record_pc <= abacus_instruction_pc;
+            record_signals <= signals;
+            record_cycles <= 32'd1;
+        end
+    end
+end
+
+final begin
+    write_record();
+    $fclose(fd);
+end
+
+endmodule
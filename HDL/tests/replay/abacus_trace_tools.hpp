@@ -0,0 +1,111 @@
+// Shared by abacus_replay and abacus_model: the counter registers they report, in the order of the
+// register map, and the random trace generator, so both can replay the same random trace.
+
+#ifndef ABACUS_TRACE_TOOLS_HPP
+#define ABACUS_TRACE_TOOLS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "abacus_ioctl.h"
+#include "abacus_trace.h"
+
+struct Register {
+    uint32_t offset;
+    std::string name;
+    bool wide; // A counter, whose upper word is read through ABACUS_REG_COUNTER_HI
+};
+
+static const char *const IP_NAMES[ABACUS_IP_NUM_COUNTERS] = {
+    "load_word", "store_word", "addition", "subtraction", "branch", "jump", "system_privilege", "atomic",
+    "logical", "shift", "compare", "upper_immediate", "multiply", "divide", "csr", "fence", "fp_load",
+    "fp_store", "fp_arithmetic", "fp_fused_multiply_add", "fp_divide_sqrt", "other", "total",
+};
+
+static const char *const CP_NAMES[10] = {
+    "icache_request", "icache_hit", "icache_miss", "icache_line_fill_latency", "dcache_request",
+    "dcache_hit", "dcache_miss", "dcache_line_fill_latency", "line_fill_occupancy", "line_fill_active",
+};
+
+static const char *const SU_NAMES[ABACUS_SU_NUM_COUNTERS] = {
+    "branch_misprediction", "ras_misprediction", "issue_no_instruction", "issue_no_id", "issue_flush",
+    "issue_unit_busy", "issue_operands_not_ready", "issue_hold", "issue_multi_source", "cycles",
+    "instructions", "cpi_flush", "cpi_frontend_empty", "cpi_hold", "cpi_operand_dependency",
+    "cpi_unit_busy", "cpi_other",
+};
+
+// Every counter register of the instruction, cache and stall units, in address order
+inline std::vector<Register> counter_registers() {
+    std::vector<Register> registers;
+
+    for (unsigned i = 0; i < ABACUS_IP_NUM_COUNTERS; i++) {
+        registers.push_back({ ABACUS_REG_IP_BASE + 4 * i, std::string("ip.") + IP_NAMES[i], true });
+    }
+    for (unsigned i = 0; i < 10; i++) {
+        registers.push_back({ ABACUS_REG_CP_BASE + 4 * i, std::string("cp.") + CP_NAMES[i], true });
+    }
+    for (unsigned i = 0; i < ABACUS_LATENCY_BUCKETS; i++) {
+        registers.push_back({ ABACUS_REG_CP_BASE + 0x28 + 4 * i, "cp.icache_line_fill_histogram_" + std::to_string(i), true });
+    }
+    for (unsigned i = 0; i < ABACUS_LATENCY_BUCKETS; i++) {
+        registers.push_back({ ABACUS_REG_CP_BASE + 0x58 + 4 * i, "cp.dcache_line_fill_histogram_" + std::to_string(i), true });
+    }
+    registers.push_back({ ABACUS_REG_ICACHE_LINE_FILL_MIN, "cp.icache_line_fill_min", false });
+    registers.push_back({ ABACUS_REG_ICACHE_LINE_FILL_MAX, "cp.icache_line_fill_max", false });
+    registers.push_back({ ABACUS_REG_DCACHE_LINE_FILL_MIN, "cp.dcache_line_fill_min", false });
+    registers.push_back({ ABACUS_REG_DCACHE_LINE_FILL_MAX, "cp.dcache_line_fill_max", false });
+    for (unsigned i = 0; i < ABACUS_SU_NUM_COUNTERS; i++) {
+        registers.push_back({ ABACUS_REG_SU_BASE + 4 * i, std::string("su.") + SU_NAMES[i], true });
+    }
+    return registers;
+}
+
+// Source of trace records, from a file or generated
+class TraceSource {
+public:
+    virtual ~TraceSource() {}
+    // Fills up to count records, returns how many, 0 at the end of the trace
+    virtual size_t next(abacus_trace_record *records, size_t count) = 0;
+};
+
+// Random nets, for throughput measurements and for the self checks
+class RandomTrace : public TraceSource {
+public:
+    RandomTrace(uint64_t cycles, uint64_t seed) : remaining_(cycles), state_(seed ? seed : 1) {}
+
+    size_t next(abacus_trace_record *records, size_t count) override {
+        size_t n = 0;
+
+        while (n < count && remaining_) {
+            abacus_trace_record &record = records[n++];
+            uint64_t bits = random();
+
+            record.instruction = (uint32_t)random() | 0x3; // Uncompressed encodings, so every class is reached
+            record.pc = (uint32_t)random() & ~0x3u;
+            record.signals = (uint32_t)bits & ((1u << ABACUS_TRACE_SIGNALS) - 1);
+            record.cycles = 1 + (uint32_t)((bits >> 32) % 8);
+            if (record.cycles > remaining_) {
+                record.cycles = (uint32_t)remaining_;
+            }
+            remaining_ -= record.cycles;
+        }
+        return n;
+    }
+
+private:
+    uint64_t random() {
+        // xorshift64
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+
+    uint64_t remaining_;
+    uint64_t state_;
+};
+
+
+#endif // ABACUS_TRACE_TOOLS_HPP
@@ -12,24 +12,92 @@ int disable_dcache_profiling(void);
 int enable_stall_unit(void);
 int disable_stall_unit(void);
 void stall_unit_profile(void);
+void set_stall_level_mode(unsigned int mask);
+static void cpi_stack(void);
+void abacus_snapshot(void);
+void set_snapshot_interval(unsigned int cycles);
+unsigned long long read_counter(volatile unsigned int* counter_reg);
+void overflow_status(void);
+void clear_overflow(void);
+void clear_units(unsigned int mask);
+int enable_pc_sampling(unsigned int period);
+int disable_pc_sampling(void);
+void pc_samples(void);
+void roi_markers(void);
+void roi_pc(unsigned int start_low, unsigned int start_high, unsigned int stop_low, unsigned int stop_high);
+void roi_off(void);
+void roi_status(void);
+int select_event(unsigned int counter, unsigned int event, int edge);
+void event_counters(void);
+int enable_branch_hotlist(void);
+int disable_branch_hotlist(void);
+void branch_hotlist(void);
+int enable_miss_sketch(unsigned int granule_shift, unsigned int low, unsigned int high);
+int disable_miss_sketch(void);
+void miss_hotspots(void);
+int enable_bus_profiling(void);
+int disable_bus_profiling(void);
+void bus_profile(void);
+int set_rate_alarm(unsigned int alarm, unsigned int event, unsigned int window, unsigned int threshold);
+void rate_alarms(void);
+void set_unit_filter(unsigned int mask, unsigned int modes, int asid);
+void unit_filters(void);
 
 #define ABACUS_BASE_ADDR 0xf0030000
 #define INSTRUCTION_PROFILE_UNIT_BASE_ADDR (ABACUS_BASE_ADDR + 0x0100)
 #define CACHE_PROFILE_UNIT_BASE_ADDR (ABACUS_BASE_ADDR + 0x0200)
 #define STALL_UNIT_BASE_ADDR (ABACUS_BASE_ADDR + 0x0300)
+#define PC_SAMPLER_BASE_ADDR (ABACUS_BASE_ADDR + 0x0400)
+#define TRIGGER_BASE_ADDR (ABACUS_BASE_ADDR + 0x0500)
+#define EVENT_COUNTER_BASE_ADDR (ABACUS_BASE_ADDR + 0x0700)
+#define BRANCH_HOTLIST_BASE_ADDR (ABACUS_BASE_ADDR + 0x0B00)
+#define MISS_SKETCH_BASE_ADDR (ABACUS_BASE_ADDR + 0x0C00)
+#define BUS_PROFILER_BASE_ADDR (ABACUS_BASE_ADDR + 0x0D00)
+#define RATE_ALARM_BASE_ADDR (ABACUS_BASE_ADDR + 0x0E00)
+#define UNIT_FILTER_BASE_ADDR (ABACUS_BASE_ADDR + 0x0F00)
+
+// Region-of-interest markers, NOP hints that start and stop counting while the marker trigger is on
+#define ABACUS_ROI_START() __asm__ __volatile__("slti x0, x0, 1" ::: "memory")
+#define ABACUS_ROI_STOP() __asm__ __volatile__("slti x0, x0, 2" ::: "memory")
 
 volatile unsigned int* INSTRUCTION_PROFILE_UNIT_ENABLE = (volatile unsigned int*)(ABACUS_BASE_ADDR + 0x04);
 volatile unsigned int* CACHE_PROFILE_UNIT_ENABLE = (volatile unsigned int*)(ABACUS_BASE_ADDR + 0x08);
 volatile unsigned int* STALL_UNIT_ENABLE = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x0C);
+volatile unsigned int* SNAPSHOT_REG = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x10);
+volatile unsigned int* SNAPSHOT_INTERVAL_REG = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x14);
+volatile unsigned int* COUNTER_HI_REG = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x18);
+volatile unsigned int* INSTRUCTION_PROFILE_UNIT_OVERFLOW = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x20);
+volatile unsigned int* CACHE_PROFILE_UNIT_OVERFLOW = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x24);
+volatile unsigned int* STALL_UNIT_OVERFLOW = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x28);
+volatile unsigned int* PC_SAMPLER_ENABLE = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x2C);
+volatile unsigned int* STALL_UNIT_LEVEL_MODE = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x30); // Bit n: stall counter n counts cycles
+volatile unsigned int* EVENT_COUNTER_OVERFLOW = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x34);
+volatile unsigned int* BRANCH_HOTLIST_ENABLE = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x38);
+volatile unsigned int* MISS_SKETCH_ENABLE = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x3C);
+volatile unsigned int* BUS_PROFILER_ENABLE = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x40);
+volatile unsigned int* BUS_PROFILER_OVERFLOW = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x44);
+volatile unsigned int* UNIT_CLEAR_REG = (volatile unsigned int*) (ABACUS_BASE_ADDR + 0x48);
+
+// Unit Clear bits. The enable registers only pause and resume counting, a unit keeps its counters
+// until it is cleared, so a function can be measured over many calls with the code in between paused out.
+#define UNIT_CLEAR_IP 0x01
+#define UNIT_CLEAR_CP 0x02
+#define UNIT_CLEAR_SU 0x04
+#define UNIT_CLEAR_PC 0x08
+#define UNIT_CLEAR_BH 0x10
+#define UNIT_CLEAR_MS 0x20
+#define UNIT_CLEAR_BUS 0x40
+#define UNIT_CLEAR_EVENTS 0x80
 
-volatile unsigned int* LOAD_WORD_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x00);
-volatile unsigned int* STORE_WORD_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x04);
-volatile unsigned int* ADDITION_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x08);
-volatile unsigned int* SUBTRACTION_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x0C);
-volatile unsigned int* BRANCH_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x10);
-volatile unsigned int* JUMP_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x14);
-volatile unsigned int* SYSTEM_PRIVILEGE_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x18);
-volatile unsigned int* ATOMIC_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x1C);
+// One counter per instruction class, 4 bytes apart, in this order
+#define INSTRUCTION_CLASSES 23
+volatile unsigned int* INSTRUCTION_CLASS_COUNTER_REGS = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x00);
+const char* INSTRUCTION_CLASS_NAMES[INSTRUCTION_CLASSES] = {
+    "load", "store", "addition", "subtraction", "branch", "jump", "system privilege", "atomic",
+    "logical", "shift", "compare", "upper immediate", "multiply", "divide", "CSR", "fence",
+    "FP load", "FP store", "FP arithmetic", "FP fused multiply-add", "FP divide/sqrt", "other"
+};
+volatile unsigned int* INSTRUCTION_TOTAL_COUNTER_REG = (volatile unsigned int*)(INSTRUCTION_PROFILE_UNIT_BASE_ADDR + 0x58);
 
 volatile unsigned int* ICACHE_REQUEST_COUNTER_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x00);
 volatile unsigned int* ICACHE_HIT_COUNTER_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x04);
@@ -41,6 +109,18 @@ volatile unsigned int* DCACHE_HIT_COUNTER_REG = (volatile unsigned int*)(CACHE_P
 volatile unsigned int* DCACHE_MISS_COUNTER_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x18);
 volatile unsigned int* DCACHE_LINE_FILL_LATENCY_COUNTER_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x1C);
 
+volatile unsigned int* LINE_FILL_OCCUPANCY_COUNTER_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x20);
+volatile unsigned int* LINE_FILL_ACTIVE_COUNTER_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x24);
+
+// Bucket b counts fills of 2^b to 2^(b+1)-1 cycles, the last one also counts every longer fill
+#define LATENCY_BUCKETS 12
+volatile unsigned int* ICACHE_LINE_FILL_HISTOGRAM_REGS = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x28);
+volatile unsigned int* DCACHE_LINE_FILL_HISTOGRAM_REGS = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x58);
+volatile unsigned int* ICACHE_LINE_FILL_MIN_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x88);
+volatile unsigned int* ICACHE_LINE_FILL_MAX_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x8C);
+volatile unsigned int* DCACHE_LINE_FILL_MIN_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x90);
+volatile unsigned int* DCACHE_LINE_FILL_MAX_REG = (volatile unsigned int*)(CACHE_PROFILE_UNIT_BASE_ADDR + 0x94);
+
 volatile unsigned int* BRANCH_MISPREDICTION_COUNTER_REG = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x00);
 volatile unsigned int* RAS_MISPREDICTION_COUNTER_REG = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x04);
 volatile unsigned int* ISSUE_NO_INSTRUCTION_STAT_COUNTER_REG = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x08);
@@ -50,17 +130,137 @@ volatile unsigned int* ISSUE_UNIT_BUSY_STAT_COUNTER_REG = (volatile unsigned int
 volatile unsigned int* ISSUE_OPERANDS_NOT_READY_STAT_COUNTER_REG = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x18);
 volatile unsigned int* ISSUE_HOLD_STAT_COUNTER_REG = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x1C);
 volatile unsigned int* ISSUE_MULTI_SOURCE_STATS = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x20);
+volatile unsigned int* CYCLE_COUNTER_REG = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x24);
+volatile unsigned int* INSTRUCTION_COUNTER_REG = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x28);
+
+// CPI stack, the cycles that did not issue in the category of their first stall cause
+#define CPI_STALLS 6
+volatile unsigned int* CPI_STALL_COUNTER_REGS = (volatile unsigned int*)(STALL_UNIT_BASE_ADDR + 0x2C);
+static const char* cpi_stall_names[CPI_STALLS] = {
+	"Flush", "Frontend empty", "Hold", "Operand dependency", "Unit busy", "Other",
+};
+
+volatile unsigned int* PC_SAMPLE_PERIOD_REG = (volatile unsigned int*)(PC_SAMPLER_BASE_ADDR + 0x00);
+volatile unsigned int* PC_SAMPLE_COUNT_REG = (volatile unsigned int*)(PC_SAMPLER_BASE_ADDR + 0x04);
+volatile unsigned int* PC_SAMPLE_DATA_REG = (volatile unsigned int*)(PC_SAMPLER_BASE_ADDR + 0x08); // Reading pops the FIFO
+volatile unsigned int* PC_SAMPLE_DROPPED_REG = (volatile unsigned int*)(PC_SAMPLER_BASE_ADDR + 0x0C);
+
+volatile unsigned int* TRIGGER_CONTROL_REG = (volatile unsigned int*)(TRIGGER_BASE_ADDR + 0x00); // Bit 0: PC ranges, bit 1: markers
+volatile unsigned int* TRIGGER_STATUS_REG = (volatile unsigned int*)(TRIGGER_BASE_ADDR + 0x04);
+volatile unsigned int* TRIGGER_REGION_COUNT_REG = (volatile unsigned int*)(TRIGGER_BASE_ADDR + 0x08);
+volatile unsigned int* TRIGGER_START_PC_LOW_REG = (volatile unsigned int*)(TRIGGER_BASE_ADDR + 0x10);
+volatile unsigned int* TRIGGER_START_PC_HIGH_REG = (volatile unsigned int*)(TRIGGER_BASE_ADDR + 0x14);
+volatile unsigned int* TRIGGER_STOP_PC_LOW_REG = (volatile unsigned int*)(TRIGGER_BASE_ADDR + 0x18);
+volatile unsigned int* TRIGGER_STOP_PC_HIGH_REG = (volatile unsigned int*)(TRIGGER_BASE_ADDR + 0x1C);
+
+// Programmable counters, each counts the event chosen by its select register
+#define EVENT_SELECT_EDGE 0x100       // Count rising edges instead of cycles
+#define EVENT_SELECT_ENABLE 0x80000000
+#define NUM_EVENTS 17
+volatile unsigned int* EVENT_COUNTER_REGS = (volatile unsigned int*)(EVENT_COUNTER_BASE_ADDR + 0x00);
+volatile unsigned int* EVENT_SELECT_REGS = (volatile unsigned int*)(EVENT_COUNTER_BASE_ADDR + 0x40);
+volatile unsigned int* EVENT_NUM_COUNTERS_REG = (volatile unsigned int*)(EVENT_COUNTER_BASE_ADDR + 0x80);
+static const char* event_names[NUM_EVENTS] = {
+	"instruction issued", "icache request", "dcache request", "icache miss", "dcache hit",
+	"icache line fill", "dcache line fill", "branch mispredict", "RAS mispredict", "issue no instruction",
+	"issue no ID", "issue flush", "issue unit busy", "issue operands not ready", "issue hold",
+	"issue multi source", "cycle",
+};
+
+// Most mispredicted branches, entry n is PC, mispredictions, executions and error from BRANCH_HOTLIST_ENTRY_REGS + 4 * n
+#define BRANCH_HOTLIST_MAX_ENTRIES 15
+volatile unsigned int* BRANCH_HOTLIST_ENTRIES_REG = (volatile unsigned int*)(BRANCH_HOTLIST_BASE_ADDR + 0x00);
+volatile unsigned int* BRANCH_HOTLIST_MISPREDICTS_REG = (volatile unsigned int*)(BRANCH_HOTLIST_BASE_ADDR + 0x04);
+volatile unsigned int* BRANCH_HOTLIST_BRANCHES_REG = (volatile unsigned int*)(BRANCH_HOTLIST_BASE_ADDR + 0x08);
+volatile unsigned int* BRANCH_HOTLIST_ENTRY_REGS = (volatile unsigned int*)(BRANCH_HOTLIST_BASE_ADDR + 0x10);
+
+// Most missed dcache granules, entry n is the granule address and its estimated misses from MISS_SKETCH_TOPK_REGS + 2 * n
+#define MISS_SKETCH_MAX_ENTRIES 16
+volatile unsigned int* MISS_SKETCH_WIDTH_REG = (volatile unsigned int*)(MISS_SKETCH_BASE_ADDR + 0x00);
+volatile unsigned int* MISS_SKETCH_TOPK_ENTRIES_REG = (volatile unsigned int*)(MISS_SKETCH_BASE_ADDR + 0x04);
+volatile unsigned int* MISS_SKETCH_GRANULE_SHIFT_REG = (volatile unsigned int*)(MISS_SKETCH_BASE_ADDR + 0x0C);
+volatile unsigned int* MISS_SKETCH_FILTER_LOW_REG = (volatile unsigned int*)(MISS_SKETCH_BASE_ADDR + 0x10);
+volatile unsigned int* MISS_SKETCH_FILTER_HIGH_REG = (volatile unsigned int*)(MISS_SKETCH_BASE_ADDR + 0x14);
+volatile unsigned int* MISS_SKETCH_TOTAL_REG = (volatile unsigned int*)(MISS_SKETCH_BASE_ADDR + 0x18);
+volatile unsigned int* MISS_SKETCH_TOPK_REGS = (volatile unsigned int*)(MISS_SKETCH_BASE_ADDR + 0x40);
+
+// Memory bus traffic, a transaction is a single access or a whole burst
+volatile unsigned int* BUS_CYCLE_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x00);
+volatile unsigned int* BUS_READ_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x04);
+volatile unsigned int* BUS_WRITE_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x08);
+volatile unsigned int* BUS_READ_BYTES_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x0C);
+volatile unsigned int* BUS_WRITE_BYTES_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x10);
+volatile unsigned int* BUS_BUSY_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x14);
+volatile unsigned int* BUS_OCCUPANCY_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x18);
+volatile unsigned int* BUS_WAIT_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x1C);
+volatile unsigned int* BUS_LATENCY_COUNTER_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x20);
+volatile unsigned int* BUS_LATENCY_HISTOGRAM_REGS = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x28);
+volatile unsigned int* BUS_LATENCY_MIN_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x58);
+volatile unsigned int* BUS_LATENCY_MAX_REG = (volatile unsigned int*)(BUS_PROFILER_BASE_ADDR + 0x5C);
+
+// Rate alarms, alarm n is select, window, threshold and last window count from RATE_ALARM_REGS + 4 * n
+#define RATE_ALARM_SELECT_FREEZE 0x200 // Freeze the snapshot on a crossing
+volatile unsigned int* RATE_ALARM_COUNT_REG = (volatile unsigned int*)(RATE_ALARM_BASE_ADDR + 0x00);
+volatile unsigned int* RATE_ALARM_STATUS_REG = (volatile unsigned int*)(RATE_ALARM_BASE_ADDR + 0x04);
+volatile unsigned int* RATE_ALARM_PC_REG = (volatile unsigned int*)(RATE_ALARM_BASE_ADDR + 0x08);
+volatile unsigned int* RATE_ALARM_TIMESTAMP_REG = (volatile unsigned int*)(RATE_ALARM_BASE_ADDR + 0x10);
+volatile unsigned int* RATE_ALARM_REGS = (volatile unsigned int*)(RATE_ALARM_BASE_ADDR + 0x20);
+
+// Unit filters, one per Unit Clear bit. Bit m of bits 3:0 counts in privilege mode m, and bit 31 also
+// requires the ASID in bits 24:16. The event counter filter gates the rate alarms too.
+#define UNIT_FILTERS 8
+#define FILTER_MODES 0xF // Every mode, the value out of reset
+#define FILTER_ASID_MATCH 0x80000000
+volatile unsigned int* UNIT_FILTER_REGS = (volatile unsigned int*)(UNIT_FILTER_BASE_ADDR + 0x00);
+volatile unsigned int* CORE_MODE_REG = (volatile unsigned int*)(UNIT_FILTER_BASE_ADDR + 0x20); // Bits 1:0 mode, bits 24:16 ASID
+
+// Latch every counter of every unit on the same clock edge
+void abacus_snapshot(void) {
+    *(SNAPSHOT_REG) = (unsigned int) 0x1;
+}
+
+// Number of cycles between automatic snapshots, 0 leaves the counters frozen until abacus_snapshot()
+void set_snapshot_interval(unsigned int cycles) {
+    *(SNAPSHOT_INTERVAL_REG) = cycles;
+}
+
+// Counters are 64 bits wide. Reading the low word latches the upper word into COUNTER_HI_REG,
+// so the two halves always belong to the same value.
+unsigned long long read_counter(volatile unsigned int* counter_reg) {
+    unsigned int lo = *(counter_reg);
+    unsigned int hi = *(COUNTER_HI_REG);
+    return ((unsigned long long) hi << 32) | lo;
+}
+
+// Bit n of each status register is set when counter n of that unit wrapped
+void overflow_status(void) {
+    printf("Overflowed instruction profile counters: 0x%x\n", *(INSTRUCTION_PROFILE_UNIT_OVERFLOW));
+    printf("Overflowed cache profile counters: 0x%x\n", *(CACHE_PROFILE_UNIT_OVERFLOW));
+    printf("Overflowed stall unit counters: 0x%x\n", *(STALL_UNIT_OVERFLOW));
+    printf("Overflowed event counters: 0x%x\n", *(EVENT_COUNTER_OVERFLOW));
+    printf("Overflowed bus profiler counters: 0x%x\n", *(BUS_PROFILER_OVERFLOW));
+}
+
+void clear_overflow(void) {
+    *(INSTRUCTION_PROFILE_UNIT_OVERFLOW) = 0xffffffff;
+    *(CACHE_PROFILE_UNIT_OVERFLOW) = 0xffffffff;
+    *(STALL_UNIT_OVERFLOW) = 0xffffffff;
+    *(EVENT_COUNTER_OVERFLOW) = 0xffffffff;
+    *(BUS_PROFILER_OVERFLOW) = 0xffffffff;
+}
+
+// Empties every unit of the mask on the same clock edge, enabled or not
+void clear_units(unsigned int mask) {
+    *(UNIT_CLEAR_REG) = mask;
+}
 
 void instruction_profile(void) {
+    abacus_snapshot();
     printf("The following are the number of issued instructions of a certain OPCODE type \n");
-    printf("The number of load word: %u\n", *(LOAD_WORD_COUNTER_REG));
-    printf("The number of store word: %u\n", *(STORE_WORD_COUNTER_REG));
-    printf("The number of adds: %u\n", *(ADDITION_COUNTER_REG));
-    printf("The number of subtractions: %u\n", *(SUBTRACTION_COUNTER_REG));
-    printf("The number of branches: %u\n", *(BRANCH_COUNTER_REG));
-    printf("The number of jumps: %u\n", *(JUMP_COUNTER_REG));
-    printf("The number of system privilege instructions: %u\n", *(SYSTEM_PRIVILEGE_COUNTER_REG));
-    printf("The number of atomic instructions: %u\n", *(ATOMIC_COUNTER_REG));
+    for (int i = 0; i < INSTRUCTION_CLASSES - 1; i++) {
+        printf("The number of %s instructions: %llu\n", INSTRUCTION_CLASS_NAMES[i], read_counter(INSTRUCTION_CLASS_COUNTER_REGS + i));
+    }
+    printf("The total number of issued instructions: %llu\n", read_counter(INSTRUCTION_TOTAL_COUNTER_REG));
 }
 
 int enable_instruction_profiling(void) {
@@ -73,11 +273,46 @@ int disable_instruction_profiling(void) {
     return (*(INSTRUCTION_PROFILE_UNIT_ENABLE) == 0x0);
 }
 
+// Percentiles are resolved to a histogram bucket, so the upper bound of the bucket is printed,
+// capped by the longest event. Integer arithmetic only, printf may be built without float support.
+static void latency_summary(const char* what, volatile unsigned int* histogram_regs, unsigned long long total_cycles,
+                            unsigned int min, unsigned int max) {
+    static const unsigned int percentiles[] = { 50, 90, 99 };
+    unsigned long long histogram[LATENCY_BUCKETS];
+    unsigned long long fills = 0, seen, bound;
+    unsigned int b, p;
+
+    for (b = 0; b < LATENCY_BUCKETS; b++) {
+        histogram[b] = read_counter(histogram_regs + b);
+        fills += histogram[b];
+    }
+    if (fills == 0) {
+        printf("No %ss completed\n", what);
+        return;
+    }
+
+    printf("%s latency: mean %llu, min %u, max %u cycles\n", what, total_cycles / fills, min, max);
+    for (p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++) {
+        seen = 0;
+        for (b = 0; b < LATENCY_BUCKETS - 1; b++) {
+            seen += histogram[b];
+            if (seen * 100 >= fills * percentiles[p]) {
+                break;
+            }
+        }
+        bound = (b == LATENCY_BUCKETS - 1 || max < (2ULL << b) - 1) ? max : (2ULL << b) - 1;
+        printf("%s latency p%u: <= %llu cycles\n", what, percentiles[p], bound);
+    }
+}
+
 void icache_profile(void) {
-    printf("The number of icache requests: %u\n", *(ICACHE_REQUEST_COUNTER_REG));
-    printf("The number of icache hits: %u\n", *(ICACHE_HIT_COUNTER_REG));
-    printf("The number of icache misses: %u\n", *(ICACHE_MISS_COUNTER_REG));
-    printf("The number of clock cycles to replace a line in the instruction cache with the current replacement policy is: %u\n", *(ICACHE_LINE_FILL_LATENCY_COUNTER_REG));
+    abacus_snapshot();
+    printf("The number of icache requests: %llu\n", read_counter(ICACHE_REQUEST_COUNTER_REG));
+    printf("The number of icache hits: %llu\n", read_counter(ICACHE_HIT_COUNTER_REG));
+    printf("The number of icache misses: %llu\n", read_counter(ICACHE_MISS_COUNTER_REG));
+    printf("The number of clock cycles to replace a line in the instruction cache with the current replacement policy is: %llu\n", read_counter(ICACHE_LINE_FILL_LATENCY_COUNTER_REG));
+    latency_summary("icache line fill", ICACHE_LINE_FILL_HISTOGRAM_REGS, read_counter(ICACHE_LINE_FILL_LATENCY_COUNTER_REG),
+                    *(ICACHE_LINE_FILL_MIN_REG), *(ICACHE_LINE_FILL_MAX_REG));
 }
 
 int enable_icache_profiling(void) {
@@ -91,10 +326,20 @@ int disable_icache_profiling(void) {
 }
 
 void dcache_profile(void) {
-    printf("The number of dcache requests: %u\n", *(DCACHE_REQUEST_COUNTER_REG));
-    printf("The number of dcache hits: %u\n", *(DCACHE_HIT_COUNTER_REG));
-    printf("The number of dcache misses: %u\n", *(DCACHE_MISS_COUNTER_REG));
-    printf("The number of clock cycles to replace a line in the data cache with the current replacement policy is: %u\n", *(DCACHE_LINE_FILL_LATENCY_COUNTER_REG));
+    abacus_snapshot();
+    printf("The number of dcache requests: %llu\n", read_counter(DCACHE_REQUEST_COUNTER_REG));
+    printf("The number of dcache hits: %llu\n", read_counter(DCACHE_HIT_COUNTER_REG));
+    printf("The number of dcache misses: %llu\n", read_counter(DCACHE_MISS_COUNTER_REG));
+    printf("The number of clock cycles to replace a line in the data cache with the current replacement policy is: %llu\n", read_counter(DCACHE_LINE_FILL_LATENCY_COUNTER_REG));
+    latency_summary("dcache line fill", DCACHE_LINE_FILL_HISTOGRAM_REGS, read_counter(DCACHE_LINE_FILL_LATENCY_COUNTER_REG),
+                    *(DCACHE_LINE_FILL_MIN_REG), *(DCACHE_LINE_FILL_MAX_REG));
+
+    unsigned long long occupancy = read_counter(LINE_FILL_OCCUPANCY_COUNTER_REG);
+    unsigned long long active = read_counter(LINE_FILL_ACTIVE_COUNTER_REG);
+    if (active) {
+        printf("Memory-level parallelism: %llu.%02llu fills in flight over %llu busy cycles\n",
+               occupancy / active, (occupancy * 100 / active) % 100, active);
+    }
 }
 
 int enable_dcache_profiling(void) {
@@ -118,16 +363,365 @@ int disable_stall_unit(void) {
 }
 
 void stall_unit_profile(void) {
-	printf("Branch misprediction count: %u \n", *(BRANCH_MISPREDICTION_COUNTER_REG));
-	printf("RAS misprediction count: %u \n", *(RAS_MISPREDICTION_COUNTER_REG));
+	abacus_snapshot();
+	printf("Branch misprediction count: %llu \n", read_counter(BRANCH_MISPREDICTION_COUNTER_REG));
+	printf("RAS misprediction count: %llu \n", read_counter(RAS_MISPREDICTION_COUNTER_REG));
 
 	printf("\nCauses of stalls in the issue stage:\n");
 
-	printf("No instructions: %u \n", *(ISSUE_NO_INSTRUCTION_STAT_COUNTER_REG));
-	printf("No ID's remaining: %u \n", *(ISSUE_NO_ID_STAT_COUNTER_REG));
-	printf("Flush occurred: %u \n", *(ISSUE_FLUSH_STAT_COUNTER_REG));
-	printf("Issue unit was busy: %u \n", *(ISSUE_UNIT_BUSY_STAT_COUNTER_REG));
-	printf("Issue operands were not ready: %u \n", *(ISSUE_OPERANDS_NOT_READY_STAT_COUNTER_REG));
-	printf("Issue hold: %u \n", *(ISSUE_HOLD_STAT_COUNTER_REG));
-	printf("Issue multi source: %u \n", *(ISSUE_MULTI_SOURCE_STATS));
-}
\ No newline at end of file
+	printf("No instructions: %llu \n", read_counter(ISSUE_NO_INSTRUCTION_STAT_COUNTER_REG));
+	printf("No ID's remaining: %llu \n", read_counter(ISSUE_NO_ID_STAT_COUNTER_REG));
+	printf("Flush occurred: %llu \n", read_counter(ISSUE_FLUSH_STAT_COUNTER_REG));
+	printf("Issue unit was busy: %llu \n", read_counter(ISSUE_UNIT_BUSY_STAT_COUNTER_REG));
+	printf("Issue operands were not ready: %llu \n", read_counter(ISSUE_OPERANDS_NOT_READY_STAT_COUNTER_REG));
+	printf("Issue hold: %llu \n", read_counter(ISSUE_HOLD_STAT_COUNTER_REG));
+	printf("Issue multi source: %llu \n", read_counter(ISSUE_MULTI_SOURCE_STATS));
+
+	cpi_stack();
+}
+
+// Top-down CPI stack, printed in thousandths as printf may be built without floating point support.
+// Issue cycles add 1 to the CPI and each stall category adds its cycles per instruction.
+static void cpi_stack(void) {
+	unsigned long long cycles = read_counter(CYCLE_COUNTER_REG);
+	unsigned long long instructions = read_counter(INSTRUCTION_COUNTER_REG);
+	unsigned long long stalls;
+	int i;
+
+	printf("\nCycles: %llu \n", cycles);
+	printf("Instructions issued: %llu \n", instructions);
+	if (instructions == 0) {
+		return;
+	}
+
+	printf("CPI: %llu.%03llu \n", cycles / instructions, (cycles * 1000 / instructions) % 1000);
+	printf("  Issue: 1.000 (%llu%% of cycles) \n", instructions * 100 / cycles);
+	for (i = 0; i < CPI_STALLS; i++) {
+		stalls = read_counter(&CPI_STALL_COUNTER_REGS[i]);
+		printf("  %s: %llu.%03llu (%llu%% of cycles) \n", cpi_stall_names[i], stalls / instructions,
+		       (stalls * 1000 / instructions) % 1000, stalls * 100 / cycles);
+	}
+}
+
+// Stall counters whose bit is set count the cycles their stall lasts, instead of one per stall
+void set_stall_level_mode(unsigned int mask) {
+	*(STALL_UNIT_LEVEL_MODE) = mask;
+}
+
+// Sample the PC of the issuing instruction every period cycles
+int enable_pc_sampling(unsigned int period) {
+	*(PC_SAMPLE_PERIOD_REG) = period;
+	*(PC_SAMPLER_ENABLE) = (unsigned int) 0x1;
+	return (*(PC_SAMPLER_ENABLE) == 0x1);
+}
+
+int disable_pc_sampling(void) {
+	*(PC_SAMPLER_ENABLE) = (unsigned int) 0x0;
+	return (*(PC_SAMPLER_ENABLE) == 0x0);
+}
+
+// Drains the sample FIFO, one hex PC per line, in the format read by SW/linux/abacus_pcprof report
+void pc_samples(void) {
+	unsigned int count = *(PC_SAMPLE_COUNT_REG);
+
+	while (count--) {
+		printf("%08x\n", *(PC_SAMPLE_DATA_REG));
+	}
+	printf("Dropped samples: %u \n", *(PC_SAMPLE_DROPPED_REG));
+}
+
+// Only count between ABACUS_ROI_START() and ABACUS_ROI_STOP()
+void roi_markers(void) {
+	*(TRIGGER_CONTROL_REG) = (unsigned int) 0x2;
+}
+
+// Only count from an instruction in the start range up to one in the stop range, both inclusive
+void roi_pc(unsigned int start_low, unsigned int start_high, unsigned int stop_low, unsigned int stop_high) {
+	*(TRIGGER_START_PC_LOW_REG) = start_low;
+	*(TRIGGER_START_PC_HIGH_REG) = start_high;
+	*(TRIGGER_STOP_PC_LOW_REG) = stop_low;
+	*(TRIGGER_STOP_PC_HIGH_REG) = stop_high;
+	*(TRIGGER_CONTROL_REG) = (unsigned int) 0x1; // Written last, a control write restarts the trigger
+}
+
+void roi_off(void) {
+	*(TRIGGER_CONTROL_REG) = (unsigned int) 0x0;
+}
+
+void roi_status(void) {
+	unsigned int control = *(TRIGGER_CONTROL_REG);
+
+	printf("PC range trigger: %s \n", (control & 0x1) ? "on" : "off");
+	printf("Marker trigger: %s \n", (control & 0x2) ? "on" : "off");
+	printf("Start PC range: 0x%08x-0x%08x \n", *(TRIGGER_START_PC_LOW_REG), *(TRIGGER_START_PC_HIGH_REG));
+	printf("Stop PC range: 0x%08x-0x%08x \n", *(TRIGGER_STOP_PC_LOW_REG), *(TRIGGER_STOP_PC_HIGH_REG));
+	printf("Inside region: %s \n", (*(TRIGGER_STATUS_REG) & 0x1) ? "yes" : "no");
+	printf("Regions entered: %u \n", *(TRIGGER_REGION_COUNT_REG));
+}
+
+// Point a programmable counter at an event and restart it from zero, event NUM_EVENTS or above stops it
+int select_event(unsigned int counter, unsigned int event, int edge) {
+	if (counter >= *(EVENT_NUM_COUNTERS_REG)) {
+		return 0;
+	}
+	EVENT_SELECT_REGS[counter] = (event < NUM_EVENTS) ? (event | (edge ? EVENT_SELECT_EDGE : 0) | EVENT_SELECT_ENABLE) : 0;
+	return 1;
+}
+
+void event_counters(void) {
+	unsigned int count = *(EVENT_NUM_COUNTERS_REG);
+	unsigned int select;
+	unsigned int i;
+
+	abacus_snapshot();
+	for (i = 0; i < count; i++) {
+		select = EVENT_SELECT_REGS[i];
+		if (!(select & EVENT_SELECT_ENABLE) || (select & 0xff) >= NUM_EVENTS) {
+			printf("Counter %u: off\n", i);
+			continue;
+		}
+		printf("Counter %u, %s %s: %llu\n", i, event_names[select & 0xff], (select & EVENT_SELECT_EDGE) ? "edges" : "cycles",
+		       read_counter(&EVENT_COUNTER_REGS[i]));
+	}
+}
+
+int enable_branch_hotlist(void) {
+	*(BRANCH_HOTLIST_ENABLE) = (unsigned int) 0x1;
+	return (*(BRANCH_HOTLIST_ENABLE) == 0x1);
+}
+
+// Disabling also empties the table
+int disable_branch_hotlist(void) {
+	*(BRANCH_HOTLIST_ENABLE) = (unsigned int) 0x0;
+	return (*(BRANCH_HOTLIST_ENABLE) == 0x0);
+}
+
+// Prints the hot list, most mispredicted branch first. Mispredictions are an upper bound, the
+// guaranteed count subtracts the error inherited when the branch took its entry.
+void branch_hotlist(void) {
+	unsigned int entries = *(BRANCH_HOTLIST_ENTRIES_REG);
+	unsigned int table[BRANCH_HOTLIST_MAX_ENTRIES][4];
+	unsigned int order[BRANCH_HOTLIST_MAX_ENTRIES];
+	unsigned int mispredicts, branches;
+	unsigned int i, j, k;
+
+	if (entries == 0 || entries > BRANCH_HOTLIST_MAX_ENTRIES) {
+		printf("No branch hot list in this build\n");
+		return;
+	}
+
+	*(SNAPSHOT_REG) = (unsigned int) 0x3; // Hold the table still while it is copied
+	mispredicts = *(BRANCH_HOTLIST_MISPREDICTS_REG);
+	branches = *(BRANCH_HOTLIST_BRANCHES_REG);
+	for (i = 0; i < entries; i++) {
+		for (j = 0; j < 4; j++) {
+			table[i][j] = BRANCH_HOTLIST_ENTRY_REGS[4 * i + j];
+		}
+	}
+	*(SNAPSHOT_REG) = (unsigned int) 0x0;
+
+	// Insertion sort on the mispredictions, the table is at most 15 entries
+	for (i = 0; i < entries; i++) {
+		k = i;
+		while (k > 0 && table[order[k - 1]][1] < table[i][1]) {
+			order[k] = order[k - 1];
+			k--;
+		}
+		order[k] = i;
+	}
+
+	printf("Branches: %u, mispredicted: %u\n", branches, mispredicts);
+	printf("%-10s %12s %12s %12s %8s\n", "PC", "Mispredicts", "Guaranteed", "Executions", "Share");
+	for (i = 0; i < entries; i++) {
+		k = order[i];
+		if (table[k][1] == 0) {
+			break; // Empty entries sort last
+		}
+		printf("%08x   %12u %12u %12u %7u%%\n", table[k][0], table[k][1], table[k][1] - table[k][3], table[k][2],
+		       mispredicts ? (unsigned int)(100ULL * table[k][1] / mispredicts) : 0);
+	}
+}
+
+// Counts misses from low to high per granule of 1 << granule_shift bytes. The sketch restarts empty,
+// so it never mixes granules of two sizes, and is swept clear for a few thousand cycles before it counts.
+int enable_miss_sketch(unsigned int granule_shift, unsigned int low, unsigned int high) {
+	*(MISS_SKETCH_ENABLE) = (unsigned int) 0x0;
+	*(MISS_SKETCH_GRANULE_SHIFT_REG) = granule_shift;
+	*(MISS_SKETCH_FILTER_LOW_REG) = low;
+	*(MISS_SKETCH_FILTER_HIGH_REG) = high;
+	clear_units(UNIT_CLEAR_MS);
+	*(MISS_SKETCH_ENABLE) = (unsigned int) 0x1;
+	return (*(MISS_SKETCH_ENABLE) == 0x1);
+}
+
+int disable_miss_sketch(void) {
+	*(MISS_SKETCH_ENABLE) = (unsigned int) 0x0;
+	return (*(MISS_SKETCH_ENABLE) == 0x0);
+}
+
+// Prints the top-K table of the miss sketch, most missed granule first
+void miss_hotspots(void) {
+	unsigned int entries = *(MISS_SKETCH_TOPK_ENTRIES_REG);
+	unsigned int table[MISS_SKETCH_MAX_ENTRIES][2];
+	unsigned int order[MISS_SKETCH_MAX_ENTRIES];
+	unsigned int total;
+	unsigned int i, j, k;
+
+	if (*(MISS_SKETCH_WIDTH_REG) == 0 || entries == 0 || entries > MISS_SKETCH_MAX_ENTRIES) {
+		printf("No miss sketch in this build\n");
+		return;
+	}
+
+	*(SNAPSHOT_REG) = (unsigned int) 0x3; // Hold the table still while it is copied
+	total = *(MISS_SKETCH_TOTAL_REG);
+	for (i = 0; i < entries; i++) {
+		for (j = 0; j < 2; j++) {
+			table[i][j] = MISS_SKETCH_TOPK_REGS[2 * i + j];
+		}
+	}
+	*(SNAPSHOT_REG) = (unsigned int) 0x0;
+
+	for (i = 0; i < entries; i++) {
+		k = i;
+		while (k > 0 && table[order[k - 1]][1] < table[i][1]) {
+			order[k] = order[k - 1];
+			k--;
+		}
+		order[k] = i;
+	}
+
+	printf("DCache misses from %08x to %08x: %u\n", *(MISS_SKETCH_FILTER_LOW_REG), *(MISS_SKETCH_FILTER_HIGH_REG), total);
+	printf("%-10s %12s %8s\n", "Address", "Misses", "Share");
+	for (i = 0; i < entries; i++) {
+		k = order[i];
+		if (table[k][1] == 0) {
+			break;
+		}
+		printf("%08x   %12u %7u%%\n", table[k][0], table[k][1], total ? (unsigned int)(100ULL * table[k][1] / total) : 0);
+	}
+}
+
+int enable_bus_profiling(void) {
+	*(BUS_PROFILER_ENABLE) = (unsigned int) 0x1;
+	return (*(BUS_PROFILER_ENABLE) == 0x1);
+}
+
+int disable_bus_profiling(void) {
+	*(BUS_PROFILER_ENABLE) = (unsigned int) 0x0;
+	return (*(BUS_PROFILER_ENABLE) == 0x0);
+}
+
+// With one request outstanding at most, the occupied share of the cycles is how close the bus is to
+// saturation. Requests that mostly wait on a bus that is not full point at latency, not bandwidth.
+void bus_profile(void) {
+	unsigned long long cycles, reads, read_bytes, writes, write_bytes, busy, occupancy, wait, latency, data_cycles;
+	unsigned int min, max;
+
+	*(SNAPSHOT_REG) = (unsigned int) 0x3; // Hold the counters still while they are read
+	cycles = read_counter(BUS_CYCLE_COUNTER_REG);
+	reads = read_counter(BUS_READ_COUNTER_REG);
+	read_bytes = read_counter(BUS_READ_BYTES_COUNTER_REG);
+	writes = read_counter(BUS_WRITE_COUNTER_REG);
+	write_bytes = read_counter(BUS_WRITE_BYTES_COUNTER_REG);
+	busy = read_counter(BUS_BUSY_COUNTER_REG);
+	occupancy = read_counter(BUS_OCCUPANCY_COUNTER_REG);
+	wait = read_counter(BUS_WAIT_COUNTER_REG);
+	latency = read_counter(BUS_LATENCY_COUNTER_REG);
+	min = *(BUS_LATENCY_MIN_REG);
+	max = *(BUS_LATENCY_MAX_REG);
+	if (cycles == 0) {
+		*(SNAPSHOT_REG) = (unsigned int) 0x0;
+		printf("The bus profiler has not counted any cycle\n");
+		return;
+	}
+	data_cycles = occupancy - wait;
+
+	printf("Bus cycles: %llu\n", cycles);
+	printf("Bus reads: %llu (%llu bytes)\n", reads, read_bytes);
+	printf("Bus writes: %llu (%llu bytes)\n", writes, write_bytes);
+	printf("Bus busy cycles: %llu\n", busy);
+	printf("Bus occupancy: %llu%% of cycles with a request outstanding\n", occupancy * 100 / cycles);
+	printf("Bus data cycles: %llu (%llu%%)\n", data_cycles, data_cycles * 100 / cycles);
+	printf("Bus wait states: %llu\n", wait);
+	latency_summary("bus transaction", BUS_LATENCY_HISTOGRAM_REGS, latency, min, max);
+	*(SNAPSHOT_REG) = (unsigned int) 0x0;
+
+	if (occupancy * 10 >= cycles * 8) {
+		printf("The bus is near saturation, the program is bandwidth-bound\n");
+	} else if (wait * 2 > occupancy) {
+		printf("The bus mostly waits on memory, the program is latency-bound\n");
+	} else {
+		printf("The bus has headroom, memory traffic is not the bottleneck\n");
+	}
+}
+
+// Alarm n crosses when a window of window counted cycles has more than threshold of the event, and
+// freezes the snapshot of the crossing until rate_alarms() clears it. An event out of range stops it.
+int set_rate_alarm(unsigned int alarm, unsigned int event, unsigned int window, unsigned int threshold) {
+	if (alarm >= *(RATE_ALARM_COUNT_REG)) {
+		return 0;
+	}
+	RATE_ALARM_REGS[4 * alarm + 1] = window;
+	RATE_ALARM_REGS[4 * alarm + 2] = threshold;
+	RATE_ALARM_REGS[4 * alarm] = (event < NUM_EVENTS) ? (event | RATE_ALARM_SELECT_FREEZE | EVENT_SELECT_ENABLE) : 0;
+	return 1;
+}
+
+// Polls the alarms. The counters of a crossing are still in the frozen snapshot, so they are read
+// without taking a new one, then clearing the status releases the freeze.
+void rate_alarms(void) {
+	unsigned int count = *(RATE_ALARM_COUNT_REG);
+	unsigned int status = *(RATE_ALARM_STATUS_REG);
+	unsigned int select;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		select = RATE_ALARM_REGS[4 * i];
+		if (!(select & EVENT_SELECT_ENABLE) || (select & 0xff) >= NUM_EVENTS) {
+			printf("Alarm %u: off\n", i);
+			continue;
+		}
+		printf("Alarm %u, more than %u %s per %u cycles: last window %u%s\n", i, RATE_ALARM_REGS[4 * i + 2],
+		       event_names[select & 0xff], RATE_ALARM_REGS[4 * i + 1], RATE_ALARM_REGS[4 * i + 3],
+		       (status & (1U << i)) ? ", crossed" : "");
+	}
+	if (!status) {
+		return;
+	}
+
+	printf("First crossing at cycle %llu, PC 0x%08x\n", read_counter(RATE_ALARM_TIMESTAMP_REG), *(RATE_ALARM_PC_REG));
+	printf("Cycles: %llu, instructions: %llu, dcache misses: %llu\n", read_counter(CYCLE_COUNTER_REG),
+	       read_counter(INSTRUCTION_COUNTER_REG), read_counter(DCACHE_MISS_COUNTER_REG));
+	*(RATE_ALARM_STATUS_REG) = status;
+}
+
+// The units of the mask only count in the modes given, bit 0 user, 1 supervisor and 3 machine, and in
+// address space asid unless it is negative. This program runs in machine mode, so 0x8 leaves out any
+// user mode code it calls.
+void set_unit_filter(unsigned int mask, unsigned int modes, int asid) {
+	unsigned int filter = (modes & FILTER_MODES) | ((asid >= 0) ? (FILTER_ASID_MATCH | ((unsigned int)(asid & 0x1ff) << 16)) : 0);
+	unsigned int i;
+
+	for (i = 0; i < UNIT_FILTERS; i++) {
+		if (mask & (1U << i)) {
+			UNIT_FILTER_REGS[i] = filter;
+		}
+	}
+}
+
+void unit_filters(void) {
+	static const char* names[UNIT_FILTERS] = { "ip", "cp", "su", "pcs", "bh", "ms", "bus", "events" };
+	unsigned int filter;
+	unsigned int i;
+
+	for (i = 0; i < UNIT_FILTERS; i++) {
+		filter = UNIT_FILTER_REGS[i];
+		printf("%-7s %s%s%s", names[i], (filter & 0x1) ? "user " : "", (filter & 0x2) ? "supervisor " : "",
+		       (filter & 0x8) ? "machine " : "");
+		if (filter & FILTER_ASID_MATCH) {
+			printf("asid %u", (filter >> 16) & 0x1ff);
+		}
+		printf("\n");
+	}
+	printf("Running in mode %u, ASID %u\n", *(CORE_MODE_REG) & 0x3, (*(CORE_MODE_REG) >> 16) & 0x1ff);
+}
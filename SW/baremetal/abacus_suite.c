@@ -0,0 +1,440 @@
+#include <stdio.h>
+
+// Accuracy and overhead suite. Each kernel is a hand written loop between the region-of-interest
+// markers, so the counters see exactly its instructions and the expected counts follow from the
+// code: the instruction classes, branches and issued instructions are exact, the mispredictions,
+// misses and bus traffic depend on the predictor and cache geometry and are checked against bounds.
+// Every check prints one PASS or FAIL line and the last line is "ABACUS SUITE PASS" or
+// "ABACUS SUITE FAIL", for a script watching the console of the simulation.
+
+int abacus_suite(void);
+
+extern unsigned long long read_counter(volatile unsigned int* counter_reg);
+extern void abacus_snapshot(void);
+
+extern volatile unsigned int* INSTRUCTION_PROFILE_UNIT_ENABLE;
+extern volatile unsigned int* CACHE_PROFILE_UNIT_ENABLE;
+extern volatile unsigned int* STALL_UNIT_ENABLE;
+extern volatile unsigned int* BUS_PROFILER_ENABLE;
+extern volatile unsigned int* UNIT_CLEAR_REG;
+extern volatile unsigned int* UNIT_FILTER_REGS;
+extern volatile unsigned int* SNAPSHOT_REG;
+extern volatile unsigned int* STALL_UNIT_LEVEL_MODE;
+extern volatile unsigned int* TRIGGER_CONTROL_REG;
+extern volatile unsigned int* INSTRUCTION_CLASS_COUNTER_REGS;
+extern volatile unsigned int* DCACHE_REQUEST_COUNTER_REG;
+extern volatile unsigned int* DCACHE_MISS_COUNTER_REG;
+extern volatile unsigned int* BRANCH_MISPREDICTION_COUNTER_REG;
+extern volatile unsigned int* CYCLE_COUNTER_REG;
+extern volatile unsigned int* INSTRUCTION_COUNTER_REG;
+extern volatile unsigned int* CPI_STALL_COUNTER_REGS;
+extern volatile unsigned int* BUS_READ_COUNTER_REG;
+extern volatile unsigned int* BUS_READ_BYTES_COUNTER_REG;
+extern volatile unsigned int* BUS_WRITE_BYTES_COUNTER_REG;
+
+// The buffers must be at least twice the data cache so a pass over them misses, and each chase node
+// sits on a line of its own as long as the cache lines are at most SUITE_LINE_BYTES
+#ifndef SUITE_BUFFER_BYTES
+#define SUITE_BUFFER_BYTES (32 * 1024)
+#endif
+#define SUITE_LINE_BYTES 64
+#define SUITE_CHASE_NODES (SUITE_BUFFER_BYTES / SUITE_LINE_BYTES)
+#define SUITE_CHASE_STRIDE 17 // Odd, so the chain visits every node of the power of two sized buffer
+#define SUITE_COPY_WORDS (SUITE_BUFFER_BYTES / 4)
+#define SUITE_ITERATIONS 1000
+#define SUITE_LFSR_TAPS 0x80200003 // Maximal length Galois LFSR
+#define SUITE_REPEATS 8            // Each read path is timed this many times and the fastest kept
+
+// Indices into INSTRUCTION_CLASS_COUNTER_REGS, see INSTRUCTION_CLASS_NAMES in abacus.c
+#define CLASS_LOAD 0
+#define CLASS_STORE 1
+#define CLASS_ADDITION 2
+#define CLASS_BRANCH 4
+#define CLASS_ATOMIC 7
+#define CLASS_LOGICAL 8
+#define CLASS_SHIFT 9
+#define CLASS_MULTIPLY 12
+#define CLASS_DIVIDE 13
+#define CLASS_TOTAL 22
+#define NUM_CLASSES 23
+#define NUM_CPI_STALLS 6
+
+struct suite_counts {
+	unsigned long long classes[NUM_CLASSES];
+	unsigned long long cycles;
+	unsigned long long issued;
+	unsigned long long cpi_stalls;
+	unsigned long long mispredictions;
+	unsigned long long dcache_requests;
+	unsigned long long dcache_misses;
+	unsigned long long bus_reads;
+	unsigned long long bus_read_bytes;
+	unsigned long long bus_write_bytes;
+};
+
+static unsigned int chase_buffer[SUITE_BUFFER_BYTES / 4] __attribute__((aligned(SUITE_LINE_BYTES)));
+static unsigned int copy_buffer[SUITE_BUFFER_BYTES / 4] __attribute__((aligned(SUITE_LINE_BYTES)));
+static volatile unsigned int atomic_word;
+static volatile unsigned long long sink;
+
+static unsigned int checks;
+static unsigned int failures;
+
+static void check(const char* kernel, const char* what, unsigned long long value, unsigned long long min,
+                  unsigned long long max) {
+	int pass = value >= min && value <= max;
+
+	checks++;
+	failures += !pass;
+	printf("%-8s %-22s %10llu in [%llu, %llu] %s\n", kernel, what, value, min, max, pass ? "PASS" : "FAIL");
+}
+
+// Unit Clear bits of the instruction and cache profile units, the stall unit and the bus profiler
+#define SUITE_UNITS 0x47
+
+// Every kernel starts from zero, the units are cleared on the same edge
+static void restart_units(void) {
+	*(UNIT_CLEAR_REG) = SUITE_UNITS;
+	*(INSTRUCTION_PROFILE_UNIT_ENABLE) = 0x1;
+	*(CACHE_PROFILE_UNIT_ENABLE) = 0x1;
+	*(STALL_UNIT_ENABLE) = 0x1;
+	*(BUS_PROFILER_ENABLE) = 0x1;
+}
+
+// The counters are frozen outside the region, so one snapshot after the kernel holds all of it
+static void read_counts(struct suite_counts* counts) {
+	int i;
+
+	abacus_snapshot();
+	for (i = 0; i < NUM_CLASSES; i++) {
+		counts->classes[i] = read_counter(INSTRUCTION_CLASS_COUNTER_REGS + i);
+	}
+	counts->cycles = read_counter(CYCLE_COUNTER_REG);
+	counts->issued = read_counter(INSTRUCTION_COUNTER_REG);
+	counts->cpi_stalls = 0;
+	for (i = 0; i < NUM_CPI_STALLS; i++) {
+		counts->cpi_stalls += read_counter(CPI_STALL_COUNTER_REGS + i);
+	}
+	counts->mispredictions = read_counter(BRANCH_MISPREDICTION_COUNTER_REG);
+	counts->dcache_requests = read_counter(DCACHE_REQUEST_COUNTER_REG);
+	counts->dcache_misses = read_counter(DCACHE_MISS_COUNTER_REG);
+	counts->bus_reads = read_counter(BUS_READ_COUNTER_REG);
+	counts->bus_read_bytes = read_counter(BUS_READ_BYTES_COUNTER_REG);
+	counts->bus_write_bytes = read_counter(BUS_WRITE_BYTES_COUNTER_REG);
+}
+
+// Checks that hold for any kernel: the units agree on the issued instructions, the classes add up
+// to the total and the CPI stack accounts for every cycle
+static void check_consistency(const char* kernel, const struct suite_counts* counts, unsigned long long instructions) {
+	unsigned long long sum = 0;
+	int i;
+
+	for (i = 0; i < CLASS_TOTAL; i++) {
+		sum += counts->classes[i];
+	}
+	check(kernel, "instructions", counts->classes[CLASS_TOTAL], instructions, instructions);
+	check(kernel, "stall unit issued", counts->issued, instructions, instructions);
+	check(kernel, "class sum", sum, instructions, instructions);
+	check(kernel, "CPI stack cycles", counts->issued + counts->cpi_stalls, counts->cycles, counts->cycles);
+	printf("%-8s %llu cycles, CPI %llu.%03llu\n", kernel, counts->cycles, counts->cycles / instructions,
+	       (counts->cycles * 1000 / instructions) % 1000);
+}
+
+// Dependent loads over a chain that visits every line of the buffer once: 3 instructions per node,
+// a load, an addition and a branch, and a miss per node once the previous pass has been evicted
+static void pointer_chase(void) {
+	struct suite_counts counts;
+	unsigned int* node = chase_buffer;
+	unsigned int nodes = SUITE_CHASE_NODES;
+	unsigned int i;
+
+	for (i = 0; i < SUITE_CHASE_NODES; i++) {
+		chase_buffer[i * (SUITE_LINE_BYTES / 4)] =
+			(unsigned long)&chase_buffer[((i + SUITE_CHASE_STRIDE) % SUITE_CHASE_NODES) * (SUITE_LINE_BYTES / 4)];
+	}
+	for (i = 0; i < SUITE_COPY_WORDS; i++) {
+		sink = copy_buffer[i]; // Evicts the chain written above
+	}
+
+	restart_units();
+	__asm__ __volatile__(
+		"slti x0, x0, 1\n"        // ABACUS_ROI_START
+		"1: lw %0, 0(%0)\n"
+		"addi %1, %1, -1\n"
+		"bnez %1, 1b\n"
+		"slti x0, x0, 2\n"        // ABACUS_ROI_STOP
+		: "+r"(node), "+r"(nodes) : : "memory");
+	read_counts(&counts);
+
+	check_consistency("chase", &counts, 3ULL * SUITE_CHASE_NODES);
+	check("chase", "loads", counts.classes[CLASS_LOAD], SUITE_CHASE_NODES, SUITE_CHASE_NODES);
+	check("chase", "additions", counts.classes[CLASS_ADDITION], SUITE_CHASE_NODES, SUITE_CHASE_NODES);
+	check("chase", "branches", counts.classes[CLASS_BRANCH], SUITE_CHASE_NODES, SUITE_CHASE_NODES);
+	check("chase", "mispredictions", counts.mispredictions, 0, 4);
+	check("chase", "dcache requests", counts.dcache_requests, SUITE_CHASE_NODES / 2, SUITE_CHASE_NODES);
+	check("chase", "dcache misses", counts.dcache_misses, SUITE_CHASE_NODES / 2, SUITE_CHASE_NODES);
+	check("chase", "bus reads", counts.bus_reads, counts.dcache_misses, SUITE_CHASE_NODES + 16);
+	check("chase", "end of chain", node == chase_buffer, 1, 1);
+}
+
+// Word copy of a whole buffer: 6 instructions per word, a load, a store, three additions and a
+// branch, and at least half of the source read from memory since it is twice the cache
+static void streaming_copy(void) {
+	struct suite_counts counts;
+	unsigned int* source = chase_buffer;
+	unsigned int* destination = copy_buffer;
+	unsigned int words = SUITE_COPY_WORDS;
+	unsigned int i, mismatches = 0;
+
+	for (i = 0; i < SUITE_COPY_WORDS; i++) {
+		chase_buffer[i] = i * 0x9e3779b1;
+	}
+
+	restart_units();
+	__asm__ __volatile__(
+		"slti x0, x0, 1\n"
+		"1: lw t0, 0(%0)\n"
+		"sw t0, 0(%1)\n"
+		"addi %0, %0, 4\n"
+		"addi %1, %1, 4\n"
+		"addi %2, %2, -1\n"
+		"bnez %2, 1b\n"
+		"slti x0, x0, 2\n"
+		: "+r"(source), "+r"(destination), "+r"(words) : : "t0", "memory");
+	read_counts(&counts);
+
+	for (i = 0; i < SUITE_COPY_WORDS; i++) {
+		mismatches += copy_buffer[i] != i * 0x9e3779b1;
+	}
+
+	check_consistency("copy", &counts, 6ULL * SUITE_COPY_WORDS);
+	check("copy", "loads", counts.classes[CLASS_LOAD], SUITE_COPY_WORDS, SUITE_COPY_WORDS);
+	check("copy", "stores", counts.classes[CLASS_STORE], SUITE_COPY_WORDS, SUITE_COPY_WORDS);
+	check("copy", "additions", counts.classes[CLASS_ADDITION], 3ULL * SUITE_COPY_WORDS, 3ULL * SUITE_COPY_WORDS);
+	check("copy", "branches", counts.classes[CLASS_BRANCH], SUITE_COPY_WORDS, SUITE_COPY_WORDS);
+	check("copy", "mispredictions", counts.mispredictions, 0, 4);
+	check("copy", "bus read bytes", counts.bus_read_bytes, SUITE_BUFFER_BYTES / 2, 2ULL * SUITE_BUFFER_BYTES);
+	check("copy", "bus write bytes", counts.bus_write_bytes, 0, 2ULL * SUITE_BUFFER_BYTES);
+	check("copy", "mismatched words", mismatches, 0, 0);
+}
+
+// A branch on each bit of a maximal LFSR, which no predictor learns from the recent outcomes.
+// The taken path skips the feedback xor, so the exact counts come from running the LFSR here too.
+static void branch_heavy(void) {
+	struct suite_counts counts;
+	unsigned int lfsr = 0xace1, expected = 0xace1;
+	unsigned int iterations = SUITE_ITERATIONS;
+	unsigned int ones = 0;
+	unsigned int i;
+
+	for (i = 0; i < SUITE_ITERATIONS; i++) {
+		if (expected & 1) {
+			expected = (expected >> 1) ^ SUITE_LFSR_TAPS;
+			ones++;
+		} else {
+			expected >>= 1;
+		}
+	}
+
+	restart_units();
+	__asm__ __volatile__(
+		"slti x0, x0, 1\n"
+		"1: andi t0, %0, 1\n"
+		"srli %0, %0, 1\n"
+		"beqz t0, 2f\n"
+		"xor %0, %0, %2\n"
+		"2: addi %1, %1, -1\n"
+		"bnez %1, 1b\n"
+		"slti x0, x0, 2\n"
+		: "+r"(lfsr), "+r"(iterations) : "r"(SUITE_LFSR_TAPS) : "t0");
+	read_counts(&counts);
+
+	check_consistency("branch", &counts, 5ULL * SUITE_ITERATIONS + ones);
+	check("branch", "branches", counts.classes[CLASS_BRANCH], 2 * SUITE_ITERATIONS, 2 * SUITE_ITERATIONS);
+	check("branch", "logical", counts.classes[CLASS_LOGICAL], SUITE_ITERATIONS + ones, SUITE_ITERATIONS + ones);
+	check("branch", "shifts", counts.classes[CLASS_SHIFT], SUITE_ITERATIONS, SUITE_ITERATIONS);
+	check("branch", "additions", counts.classes[CLASS_ADDITION], SUITE_ITERATIONS, SUITE_ITERATIONS);
+	check("branch", "mispredictions", counts.mispredictions, SUITE_ITERATIONS / 8, SUITE_ITERATIONS + 4);
+	check("branch", "final LFSR", lfsr == expected, 1, 1);
+}
+
+// Two multiplies and two divides per iteration. The divider takes several cycles per divide, so
+// the CPI stack holds at least one stall cycle for each.
+static void muldiv_heavy(void) {
+	struct suite_counts counts;
+	unsigned int x = 1;
+	unsigned int iterations = SUITE_ITERATIONS;
+
+	restart_units();
+	__asm__ __volatile__(
+		"slti x0, x0, 1\n"
+		"1: mul %0, %0, %2\n"
+		"mulhu t0, %0, %2\n"
+		"divu t1, %0, %3\n"
+		"remu t2, t0, %3\n"
+		"addi %1, %1, -1\n"
+		"bnez %1, 1b\n"
+		"slti x0, x0, 2\n"
+		: "+r"(x), "+r"(iterations) : "r"(0x9e3779b1), "r"(7) : "t0", "t1", "t2");
+	read_counts(&counts);
+
+	check_consistency("muldiv", &counts, 6ULL * SUITE_ITERATIONS);
+	check("muldiv", "multiplies", counts.classes[CLASS_MULTIPLY], 2 * SUITE_ITERATIONS, 2 * SUITE_ITERATIONS);
+	check("muldiv", "divides", counts.classes[CLASS_DIVIDE], 2 * SUITE_ITERATIONS, 2 * SUITE_ITERATIONS);
+	check("muldiv", "branches", counts.classes[CLASS_BRANCH], SUITE_ITERATIONS, SUITE_ITERATIONS);
+	check("muldiv", "stall cycles", counts.cpi_stalls, 2 * SUITE_ITERATIONS, counts.cycles);
+}
+
+// An AMO and an LR/SC pair on one word per iteration. The SC writes back what the LR read, so the
+// word ends up holding the number of iterations whether or not each SC succeeds.
+static void atomic_heavy(void) {
+#ifdef __riscv_atomic
+	struct suite_counts counts;
+	unsigned int iterations = SUITE_ITERATIONS;
+
+	atomic_word = 0;
+	restart_units();
+	__asm__ __volatile__(
+		"slti x0, x0, 1\n"
+		"1: amoadd.w zero, %1, (%2)\n"
+		"lr.w t0, (%2)\n"
+		"sc.w t1, t0, (%2)\n"
+		"addi %0, %0, -1\n"
+		"bnez %0, 1b\n"
+		"slti x0, x0, 2\n"
+		: "+r"(iterations) : "r"(1), "r"(&atomic_word) : "t0", "t1", "memory");
+	read_counts(&counts);
+
+	check_consistency("atomic", &counts, 5ULL * SUITE_ITERATIONS);
+	check("atomic", "atomics", counts.classes[CLASS_ATOMIC], 3 * SUITE_ITERATIONS, 3 * SUITE_ITERATIONS);
+	check("atomic", "branches", counts.classes[CLASS_BRANCH], SUITE_ITERATIONS, SUITE_ITERATIONS);
+	check("atomic", "final value", atomic_word, SUITE_ITERATIONS, SUITE_ITERATIONS);
+#else
+	printf("atomic   skipped, the firmware is built without the A extension\n");
+#endif
+}
+
+static void read_nothing(void) {
+}
+
+static void read_one_counter(void) {
+	sink = read_counter(INSTRUCTION_CLASS_COUNTER_REGS);
+}
+
+static void read_one_register(void) {
+	sink = *(DCACHE_MISS_COUNTER_REG);
+}
+
+static void hold_and_release(void) {
+	*(SNAPSHOT_REG) = 0x3;
+	*(SNAPSHOT_REG) = 0x0;
+}
+
+static void read_instruction_classes(void) {
+	int i;
+
+	for (i = 0; i < NUM_CLASSES; i++) {
+		sink = read_counter(INSTRUCTION_CLASS_COUNTER_REGS + i);
+	}
+}
+
+static void read_stall_unit(void) {
+	int i;
+
+	for (i = 0; i < 11 + NUM_CPI_STALLS; i++) {
+		sink = read_counter(BRANCH_MISPREDICTION_COUNTER_REG + i);
+	}
+}
+
+static const struct {
+	const char* name;
+	void (*read)(void);
+} read_paths[] = {
+	{ "abacus_snapshot()", abacus_snapshot },
+	{ "read_counter()", read_one_counter },
+	{ "32-bit register read", read_one_register },
+	{ "snapshot hold and release", hold_and_release },
+	{ "every instruction class counter", read_instruction_classes },
+	{ "every stall unit counter", read_stall_unit },
+};
+
+// Fewest cycles of SUITE_REPEATS calls, timed by the stall unit itself between the markers
+static unsigned long long time_read_path(void (*read)(void), unsigned long long* instructions) {
+	unsigned long long best = ~0ULL, cycles;
+	int repeat;
+
+	for (repeat = 0; repeat < SUITE_REPEATS; repeat++) {
+		restart_units();
+		__asm__ __volatile__("slti x0, x0, 1" ::: "memory");
+		read();
+		__asm__ __volatile__("slti x0, x0, 2" ::: "memory");
+		abacus_snapshot();
+		cycles = read_counter(CYCLE_COUNTER_REG);
+		if (cycles < best) {
+			best = cycles;
+			*instructions = read_counter(INSTRUCTION_COUNTER_REG);
+		}
+	}
+	return best;
+}
+
+// The call of an empty function is the baseline, so each cost is that of the read path alone
+static void read_path_costs(void) {
+	unsigned long long baseline, baseline_instructions, cycles, instructions;
+	unsigned int i;
+
+	baseline = time_read_path(read_nothing, &baseline_instructions);
+	printf("\nCost of the abacus.c read paths, beyond a call of %llu cycles:\n", baseline);
+	for (i = 0; i < sizeof(read_paths) / sizeof(read_paths[0]); i++) {
+		cycles = time_read_path(read_paths[i].read, &instructions);
+		printf("%-34s %6llu cycles %6llu instructions\n", read_paths[i].name, cycles > baseline ? cycles - baseline : 0,
+		       instructions > baseline_instructions ? instructions - baseline_instructions : 0);
+	}
+}
+
+// Runs every kernel and read path, returns the number of failed checks. The units are left
+// enabled, filtered and counting as they were, but their counters are cleared.
+int abacus_suite(void) {
+	unsigned int filters[8];
+	unsigned int ip_enable = *(INSTRUCTION_PROFILE_UNIT_ENABLE);
+	unsigned int cp_enable = *(CACHE_PROFILE_UNIT_ENABLE);
+	unsigned int su_enable = *(STALL_UNIT_ENABLE);
+	unsigned int bus_enable = *(BUS_PROFILER_ENABLE);
+	unsigned int level_mode = *(STALL_UNIT_LEVEL_MODE);
+	unsigned int trigger = *(TRIGGER_CONTROL_REG);
+	unsigned int i;
+
+	checks = 0;
+	failures = 0;
+	// The kernels run in machine mode, so the units count in every mode
+	for (i = 0; i < 8; i++) {
+		filters[i] = UNIT_FILTER_REGS[i];
+		if (SUITE_UNITS & (1U << i)) {
+			UNIT_FILTER_REGS[i] = 0xF;
+		}
+	}
+	*(STALL_UNIT_LEVEL_MODE) = 0x0; // Mispredictions counted as events
+	*(TRIGGER_CONTROL_REG) = 0x2;   // Only count between the markers
+
+	pointer_chase();
+	streaming_copy();
+	branch_heavy();
+	muldiv_heavy();
+	atomic_heavy();
+	read_path_costs();
+
+	*(TRIGGER_CONTROL_REG) = trigger;
+	*(STALL_UNIT_LEVEL_MODE) = level_mode;
+	*(UNIT_CLEAR_REG) = SUITE_UNITS;
+	*(INSTRUCTION_PROFILE_UNIT_ENABLE) = ip_enable;
+	*(CACHE_PROFILE_UNIT_ENABLE) = cp_enable;
+	*(STALL_UNIT_ENABLE) = su_enable;
+	*(BUS_PROFILER_ENABLE) = bus_enable;
+	for (i = 0; i < 8; i++) {
+		UNIT_FILTER_REGS[i] = filters[i];
+	}
+
+	printf("\n%u checks, %u failed\n", checks, failures);
+	printf("ABACUS SUITE %s\n", failures ? "FAIL" : "PASS");
+	return failures;
+}
@@ -27,6 +27,34 @@ extern int disable_dcache_profiling(void);
 extern int enable_stall_unit(void);
 extern int disable_stall_unit(void);
 extern void stall_unit_profile(void);
+extern void set_stall_level_mode(unsigned int mask);
+extern void set_snapshot_interval(unsigned int cycles);
+extern void overflow_status(void);
+extern void clear_overflow(void);
+extern void clear_units(unsigned int mask);
+extern int enable_pc_sampling(unsigned int period);
+extern int disable_pc_sampling(void);
+extern void pc_samples(void);
+extern void roi_markers(void);
+extern void roi_pc(unsigned int start_low, unsigned int start_high, unsigned int stop_low, unsigned int stop_high);
+extern void roi_off(void);
+extern void roi_status(void);
+extern int select_event(unsigned int counter, unsigned int event, int edge);
+extern void event_counters(void);
+extern int enable_branch_hotlist(void);
+extern int disable_branch_hotlist(void);
+extern void branch_hotlist(void);
+extern int enable_miss_sketch(unsigned int granule_shift, unsigned int low, unsigned int high);
+extern int disable_miss_sketch(void);
+extern void miss_hotspots(void);
+extern int enable_bus_profiling(void);
+extern int disable_bus_profiling(void);
+extern void bus_profile(void);
+extern int set_rate_alarm(unsigned int alarm, unsigned int event, unsigned int window, unsigned int threshold);
+extern void rate_alarms(void);
+extern void set_unit_filter(unsigned int mask, unsigned int modes, int asid);
+extern void unit_filters(void);
+extern int abacus_suite(void);
 
 static char *readstr(void) {
 	char c[2];
@@ -89,17 +117,45 @@ static void help(void) {
 	puts("help               - Show this command");
 	puts("reboot             - Reboot CPU");
 	puts("enable_ip          - Enable instruction profiling");
-	puts("disable_ip         - Disable instruction profiling");
+	puts("disable_ip         - Pause instruction profiling, keeping the counters");
 	puts("get_ip_stats       - Show instruction profiling stats");
 	puts("enable_icp         - Enable instruction cache profiling");
-	puts("disable_icp        - Disable instruction cache profiling");
+	puts("disable_icp        - Pause cache profiling, keeping the counters");
 	puts("get_icp_stats      - Show instruction cache profiling stats");
 	puts("enable_dcp         - Enable data cache profiling");
-	puts("disable_dcp        - Disable data cache profiling");
+	puts("disable_dcp        - Pause cache profiling, keeping the counters");
 	puts("get_dcp_stats      - Show data cache profiling stats");
 	puts("enable_su			 - Enable the stall unit profiler");
-	puts("disable_su		 - Disable the stall unit profiler");
-	puts("get_su_stats		 - Show stall unit stats");
+	puts("disable_su		 - Pause the stall unit profiler, keeping the counters");
+	puts("get_su_stats		 - Show stall unit stats and the CPI stack");
+	puts("su_level_mode <mask> - Stall counters whose bit is set count cycles (0x1fc = every issue stall)");
+	puts("snapshot_interval <cycles> - Cycles between automatic counter snapshots (0 = on read only)");
+	puts("get_overflow       - Show which counters have wrapped");
+	puts("clear_overflow     - Clear the counter overflow status");
+	puts("clear_units [mask] - Empty the units of the mask (bit 0 ip, 1 cp, 2 su, 3 pcs, 4 bh, 5 ms, 6 bus, 7 events; all by default)");
+	puts("enable_pcs <cycles> - Sample the issuing PC every <cycles> cycles");
+	puts("disable_pcs        - Pause PC sampling, keeping the samples");
+	puts("get_pc_samples     - Print and drain the sampled PCs");
+	puts("roi_markers        - Only count between the start and stop marker instructions");
+	puts("roi_pc <start_lo> <start_hi> <stop_lo> <stop_hi> - Only count from the start PC range to the stop PC range");
+	puts("roi_off            - Count everywhere");
+	puts("roi_status         - Show the region-of-interest trigger");
+	puts("event_select <n> <event> [edge] - Count an event (0-16, see README) on programmable counter n, in edges if edge is 1");
+	puts("get_events         - Show the programmable counters");
+	puts("enable_bh          - Enable the branch misprediction hot list");
+	puts("disable_bh         - Pause the branch misprediction hot list");
+	puts("get_branch_hotlist - Show the most mispredicted branches");
+	puts("enable_ms <shift> <low> <high> - Count dcache misses from low to high per 1 << shift bytes (6 = lines)");
+	puts("disable_ms         - Pause the dcache miss sketch");
+	puts("get_miss_hotspots  - Show the most missed dcache granules");
+	puts("enable_bus         - Enable memory bus profiling");
+	puts("disable_bus        - Pause memory bus profiling, keeping the counters");
+	puts("get_bus_stats      - Show memory bus traffic, latency and saturation");
+	puts("set_alarm <n> <event> <window> <threshold> - Alarm n when a window of cycles has more than threshold events");
+	puts("get_alarms         - Show the alarms and the frozen counters of a crossing, then rearm them");
+	puts("set_filter <mask> <modes> [asid] - Units of the mask (bits as clear_units) only count in modes (1 user, 2 supervisor, 8 machine) and in one ASID");
+	puts("get_filters        - Show the unit filters and the current mode and ASID");
+	puts("run_suite          - Check the counters on known kernels and time the read paths");
 }
 
 static void reboot_cmd(void) {
@@ -166,6 +222,122 @@ static void console_service(void) {
 			printf("Error: Could not disable stall unit");
 	} else if (strcmp(token, "get_su_stats") == 0) {
 		stall_unit_profile();
+	} else if (strcmp(token, "su_level_mode") == 0) {
+		set_stall_level_mode(strtoul(get_token(&str), NULL, 0));
+		printf("Stall level mode set\n");
+	} else if (strcmp(token, "snapshot_interval") == 0) {
+		set_snapshot_interval(strtoul(get_token(&str), NULL, 0));
+		printf("Snapshot interval set\n");
+	} else if (strcmp(token, "get_overflow") == 0) {
+		overflow_status();
+	} else if (strcmp(token, "clear_overflow") == 0) {
+		clear_overflow();
+	} else if (strcmp(token, "clear_units") == 0) {
+		token = get_token(&str);
+		clear_units(*token ? strtoul(token, NULL, 0) : 0xff);
+		printf("Units cleared\n");
+	} else if (strcmp(token, "enable_pcs") == 0) {
+		if (enable_pc_sampling(strtoul(get_token(&str), NULL, 0)))
+			printf("PC sampling enabled\n");
+		else
+			printf("Error: Could not enable PC sampling\n");
+	} else if (strcmp(token, "disable_pcs") == 0) {
+		if (disable_pc_sampling())
+			printf("PC sampling disabled\n");
+		else
+			printf("Error: Could not disable PC sampling\n");
+	} else if (strcmp(token, "get_pc_samples") == 0) {
+		pc_samples();
+	} else if (strcmp(token, "roi_markers") == 0) {
+		roi_markers();
+		printf("Counting between markers\n");
+	} else if (strcmp(token, "roi_pc") == 0) {
+		unsigned int start_low = strtoul(get_token(&str), NULL, 0);
+		unsigned int start_high = strtoul(get_token(&str), NULL, 0);
+		unsigned int stop_low = strtoul(get_token(&str), NULL, 0);
+		unsigned int stop_high = strtoul(get_token(&str), NULL, 0);
+
+		roi_pc(start_low, start_high, stop_low, stop_high);
+		printf("Counting between PC ranges\n");
+	} else if (strcmp(token, "roi_off") == 0) {
+		roi_off();
+		printf("Counting everywhere\n");
+	} else if (strcmp(token, "roi_status") == 0) {
+		roi_status();
+	} else if (strcmp(token, "event_select") == 0) {
+		unsigned int counter = strtoul(get_token(&str), NULL, 0);
+		unsigned int event = strtoul(get_token(&str), NULL, 0);
+		int edge = strtoul(get_token(&str), NULL, 0) != 0;
+
+		if (select_event(counter, event, edge))
+			printf("Event selected\n");
+		else
+			printf("Error: No programmable counter %u\n", counter);
+	} else if (strcmp(token, "get_events") == 0) {
+		event_counters();
+	} else if (strcmp(token, "enable_bh") == 0) {
+		if (enable_branch_hotlist())
+			printf("Branch hot list enabled\n");
+		else
+			printf("Error: Could not enable the branch hot list\n");
+	} else if (strcmp(token, "disable_bh") == 0) {
+		if (disable_branch_hotlist())
+			printf("Branch hot list disabled\n");
+		else
+			printf("Error: Could not disable the branch hot list\n");
+	} else if (strcmp(token, "get_branch_hotlist") == 0) {
+		branch_hotlist();
+	} else if (strcmp(token, "enable_ms") == 0) {
+		unsigned int shift = strtoul(get_token(&str), NULL, 0);
+		unsigned int low = strtoul(get_token(&str), NULL, 0);
+		unsigned int high = strtoul(get_token(&str), NULL, 0);
+
+		if (enable_miss_sketch(shift, low, high))
+			printf("Miss sketch enabled\n");
+		else
+			printf("Error: Could not enable the miss sketch\n");
+	} else if (strcmp(token, "disable_ms") == 0) {
+		if (disable_miss_sketch())
+			printf("Miss sketch disabled\n");
+		else
+			printf("Error: Could not disable the miss sketch\n");
+	} else if (strcmp(token, "get_miss_hotspots") == 0) {
+		miss_hotspots();
+	} else if (strcmp(token, "enable_bus") == 0) {
+		if (enable_bus_profiling())
+			printf("Bus profiling enabled\n");
+		else
+			printf("Error: Could not enable bus profiling\n");
+	} else if (strcmp(token, "disable_bus") == 0) {
+		if (disable_bus_profiling())
+			printf("Bus profiling disabled\n");
+		else
+			printf("Error: Could not disable bus profiling\n");
+	} else if (strcmp(token, "get_bus_stats") == 0) {
+		bus_profile();
+	} else if (strcmp(token, "set_alarm") == 0) {
+		unsigned int alarm = strtoul(get_token(&str), NULL, 0);
+		unsigned int event = strtoul(get_token(&str), NULL, 0);
+		unsigned int window = strtoul(get_token(&str), NULL, 0);
+		unsigned int threshold = strtoul(get_token(&str), NULL, 0);
+
+		if (set_rate_alarm(alarm, event, window, threshold))
+			printf("Alarm set\n");
+		else
+			printf("Error: No rate alarm %u\n", alarm);
+	} else if (strcmp(token, "get_alarms") == 0) {
+		rate_alarms();
+	} else if (strcmp(token, "set_filter") == 0) {
+		unsigned int mask = strtoul(get_token(&str), NULL, 0);
+		unsigned int modes = strtoul(get_token(&str), NULL, 0);
+
+		token = get_token(&str);
+		set_unit_filter(mask, modes, *token ? (int)strtoul(token, NULL, 0) : -1);
+		printf("Filter set\n");
+	} else if (strcmp(token, "get_filters") == 0) {
+		unit_filters();
+	} else if (strcmp(token, "run_suite") == 0) {
+		abacus_suite();
 	}
 
 	prompt();
@@ -177,6 +349,9 @@ int main(void) {
 	uart_init();
 
 	puts("\nABACUS Bare Metal Program built on "__DATE__" "__TIME__"\n");
+#ifdef ABACUS_SUITE_AUTORUN
+	abacus_suite();
+#endif
 	help();
 	prompt();
 
@@ -0,0 +1,268 @@
+#include "libabacus.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "abacus_ioctl.h"
+#endif
+
+namespace abacus {
+
+#ifdef __linux__
+// The offsets are repeated in the header so it also builds baremetal, check them against the driver ABI.
+// The window holds struct abacus_counters from its ip member on.
+#define WINDOW_OFFSET(block, type, field) \
+    (ABACUS_REG_SNAPSHOT_WINDOW + offsetof(abacus_counters, block) - offsetof(abacus_counters, ip) + offsetof(type, field))
+static_assert(COUNTER_OFFSETS[BRANCHES] == WINDOW_OFFSET(ip, abacus_ip_counters, branch), "");
+static_assert(COUNTER_OFFSETS[ICACHE_REQUESTS] == WINDOW_OFFSET(cp, abacus_cp_counters, icache_request), "");
+static_assert(COUNTER_OFFSETS[ICACHE_MISSES] == WINDOW_OFFSET(cp, abacus_cp_counters, icache_miss), "");
+static_assert(COUNTER_OFFSETS[DCACHE_REQUESTS] == WINDOW_OFFSET(cp, abacus_cp_counters, dcache_request), "");
+static_assert(COUNTER_OFFSETS[DCACHE_MISSES] == WINDOW_OFFSET(cp, abacus_cp_counters, dcache_miss), "");
+static_assert(COUNTER_OFFSETS[BRANCH_MISPREDICTS] == WINDOW_OFFSET(su, abacus_su_counters, branch_misprediction), "");
+static_assert(COUNTER_OFFSETS[INSTRUCTIONS] == WINDOW_OFFSET(su, abacus_su_counters, instructions), "");
+static_assert(COUNTER_OFFSETS[STALL_CYCLES] == WINDOW_OFFSET(su, abacus_su_counters, cycles), "");
+static_assert(COUNTER_OFFSETS[CPI_FLUSH] == WINDOW_OFFSET(su, abacus_su_counters, cpi_flush), "");
+static_assert(COUNTER_OFFSETS[CPI_OTHER] == WINDOW_OFFSET(su, abacus_su_counters, cpi_other), "");
+#endif
+
+const char *const COUNTER_NAMES[NUM_COUNTERS] = {
+    "instructions", "branches", "icache_requests", "icache_misses", "dcache_requests", "dcache_misses",
+    "branch_mispredicts", "stall_unit_cycles", "cpi_flush", "cpi_frontend_empty", "cpi_hold",
+    "cpi_operand_dependency", "cpi_unit_busy", "cpi_other",
+};
+
+namespace detail {
+
+// Regions entered before init() read zeros from here instead of faulting
+static const uint32_t unmapped[COUNTER_OFFSETS[CPI_OTHER] / sizeof(uint32_t) + 1] = {};
+
+volatile const uint32_t *registers = unmapped;
+RegionEntry region_table[ABACUS_MAX_REGIONS];
+unsigned region_count;
+
+static void add(Totals &totals, const Sample &start, const Sample &end) {
+    totals.entries++;
+    totals.cycles += end.cycles - start.cycles;
+    for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+        // Unsigned 32-bit difference, correct across one wrap of the low word
+        totals.counts[i] += (uint32_t)(end.counts[i] - start.counts[i]);
+    }
+}
+
+void record(unsigned region, const Sample &start, const Sample &end, unsigned parent) {
+    add(region_table[region].inclusive, start, end);
+    if (parent < ABACUS_MAX_REGIONS) {
+        add(region_table[parent].children, start, end);
+    }
+}
+
+} // namespace detail
+
+ScopedRegion *ScopedRegion::current_;
+
+#ifdef __linux__
+static int device_fd = -1;
+static void *device_page = MAP_FAILED;
+
+int init() {
+    uint32_t version = 0;
+    uint32_t units = ABACUS_UNIT_IP | ABACUS_UNIT_CP | ABACUS_UNIT_SU;
+    uint32_t interval = 1;
+
+    if (device_fd >= 0) {
+        return 0;
+    }
+
+    device_fd = open("/dev/abacus", O_RDONLY);
+    if (device_fd < 0) {
+        return -errno;
+    }
+
+    if (ioctl(device_fd, ABACUS_IOC_GET_VERSION, &version) < 0 || version != ABACUS_ABI_VERSION ||
+        ioctl(device_fd, ABACUS_IOC_ENABLE, &units) < 0 ||
+        ioctl(device_fd, ABACUS_IOC_SET_SNAPSHOT_INTERVAL, &interval) < 0) {
+        int err = (version != ABACUS_ABI_VERSION) ? -EPROTO : -errno;
+
+        close(device_fd);
+        device_fd = -1;
+        return err;
+    }
+
+    device_page = mmap(NULL, ABACUS_MMAP_SIZE, PROT_READ, MAP_SHARED, device_fd, 0);
+    if (device_page == MAP_FAILED) {
+        int err = -errno;
+
+        close(device_fd);
+        device_fd = -1;
+        return err;
+    }
+
+    detail::registers = (volatile const uint32_t *)device_page;
+    return 0;
+}
+
+void shutdown() {
+    detail::registers = detail::unmapped;
+    if (device_page != MAP_FAILED) {
+        munmap(device_page, ABACUS_MMAP_SIZE);
+        device_page = MAP_FAILED;
+    }
+    if (device_fd >= 0) {
+        close(device_fd);
+        device_fd = -1;
+    }
+}
+#else
+#define ABACUS_BASE_ADDR 0xf0030000
+
+int init() {
+    volatile uint32_t *regs = (volatile uint32_t *)ABACUS_BASE_ADDR;
+
+    regs[0x04 / sizeof(uint32_t)] = 0x1; // Instruction profile enable
+    regs[0x08 / sizeof(uint32_t)] = 0x1; // Cache profile enable
+    regs[0x0C / sizeof(uint32_t)] = 0x1; // Stall unit enable
+    regs[0x14 / sizeof(uint32_t)] = 0x1; // Snapshot interval
+    detail::registers = regs;
+    return 0;
+}
+
+void shutdown() {
+    detail::registers = detail::unmapped;
+}
+#endif
+
+Region::Region(const char *name) {
+    index_ = (detail::region_count < ABACUS_MAX_REGIONS) ? detail::region_count++ : ABACUS_MAX_REGIONS - 1;
+    if (!detail::region_table[index_].name) {
+        detail::region_table[index_].name = name;
+    }
+}
+
+static Totals exclusive(const detail::RegionEntry &entry) {
+    Totals self = entry.inclusive;
+
+    self.cycles -= entry.children.cycles;
+    for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+        self.counts[i] -= entry.children.counts[i];
+    }
+    return self;
+}
+
+Totals Region::exclusive() const {
+    return abacus::exclusive(detail::region_table[index_]);
+}
+
+void Region::reset() {
+    memset(&detail::region_table[index_].inclusive, 0, sizeof(Totals));
+    memset(&detail::region_table[index_].children, 0, sizeof(Totals));
+}
+
+void reset() {
+    for (unsigned i = 0; i < detail::region_count; i++) {
+        memset(&detail::region_table[i].inclusive, 0, sizeof(Totals));
+        memset(&detail::region_table[i].children, 0, sizeof(Totals));
+    }
+}
+
+static double ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator ? (double)numerator / (double)denominator : 0.0;
+}
+
+Metrics derive(const Totals &totals) {
+    Metrics m;
+    uint64_t instructions = totals.counts[INSTRUCTIONS];
+
+    m.ipc = ratio(instructions, totals.cycles);
+    m.cpi = ratio(totals.counts[STALL_CYCLES], instructions);
+    m.icache_miss_rate = ratio(totals.counts[ICACHE_MISSES], totals.counts[ICACHE_REQUESTS]);
+    m.dcache_miss_rate = ratio(totals.counts[DCACHE_MISSES], totals.counts[DCACHE_REQUESTS]);
+    m.icache_mpki = 1000.0 * ratio(totals.counts[ICACHE_MISSES], instructions);
+    m.dcache_mpki = 1000.0 * ratio(totals.counts[DCACHE_MISSES], instructions);
+    m.mispredicts_per_branch = ratio(totals.counts[BRANCH_MISPREDICTS], totals.counts[BRANCHES]);
+    m.branch_mpki = 1000.0 * ratio(totals.counts[BRANCH_MISPREDICTS], instructions);
+    for (unsigned i = 0; i < NUM_STALLS; i++) {
+        m.stall_cpi[i] = ratio(totals.counts[FIRST_STALL + i], instructions);
+    }
+    return m;
+}
+
+Overhead measure_overhead(unsigned iterations) {
+    static Region calibration("libabacus overhead");
+    Overhead overhead = { UINT64_MAX, 0 };
+    uint64_t total = 0;
+    uint64_t start, elapsed;
+
+    for (unsigned i = 0; i < iterations; i++) {
+        start = detail::read_cycles();
+        {
+            ScopedRegion region(calibration);
+        }
+        elapsed = detail::read_cycles() - start;
+        total += elapsed;
+        if (elapsed < overhead.min) {
+            overhead.min = elapsed;
+        }
+    }
+    overhead.mean = iterations ? total / iterations : 0;
+    if (!iterations) {
+        overhead.min = 0;
+    }
+    calibration.reset();
+    return overhead;
+}
+
+// Printed as fixed point, the baremetal printf may be built without floating point support
+static void print_fixed(const char *name, double value, unsigned scale, const char *unit) {
+    unsigned long long fixed = (unsigned long long)(value * scale * 100.0 + 0.5);
+
+    printf("  %-26s %llu.%02llu%s\n", name, fixed / 100, fixed % 100, unit);
+}
+
+static void print_metrics(const Metrics &m) {
+    print_fixed("ipc", m.ipc, 1, "");
+    print_fixed("cpi", m.cpi, 1, "");
+    print_fixed("icache_miss_rate", m.icache_miss_rate, 100, "%");
+    print_fixed("dcache_miss_rate", m.dcache_miss_rate, 100, "%");
+    print_fixed("icache_mpki", m.icache_mpki, 1, "");
+    print_fixed("dcache_mpki", m.dcache_mpki, 1, "");
+    print_fixed("mispredicts_per_branch", m.mispredicts_per_branch, 1, "");
+    print_fixed("branch_mpki", m.branch_mpki, 1, "");
+    for (unsigned i = 0; i < NUM_STALLS; i++) {
+        print_fixed(COUNTER_NAMES[FIRST_STALL + i], m.stall_cpi[i], 1, " cycles per instruction");
+    }
+}
+
+void report() {
+    for (unsigned r = 0; r < detail::region_count; r++) {
+        const detail::RegionEntry &entry = detail::region_table[r];
+        Totals self = exclusive(entry);
+
+        if (!entry.inclusive.entries) {
+            continue;
+        }
+
+        printf("Region %s: %llu entries, %llu cycles (%llu self)\n", entry.name,
+               (unsigned long long)entry.inclusive.entries, (unsigned long long)entry.inclusive.cycles,
+               (unsigned long long)self.cycles);
+        for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+            printf("  %-26s %llu (%llu self)\n", COUNTER_NAMES[i], (unsigned long long)entry.inclusive.counts[i],
+                   (unsigned long long)self.counts[i]);
+        }
+        printf(" Self:\n");
+        print_metrics(derive(self));
+        if (entry.children.entries) {
+            printf(" Including nested regions:\n");
+            print_metrics(derive(entry.inclusive));
+        }
+    }
+}
+
+} // namespace abacus
@@ -0,0 +1,222 @@
+// libabacus: region profiling on top of the ABACUS counters, for baremetal and Linux.
+//
+//   static abacus::Region matmul_region("matmul");
+//
+//   abacus::init();
+//   {
+//       abacus::ScopedRegion region(matmul_region);
+//       matmul(a, b, c);
+//   }
+//   abacus::report();
+//
+// A ScopedRegion reads the counters it needs when it is constructed and again when it is
+// destroyed, and adds the difference to the totals of its region. Regions nest: each one
+// also knows how much of its count came from the regions opened inside it, so both the
+// inclusive and the exclusive (self) counts are reported.
+//
+// The stall unit puts every cycle in one category of a top-down CPI stack, so the report also
+// shows which stall cause the CPI above 1 of a region comes from.
+//
+// Only the low word of each counter is read from the snapshot window, which halves the bus reads
+// per entry. A single entry of a region must therefore see fewer than
+// 2^32 events of each counter, the totals themselves are 64 bits. Cycles come from the cycle
+// CSR of the core, not from the bus.
+//
+// Entry plus exit costs two register reads per counter below and a few dozen instructions of
+// bookkeeping, measure_overhead() times it on the running system. The counters are system-wide
+// and the table is not locked, so regions should be entered from one thread.
+
+#ifndef LIBABACUS_HPP
+#define LIBABACUS_HPP
+
+#include <stdint.h>
+
+#ifndef ABACUS_MAX_REGIONS
+#define ABACUS_MAX_REGIONS 64
+#endif
+
+namespace abacus {
+
+// Counters read at each region boundary
+enum Counter : unsigned {
+    INSTRUCTIONS,
+    BRANCHES,
+    ICACHE_REQUESTS,
+    ICACHE_MISSES,
+    DCACHE_REQUESTS,
+    DCACHE_MISSES,
+    BRANCH_MISPREDICTS,
+    STALL_CYCLES,  // Cycles counted by the stall unit, instructions plus the CPI stack categories
+    CPI_FLUSH,     // CPI stack categories, in stall unit register order
+    CPI_FRONTEND_EMPTY,
+    CPI_HOLD,
+    CPI_OPERAND_DEPENDENCY,
+    CPI_UNIT_BUSY,
+    CPI_OTHER,
+    NUM_COUNTERS
+};
+
+constexpr unsigned FIRST_STALL = CPI_FLUSH;
+constexpr unsigned NUM_STALLS = NUM_COUNTERS - FIRST_STALL;
+
+// Offsets of the low words in the snapshot window from the start of the ABACUS register page, in
+// Counter order. Window reads have no side effects, unlike the counter registers, whose low word
+// latches the COUNTER_HI register that the Linux driver reads counters through.
+constexpr uint32_t COUNTER_OFFSETS[NUM_COUNTERS] = {
+    0xA18, // Stall unit, issued instructions
+    0x820, // Instruction profile, branches
+    0x8B8, 0x8C8, // Cache profile, icache requests and misses
+    0x8D8, 0x8E8, // Cache profile, dcache requests and misses
+    0x9C8, // Stall unit, branch mispredictions
+    0xA10, // Stall unit, cycles
+    0xA20, 0xA28, 0xA30, 0xA38, 0xA40, 0xA48, // Stall unit, CPI stack
+};
+
+extern const char *const COUNTER_NAMES[NUM_COUNTERS];
+
+// Counter values at one instant
+struct Sample {
+    uint64_t cycles;
+    uint32_t counts[NUM_COUNTERS];
+};
+
+// Accumulated counts of one region
+struct Totals {
+    uint64_t entries;
+    uint64_t cycles;
+    uint64_t counts[NUM_COUNTERS];
+};
+
+// Ratios derived from a Totals, 0 where the denominator is 0
+struct Metrics {
+    double ipc;                          // From the cycle CSR
+    double cpi;                          // From the stall unit cycles, the sum of the CPI stack
+    double icache_miss_rate;
+    double dcache_miss_rate;
+    double icache_mpki;                  // Misses per thousand instructions
+    double dcache_mpki;
+    double mispredicts_per_branch;
+    double branch_mpki;
+    double stall_cpi[NUM_STALLS];        // CPI stack: stall cycles per instruction of each category, in Counter order.
+                                         // 1 for the issue cycle plus every stall_cpi adds up to cpi.
+};
+
+Metrics derive(const Totals &totals);
+
+// Entry and exit cost of an empty ScopedRegion, in cycles
+struct Overhead {
+    uint64_t min;
+    uint64_t mean;
+};
+
+namespace detail {
+
+extern volatile const uint32_t *registers;
+
+struct RegionEntry {
+    const char *name;
+    Totals inclusive;
+    Totals children; // Part of inclusive that was spent in nested regions
+};
+
+extern RegionEntry region_table[ABACUS_MAX_REGIONS];
+extern unsigned region_count;
+
+inline uint64_t read_cycles() {
+#if defined(__riscv) && __riscv_xlen == 32
+    uint32_t hi, lo, hi2;
+
+    // The high word is read on both sides of the low word in case the low word wrapped in between
+    do {
+        __asm__ __volatile__("rdcycleh %0" : "=r"(hi));
+        __asm__ __volatile__("rdcycle %0" : "=r"(lo));
+        __asm__ __volatile__("rdcycleh %0" : "=r"(hi2));
+    } while (hi != hi2);
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__riscv)
+    uint64_t cycles;
+
+    __asm__ __volatile__("rdcycle %0" : "=r"(cycles));
+    return cycles;
+#else
+    return 0; // Host builds only check the API, there is no ABACUS to profile
+#endif
+}
+
+inline void read_sample(Sample &sample) {
+    for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+        sample.counts[i] = registers[COUNTER_OFFSETS[i] / sizeof(uint32_t)];
+    }
+}
+
+void record(unsigned region, const Sample &start, const Sample &end, unsigned parent);
+
+} // namespace detail
+
+// Enables the instruction, cache and stall units and sets the snapshot interval to one cycle, so
+// the snapshot window follows the live counters. On Linux this opens and maps the device, which the
+// driver must be loaded for. Returns 0 or a negative errno.
+int init();
+
+// Unmaps the registers on Linux, the units are left enabled
+void shutdown();
+
+// A named row in the region table. Regions are meant to be static, they claim their row on
+// construction and keep it. Past ABACUS_MAX_REGIONS, every further region shares the last row.
+class Region {
+public:
+    explicit Region(const char *name);
+
+    const char *name() const { return detail::region_table[index_].name; }
+    const Totals &inclusive() const { return detail::region_table[index_].inclusive; }
+    Totals exclusive() const;
+    void reset();
+
+private:
+    friend class ScopedRegion;
+    unsigned index_;
+};
+
+// Counts from construction to destruction into a Region. No allocation, no syscall.
+class ScopedRegion {
+public:
+    explicit ScopedRegion(Region &region) : index_(region.index_), parent_(current_) {
+        current_ = this;
+        // Counters last, so the bookkeeping above is not counted
+        detail::read_sample(start_);
+        start_.cycles = detail::read_cycles();
+    }
+
+    ~ScopedRegion() {
+        Sample end;
+
+        // Counters first, so the bookkeeping below is not counted
+        end.cycles = detail::read_cycles();
+        detail::read_sample(end);
+        detail::record(index_, start_, end, parent_ ? parent_->index_ : ABACUS_MAX_REGIONS);
+        current_ = parent_;
+    }
+
+    ScopedRegion(const ScopedRegion &) = delete;
+    ScopedRegion &operator=(const ScopedRegion &) = delete;
+
+private:
+    static ScopedRegion *current_; // Innermost open region
+
+    unsigned index_;
+    ScopedRegion *parent_;
+    Sample start_;
+};
+
+// Times iterations empty regions in a row. Call it outside of any region.
+Overhead measure_overhead(unsigned iterations = 1000);
+
+// Prints every region with its exclusive counts and derived metrics, then its inclusive metrics
+void report();
+
+// Clears the totals of every region, the regions keep their rows
+void reset();
+
+} // namespace abacus
+
+#endif // LIBABACUS_HPP
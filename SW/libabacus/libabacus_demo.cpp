@@ -0,0 +1,78 @@
+// Profiles two small kernels with libabacus and prints the region report, after the cost of
+// entering and leaving a region on this system.
+//
+// Usage: ./libabacus_demo
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libabacus.hpp"
+
+#define ARRAY_WORDS (256 * 1024) // Larger than the data cache
+#define STRIDE_WORDS 16          // One access per line of 64 bytes
+
+static abacus::Region demo_region("demo");
+static abacus::Region stride_region("strided_sum");
+static abacus::Region branch_region("random_branches");
+
+static uint32_t data[ARRAY_WORDS];
+
+// Keeps the compiler from discarding the kernels
+static volatile uint32_t sink;
+
+static void strided_sum(void) {
+    abacus::ScopedRegion region(stride_region);
+    uint32_t sum = 0;
+
+    for (unsigned i = 0; i < ARRAY_WORDS; i += STRIDE_WORDS) {
+        sum += data[i];
+    }
+    sink = sum;
+}
+
+// A data-dependent branch on random values, which the predictor gets wrong about half the time
+static void random_branches(void) {
+    abacus::ScopedRegion region(branch_region);
+    uint32_t taken = 0;
+
+    for (unsigned i = 0; i < ARRAY_WORDS; i++) {
+        if (data[i] & 1) {
+            taken++;
+        }
+    }
+    sink = taken;
+}
+
+int main() {
+    abacus::Overhead overhead;
+    int err;
+
+    err = abacus::init();
+    if (err < 0) {
+        printf("Could not open the ABACUS device: %s\n", strerror(-err));
+        return -1;
+    }
+
+    for (unsigned i = 0; i < ARRAY_WORDS; i++) {
+        data[i] = (uint32_t)rand();
+    }
+
+    overhead = abacus::measure_overhead();
+    printf("Region entry and exit: %llu cycles min, %llu cycles mean\n",
+           (unsigned long long)overhead.min, (unsigned long long)overhead.mean);
+
+    {
+        abacus::ScopedRegion region(demo_region);
+
+        for (int pass = 0; pass < 4; pass++) {
+            strided_sum();
+            random_branches();
+        }
+    }
+
+    abacus::report();
+    abacus::shutdown();
+    return 0;
+}
@@ -0,0 +1,178 @@
+// Rate alarm log of the ABACUS driver.
+//
+// A crossing of a rate alarm sets its status bit, which raises the interrupt. The handler records the
+// hart, the PC and timestamp the hardware latched at the crossing and, when a freezing alarm crossed,
+// the snapshot window it froze, then clears the status, which releases the freeze and lets the alarms
+// record the next crossing. Userspace drains the log with ABACUS_IOC_READ_ALARMS, so rare bursts are
+// caught without anyone polling the counters. Without the interrupt line the status is collected on
+// each read of the log, of the counters and of a perf event instead, and a snapshot taken in between
+// replaces the frozen one.
+//
+// The log is a fixed ring of events, new events are dropped while it is full.
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+#include "abacus_driver.h"
+
+#define ABACUS_ALARM_LOG_ENTRIES 32
+
+// Raw, as the perf callbacks collect crossings with interrupts disabled
+static DEFINE_RAW_SPINLOCK(alarm_lock);
+// Readers take events off the log one at a time, so only one reader drains it at a time
+static DEFINE_MUTEX(alarm_read_lock);
+static struct abacus_alarm_event alarm_log[ABACUS_ALARM_LOG_ENTRIES];
+static unsigned int alarm_head; // Oldest event
+static unsigned int alarm_count;
+static u32 alarm_dropped;
+
+// Must be called with alarm_lock held
+static void abacus_alarm_record(unsigned int hart, u32 status) {
+	void __iomem *regs = abacus_base + ABACUS_HART_OFFSET(hart);
+	struct abacus_alarm_event *event;
+	u32 freeze = 0;
+	unsigned int n;
+
+	if (alarm_count == ABACUS_ALARM_LOG_ENTRIES) {
+		alarm_dropped++;
+		return;
+	}
+
+	event = &alarm_log[(alarm_head + alarm_count) % ABACUS_ALARM_LOG_ENTRIES];
+	memset(event, 0, sizeof(*event));
+	event->time_ns = ktime_get_ns();
+	event->hart = hart;
+	event->status = status;
+	event->pc = ioread32(regs + ABACUS_REG_ALARM_PC);
+	for (n = 0; n < ABACUS_ALARM_MAX; n++) {
+		if (status & (1U << n))
+			freeze |= ioread32(regs + ABACUS_REG_ALARM_SELECT(n)) & ABACUS_ALARM_SELECT_FREEZE;
+	}
+
+	// The window is read as it is, a snapshot command would replace the frozen counters
+	raw_spin_lock(&abacus_read_lock);
+	event->timestamp = abacus_read_counter64(ABACUS_HART_OFFSET(hart) + ABACUS_REG_ALARM_TIMESTAMP);
+	if (freeze) {
+		event->frozen = 1;
+		memcpy_fromio(&event->ip, regs + ABACUS_REG_SNAPSHOT_WINDOW, ABACUS_SNAPSHOT_WINDOW_SIZE);
+	}
+	raw_spin_unlock(&abacus_read_lock);
+
+	alarm_count++;
+}
+
+// Moves the crossings of every hart into the log and clears them in the hardware, returns true if
+// any alarm had crossed
+bool abacus_alarm_collect(void) {
+	void __iomem *status_reg;
+	unsigned long flags;
+	unsigned int h;
+	u32 status;
+	bool crossed = false;
+
+	raw_spin_lock_irqsave(&alarm_lock, flags);
+	for (h = 0; h < abacus_num_harts; h++) {
+		status_reg = abacus_base + ABACUS_HART_OFFSET(h) + ABACUS_REG_ALARM_STATUS;
+		status = ioread32(status_reg);
+		if (!status)
+			continue;
+		abacus_alarm_record(h, status);
+		iowrite32(status, status_reg);
+		crossed = true;
+	}
+	raw_spin_unlock_irqrestore(&alarm_lock, flags);
+	return crossed;
+}
+
+// The window and threshold are written first, the select write then restarts the alarm with them
+int abacus_alarm_set(const struct abacus_alarm_config *config) {
+	unsigned int h;
+
+	if (config->index >= min_t(u32, ioread32(abacus_base + ABACUS_REG_ALARM_COUNT), ABACUS_ALARM_MAX))
+		return -EINVAL;
+	if (config->select & ~(ABACUS_EVENT_SELECT_EVENT | ABACUS_EVENT_SELECT_EDGE | ABACUS_EVENT_SELECT_ENABLE |
+			       ABACUS_ALARM_SELECT_FREEZE))
+		return -EINVAL;
+
+	for (h = 0; h < abacus_num_harts; h++) {
+		void __iomem *regs = abacus_base + ABACUS_HART_OFFSET(h);
+
+		iowrite32(config->window, regs + ABACUS_REG_ALARM_WINDOW(config->index));
+		iowrite32(config->threshold, regs + ABACUS_REG_ALARM_THRESHOLD(config->index));
+		iowrite32(config->select, regs + ABACUS_REG_ALARM_SELECT(config->index));
+	}
+	return 0;
+}
+
+// Events are copied to userspace without the lock and only taken off the log once the copy has
+// succeeded, so a fault leaves the event for the next read
+long abacus_alarm_read(struct abacus_alarm_events __user *uarg) {
+	struct abacus_alarm_events req;
+	struct abacus_alarm_event *event;
+	struct abacus_alarm_event __user *dst;
+	unsigned long flags;
+	long ret = 0;
+
+	if (copy_from_user(&req, uarg, sizeof(req)))
+		return -EFAULT;
+
+	event = kmalloc(sizeof(*event), GFP_KERNEL);
+	if (!event)
+		return -ENOMEM;
+
+	abacus_alarm_collect();
+
+	dst = u64_to_user_ptr(req.events);
+	req.count = 0;
+	mutex_lock(&alarm_read_lock);
+	while (req.count < req.capacity) {
+		raw_spin_lock_irqsave(&alarm_lock, flags);
+		if (!alarm_count) {
+			raw_spin_unlock_irqrestore(&alarm_lock, flags);
+			break;
+		}
+		*event = alarm_log[alarm_head];
+		raw_spin_unlock_irqrestore(&alarm_lock, flags);
+
+		if (copy_to_user(dst + req.count, event, sizeof(*event))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		// The oldest event is not overwritten while it is logged, new events only go behind it
+		raw_spin_lock_irqsave(&alarm_lock, flags);
+		alarm_head = (alarm_head + 1) % ABACUS_ALARM_LOG_ENTRIES;
+		alarm_count--;
+		raw_spin_unlock_irqrestore(&alarm_lock, flags);
+		req.count++;
+	}
+	mutex_unlock(&alarm_read_lock);
+	kfree(event);
+
+	raw_spin_lock_irqsave(&alarm_lock, flags);
+	req.dropped = alarm_dropped;
+	req.pending = alarm_count;
+	raw_spin_unlock_irqrestore(&alarm_lock, flags);
+
+	if (ret)
+		return ret;
+	if (copy_to_user(uarg, &req, sizeof(req)))
+		return -EFAULT;
+	return 0;
+}
+
+// Stops every alarm, so none holds back the automatic snapshots once the driver is gone
+void abacus_alarm_exit(void) {
+	unsigned int h, n, count;
+
+	count = min_t(u32, ioread32(abacus_base + ABACUS_REG_ALARM_COUNT), ABACUS_ALARM_MAX);
+	for (h = 0; h < abacus_num_harts; h++) {
+		for (n = 0; n < count; n++)
+			iowrite32(0, abacus_base + ABACUS_HART_OFFSET(h) + ABACUS_REG_ALARM_SELECT(n));
+		iowrite32(0xFF, abacus_base + ABACUS_HART_OFFSET(h) + ABACUS_REG_ALARM_STATUS);
+	}
+}
@@ -0,0 +1,157 @@
+// Microbenchmark for the cost of reading every ABACUS counter from userspace.
+// Compares the legacy text commands (one read() and one snprintf per unit), the
+// ABACUS_IOC_READ_COUNTERS ioctl (one syscall), and the read-only mmap of the
+// register page (no syscall) through the per-counter registers and through the
+// snapshot window.
+//
+// Usage: ./abacus_bench [iterations]
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "abacus_ioctl.h"
+
+#define DEVICE "/dev/abacus"
+#define DEFAULT_ITERATIONS 10000
+
+static const char *text_commands[] = { "get_ip_stats", "get_icp_stats", "get_dcp_stats", "get_su_stats" };
+
+// Keeps the compiler from discarding the reads
+static volatile uint64_t sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int read_text(int fd) {
+    char buffer[512];
+    char *value;
+    size_t i;
+
+    for (i = 0; i < sizeof(text_commands) / sizeof(text_commands[0]); i++) {
+        strcpy(buffer, text_commands[i]);
+        if (read(fd, buffer, sizeof(buffer)) < 0) {
+            return -1;
+        }
+        // Parse the first value, as a consumer of the text format has to
+        value = strchr(buffer, ':');
+        sink = value ? strtoull(value + 1, NULL, 10) : 0;
+    }
+    return 0;
+}
+
+static int read_ioctl(int fd) {
+    struct abacus_counters c;
+
+    if (ioctl(fd, ABACUS_IOC_READ_COUNTERS, &c) < 0) {
+        return -1;
+    }
+    sink = c.ip.load_word;
+    return 0;
+}
+
+// Low word first, it latches the upper word into ABACUS_REG_COUNTER_HI. The driver reads counters
+// through the same register, so run the bench on a system where nothing else is reading them.
+static void read_mmap_block(volatile const uint32_t *regs, __u64 *dst, unsigned int offset, int count) {
+    uint32_t lo;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        lo = regs[offset / 4 + i];
+        dst[i] = ((uint64_t)regs[ABACUS_REG_COUNTER_HI / 4] << 32) | lo;
+    }
+}
+
+static int read_mmap(volatile const uint32_t *regs) {
+    struct abacus_counters c;
+
+    read_mmap_block(regs, (__u64 *)&c.ip, ABACUS_REG_IP_BASE, ABACUS_IP_NUM_COUNTERS);
+    read_mmap_block(regs, (__u64 *)&c.cp, ABACUS_REG_CP_BASE, ABACUS_CP_NUM_COUNTERS);
+    read_mmap_block(regs, (__u64 *)&c.su, ABACUS_REG_SU_BASE, ABACUS_SU_NUM_COUNTERS);
+
+    sink = c.ip.load_word;
+    return 0;
+}
+
+// One copy of the packed window, wide loads instead of a low and high read per counter
+static int read_window(volatile const uint32_t *regs) {
+    struct abacus_counters c;
+
+    memcpy(&c.ip, (const void *)&regs[ABACUS_REG_SNAPSHOT_WINDOW / 4], ABACUS_SNAPSHOT_WINDOW_SIZE);
+
+    sink = c.ip.load_word;
+    return 0;
+}
+
+static void report(const char *name, uint64_t elapsed_ns, long iterations) {
+    printf("%-8s %10.1f ns per full counter read (%ld iterations)\n", name, (double)elapsed_ns / iterations, iterations);
+}
+
+int main(int argc, char **argv) {
+    long iterations = (argc > 1) ? strtol(argv[1], NULL, 0) : DEFAULT_ITERATIONS;
+    volatile const uint32_t *regs;
+    uint64_t start;
+    long i;
+    int fd;
+
+    if (iterations <= 0) {
+        printf("Usage: %s [iterations]\n", argv[0]);
+        return -1;
+    }
+
+    fd = open(DEVICE, O_RDWR);
+    if (fd < 0) {
+        printf("There was an error with opening the device\n");
+        return -1;
+    }
+
+    regs = mmap(NULL, ABACUS_MMAP_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (regs == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return -1;
+    }
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        if (read_text(fd) < 0) {
+            perror("read");
+            break;
+        }
+    }
+    report("text", now_ns() - start, iterations);
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        if (read_ioctl(fd) < 0) {
+            perror("ioctl");
+            break;
+        }
+    }
+    report("ioctl", now_ns() - start, iterations);
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        read_mmap(regs);
+    }
+    report("mmap", now_ns() - start, iterations);
+
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        read_window(regs);
+    }
+    report("window", now_ns() - start, iterations);
+
+    munmap((void *)regs, ABACUS_MMAP_SIZE);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Shared between the source files of the ABACUS kernel module, not part of the userspace ABI
+
+#ifndef ABACUS_DRIVER_H
+#define ABACUS_DRIVER_H
+
+#include <linux/io.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+
+#include "abacus_ioctl.h"
+
+#define DEVICE_NAME "abacus"
+#define ABACUS_BASE_ADDR 0xf0030000
+
+extern void __iomem *abacus_base;
+
+// Harts the hardware was built with, 1 for a single-hart build. Hart h has the register page
+// at abacus_base + ABACUS_HART_OFFSET(h), hart 0 the one single-hart code has always used.
+extern unsigned int abacus_num_harts;
+
+// Writes a register of every hart, for the settings that apply to all of them alike
+void abacus_write_all_harts(u32 value, unsigned int offset);
+
+// Hart profiled by the block of a Linux CPU, which may be out of range on a system with more
+// CPUs than the hardware has blocks
+static inline unsigned int abacus_cpu_hart(unsigned int cpu) {
+#ifdef CONFIG_RISCV
+	return cpuid_to_hartid_map(cpu);
+#else
+	return cpu;
+#endif
+}
+
+// Reading a 64-bit counter is a two register sequence through the shared COUNTER_HI register,
+// so readers of the counters are serialised. It is a raw spinlock because the perf callbacks
+// read counters with interrupts disabled. Userspace readers of the mmap cannot take it, they
+// read the snapshot window instead, which leaves COUNTER_HI alone.
+extern raw_spinlock_t abacus_read_lock;
+
+// Must be called with abacus_read_lock held. Offsets include ABACUS_HART_OFFSET() of the hart to read.
+u64 abacus_read_counter64(unsigned int offset);
+void abacus_read_block(__u64 *dst, unsigned int offset, unsigned int count);
+// What a counter gained from last to now, across a wrap of a counter narrower than 64 bits
+u64 abacus_counter_delta(u64 now, u64 last);
+// ABACUS_HART_ALL snapshots every hart on one edge and copies their aggregate window
+void abacus_read_snapshot(void *dst, size_t size, unsigned int hart);
+void __iomem *abacus_snapshot_hold(unsigned int hart);
+void abacus_snapshot_release(unsigned int hart);
+
+#define ABACUS_NUM_COUNTERS (ABACUS_IP_NUM_COUNTERS + ABACUS_CP_NUM_COUNTERS + ABACUS_SU_NUM_COUNTERS)
+
+// perf_event PMU, abacus_pmu.c
+int abacus_pmu_init(void);
+void abacus_pmu_exit(void);
+
+// Per-process attribution, abacus_task.c
+int abacus_task_init(void);
+void abacus_task_exit(void);
+int abacus_task_attribution(bool enable);
+int abacus_task_read(struct abacus_task_counters *counters);
+
+// Snapshot ring, abacus_ring.c
+int abacus_ring_init(bool use_irq);
+void abacus_ring_exit(void);
+int abacus_ring_start(const struct abacus_ring_config *config);
+void abacus_ring_stop(void);
+void abacus_ring_status(struct abacus_ring_status *status);
+int abacus_ring_consume(u32 tail);
+int abacus_ring_mmap(struct vm_area_struct *vma);
+__poll_t abacus_ring_poll(struct file *file, poll_table *wait);
+bool abacus_ring_interrupt(void);
+
+// Timer sampler, abacus_sampler.c
+void abacus_sampler_init(void);
+void abacus_sampler_exit(void);
+int abacus_sampler_start(const struct abacus_sampler_config *config);
+void abacus_sampler_stop(void);
+void abacus_sampler_status(struct abacus_sampler_status *status);
+ssize_t abacus_sampler_read(struct file *file, char __user *buffer, size_t len, loff_t *offset);
+__poll_t abacus_sampler_poll(struct file *file, poll_table *wait);
+
+// Rate alarm log, abacus_alarm.c
+void abacus_alarm_exit(void);
+bool abacus_alarm_collect(void);
+int abacus_alarm_set(const struct abacus_alarm_config *config);
+long abacus_alarm_read(struct abacus_alarm_events __user *uarg);
+
+#endif // ABACUS_DRIVER_H
@@ -0,0 +1,612 @@
+// Binary interface between the ABACUS kernel driver and userspace.
+// This header is shared by abacus_kernel_driver.c and the userspace tools, so it
+// only uses the fixed-width types from <linux/types.h>.
+//
+// Bump ABACUS_ABI_VERSION whenever the layout of a structure or the meaning of an
+// ioctl in this file changes, userspace should refuse to run on a version it does not know.
+
+#ifndef ABACUS_IOCTL_H
+#define ABACUS_IOCTL_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define ABACUS_ABI_VERSION 14
+
+/* Register page layout, as seen through mmap() of /dev/abacus (offsets from ABACUS_BASE_ADDR) */
+// The mapping covers the whole page, but some reads have side effects: the low word of a counter
+// register latches ABACUS_REG_COUNTER_HI, which the driver reads counters through under its lock,
+// ABACUS_REG_PC_SAMPLE_DATA pops the sampler FIFO and ABACUS_REG_MS_DATA advances the sketch index.
+// Through the mapping, read counters from the snapshot window and otherwise only the enable,
+// configuration and status words, never those registers.
+#define ABACUS_MMAP_SIZE 0x1000
+#define ABACUS_REGION_SIZE 0x10000 // Every hart and the global block, the most mmap() accepts
+// mmap() offset of the snapshot ring, an array of struct abacus_ring_record
+#define ABACUS_MMAP_RING_OFFSET 0x100000
+// Minor number of the sampler device, read() returns struct abacus_sample (mknod /dev/abacus_samples c <major> 1)
+#define ABACUS_SAMPLER_MINOR 1
+
+#define ABACUS_REG_IP_ENABLE 0x004
+#define ABACUS_REG_CP_ENABLE 0x008
+#define ABACUS_REG_SU_ENABLE 0x00C
+#define ABACUS_REG_SNAPSHOT 0x010          // ABACUS_SNAPSHOT_* bits
+#define ABACUS_REG_SNAPSHOT_INTERVAL 0x014 // Cycles between automatic snapshots, 0 = only on ABACUS_REG_SNAPSHOT
+#define ABACUS_REG_COUNTER_HI 0x018        // Upper 32 bits of the counter whose low word was read last
+#define ABACUS_REG_IRQ_ENABLE 0x01C        // Bit 0: interrupt on counter overflow, bit 1: on the snapshot ring, bit 2: on a rate alarm
+#define ABACUS_REG_IP_OVERFLOW 0x020       // Sticky wrap status, bit n = counter n of the unit, write 1 to clear
+#define ABACUS_REG_CP_OVERFLOW 0x024
+#define ABACUS_REG_SU_OVERFLOW 0x028
+#define ABACUS_REG_PC_ENABLE 0x02C
+#define ABACUS_REG_SU_LEVEL_MODE 0x030     // Bit n: stall unit counter n counts cycles instead of events
+#define ABACUS_REG_EVENT_OVERFLOW 0x034    // Sticky wrap status of the programmable counters, write 1 to clear
+#define ABACUS_REG_BH_ENABLE 0x038
+#define ABACUS_REG_MS_ENABLE 0x03C
+#define ABACUS_REG_BUS_ENABLE 0x040
+#define ABACUS_REG_BUS_OVERFLOW 0x044      // Sticky wrap status of the bus profiler, write 1 to clear
+#define ABACUS_REG_UNIT_CLEAR 0x048        // Write ABACUS_UNIT_* bits to empty those units, reads 0
+
+#define ABACUS_REG_IP_BASE 0x100
+#define ABACUS_REG_CP_BASE 0x200
+#define ABACUS_REG_SU_BASE 0x300
+#define ABACUS_REG_PC_BASE 0x400
+#define ABACUS_REG_TRIGGER_BASE 0x500
+#define ABACUS_REG_RING_BASE 0x600
+#define ABACUS_REG_EVENT_BASE 0x700
+#define ABACUS_REG_SNAPSHOT_WINDOW 0x800
+#define ABACUS_REG_BH_BASE 0xB00
+#define ABACUS_REG_MS_BASE 0xC00
+#define ABACUS_REG_BUS_BASE 0xD00
+#define ABACUS_REG_ALARM_BASE 0xE00
+#define ABACUS_REG_FILTER_BASE 0xF00
+
+#define ABACUS_SNAPSHOT_NOW 0x1  // Latch every counter in the same cycle
+#define ABACUS_SNAPSHOT_HOLD 0x2 // Hold back automatic snapshots until cleared, reads back
+
+// Multi-hart builds (abacus_smp) repeat the register page above for every hart, hart h at
+// ABACUS_HART_OFFSET(h), and add a global block. A single-hart build is hart 0 and reads 0 at
+// ABACUS_REG_NUM_HARTS.
+#define ABACUS_HART_STRIDE 0x1000
+#define ABACUS_HART_OFFSET(h) ((h) * ABACUS_HART_STRIDE)
+#define ABACUS_MAX_HARTS 15
+#define ABACUS_HART_ALL 0xFFFFFFFFU // Every hart, for struct abacus_hart_counters
+
+#define ABACUS_REG_GLOBAL_BASE 0xF000
+#define ABACUS_REG_NUM_HARTS (ABACUS_REG_GLOBAL_BASE + 0x000)
+#define ABACUS_REG_GLOBAL_SNAPSHOT (ABACUS_REG_GLOBAL_BASE + 0x004)  // ABACUS_SNAPSHOT_* bits, applied to every hart on one edge
+#define ABACUS_REG_HART_IRQ_STATUS (ABACUS_REG_GLOBAL_BASE + 0x008)  // Bit h: interrupt of hart h is raised
+#define ABACUS_REG_GLOBAL_CLEAR (ABACUS_REG_GLOBAL_BASE + 0x00C)     // ABACUS_REG_UNIT_CLEAR of every hart on one edge
+#define ABACUS_REG_AGGREGATE_WINDOW (ABACUS_REG_GLOBAL_BASE + 0x800) // Snapshot window summed over the harts, see below
+
+// PC sampler block. Reading ABACUS_REG_PC_SAMPLE_DATA pops the FIFO, so samples should only be
+// drained through ABACUS_IOC_READ_PC_SAMPLES, never through the mmap of the register page
+#define ABACUS_REG_PC_SAMPLE_PERIOD (ABACUS_REG_PC_BASE + 0x0)  // Cycles between samples, 0 stops sampling
+#define ABACUS_REG_PC_SAMPLE_COUNT (ABACUS_REG_PC_BASE + 0x4)   // Samples waiting in the FIFO
+#define ABACUS_REG_PC_SAMPLE_DATA (ABACUS_REG_PC_BASE + 0x8)    // Oldest sample, reading it pops the FIFO
+#define ABACUS_REG_PC_SAMPLE_DROPPED (ABACUS_REG_PC_BASE + 0xC) // Samples lost to a full FIFO since the sampler was last cleared
+
+// Line fill latency histograms and extremes in the cache profile block. Histogram bucket b counts
+// fills of 2^b to 2^(b+1)-1 cycles, the last bucket also counts every longer fill.
+#define ABACUS_LATENCY_BUCKETS 12
+#define ABACUS_REG_ICACHE_LINE_FILL_MIN (ABACUS_REG_CP_BASE + 0x88) // 32 bits, all ones until the first fill completes
+#define ABACUS_REG_ICACHE_LINE_FILL_MAX (ABACUS_REG_CP_BASE + 0x8C)
+#define ABACUS_REG_DCACHE_LINE_FILL_MIN (ABACUS_REG_CP_BASE + 0x90)
+#define ABACUS_REG_DCACHE_LINE_FILL_MAX (ABACUS_REG_CP_BASE + 0x94)
+
+// Region-of-interest triggers. While a trigger mode is selected, the instruction, cache and stall
+// units only count inside the region, between a start and a stop event seen in the instruction stream
+#define ABACUS_REG_TRIGGER_CONTROL (ABACUS_REG_TRIGGER_BASE + 0x00)       // ABACUS_TRIGGER_*, a write leaves the region
+#define ABACUS_REG_TRIGGER_STATUS (ABACUS_REG_TRIGGER_BASE + 0x04)        // Bit 0: inside the region
+#define ABACUS_REG_TRIGGER_REGION_COUNT (ABACUS_REG_TRIGGER_BASE + 0x08)  // Regions entered since the last control write
+#define ABACUS_REG_TRIGGER_START_PC_LOW (ABACUS_REG_TRIGGER_BASE + 0x10)  // Inclusive PC ranges, low above high never matches
+#define ABACUS_REG_TRIGGER_START_PC_HIGH (ABACUS_REG_TRIGGER_BASE + 0x14)
+#define ABACUS_REG_TRIGGER_STOP_PC_LOW (ABACUS_REG_TRIGGER_BASE + 0x18)
+#define ABACUS_REG_TRIGGER_STOP_PC_HIGH (ABACUS_REG_TRIGGER_BASE + 0x1C)
+
+#define ABACUS_TRIGGER_PC_RANGE (1U << 0) // Start on an instruction in the start range, stop on one in the stop range
+#define ABACUS_TRIGGER_MARKER (1U << 1)   // Start and stop on the marker instructions below
+
+// Marker instructions, SLTI hints with rd = x0 that execute as NOPs. The instructions between the
+// two markers are counted, the markers themselves are not.
+#define ABACUS_ROI_START_MARKER 0x00102013 // slti x0, x0, 1
+#define ABACUS_ROI_STOP_MARKER 0x00202013  // slti x0, x0, 2
+
+#if defined(__riscv) && !defined(__KERNEL__)
+#define ABACUS_ROI_START() __asm__ __volatile__("slti x0, x0, 1" ::: "memory")
+#define ABACUS_ROI_STOP() __asm__ __volatile__("slti x0, x0, 2" ::: "memory")
+#endif
+
+#define ABACUS_IP_NUM_COUNTERS 23
+#define ABACUS_CP_NUM_COUNTERS (10 + 2 * ABACUS_LATENCY_BUCKETS)
+#define ABACUS_CPI_STALLS 6
+#define ABACUS_SU_NUM_COUNTERS (11 + ABACUS_CPI_STALLS)
+
+// Snapshot ring. When enabled, every automatic snapshot is written by a bus master into a ring of
+// struct abacus_ring_record in memory; snapshots that find the ring full are dropped. The driver owns
+// these registers, userspace uses ABACUS_IOC_RING_*, mmap() at ABACUS_MMAP_RING_OFFSET and poll().
+#define ABACUS_REG_RING_CONTROL (ABACUS_REG_RING_BASE + 0x00)       // Bit 0: enable, writing it as 1 starts from record 0
+#define ABACUS_REG_RING_ADDRESS (ABACUS_REG_RING_BASE + 0x04)       // Bus address of record 0
+#define ABACUS_REG_RING_ENTRIES (ABACUS_REG_RING_BASE + 0x08)       // Records in the ring, at least 2
+#define ABACUS_REG_RING_HEAD (ABACUS_REG_RING_BASE + 0x0C)          // Next record the hardware writes
+#define ABACUS_REG_RING_TAIL (ABACUS_REG_RING_BASE + 0x10)          // Next record software consumes
+#define ABACUS_REG_RING_DROPPED (ABACUS_REG_RING_BASE + 0x14)       // Snapshots lost to a full ring
+#define ABACUS_REG_RING_IRQ_THRESHOLD (ABACUS_REG_RING_BASE + 0x18) // Records per interrupt, 0 counts as 1
+#define ABACUS_REG_RING_STATUS (ABACUS_REG_RING_BASE + 0x1C)        // ABACUS_RING_STATUS_*
+
+#define ABACUS_RING_STATUS_IRQ (1U << 0)       // Threshold reached or a snapshot dropped, write 1 to clear
+#define ABACUS_RING_STATUS_BUSY (1U << 1)      // A record is being written
+#define ABACUS_RING_STATUS_BUS_ERROR (1U << 2) // A write failed, the ring is stopped until the next start
+#define ABACUS_RING_MAX_ENTRIES 65536
+
+// Programmable event counters. Each counts the ABACUS_EVENT_* chosen by its select register, every cycle
+// the event is high or, with ABACUS_EVENT_SELECT_EDGE, on its rising edges. Writing a select register
+// restarts its counter from zero. The counters are read like the others, low word then COUNTER_HI.
+#define ABACUS_REG_EVENT_COUNTER(n) (ABACUS_REG_EVENT_BASE + 4 * (n))
+#define ABACUS_REG_EVENT_SELECT(n) (ABACUS_REG_EVENT_BASE + 0x40 + 4 * (n))
+#define ABACUS_REG_EVENT_NUM_COUNTERS (ABACUS_REG_EVENT_BASE + 0x80) // Counters the hardware was built with
+#define ABACUS_EVENT_MAX_COUNTERS 16
+
+#define ABACUS_EVENT_SELECT_EVENT 0xFFU       // ABACUS_EVENT_*
+#define ABACUS_EVENT_SELECT_EDGE (1U << 8)    // Count rising edges instead of cycles
+#define ABACUS_EVENT_SELECT_ENABLE (1U << 31) // The counter holds its count while this is 0
+
+// Events of the programmable counters, the single-bit core nets in abacus_top port order
+#define ABACUS_EVENT_INSTRUCTION_ISSUED 0
+#define ABACUS_EVENT_ICACHE_REQUEST 1
+#define ABACUS_EVENT_DCACHE_REQUEST 2
+#define ABACUS_EVENT_ICACHE_MISS 3
+#define ABACUS_EVENT_DCACHE_HIT 4
+#define ABACUS_EVENT_ICACHE_LINE_FILL 5 // A fill is in progress
+#define ABACUS_EVENT_DCACHE_LINE_FILL 6
+#define ABACUS_EVENT_BRANCH_MISPREDICT 7
+#define ABACUS_EVENT_RAS_MISPREDICT 8
+#define ABACUS_EVENT_ISSUE_NO_INSTRUCTION 9
+#define ABACUS_EVENT_ISSUE_NO_ID 10
+#define ABACUS_EVENT_ISSUE_FLUSH 11
+#define ABACUS_EVENT_ISSUE_UNIT_BUSY 12
+#define ABACUS_EVENT_ISSUE_OPERANDS_NOT_READY 13
+#define ABACUS_EVENT_ISSUE_HOLD 14
+#define ABACUS_EVENT_ISSUE_MULTI_SOURCE 15
+#define ABACUS_EVENT_CYCLE 16           // Always high
+#define ABACUS_NUM_EVENTS 17
+
+// Branch misprediction hot list, the most mispredicted branches of the hart in a space-saving table.
+// A branch that is not in the table takes over the entry with the fewest mispredictions and inherits
+// that count as its error, so an entry overstates its branch by at most the error. The table is copied
+// on each snapshot like the counters, and ABACUS_IOC_CLEAR of ABACUS_UNIT_BH empties it.
+#define ABACUS_REG_BH_ENTRIES (ABACUS_REG_BH_BASE + 0x0)     // Entries the hardware was built with, 0 without a hot list
+#define ABACUS_REG_BH_MISPREDICTS (ABACUS_REG_BH_BASE + 0x4) // Every mispredicted branch, 32 bits
+#define ABACUS_REG_BH_BRANCHES (ABACUS_REG_BH_BASE + 0x8)    // Every resolved branch, 32 bits
+#define ABACUS_REG_BH_ENTRY(n) (ABACUS_REG_BH_BASE + 0x10 + 16 * (n)) // struct abacus_branch_entry
+#define ABACUS_BH_MAX_ENTRIES 15
+
+// Data cache miss sketch, the misses of every address granule (address >> granule shift) counted in a
+// count-min sketch of ABACUS_MS_ROWS rows. Row r counts a granule g in column
+// ((g * ABACUS_MS_HASH[r]) mod 2^32) >> (32 - log2(width)), so the smallest of its ABACUS_MS_ROWS
+// counters is an estimate of its misses that is never too low. The top-K table holds the granules
+// with the largest estimates. It and the total are copied on each snapshot like the counters, the
+// sketch is read live. Disabling the unit pauses it, ABACUS_REG_UNIT_CLEAR and ABACUS_IOC_CLEAR
+// empty it.
+#define ABACUS_REG_MS_WIDTH (ABACUS_REG_MS_BASE + 0x00)         // Counters per row, 0 without a sketch
+#define ABACUS_REG_MS_TOPK_ENTRIES (ABACUS_REG_MS_BASE + 0x04)  // Entries in the top-K table
+#define ABACUS_REG_MS_STATUS (ABACUS_REG_MS_BASE + 0x08)        // ABACUS_MS_STATUS_* bits
+#define ABACUS_REG_MS_GRANULE_SHIFT (ABACUS_REG_MS_BASE + 0x0C) // 6 for 64-byte lines (default), 12 for pages
+#define ABACUS_REG_MS_FILTER_LOW (ABACUS_REG_MS_BASE + 0x10)    // Lowest miss address counted
+#define ABACUS_REG_MS_FILTER_HIGH (ABACUS_REG_MS_BASE + 0x14)   // Highest miss address counted
+#define ABACUS_REG_MS_TOTAL (ABACUS_REG_MS_BASE + 0x18)         // Misses counted, 32 bits
+#define ABACUS_REG_MS_INDEX (ABACUS_REG_MS_BASE + 0x1C)         // Counter read next, row * width + column
+#define ABACUS_REG_MS_DATA (ABACUS_REG_MS_BASE + 0x20)          // Reads a counter and advances the index, no bursts
+#define ABACUS_REG_MS_TOPK(n) (ABACUS_REG_MS_BASE + 0x40 + 8 * (n)) // struct abacus_miss_entry
+#define ABACUS_MS_STATUS_CLEARING 0x1 // The sketch is being zeroed after a clear, misses are not counted yet
+#define ABACUS_MS_ROWS 4
+#define ABACUS_MS_MAX_WIDTH 4096
+#define ABACUS_MS_MAX_ENTRIES 16
+#define ABACUS_MS_HASH { 0x9E3779B1U, 0x85EBCA77U, 0xC2B2AE3DU, 0x27D4EB2FU } // Multiplier of each row
+
+// Memory bus profiler, traffic on the Wishbone bus between the core and memory. The 64-bit counters
+// are in the order of struct abacus_bus_counters from cycles to the histogram, then the 32-bit
+// latency extremes. In a multi-hart build the harts share the bus and only hart 0 has the unit.
+#define ABACUS_REG_BUS_LATENCY_MIN (ABACUS_REG_BUS_BASE + 0x58) // Cycles, all ones until a transaction completes
+#define ABACUS_REG_BUS_LATENCY_MAX (ABACUS_REG_BUS_BASE + 0x5C)
+#define ABACUS_BUS_NUM_COUNTERS (9 + ABACUS_LATENCY_BUCKETS)
+
+// Rate alarms. Alarm n counts the ABACUS_EVENT_* chosen by its select register over tumbling windows of
+// counted cycles, and crosses the first time a window counts more than its threshold. A crossing sets
+// its status bit, and the first one since the status was clear latches the PC of the last issued
+// instruction and the timestamp. With ABACUS_ALARM_SELECT_FREEZE it also takes a snapshot and holds
+// back automatic snapshots until its status bit is cleared, so the snapshot window keeps the counters
+// of the crossing. Software snapshots still replace it. The driver collects crossings into a log read
+// with ABACUS_IOC_READ_ALARMS, from the interrupt when it has one.
+#define ABACUS_REG_ALARM_COUNT (ABACUS_REG_ALARM_BASE + 0x00)     // Alarms the hardware was built with, 0 without any
+#define ABACUS_REG_ALARM_STATUS (ABACUS_REG_ALARM_BASE + 0x04)    // Bit n: alarm n crossed, sticky, write 1 to clear
+#define ABACUS_REG_ALARM_PC (ABACUS_REG_ALARM_BASE + 0x08)        // Last issued PC at the first crossing
+#define ABACUS_REG_ALARM_TIMESTAMP (ABACUS_REG_ALARM_BASE + 0x10) // Cycles since reset at the first crossing, 64 bits
+#define ABACUS_REG_ALARM_SELECT(n) (ABACUS_REG_ALARM_BASE + 0x20 + 16 * (n)) // Writing it restarts the alarm
+#define ABACUS_REG_ALARM_WINDOW(n) (ABACUS_REG_ALARM_BASE + 0x24 + 16 * (n)) // Counted cycles per window, 0 stops the alarm
+#define ABACUS_REG_ALARM_THRESHOLD(n) (ABACUS_REG_ALARM_BASE + 0x28 + 16 * (n))
+#define ABACUS_REG_ALARM_LAST(n) (ABACUS_REG_ALARM_BASE + 0x2C + 16 * (n))   // Count of the last full window, saturating
+#define ABACUS_ALARM_MAX 8
+// Alarm select bit on top of the ABACUS_EVENT_SELECT_* ones
+#define ABACUS_ALARM_SELECT_FREEZE (1U << 9) // Freeze the snapshot on a crossing
+
+// Unit filters. Filter n gates the unit of ABACUS_UNIT_* bit n, and the filter of ABACUS_UNIT_EVENTS also
+// gates the rate alarms. A unit only counts in the cycles its hart runs in one of the ABACUS_FILTER_*
+// modes and, with ABACUS_FILTER_ASID_MATCH, in the address space of the ASID field. Every mode passes out
+// of reset. An event belongs to the mode and ASID of the cycle it is seen in, so a line fill still
+// outstanding after a trap is counted in the mode of the handler.
+#define ABACUS_REG_UNIT_FILTER(n) (ABACUS_REG_FILTER_BASE + 4 * (n))
+#define ABACUS_REG_CORE_MODE (ABACUS_REG_FILTER_BASE + 0x20) // Bits 1:0 privilege mode, bits 24:16 ASID of the hart now
+#define ABACUS_UNIT_FILTERS 8
+#define ABACUS_FILTER_USER (1U << 0)
+#define ABACUS_FILTER_SUPERVISOR (1U << 1)
+#define ABACUS_FILTER_MACHINE (1U << 3)
+#define ABACUS_FILTER_MODES 0xFU           // Bit m passes privilege mode m, the value out of reset
+#define ABACUS_FILTER_ASID_SHIFT 16
+#define ABACUS_FILTER_ASID (0x1FFU << ABACUS_FILTER_ASID_SHIFT)
+#define ABACUS_FILTER_ASID_MATCH (1U << 31)
+
+// Snapshot window, a copy of every snapshot counter that reads without side effects, so it can be
+// fetched with burst reads. The ip, cp and su counters follow each other as little-endian 64-bit words,
+// then the four 32-bit line fill extremes, the layout of struct abacus_counters from ip on.
+#define ABACUS_SNAPSHOT_WINDOW_SIZE \
+	((ABACUS_IP_NUM_COUNTERS + ABACUS_CP_NUM_COUNTERS + ABACUS_SU_NUM_COUNTERS) * 8 + 4 * 4)
+
+// ABACUS_REG_SU_LEVEL_MODE bits of the issue stall counters, which then add up stall cycles
+#define ABACUS_SU_LEVEL_ISSUE_STALLS 0x1FC
+
+/* Unit mask used by ABACUS_IOC_ENABLE / ABACUS_IOC_DISABLE / ABACUS_IOC_CLEAR and abacus_counters.enabled.
+ * Disabling a unit pauses it and keeps its counters, ABACUS_IOC_CLEAR empties it. */
+#define ABACUS_UNIT_IP (1U << 0)
+#define ABACUS_UNIT_CP (1U << 1)
+#define ABACUS_UNIT_SU (1U << 2)
+#define ABACUS_UNIT_PC (1U << 3)
+#define ABACUS_UNIT_BH (1U << 4)
+#define ABACUS_UNIT_MS (1U << 5)
+#define ABACUS_UNIT_BUS (1U << 6)
+#define ABACUS_UNIT_ALL (ABACUS_UNIT_IP | ABACUS_UNIT_CP | ABACUS_UNIT_SU | ABACUS_UNIT_PC | ABACUS_UNIT_BH | ABACUS_UNIT_MS | \
+			 ABACUS_UNIT_BUS)
+#define ABACUS_UNIT_EVENTS (1U << 7) // ABACUS_IOC_CLEAR only, the programmable counters are enabled one by one
+
+// Counters are 64 bits wide. Each one is read as its low word at the counter's register,
+// followed by ABACUS_REG_COUNTER_HI, which holds the upper word latched by that low word read.
+//
+// Field order of each unit matches its register order, so a unit can be filled
+// by reading its register block front to back
+struct abacus_ip_counters {
+	__u64 load_word;
+	__u64 store_word;
+	__u64 addition;
+	__u64 subtraction;
+	__u64 branch;
+	__u64 jump;
+	__u64 system_privilege;
+	__u64 atomic;
+	__u64 logical;
+	__u64 shift;
+	__u64 compare;
+	__u64 upper_immediate;
+	__u64 multiply;
+	__u64 divide;
+	__u64 csr;
+	__u64 fence;
+	__u64 fp_load;
+	__u64 fp_store;
+	__u64 fp_arithmetic;
+	__u64 fp_fused_multiply_add;
+	__u64 fp_divide_sqrt;
+	__u64 other;  // Encodings outside RV32IMAFD, so the classes add up to total
+	__u64 total;  // Every issued instruction
+};
+
+struct abacus_cp_counters {
+	__u64 icache_request;
+	__u64 icache_hit;
+	__u64 icache_miss;
+	__u64 icache_line_fill_latency;
+	__u64 dcache_request;
+	__u64 dcache_hit;
+	__u64 dcache_miss;
+	__u64 dcache_line_fill_latency;
+	__u64 line_fill_occupancy; // Outstanding fills summed per cycle, divided by line_fill_active gives the MLP
+	__u64 line_fill_active;    // Cycles with at least one fill outstanding
+	__u64 icache_line_fill_histogram[ABACUS_LATENCY_BUCKETS];
+	__u64 dcache_line_fill_histogram[ABACUS_LATENCY_BUCKETS];
+};
+
+struct abacus_su_counters {
+	__u64 branch_misprediction;
+	__u64 ras_misprediction;
+	__u64 issue_no_instruction;
+	__u64 issue_no_id;
+	__u64 issue_flush;
+	__u64 issue_unit_busy;
+	__u64 issue_operands_not_ready;
+	__u64 issue_hold;
+	__u64 issue_multi_source;
+	__u64 cycles;        // Every cycle the unit counted
+	__u64 instructions;  // Issued instructions, also the issue cycles of the CPI stack
+	// CPI stack: every cycle that did not issue, in the category of its first stall cause in this
+	// order, so instructions and the six categories add up to cycles
+	__u64 cpi_flush;
+	__u64 cpi_frontend_empty;
+	__u64 cpi_hold;
+	__u64 cpi_operand_dependency;
+	__u64 cpi_unit_busy;
+	__u64 cpi_other;
+};
+
+// Every member is naturally aligned, so the structure is densely packed with no padding and
+// has the same layout for 32- and 64-bit userspace
+struct abacus_counters {
+	__u32 version;  // ABACUS_ABI_VERSION of the driver that filled this in
+	__u32 enabled;  // ABACUS_UNIT_* mask of the units that were enabled at read time
+	__u32 ip_overflow; // Counters that wrapped since the last ABACUS_IOC_CLEAR_OVERFLOW, bit n = counter n
+	__u32 cp_overflow;
+	__u32 su_overflow;
+	__u32 reserved;
+	struct abacus_ip_counters ip;
+	struct abacus_cp_counters cp;
+	struct abacus_su_counters su;
+	__u32 icache_line_fill_min; // Cycles, all ones if no fill completed yet
+	__u32 icache_line_fill_max;
+	__u32 dcache_line_fill_min;
+	__u32 dcache_line_fill_max;
+};
+
+// One snapshot in the ring. The hardware writes the sequence word last, so a record is complete once
+// its sequence is the one the reader expects next; the first record of a run has sequence 1.
+struct abacus_ring_record {
+	__u64 timestamp; // Cycles since reset at the snapshot
+	__u32 flags;     // ABACUS_RING_TORN, and in bits 31:16 the snapshots dropped just before this one
+	__u32 sequence;
+	struct abacus_ip_counters ip;
+	struct abacus_cp_counters cp;
+	struct abacus_su_counters su;
+	__u32 icache_line_fill_min;
+	__u32 icache_line_fill_max;
+	__u32 dcache_line_fill_min;
+	__u32 dcache_line_fill_max;
+	__u32 reserved[4]; // Pads a record to a multiple of 64 bytes
+};
+
+#define ABACUS_RING_TORN (1U << 0) // A software snapshot changed the counters while they were copied
+#define ABACUS_RING_DROPS(flags) ((flags) >> 16)
+
+// Ring configuration, ABACUS_IOC_RING_START
+struct abacus_ring_config {
+	__u32 entries;       // Records in the ring, 2 to ABACUS_RING_MAX_ENTRIES
+	__u32 interval;      // Cycles between records, programmed as the snapshot interval of every hart until the ring stops
+	__u32 irq_threshold; // Records per wakeup of poll(), 0 counts as 1
+	__u32 reserved;
+};
+
+// Ring position, ABACUS_IOC_RING_STATUS. Records tail up to head are ready, tail advances with
+// ABACUS_IOC_RING_CONSUME.
+struct abacus_ring_status {
+	__u32 head;
+	__u32 tail;
+	__u32 dropped;   // Snapshots lost to a full ring since the start
+	__u32 status;    // ABACUS_RING_STATUS_*
+};
+
+// Sampler configuration, ABACUS_IOC_SAMPLER_START. A kernel timer reads the counters every period
+// and queues what each one gained since the previous sample.
+struct abacus_sampler_config {
+	__u32 period_ns; // ABACUS_SAMPLER_MIN_PERIOD_NS or more
+	__u32 entries;   // Samples queued at most, a power of two up to ABACUS_SAMPLER_MAX_ENTRIES
+	__u32 units;     // ABACUS_UNIT_IP, _CP and _SU mask of the counters read, the others stay 0
+	__u32 hart;      // Hart to sample, or ABACUS_HART_ALL for the sum of every hart
+	__u32 wakeup;    // Samples queued before read() and poll() wake up, 0 counts as 1
+	__u32 reserved;
+};
+
+#define ABACUS_SAMPLER_MIN_PERIOD_NS 10000
+#define ABACUS_SAMPLER_MAX_ENTRIES 65536
+
+// One sample, read() from the sampler device in whole samples. A sample that finds the queue full is
+// skipped, the next one then covers the skipped period too and its sequence jumps by the skipped count.
+struct abacus_sample {
+	__u64 timestamp; // CLOCK_MONOTONIC nanoseconds of the read
+	__u32 sequence;  // 1 for the first sample of a run
+	__u32 reserved;
+	struct abacus_ip_counters ip; // Counts since the previous sample
+	struct abacus_cp_counters cp;
+	struct abacus_su_counters su;
+};
+
+// Sampler state, ABACUS_IOC_SAMPLER_STATUS
+struct abacus_sampler_status {
+	__u32 running;
+	__u32 queued;    // Samples waiting to be read
+	__u32 skipped;   // Samples skipped because the queue was full, since the start
+	__u32 period_ns;
+};
+
+// Counters of one hart, or of every hart summed, ABACUS_IOC_READ_HART_COUNTERS. In the sum the line
+// fill minimums are the smallest of any hart, the maximums the largest, and the overflow and enabled
+// masks are merged.
+struct abacus_hart_counters {
+	__u32 hart;      // In: hart to read, or ABACUS_HART_ALL
+	__u32 num_harts; // Out: harts the hardware was built with
+	struct abacus_counters counters;
+};
+
+// Totals of one process, accumulated by the driver at each context switch while task
+// attribution is on. Counts since the process was last switched in are not included yet.
+struct abacus_task_counters {
+	__u32 pid;      // In: thread group ID of the process to look up
+	__u32 reserved;
+	struct abacus_ip_counters ip;
+	struct abacus_cp_counters cp;
+	struct abacus_su_counters su;
+};
+
+// Drains up to capacity PC samples from the sampler FIFO into the samples array
+struct abacus_pc_samples {
+	__u64 samples;  // Userspace pointer to an array of capacity __u32
+	__u32 capacity;
+	__u32 count;    // Out: samples written to the array
+	__u32 dropped;  // Out: samples lost to a full FIFO since the sampler was last cleared
+	__u32 pending;  // Out: samples left in the FIFO after this read
+};
+
+// One entry of the branch hot list, in register order. An empty entry is all zero.
+struct abacus_branch_entry {
+	__u32 pc;
+	__u32 mispredicts; // At most error more than the branch really had since it took the entry
+	__u32 executions;  // Resolves of the branch since it took the entry
+	__u32 error;
+};
+
+// Branch hot list of one hart, ABACUS_IOC_READ_BRANCH_HOTLIST, in table order
+struct abacus_branch_hotlist {
+	__u32 hart;        // In: hart to read
+	__u32 entries;     // Out: entries the hardware was built with, 0 without a hot list
+	__u32 mispredicts; // Out: every mispredicted branch
+	__u32 branches;    // Out: every resolved branch
+	struct abacus_branch_entry entry[ABACUS_BH_MAX_ENTRIES];
+};
+
+// What the miss sketch counts, ABACUS_IOC_SET_MISS_SKETCH. Applies to every hart and empties the sketches,
+// since granules of different sizes cannot be mixed.
+struct abacus_miss_config {
+	__u32 granule_shift; // 0 to 31, 6 for cache lines, 12 for pages
+	__u32 filter_low;    // Only misses from filter_low to filter_high, inclusive, are counted
+	__u32 filter_high;
+	__u32 reserved;
+};
+
+// One entry of the miss sketch top-K table, in register order. An empty entry is all zero.
+struct abacus_miss_entry {
+	__u32 addr;  // First address of the granule
+	__u32 count; // Estimated misses, never below the real count
+};
+
+// Miss sketch of one hart, ABACUS_IOC_READ_MISS_SKETCH
+struct abacus_miss_sketch {
+	__u32 hart;          // In: hart to read
+	__u32 width;         // Out: counters per row, 0 without a sketch
+	__u64 counters;      // In: userspace pointer to capacity __u32 for the sketch in row order, or 0 for the table only
+	__u32 capacity;      // In: at least ABACUS_MS_ROWS * width when counters is set
+	__u32 entries;       // Out: entries in the top-K table
+	__u32 total;         // Out: misses counted
+	__u32 status;        // Out: ABACUS_MS_STATUS_* bits
+	struct abacus_miss_config config; // Out: what was counted
+	struct abacus_miss_entry entry[ABACUS_MS_MAX_ENTRIES];
+};
+
+// Memory bus counters of one hart, ABACUS_IOC_READ_BUS_COUNTERS, in register order from cycles on. A
+// transaction is a single access or a whole burst, and its latency runs from its request to its first
+// word. With one request outstanding at most, occupancy / cycles is how close the bus is to saturation.
+struct abacus_bus_counters {
+	__u32 hart;     // In: hart to read, 0 in a multi-hart build
+	__u32 overflow; // Out: counters that wrapped since the last ABACUS_IOC_CLEAR_OVERFLOW, bit n = counter n, bit 9 the histogram
+	__u64 cycles;      // Every cycle the unit counted
+	__u64 reads;       // Read transactions
+	__u64 writes;      // Write transactions
+	__u64 read_bytes;  // Bytes read, from the byte selects of the acknowledged beats
+	__u64 write_bytes;
+	__u64 busy;        // Cycles with a bus cycle open
+	__u64 occupancy;   // Outstanding requests summed per cycle
+	__u64 wait;        // Cycles a request waited for its acknowledge
+	__u64 latency;     // First word latencies summed, divided by reads + writes gives the mean
+	__u64 latency_histogram[ABACUS_LATENCY_BUCKETS]; // Bucket b counts 2^b to 2^(b+1)-1 cycles
+	__u32 latency_min; // Cycles, all ones if no transaction completed yet
+	__u32 latency_max;
+};
+
+// Trigger configuration, written with ABACUS_IOC_SET_TRIGGER and read back with ABACUS_IOC_GET_TRIGGER
+struct abacus_trigger {
+	__u32 control;       // ABACUS_TRIGGER_* mask, 0 counts everywhere
+	__u32 start_pc_low;
+	__u32 start_pc_high;
+	__u32 stop_pc_low;
+	__u32 stop_pc_high;
+	__u32 active;        // Out: inside the region
+	__u32 region_count;  // Out: regions entered since the trigger was last set
+	__u32 reserved;
+};
+
+// Programs one alarm on every hart, ABACUS_IOC_SET_ALARM. The window and threshold are written before
+// the select register, whose write restarts the alarm.
+struct abacus_alarm_config {
+	__u32 index;     // Alarm to program, below ABACUS_REG_ALARM_COUNT
+	__u32 select;    // ABACUS_EVENT_SELECT_* and ABACUS_ALARM_SELECT_FREEZE bits, 0 stops the alarm
+	__u32 window;    // Counted cycles per window
+	__u32 threshold; // Crossing when a window counts more than this
+};
+
+// One crossing recorded by the driver. The PC and timestamp are those of the first alarm in status.
+struct abacus_alarm_event {
+	__u64 timestamp; // Cycles since reset at the crossing, the clock of abacus_ring_record
+	__u64 time_ns;   // CLOCK_MONOTONIC nanoseconds when the driver collected it
+	__u32 hart;
+	__u32 status;    // Alarms that had crossed, bit n = alarm n
+	__u32 pc;        // Last issued instruction at the crossing
+	__u32 frozen;    // 1 if the counters below are the snapshot of the crossing, 0 if no freezing alarm crossed
+	struct abacus_ip_counters ip;
+	struct abacus_cp_counters cp;
+	struct abacus_su_counters su;
+	__u32 icache_line_fill_min;
+	__u32 icache_line_fill_max;
+	__u32 dcache_line_fill_min;
+	__u32 dcache_line_fill_max;
+};
+
+// Drains up to capacity events from the alarm log, oldest first, ABACUS_IOC_READ_ALARMS
+struct abacus_alarm_events {
+	__u64 events;   // Userspace pointer to an array of capacity struct abacus_alarm_event
+	__u32 capacity;
+	__u32 count;    // Out: events written to the array
+	__u32 dropped;  // Out: events lost to a full log since the driver was loaded
+	__u32 pending;  // Out: events left in the log after this read
+};
+
+// Filters units on every hart, ABACUS_IOC_SET_FILTER. The ASID is that of satp, which the kernel assigns
+// per process and may reassign when it runs out of them, so a filter on one is best set just before the
+// region it measures. ABACUS_FILTER_CALLER_ASID takes the ASID of the calling process, which keeps it
+// until it exits or execs.
+struct abacus_filter {
+	__u32 units; // ABACUS_UNIT_* mask, ABACUS_UNIT_EVENTS included
+	__u32 modes; // ABACUS_FILTER_USER, _SUPERVISOR and _MACHINE bits, ABACUS_FILTER_MODES counts in all of them
+	__u32 asid;  // Address space counted with ABACUS_FILTER_MATCH_ASID, out: the one programmed
+	__u32 flags; // ABACUS_FILTER_MATCH_ASID, ABACUS_FILTER_CALLER_ASID
+};
+
+#define ABACUS_FILTER_MATCH_ASID (1U << 0)  // Only count in the address space of asid
+#define ABACUS_FILTER_CALLER_ASID (1U << 1) // Only count in the address space of the caller
+
+#define ABACUS_IOC_MAGIC 0xAB
+
+#define ABACUS_IOC_GET_VERSION   _IOR(ABACUS_IOC_MAGIC, 0, __u32)
+#define ABACUS_IOC_READ_COUNTERS _IOR(ABACUS_IOC_MAGIC, 1, struct abacus_counters)
+#define ABACUS_IOC_ENABLE        _IOW(ABACUS_IOC_MAGIC, 2, __u32)
+#define ABACUS_IOC_DISABLE       _IOW(ABACUS_IOC_MAGIC, 3, __u32)
+#define ABACUS_IOC_SNAPSHOT      _IO(ABACUS_IOC_MAGIC, 4)
+#define ABACUS_IOC_SET_SNAPSHOT_INTERVAL _IOW(ABACUS_IOC_MAGIC, 5, __u32)
+#define ABACUS_IOC_GET_SNAPSHOT_INTERVAL _IOR(ABACUS_IOC_MAGIC, 6, __u32)
+#define ABACUS_IOC_CLEAR_OVERFLOW _IO(ABACUS_IOC_MAGIC, 7)
+#define ABACUS_IOC_READ_PC_SAMPLES _IOWR(ABACUS_IOC_MAGIC, 8, struct abacus_pc_samples)
+#define ABACUS_IOC_SET_PC_SAMPLE_PERIOD _IOW(ABACUS_IOC_MAGIC, 9, __u32)
+#define ABACUS_IOC_TASK_ATTRIBUTION _IOW(ABACUS_IOC_MAGIC, 10, __u32) // 1 starts per-process attribution from zero, 0 stops it
+#define ABACUS_IOC_READ_TASK_COUNTERS _IOWR(ABACUS_IOC_MAGIC, 11, struct abacus_task_counters)
+#define ABACUS_IOC_SET_TRIGGER _IOW(ABACUS_IOC_MAGIC, 12, struct abacus_trigger)
+#define ABACUS_IOC_GET_TRIGGER _IOR(ABACUS_IOC_MAGIC, 13, struct abacus_trigger)
+#define ABACUS_IOC_SET_SU_LEVEL_MODE _IOW(ABACUS_IOC_MAGIC, 14, __u32) // ABACUS_REG_SU_LEVEL_MODE bits
+#define ABACUS_IOC_RING_START _IOW(ABACUS_IOC_MAGIC, 15, struct abacus_ring_config) // Clears the ring and starts a run
+#define ABACUS_IOC_RING_STOP _IO(ABACUS_IOC_MAGIC, 16)       // Stops after the record being written, the ring stays mapped
+#define ABACUS_IOC_RING_STATUS _IOR(ABACUS_IOC_MAGIC, 17, struct abacus_ring_status)
+#define ABACUS_IOC_RING_CONSUME _IOW(ABACUS_IOC_MAGIC, 18, __u32) // New tail, records before it may be overwritten
+#define ABACUS_IOC_READ_HART_COUNTERS _IOWR(ABACUS_IOC_MAGIC, 19, struct abacus_hart_counters)
+#define ABACUS_IOC_SAMPLER_START _IOW(ABACUS_IOC_MAGIC, 20, struct abacus_sampler_config) // Drops queued samples and starts a run
+#define ABACUS_IOC_SAMPLER_STOP _IO(ABACUS_IOC_MAGIC, 21) // Queued samples can still be read
+#define ABACUS_IOC_SAMPLER_STATUS _IOR(ABACUS_IOC_MAGIC, 22, struct abacus_sampler_status)
+#define ABACUS_IOC_READ_BRANCH_HOTLIST _IOWR(ABACUS_IOC_MAGIC, 23, struct abacus_branch_hotlist)
+#define ABACUS_IOC_SET_MISS_SKETCH _IOW(ABACUS_IOC_MAGIC, 24, struct abacus_miss_config)
+#define ABACUS_IOC_READ_MISS_SKETCH _IOWR(ABACUS_IOC_MAGIC, 25, struct abacus_miss_sketch)
+#define ABACUS_IOC_READ_BUS_COUNTERS _IOWR(ABACUS_IOC_MAGIC, 26, struct abacus_bus_counters)
+#define ABACUS_IOC_SET_ALARM _IOW(ABACUS_IOC_MAGIC, 27, struct abacus_alarm_config)
+#define ABACUS_IOC_READ_ALARMS _IOWR(ABACUS_IOC_MAGIC, 28, struct abacus_alarm_events)
+#define ABACUS_IOC_CLEAR _IOW(ABACUS_IOC_MAGIC, 29, __u32) // ABACUS_UNIT_* mask, cleared on every hart on one edge
+#define ABACUS_IOC_SET_FILTER _IOWR(ABACUS_IOC_MAGIC, 30, struct abacus_filter)
+
+#endif // ABACUS_IOCTL_H
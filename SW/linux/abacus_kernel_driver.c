@@ -7,9 +7,17 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/io.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/version.h>
+#ifdef CONFIG_RISCV
+#include <asm/csr.h>
+#endif
 
-#define DEVICE_NAME "abacus"
-#define ABACUS_BASE_ADDR 0xf0030000
+#include "abacus_driver.h"
 
 #define INSTRUCTION_PROFILE_UNIT_BASE_ADDR (ABACUS_BASE_ADDR + 0x0100)
 #define CACHE_PROFILE_UNIT_BASE_ADDR (ABACUS_BASE_ADDR + 0x0200)
@@ -17,61 +25,157 @@
 
 static int major_number;
 
-static void __iomem *abacus_base;
+void __iomem *abacus_base;
+unsigned int abacus_num_harts = 1;
 
+// Overflow, snapshot ring and rate alarm interrupt line, the PLIC source that core.py wires abacus_irq to.
+// Without it the overflow and alarm status are only read from the hardware on demand and the snapshot
+// ring is polled by a timer.
+static int irq = -1;
+module_param(irq, int, 0444);
+MODULE_PARM_DESC(irq, "Linux IRQ number of the ABACUS overflow, snapshot ring and rate alarm interrupt (-1 to poll)");
+
+// Counters narrower than 64 bits wrap in the hardware and are extended to 64 bits by abacus_counter_delta()
+static unsigned int counter_width = 64;
+module_param(counter_width, uint, 0444);
+MODULE_PARM_DESC(counter_width, "COUNTER_WIDTH of the ABACUS build, 32 to 64 (default 64)");
+
+DEFINE_RAW_SPINLOCK(abacus_read_lock);
+
+// Reading PC_SAMPLE_DATA pops the sampler FIFO, so only one reader drains it at a time
+static DEFINE_MUTEX(abacus_pc_sample_lock);
+static DEFINE_MUTEX(abacus_trigger_lock);
+// The miss sketch configuration and its read index, which every read of MS_DATA advances
+static DEFINE_MUTEX(abacus_miss_lock);
+
+// The programmable counters are collected too, so their wraps do not hold the interrupt line
+static const unsigned int unit_overflow_offsets[] = {
+	ABACUS_REG_IP_OVERFLOW,
+	ABACUS_REG_CP_OVERFLOW,
+	ABACUS_REG_SU_OVERFLOW,
+	ABACUS_REG_EVENT_OVERFLOW,
+	ABACUS_REG_BUS_OVERFLOW,
+};
+
+// Overflow bits collected by the interrupt handler, which clears them in the hardware
+static DEFINE_SPINLOCK(abacus_overflow_lock);
+static u32 overflow_status[ABACUS_MAX_HARTS][ARRAY_SIZE(unit_overflow_offsets)];
+
+// COUNTER_HI is latched per hart, so it is read from the page of the counter
+u64 abacus_read_counter64(unsigned int offset) {
+	u32 lo = ioread32(abacus_base + offset);
+	u32 hi = ioread32(abacus_base + (offset & ~(ABACUS_HART_STRIDE - 1)) + ABACUS_REG_COUNTER_HI);
+
+	return ((u64)hi << 32) | lo;
+}
+
+// A counter below its last value wrapped if it is narrower than 64 bits. A 64-bit counter that went
+// backwards was restarted by clearing its unit instead, and counted now since then.
+u64 abacus_counter_delta(u64 now, u64 last) {
+	if (now >= last)
+		return now - last;
+	if (counter_width < 64)
+		return now + (1ULL << counter_width) - last;
+	return now;
+}
+
+// Moves the hardware overflow bits into overflow_status and clears them in the hardware,
+// returns true if any counter had wrapped
+static bool abacus_collect_overflow(void) {
+	unsigned long flags;
+	unsigned int h, i;
+	u32 status;
+	bool overflow = false;
+
+	spin_lock_irqsave(&abacus_overflow_lock, flags);
+	for (h = 0; h < abacus_num_harts; h++) {
+		for (i = 0; i < ARRAY_SIZE(unit_overflow_offsets); i++) {
+			status = ioread32(abacus_base + ABACUS_HART_OFFSET(h) + unit_overflow_offsets[i]);
+			if (status) {
+				iowrite32(status, abacus_base + ABACUS_HART_OFFSET(h) + unit_overflow_offsets[i]);
+				overflow_status[h][i] |= status;
+				overflow = true;
+			}
+		}
+	}
+	spin_unlock_irqrestore(&abacus_overflow_lock, flags);
+	return overflow;
+}
+
+static irqreturn_t abacus_irq_handler(int irq, void *dev_id) {
+	if (abacus_collect_overflow())
+		pr_warn_ratelimited("ABACUS counter overflow\n");
+	abacus_ring_interrupt();
+	abacus_alarm_collect();
+	return IRQ_HANDLED;
+}
+
+static const struct file_operations sampler_fops;
+
+// The register page is mapped once at module load, so every open file descriptor,
+// ioctl and mmap shares the same mapping. The sampler minor reads samples instead of commands,
+// its file takes a reference on sampler_fops in place of the one open took on the device fops.
 static int device_open(struct inode *inode, struct file *file) {
-	abacus_base = ioremap(ABACUS_BASE_ADDR, 0x1000); //Map physical address space into virtual address space ( https://lwn.net/Articles/653585/ )	
-	if (!abacus_base) {
-		pr_err("Could not map abacus physical address region to the virtual address space\n");
-		return -ENOMEM;
+	const struct file_operations *fops;
+
+	if (iminor(inode) == ABACUS_SAMPLER_MINOR) {
+		fops = fops_get(&sampler_fops);
+		if (!fops)
+			return -ENODEV;
+		replace_fops(file, fops);
 	}
 	return 0;
 }
 
 static int device_release(struct inode *inode, struct file *file) {
-	iounmap(abacus_base);
 	return 0;
 }
 
+// Instruction classes in register order, for the get_ip_stats command
+static const char *const ip_class_names[ABACUS_IP_NUM_COUNTERS] = {
+    "Load Word", "Store Word", "Addition", "Subtraction", "Branches", "Jumps", "System Privilege", "Atomic",
+    "Logical", "Shift", "Compare", "Upper Immediate", "Multiply", "Divide", "CSR", "Fence",
+    "FP Load", "FP Store", "FP Arithmetic", "FP Fused Multiply-Add", "FP Divide/Sqrt", "Other", "Total Instructions",
+};
+
+static const char *const icp_names[] = {
+    "ICache Requests", "ICache Hits", "ICache Misses", "ICache Line Fill Latency Count",
+};
+
+static const char *const dcp_names[] = {
+    "DCache Requests", "DCache Hits", "DCache Misses", "DCache Line Fill Latency Count",
+};
+
+static const char *const su_names[] = {
+    "Branch Mispredictions", "RAS Mispredictions", "Issue No Instruction", "Issue No ID", "Issue Flush",
+    "Issue Unit Busy", "Issue Operands Busy", "Issue Hold", "Issue Multi Source",
+};
+
+// Text commands of device_read, each reads consecutive counters of one unit
+static const struct {
+    const char *command;
+    const char *unit;
+    unsigned int offset;
+    const char *const *names;
+    unsigned int count;
+} read_commands[] = {
+    { "get_ip_stats", "IP", ABACUS_REG_IP_BASE, ip_class_names, ARRAY_SIZE(ip_class_names) },
+    { "get_icp_stats", "ICP", ABACUS_REG_CP_BASE, icp_names, ARRAY_SIZE(icp_names) },
+    { "get_dcp_stats", "DCP", ABACUS_REG_CP_BASE + 0x10, dcp_names, ARRAY_SIZE(dcp_names) },
+    { "get_su_stats", "SU", ABACUS_REG_SU_BASE, su_names, ARRAY_SIZE(su_names) },
+};
+
+#define ABACUS_READ_OUTPUT_SIZE 1024 // get_ip_stats is the longest response
+
+// Only the counters are read under abacus_read_lock, the response is formatted after it is dropped
 static ssize_t device_read(struct file *file, char __user *buffer, size_t len, loff_t *offset) {
     char command[16]; 
-    char output[512];  // Buffer for storing the response to the command
+    char *output;  // Buffer for storing the response to the command
+    u64 counters[ABACUS_IP_NUM_COUNTERS]; // get_ip_stats reads the most counters
     int output_len;
     size_t copy_len;
-
-    // It may seem like a waste stack space to declare variables for every register in ABACUS,
-    // but compiler warning stating that C90 forbids the mixing of declarations and assignments
-    // provokes me to declare them all at the top incase the driver doesn't work after being uploaded to the 
-    // FPGA via serial (which takes time)
-    unsigned int load_word_counter;
-    unsigned int store_word_counter;
-    unsigned int addition_counter;
-    unsigned int subtraction_counter;
-    unsigned int branch_counter;
-    unsigned int jump_counter;
-    unsigned int system_counter;
-    unsigned int atomic_counter;
-
-    unsigned int icache_request_counter;
-    unsigned int icache_hit_counter;
-    unsigned int icache_miss_counter;
-    unsigned int icache_line_fill_latency_counter;
-
-    unsigned int dcache_request_counter;
-    unsigned int dcache_hit_counter;
-    unsigned int dcache_miss_counter;
-    unsigned int dcache_line_fill_latency_counter;
-
-    unsigned int branch_misprediction_counter;
-    unsigned int ras_misprediction_counter;
-    unsigned int issue_no_instruction_stat_counter;
-    unsigned int issue_no_id_stat_counter;
-    unsigned int issue_flush_stat_counter;
-    unsigned int issue_unit_busy_stat_counter;
-    unsigned int issue_operands_not_ready_stat_counter;
-    unsigned int issue_hold_stat_counter;
-    unsigned int issue_multi_source_stat_counter;
-
+    unsigned long flags;
+    unsigned int i, n;
 
     output_len = 0;
 
@@ -89,101 +193,38 @@ static ssize_t device_read(struct file *file, char __user *buffer, size_t len, l
 
     command[copy_len] = '\0';
 
-    if (strcmp(command, "get_ip_stats") == 0) {
-        load_word_counter = ioread32(abacus_base + 0x100);
-        store_word_counter = ioread32(abacus_base + 0x104);
-        addition_counter = ioread32(abacus_base + 0x108);
-        subtraction_counter = ioread32(abacus_base + 0x10C);
-        branch_counter = ioread32(abacus_base + 0x110);
-        jump_counter = ioread32(abacus_base + 0x114);
-        system_counter = ioread32(abacus_base + 0x118);
-        atomic_counter = ioread32(abacus_base + 0x11C);
-
-        pr_info("Debug: Read the IP unit\n");
-
-        output_len = snprintf(output, sizeof(output),
-                        "Load Word: %u\n"
-                        "Store Word: %u\n"
-                        "Addition: %u\n"
-                        "Subtraction: %u\n"
-                        "Branches: %u\n"
-                        "Jumps: %u\n"
-                        "System Privilege: %u\n"
-                        "Atomic: %u\n",
-                        load_word_counter, store_word_counter, addition_counter, subtraction_counter,
-                        branch_counter, jump_counter, system_counter, atomic_counter);
-    } 
-    
-    else if (strcmp(command, "get_icp_stats") == 0) {
+    for (n = 0; n < ARRAY_SIZE(read_commands); n++) {
+        if (strcmp(command, read_commands[n].command) == 0)
+            break;
+    }
+    if (n == ARRAY_SIZE(read_commands))
+        return -EINVAL; // Return invalid if the command is not recognized
 
-		icache_request_counter = ioread32(abacus_base + 0x200);
-		icache_hit_counter = ioread32(abacus_base + 0x204);
-		icache_miss_counter = ioread32(abacus_base + 0x208);
-		icache_line_fill_latency_counter = ioread32(abacus_base + 0x20C);
+    raw_spin_lock_irqsave(&abacus_read_lock, flags);
+    for (i = 0; i < read_commands[n].count; i++)
+        counters[i] = abacus_read_counter64(read_commands[n].offset + 4 * i);
+    raw_spin_unlock_irqrestore(&abacus_read_lock, flags);
 
-        pr_info("Debug: Read the ICP unit\n");
+    pr_info("Debug: Read the %s unit\n", read_commands[n].unit);
 
-        output_len = snprintf(output, sizeof(output), 
-                        "ICache Requests: %u\n"
-                        "ICache Hits: %u\n"
-                        "ICache Misses: %u\n"
-                        "ICache Line Fill Latency Count: %u\n",
-                        icache_request_counter, icache_hit_counter, icache_miss_counter, icache_line_fill_latency_counter);
-    } 
-    
-    else if (strcmp(command, "get_dcp_stats") == 0) {
-		dcache_request_counter = ioread32(abacus_base + 0x210);
-		dcache_hit_counter = ioread32(abacus_base + 0x214);
-		dcache_miss_counter = ioread32(abacus_base + 0x218);
-		dcache_line_fill_latency_counter = ioread32(abacus_base + 0x21C);
-
-        pr_info("Debug: Read the DCP unit\n");
-
-        output_len = snprintf(output, sizeof(output), 
-                        "DCache Requests: %u\n"
-                        "DCache Hits: %u\n"
-                        "DCache Misses: %u\n"
-                        "ICache Line Fill Latency Count: %u\n",
-                        dcache_request_counter, dcache_hit_counter, dcache_miss_counter, dcache_line_fill_latency_counter);
-    } 
-    
-    else if (strcmp(command, "get_su_stats") == 0) {
-		branch_misprediction_counter = ioread32(abacus_base + 0x300);
-		ras_misprediction_counter = ioread32(abacus_base + 0x304);
-		issue_no_instruction_stat_counter = ioread32(abacus_base + 0x308);
-		issue_no_id_stat_counter = ioread32(abacus_base + 0x30C);
-		issue_flush_stat_counter = ioread32(abacus_base + 0x310);
-		issue_unit_busy_stat_counter = ioread32(abacus_base + 0x314);
-		issue_operands_not_ready_stat_counter = ioread32(abacus_base + 0x318);
-		issue_hold_stat_counter = ioread32(abacus_base + 0x31C);
-		issue_multi_source_stat_counter = ioread32(abacus_base + 0x320);
-
-        pr_info("Debug: Read the SU unit\n");
-
-        output_len = snprintf(output, sizeof(output), 
-                        "Branch Mispredictions: %u\n"
-                        "RAS Mispredictions: %u\n"
-                        "Issue No Instruction: %u\n"
-                        "Issue No ID: %u\n"
-                        "Issue Flush: %u\n"
-                        "Issue Unit Busy: %u\n"
-                        "Issue Operands Busy: %u\n"
-                        "Issue Hold: %u\n"
-                        "Issue Multi Source: %u\n",
-                        branch_misprediction_counter, ras_misprediction_counter, issue_no_instruction_stat_counter, issue_no_id_stat_counter,
-                        issue_flush_stat_counter, issue_unit_busy_stat_counter, issue_operands_not_ready_stat_counter, issue_hold_stat_counter, issue_multi_source_stat_counter);
-    } 
-    
-    else {
-        return -EINVAL; // Return invalid if the command is not recognized
-    }
+    output = kmalloc(ABACUS_READ_OUTPUT_SIZE, GFP_KERNEL);
+    if (!output)
+        return -ENOMEM;
+
+    for (i = 0; i < read_commands[n].count; i++)
+        output_len += scnprintf(output + output_len, ABACUS_READ_OUTPUT_SIZE - output_len, "%s: %llu\n",
+                                read_commands[n].names[i], counters[i]);
+
+    output_len = min_t(size_t, output_len, len);
 
     // Copy the output back to the user space buffer
     if (copy_to_user(buffer, output, output_len)) {
         pr_info("device_read: Could not copy buffer data to userspace\n");
+        kfree(output);
         return -EFAULT;
     }
 
+    kfree(output);
     return output_len;
 }
 
@@ -241,27 +282,765 @@ static ssize_t device_write(struct file *file, const char __user *buffer, size_t
     return len;
 }
 
+// Binary ABI (see abacus_ioctl.h). The text commands above are kept for older tools,
+// but they cost a string compare, a pr_info and a snprintf per unit read.
+
+static const unsigned int unit_enable_offsets[] = {
+	ABACUS_REG_IP_ENABLE,
+	ABACUS_REG_CP_ENABLE,
+	ABACUS_REG_SU_ENABLE,
+	ABACUS_REG_PC_ENABLE,
+	ABACUS_REG_BH_ENABLE,
+	ABACUS_REG_MS_ENABLE,
+	ABACUS_REG_BUS_ENABLE,
+};
+
+// Must be called with abacus_read_lock held
+void abacus_read_block(__u64 *dst, unsigned int offset, unsigned int count) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = abacus_read_counter64(offset + 4 * i);
+}
+
+static unsigned int abacus_snapshot_control(unsigned int hart) {
+	return hart == ABACUS_HART_ALL ? ABACUS_REG_GLOBAL_SNAPSHOT : ABACUS_HART_OFFSET(hart) + ABACUS_REG_SNAPSHOT;
+}
+
+// Must be called with abacus_read_lock held. Takes a snapshot and holds back automatic snapshots until
+// abacus_snapshot_release(), so copies from the returned snapshot window are not torn. For
+// ABACUS_HART_ALL every hart is snapshot and held together and the window is the aggregate one.
+void __iomem *abacus_snapshot_hold(unsigned int hart) {
+	iowrite32(ABACUS_SNAPSHOT_NOW | ABACUS_SNAPSHOT_HOLD, abacus_base + abacus_snapshot_control(hart));
+	if (hart == ABACUS_HART_ALL)
+		return abacus_base + ABACUS_REG_AGGREGATE_WINDOW;
+	return abacus_base + ABACUS_HART_OFFSET(hart) + ABACUS_REG_SNAPSHOT_WINDOW;
+}
+
+void abacus_snapshot_release(unsigned int hart) {
+	iowrite32(0, abacus_base + abacus_snapshot_control(hart));
+}
+
+// Must be called with abacus_read_lock held. Copies the first size bytes of a new snapshot in one pass.
+void abacus_read_snapshot(void *dst, size_t size, unsigned int hart) {
+	memcpy_fromio(dst, abacus_snapshot_hold(hart), size);
+	abacus_snapshot_release(hart);
+}
+
+// A single-hart build has no global block, so its ABACUS_HART_ALL is hart 0
+static void abacus_read_counters(struct abacus_counters *counters, unsigned int hart) {
+	unsigned long flags;
+	unsigned int h, i;
+
+	if (hart == ABACUS_HART_ALL && abacus_num_harts == 1)
+		hart = 0;
+
+	memset(counters, 0, sizeof(*counters));
+	counters->version = ABACUS_ABI_VERSION;
+	for (h = 0; h < abacus_num_harts; h++) {
+		if (hart != ABACUS_HART_ALL && h != hart)
+			continue;
+		for (i = 0; i < ARRAY_SIZE(unit_enable_offsets); i++) {
+			if (ioread32(abacus_base + ABACUS_HART_OFFSET(h) + unit_enable_offsets[i]) & 0x1)
+				counters->enabled |= 1U << i;
+		}
+	}
+
+	abacus_collect_overflow();
+	// Before the snapshot below replaces a frozen one
+	abacus_alarm_collect();
+	spin_lock_irqsave(&abacus_overflow_lock, flags);
+	for (h = 0; h < abacus_num_harts; h++) {
+		if (hart != ABACUS_HART_ALL && h != hart)
+			continue;
+		counters->ip_overflow |= overflow_status[h][0];
+		counters->cp_overflow |= overflow_status[h][1];
+		counters->su_overflow |= overflow_status[h][2];
+	}
+	spin_unlock_irqrestore(&abacus_overflow_lock, flags);
+
+	// Every counter and line fill extreme, sampled on the same clock edge
+	raw_spin_lock_irqsave(&abacus_read_lock, flags);
+	abacus_read_snapshot(&counters->ip, ABACUS_SNAPSHOT_WINDOW_SIZE, hart);
+	raw_spin_unlock_irqrestore(&abacus_read_lock, flags);
+}
+
+// The table is copied out of a held snapshot, so its entries and totals were all taken on one edge
+static void abacus_read_branch_hotlist(struct abacus_branch_hotlist *hotlist) {
+	void __iomem *regs = abacus_base + ABACUS_HART_OFFSET(hotlist->hart);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&abacus_read_lock, flags);
+	abacus_snapshot_hold(hotlist->hart);
+	hotlist->entries = min_t(u32, ioread32(regs + ABACUS_REG_BH_ENTRIES), ABACUS_BH_MAX_ENTRIES);
+	hotlist->mispredicts = ioread32(regs + ABACUS_REG_BH_MISPREDICTS);
+	hotlist->branches = ioread32(regs + ABACUS_REG_BH_BRANCHES);
+	memcpy_fromio(hotlist->entry, regs + ABACUS_REG_BH_ENTRY(0), hotlist->entries * sizeof(hotlist->entry[0]));
+	abacus_snapshot_release(hotlist->hart);
+	raw_spin_unlock_irqrestore(&abacus_read_lock, flags);
+}
+
+// The counters are 64 bits, read through COUNTER_HI like the cache profile block
+static void abacus_read_bus_counters(struct abacus_bus_counters *bus) {
+	void __iomem *regs = abacus_base + ABACUS_HART_OFFSET(bus->hart);
+	unsigned long flags;
+
+	abacus_collect_overflow();
+	spin_lock_irqsave(&abacus_overflow_lock, flags);
+	bus->overflow = overflow_status[bus->hart][4];
+	spin_unlock_irqrestore(&abacus_overflow_lock, flags);
+
+	raw_spin_lock_irqsave(&abacus_read_lock, flags);
+	abacus_snapshot_hold(bus->hart);
+	abacus_read_block(&bus->cycles, ABACUS_HART_OFFSET(bus->hart) + ABACUS_REG_BUS_BASE, ABACUS_BUS_NUM_COUNTERS);
+	bus->latency_min = ioread32(regs + ABACUS_REG_BUS_LATENCY_MIN);
+	bus->latency_max = ioread32(regs + ABACUS_REG_BUS_LATENCY_MAX);
+	abacus_snapshot_release(bus->hart);
+	raw_spin_unlock_irqrestore(&abacus_read_lock, flags);
+}
+
+// Settings written through the ioctls apply to every hart alike
+void abacus_write_all_harts(u32 value, unsigned int offset) {
+	unsigned int h;
+
+	for (h = 0; h < abacus_num_harts; h++)
+		iowrite32(value, abacus_base + ABACUS_HART_OFFSET(h) + offset);
+}
+
+// Empties the units of the mask, on every hart on the same edge in a multi-hart build
+static void abacus_clear_units(__u32 units) {
+	if (abacus_num_harts > 1)
+		iowrite32(units, abacus_base + ABACUS_REG_GLOBAL_CLEAR);
+	else
+		iowrite32(units, abacus_base + ABACUS_REG_UNIT_CLEAR);
+}
+
+// The sketch is emptied after the change, so it holds granules of one size only
+static void abacus_set_miss_sketch(const struct abacus_miss_config *config) {
+	mutex_lock(&abacus_miss_lock);
+	abacus_write_all_harts(config->granule_shift, ABACUS_REG_MS_GRANULE_SHIFT);
+	abacus_write_all_harts(config->filter_low, ABACUS_REG_MS_FILTER_LOW);
+	abacus_write_all_harts(config->filter_high, ABACUS_REG_MS_FILTER_HIGH);
+	abacus_clear_units(ABACUS_UNIT_MS);
+	mutex_unlock(&abacus_miss_lock);
+}
+
+#define ABACUS_MS_BATCH 64
+
+// The top-K table and the total come out of a held snapshot. The sketch itself is live and is read
+// counter by counter through MS_DATA with interrupts on, it holds thousands of them.
+static long abacus_read_miss_sketch(struct abacus_miss_sketch *sketch) {
+	void __iomem *regs = abacus_base + ABACUS_HART_OFFSET(sketch->hart);
+	__u32 __user *dst = u64_to_user_ptr(sketch->counters);
+	__u32 batch[ABACUS_MS_BATCH];
+	unsigned long flags;
+	u32 count, done, n, i;
+	long ret = 0;
+
+	sketch->width = min_t(u32, ioread32(regs + ABACUS_REG_MS_WIDTH), ABACUS_MS_MAX_WIDTH);
+	count = ABACUS_MS_ROWS * sketch->width;
+	if (sketch->counters && sketch->capacity < count)
+		return -ENOSPC;
+	if (!sketch->width)
+		return 0;
+
+	mutex_lock(&abacus_miss_lock);
+
+	raw_spin_lock_irqsave(&abacus_read_lock, flags);
+	abacus_snapshot_hold(sketch->hart);
+	sketch->entries = min_t(u32, ioread32(regs + ABACUS_REG_MS_TOPK_ENTRIES), ABACUS_MS_MAX_ENTRIES);
+	sketch->total = ioread32(regs + ABACUS_REG_MS_TOTAL);
+	memcpy_fromio(sketch->entry, regs + ABACUS_REG_MS_TOPK(0), sketch->entries * sizeof(sketch->entry[0]));
+	abacus_snapshot_release(sketch->hart);
+	raw_spin_unlock_irqrestore(&abacus_read_lock, flags);
+
+	sketch->status = ioread32(regs + ABACUS_REG_MS_STATUS);
+	sketch->config.granule_shift = ioread32(regs + ABACUS_REG_MS_GRANULE_SHIFT);
+	sketch->config.filter_low = ioread32(regs + ABACUS_REG_MS_FILTER_LOW);
+	sketch->config.filter_high = ioread32(regs + ABACUS_REG_MS_FILTER_HIGH);
+
+	if (sketch->counters) {
+		// Read back so the index is written before the first counter is fetched
+		iowrite32(0, regs + ABACUS_REG_MS_INDEX);
+		ioread32(regs + ABACUS_REG_MS_INDEX);
+		for (done = 0; done < count; done += n) {
+			n = min_t(u32, count - done, ABACUS_MS_BATCH);
+			for (i = 0; i < n; i++)
+				batch[i] = ioread32(regs + ABACUS_REG_MS_DATA);
+			if (copy_to_user(dst + done, batch, n * sizeof(__u32))) {
+				ret = -EFAULT;
+				break;
+			}
+		}
+	}
+
+	mutex_unlock(&abacus_miss_lock);
+	return ret;
+}
+
+// The ranges are written before the control register, whose write restarts the region detection
+static void abacus_set_trigger(const struct abacus_trigger *trigger) {
+	mutex_lock(&abacus_trigger_lock);
+	abacus_write_all_harts(trigger->start_pc_low, ABACUS_REG_TRIGGER_START_PC_LOW);
+	abacus_write_all_harts(trigger->start_pc_high, ABACUS_REG_TRIGGER_START_PC_HIGH);
+	abacus_write_all_harts(trigger->stop_pc_low, ABACUS_REG_TRIGGER_STOP_PC_LOW);
+	abacus_write_all_harts(trigger->stop_pc_high, ABACUS_REG_TRIGGER_STOP_PC_HIGH);
+	abacus_write_all_harts(trigger->control, ABACUS_REG_TRIGGER_CONTROL);
+	mutex_unlock(&abacus_trigger_lock);
+}
+
+static void abacus_get_trigger(struct abacus_trigger *trigger) {
+	memset(trigger, 0, sizeof(*trigger));
+	mutex_lock(&abacus_trigger_lock);
+	trigger->control = ioread32(abacus_base + ABACUS_REG_TRIGGER_CONTROL);
+	trigger->start_pc_low = ioread32(abacus_base + ABACUS_REG_TRIGGER_START_PC_LOW);
+	trigger->start_pc_high = ioread32(abacus_base + ABACUS_REG_TRIGGER_START_PC_HIGH);
+	trigger->stop_pc_low = ioread32(abacus_base + ABACUS_REG_TRIGGER_STOP_PC_LOW);
+	trigger->stop_pc_high = ioread32(abacus_base + ABACUS_REG_TRIGGER_STOP_PC_HIGH);
+	trigger->active = ioread32(abacus_base + ABACUS_REG_TRIGGER_STATUS) & 0x1;
+	trigger->region_count = ioread32(abacus_base + ABACUS_REG_TRIGGER_REGION_COUNT);
+	mutex_unlock(&abacus_trigger_lock);
+}
+
+// Each filter is one register, so its modes and ASID change together
+static int abacus_set_filter(struct abacus_filter *filter) {
+	u32 value = filter->modes;
+	unsigned int n;
+
+	if (filter->flags & ABACUS_FILTER_CALLER_ASID) {
+		// The ioctl runs on the page tables of the caller, so satp holds its ASID. The kernel keeps
+		// ASID 0 for itself, and runs every process in it when the harts have too few ASIDs.
+#ifdef CONFIG_RISCV
+		filter->asid = (csr_read(CSR_SATP) >> SATP_ASID_SHIFT) & SATP_ASID_MASK;
+#else
+		filter->asid = 0;
+#endif
+		if (!filter->asid)
+			return -EOPNOTSUPP;
+	}
+	if (filter->flags & (ABACUS_FILTER_MATCH_ASID | ABACUS_FILTER_CALLER_ASID))
+		value |= ABACUS_FILTER_ASID_MATCH | (filter->asid << ABACUS_FILTER_ASID_SHIFT);
+
+	for (n = 0; n < ABACUS_UNIT_FILTERS; n++) {
+		if (filter->units & (1U << n))
+			abacus_write_all_harts(value, ABACUS_REG_UNIT_FILTER(n));
+	}
+	return 0;
+}
+
+// PC samples are popped into a small buffer and copied out a batch at a time. The FIFO fill level
+// is read once up front rather than before every pop, which halves the bus reads per sample.
+#define ABACUS_PC_SAMPLE_BATCH 64
+
+static long abacus_read_pc_samples(struct abacus_pc_samples __user *uarg) {
+	struct abacus_pc_samples req;
+	__u32 batch[ABACUS_PC_SAMPLE_BATCH];
+	__u32 __user *dst;
+	__u32 available, n, i;
+	long ret = 0;
+
+	if (copy_from_user(&req, uarg, sizeof(req)))
+		return -EFAULT;
+
+	dst = u64_to_user_ptr(req.samples);
+	req.count = 0;
+
+	mutex_lock(&abacus_pc_sample_lock);
+
+	available = ioread32(abacus_base + ABACUS_REG_PC_SAMPLE_COUNT);
+	while (available && req.count < req.capacity) {
+		n = min3(available, req.capacity - req.count, (__u32)ABACUS_PC_SAMPLE_BATCH);
+		for (i = 0; i < n; i++)
+			batch[i] = ioread32(abacus_base + ABACUS_REG_PC_SAMPLE_DATA);
+
+		if (copy_to_user(dst + req.count, batch, n * sizeof(__u32))) {
+			ret = -EFAULT;
+			break;
+		}
+		req.count += n;
+		available -= n;
+	}
+
+	req.dropped = ioread32(abacus_base + ABACUS_REG_PC_SAMPLE_DROPPED);
+	req.pending = ioread32(abacus_base + ABACUS_REG_PC_SAMPLE_COUNT);
+
+	mutex_unlock(&abacus_pc_sample_lock);
+
+	if (ret)
+		return ret;
+	if (copy_to_user(uarg, &req, sizeof(req)))
+		return -EFAULT;
+	return 0;
+}
+
+static void abacus_clear_overflow(void) {
+	unsigned long flags;
+
+	abacus_collect_overflow();
+	spin_lock_irqsave(&abacus_overflow_lock, flags);
+	memset(overflow_status, 0, sizeof(overflow_status));
+	spin_unlock_irqrestore(&abacus_overflow_lock, flags);
+}
+
+static void abacus_write_enables(__u32 units, __u32 value) {
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(unit_enable_offsets); i++) {
+		if (units & (1U << i))
+			abacus_write_all_harts(value, unit_enable_offsets[i]);
+	}
+}
+
+static long device_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+	void __user *uarg = (void __user *)arg;
+	struct abacus_counters counters;
+	__u32 value;
+
+	switch (cmd) {
+	case ABACUS_IOC_GET_VERSION:
+		value = ABACUS_ABI_VERSION;
+		return put_user(value, (__u32 __user *)uarg);
+
+	case ABACUS_IOC_READ_COUNTERS:
+		abacus_read_counters(&counters, 0);
+		if (copy_to_user(uarg, &counters, sizeof(counters)))
+			return -EFAULT;
+		return 0;
+
+	case ABACUS_IOC_READ_HART_COUNTERS: {
+		struct abacus_hart_counters *hart_counters;
+		__u32 hart;
+		long ret = 0;
+
+		if (get_user(hart, (__u32 __user *)uarg))
+			return -EFAULT;
+		if (hart != ABACUS_HART_ALL && hart >= abacus_num_harts)
+			return -EINVAL;
+
+		// Too large for the ioctl stack frame next to counters
+		hart_counters = kzalloc(sizeof(*hart_counters), GFP_KERNEL);
+		if (!hart_counters)
+			return -ENOMEM;
+		hart_counters->hart = hart;
+		hart_counters->num_harts = abacus_num_harts;
+		abacus_read_counters(&hart_counters->counters, hart);
+		if (copy_to_user(uarg, hart_counters, sizeof(*hart_counters)))
+			ret = -EFAULT;
+		kfree(hart_counters);
+		return ret;
+	}
+
+	case ABACUS_IOC_ENABLE:
+	case ABACUS_IOC_DISABLE:
+		if (get_user(value, (__u32 __user *)uarg))
+			return -EFAULT;
+		if (value & ~ABACUS_UNIT_ALL)
+			return -EINVAL;
+		abacus_write_enables(value, cmd == ABACUS_IOC_ENABLE ? 0x1 : 0x0);
+		return 0;
+
+	case ABACUS_IOC_CLEAR:
+		if (get_user(value, (__u32 __user *)uarg))
+			return -EFAULT;
+		if (value & ~(ABACUS_UNIT_ALL | ABACUS_UNIT_EVENTS))
+			return -EINVAL;
+		abacus_clear_units(value);
+		return 0;
+
+	case ABACUS_IOC_SNAPSHOT:
+		if (abacus_num_harts > 1)
+			iowrite32(ABACUS_SNAPSHOT_NOW, abacus_base + ABACUS_REG_GLOBAL_SNAPSHOT);
+		else
+			iowrite32(ABACUS_SNAPSHOT_NOW, abacus_base + ABACUS_REG_SNAPSHOT);
+		return 0;
+
+	case ABACUS_IOC_SET_SNAPSHOT_INTERVAL:
+		if (get_user(value, (__u32 __user *)uarg))
+			return -EFAULT;
+		abacus_write_all_harts(value, ABACUS_REG_SNAPSHOT_INTERVAL);
+		return 0;
+
+	case ABACUS_IOC_GET_SNAPSHOT_INTERVAL:
+		value = ioread32(abacus_base + ABACUS_REG_SNAPSHOT_INTERVAL);
+		return put_user(value, (__u32 __user *)uarg);
+
+	case ABACUS_IOC_CLEAR_OVERFLOW:
+		abacus_clear_overflow();
+		return 0;
+
+	case ABACUS_IOC_READ_PC_SAMPLES:
+		return abacus_read_pc_samples(uarg);
+
+	case ABACUS_IOC_SET_PC_SAMPLE_PERIOD:
+		if (get_user(value, (__u32 __user *)uarg))
+			return -EFAULT;
+		iowrite32(value, abacus_base + ABACUS_REG_PC_SAMPLE_PERIOD);
+		return 0;
+
+	case ABACUS_IOC_TASK_ATTRIBUTION:
+		if (get_user(value, (__u32 __user *)uarg))
+			return -EFAULT;
+		return abacus_task_attribution(value != 0);
+
+	case ABACUS_IOC_READ_TASK_COUNTERS: {
+		struct abacus_task_counters task;
+		int ret;
+
+		if (copy_from_user(&task, uarg, sizeof(task)))
+			return -EFAULT;
+		ret = abacus_task_read(&task);
+		if (ret)
+			return ret;
+		if (copy_to_user(uarg, &task, sizeof(task)))
+			return -EFAULT;
+		return 0;
+	}
+
+	case ABACUS_IOC_SET_SU_LEVEL_MODE:
+		if (get_user(value, (__u32 __user *)uarg))
+			return -EFAULT;
+		if (value & ~0x1FFU)
+			return -EINVAL;
+		abacus_write_all_harts(value, ABACUS_REG_SU_LEVEL_MODE);
+		return 0;
+
+	case ABACUS_IOC_SET_TRIGGER: {
+		struct abacus_trigger trigger;
+
+		if (copy_from_user(&trigger, uarg, sizeof(trigger)))
+			return -EFAULT;
+		if (trigger.control & ~(ABACUS_TRIGGER_PC_RANGE | ABACUS_TRIGGER_MARKER))
+			return -EINVAL;
+		abacus_set_trigger(&trigger);
+		return 0;
+	}
+
+	case ABACUS_IOC_GET_TRIGGER: {
+		struct abacus_trigger trigger;
+
+		abacus_get_trigger(&trigger);
+		if (copy_to_user(uarg, &trigger, sizeof(trigger)))
+			return -EFAULT;
+		return 0;
+	}
+
+	case ABACUS_IOC_SET_FILTER: {
+		struct abacus_filter filter;
+		long ret;
+
+		if (copy_from_user(&filter, uarg, sizeof(filter)))
+			return -EFAULT;
+		if ((filter.units & ~(ABACUS_UNIT_ALL | ABACUS_UNIT_EVENTS)) || (filter.modes & ~ABACUS_FILTER_MODES) ||
+		    (filter.flags & ~(ABACUS_FILTER_MATCH_ASID | ABACUS_FILTER_CALLER_ASID)) ||
+		    (filter.asid > (ABACUS_FILTER_ASID >> ABACUS_FILTER_ASID_SHIFT)))
+			return -EINVAL;
+		ret = abacus_set_filter(&filter);
+		if (ret)
+			return ret;
+		if (copy_to_user(uarg, &filter, sizeof(filter)))
+			return -EFAULT;
+		return 0;
+	}
+
+	case ABACUS_IOC_RING_START: {
+		struct abacus_ring_config config;
+
+		if (copy_from_user(&config, uarg, sizeof(config)))
+			return -EFAULT;
+		return abacus_ring_start(&config);
+	}
+
+	case ABACUS_IOC_RING_STOP:
+		abacus_ring_stop();
+		return 0;
+
+	case ABACUS_IOC_RING_STATUS: {
+		struct abacus_ring_status status;
+
+		abacus_ring_status(&status);
+		if (copy_to_user(uarg, &status, sizeof(status)))
+			return -EFAULT;
+		return 0;
+	}
+
+	case ABACUS_IOC_RING_CONSUME:
+		if (get_user(value, (__u32 __user *)uarg))
+			return -EFAULT;
+		return abacus_ring_consume(value);
+
+	case ABACUS_IOC_SAMPLER_START: {
+		struct abacus_sampler_config config;
+
+		if (copy_from_user(&config, uarg, sizeof(config)))
+			return -EFAULT;
+		return abacus_sampler_start(&config);
+	}
+
+	case ABACUS_IOC_SAMPLER_STOP:
+		abacus_sampler_stop();
+		return 0;
+
+	case ABACUS_IOC_SAMPLER_STATUS: {
+		struct abacus_sampler_status status;
+
+		abacus_sampler_status(&status);
+		if (copy_to_user(uarg, &status, sizeof(status)))
+			return -EFAULT;
+		return 0;
+	}
+
+	case ABACUS_IOC_READ_BRANCH_HOTLIST: {
+		struct abacus_branch_hotlist *hotlist;
+		__u32 hart;
+		long ret = 0;
+
+		if (get_user(hart, (__u32 __user *)uarg))
+			return -EFAULT;
+		if (hart >= abacus_num_harts)
+			return -EINVAL;
+
+		hotlist = kzalloc(sizeof(*hotlist), GFP_KERNEL);
+		if (!hotlist)
+			return -ENOMEM;
+		hotlist->hart = hart;
+		abacus_read_branch_hotlist(hotlist);
+		if (copy_to_user(uarg, hotlist, sizeof(*hotlist)))
+			ret = -EFAULT;
+		kfree(hotlist);
+		return ret;
+	}
+
+	case ABACUS_IOC_SET_MISS_SKETCH: {
+		struct abacus_miss_config config;
+
+		if (copy_from_user(&config, uarg, sizeof(config)))
+			return -EFAULT;
+		if (config.granule_shift > 31 || config.filter_low > config.filter_high || config.reserved)
+			return -EINVAL;
+		abacus_set_miss_sketch(&config);
+		return 0;
+	}
+
+	case ABACUS_IOC_READ_MISS_SKETCH: {
+		struct abacus_miss_sketch *sketch;
+		long ret;
+
+		sketch = kzalloc(sizeof(*sketch), GFP_KERNEL);
+		if (!sketch)
+			return -ENOMEM;
+		if (copy_from_user(sketch, uarg, sizeof(*sketch))) {
+			kfree(sketch);
+			return -EFAULT;
+		}
+		if (sketch->hart >= abacus_num_harts) {
+			kfree(sketch);
+			return -EINVAL;
+		}
+
+		ret = abacus_read_miss_sketch(sketch);
+		if (!ret && copy_to_user(uarg, sketch, sizeof(*sketch)))
+			ret = -EFAULT;
+		kfree(sketch);
+		return ret;
+	}
+
+	case ABACUS_IOC_READ_BUS_COUNTERS: {
+		struct abacus_bus_counters *bus;
+		__u32 hart;
+		long ret = 0;
+
+		if (get_user(hart, (__u32 __user *)uarg))
+			return -EFAULT;
+		if (hart >= abacus_num_harts)
+			return -EINVAL;
+
+		bus = kzalloc(sizeof(*bus), GFP_KERNEL);
+		if (!bus)
+			return -ENOMEM;
+		bus->hart = hart;
+		abacus_read_bus_counters(bus);
+		if (copy_to_user(uarg, bus, sizeof(*bus)))
+			ret = -EFAULT;
+		kfree(bus);
+		return ret;
+	}
+
+	case ABACUS_IOC_SET_ALARM: {
+		struct abacus_alarm_config config;
+
+		if (copy_from_user(&config, uarg, sizeof(config)))
+			return -EFAULT;
+		return abacus_alarm_set(&config);
+	}
+
+	case ABACUS_IOC_READ_ALARMS:
+		return abacus_alarm_read(uarg);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+// Map the register page into userspace read-only, so counters can be polled without a syscall.
+// Writes (enable/disable) still go through the ioctls so the driver stays in control of the hardware.
+// The pages of the other harts and the global block follow it on multi-hart builds.
+// The snapshot ring is mapped read-only the same way, at ABACUS_MMAP_RING_OFFSET.
+static int device_mmap(struct file *file, struct vm_area_struct *vma) {
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	if (vma->vm_pgoff == ABACUS_MMAP_RING_OFFSET >> PAGE_SHIFT)
+		return abacus_ring_mmap(vma);
+
+	if (vma->vm_pgoff != 0 || size > PAGE_ALIGN(ABACUS_REGION_SIZE))
+		return -EINVAL;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_set(vma, VM_IO | VM_DONTEXPAND | VM_DONTDUMP);
+#else
+	vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+#endif
+	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+
+	return io_remap_pfn_range(vma, vma->vm_start, ABACUS_BASE_ADDR >> PAGE_SHIFT, size, vma->vm_page_prot);
+}
+
 static struct file_operations fops = {
+	.owner = THIS_MODULE,
 	.open = device_open,
 	.write = device_write,
 	.read = device_read,
+	.unlocked_ioctl = device_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.mmap = device_mmap,
+	.poll = abacus_ring_poll,
+	.release = device_release
+};
+
+// The sampler device takes the same ioctls, so one descriptor starts, reads and stops a run
+static const struct file_operations sampler_fops = {
+	.owner = THIS_MODULE,
+	.read = abacus_sampler_read,
+	.unlocked_ioctl = device_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.poll = abacus_sampler_poll,
 	.release = device_release
 };
 
 static int __init abacus_init(void) {
+	int ret;
+
+	BUILD_BUG_ON(sizeof(struct abacus_ip_counters) != ABACUS_IP_NUM_COUNTERS * sizeof(__u64));
+	BUILD_BUG_ON(sizeof(struct abacus_cp_counters) != ABACUS_CP_NUM_COUNTERS * sizeof(__u64));
+	BUILD_BUG_ON(sizeof(struct abacus_su_counters) != ABACUS_SU_NUM_COUNTERS * sizeof(__u64));
+	BUILD_BUG_ON(sizeof(struct abacus_pc_samples) != sizeof(__u64) + 4 * sizeof(__u32));
+	BUILD_BUG_ON(sizeof(struct abacus_trigger) != 8 * sizeof(__u32));
+	BUILD_BUG_ON(sizeof(struct abacus_task_counters) != 2 * sizeof(__u32) + ABACUS_NUM_COUNTERS * sizeof(__u64));
+	BUILD_BUG_ON(sizeof(struct abacus_counters) != 10 * sizeof(__u32) + (ABACUS_IP_NUM_COUNTERS + ABACUS_CP_NUM_COUNTERS + ABACUS_SU_NUM_COUNTERS) * sizeof(__u64));
+	BUILD_BUG_ON(offsetofend(struct abacus_counters, dcache_line_fill_max) - offsetof(struct abacus_counters, ip) != ABACUS_SNAPSHOT_WINDOW_SIZE);
+	BUILD_BUG_ON(offsetof(struct abacus_ring_record, ip) != 4 * sizeof(__u32));
+	BUILD_BUG_ON(offsetofend(struct abacus_ring_record, dcache_line_fill_max) - offsetof(struct abacus_ring_record, ip) != ABACUS_SNAPSHOT_WINDOW_SIZE);
+	BUILD_BUG_ON(sizeof(struct abacus_ring_record) != 640);
+	BUILD_BUG_ON(sizeof(struct abacus_ring_config) != 4 * sizeof(__u32));
+	BUILD_BUG_ON(sizeof(struct abacus_ring_status) != 4 * sizeof(__u32));
+	BUILD_BUG_ON(sizeof(struct abacus_hart_counters) != 2 * sizeof(__u32) + sizeof(struct abacus_counters));
+	BUILD_BUG_ON(sizeof(struct abacus_sampler_config) != 6 * sizeof(__u32));
+	BUILD_BUG_ON(sizeof(struct abacus_sampler_status) != 4 * sizeof(__u32));
+	BUILD_BUG_ON(sizeof(struct abacus_alarm_config) != 4 * sizeof(__u32));
+	BUILD_BUG_ON(offsetofend(struct abacus_alarm_event, dcache_line_fill_max) - offsetof(struct abacus_alarm_event, ip) != ABACUS_SNAPSHOT_WINDOW_SIZE);
+	BUILD_BUG_ON(sizeof(struct abacus_alarm_event) != 2 * sizeof(__u64) + 4 * sizeof(__u32) + ABACUS_SNAPSHOT_WINDOW_SIZE);
+	BUILD_BUG_ON(sizeof(struct abacus_alarm_events) != sizeof(__u64) + 4 * sizeof(__u32));
+
+	if (counter_width < 32 || counter_width > 64) {
+		pr_err("counter_width must be 32 to 64, not %u\n", counter_width);
+		return -EINVAL;
+	}
+
+	abacus_base = ioremap(ABACUS_BASE_ADDR, ABACUS_REGION_SIZE); //Map physical address space into virtual address space ( https://lwn.net/Articles/653585/ )
+	if (!abacus_base) {
+		pr_err("Could not map abacus physical address region to the virtual address space\n");
+		return -ENOMEM;
+	}
+
+	// A single-hart build acknowledges the whole region and reads 0 at NUM_HARTS
+	abacus_num_harts = clamp_t(unsigned int, ioread32(abacus_base + ABACUS_REG_NUM_HARTS), 1, ABACUS_MAX_HARTS);
+
 	//register_chrdev(...) will return the dynamically assigned character device number (https://tldp.org/LDP/lkmpg/2.6/html/x569.html)
-	int major_number = register_chrdev(0, DEVICE_NAME, &fops); // Putting 0 for the major number tells the kernel to dynamically set the major number to one that is free
+	major_number = register_chrdev(0, DEVICE_NAME, &fops); // Putting 0 for the major number tells the kernel to dynamically set the major number to one that is free
 	if (major_number < 0) {
 		pr_err("Could not register character device for abacus with %d\n", major_number);
+		iounmap(abacus_base);
 		return major_number;
 	}
 
-	pr_info("Profiler module loaded with device major number %d\n", major_number); // Print the major number so we can define /dev/abacus with mknod
+	if (irq >= 0) {
+		ret = request_irq(irq, abacus_irq_handler, 0, DEVICE_NAME, NULL);
+		if (ret) {
+			pr_err("Could not request the abacus overflow interrupt %d (%d)\n", irq, ret);
+			goto err_chrdev;
+		}
+		abacus_write_all_harts(0x7, ABACUS_REG_IRQ_ENABLE);
+	}
+
+	abacus_sampler_init();
+
+	ret = abacus_ring_init(irq >= 0);
+	if (ret) {
+		pr_err("Could not set up the snapshot ring (%d)\n", ret);
+		goto err_irq;
+	}
+
+	ret = abacus_pmu_init();
+	if (ret) {
+		pr_err("Could not register the abacus perf PMU (%d)\n", ret);
+		goto err_ring;
+	}
+
+	ret = abacus_task_init();
+	if (ret) {
+		pr_err("Could not set up per-process attribution (%d)\n", ret);
+		goto err_pmu;
+	}
+
+	pr_info("Profiler module loaded with device major number %d, %u harts\n", major_number, abacus_num_harts); // Print the major number so we can define /dev/abacus with mknod
 	return 0;
+
+err_pmu:
+	abacus_pmu_exit();
+err_ring:
+	abacus_ring_exit();
+err_irq:
+	abacus_sampler_exit();
+	abacus_alarm_exit();
+	if (irq >= 0) {
+		abacus_write_all_harts(0x0, ABACUS_REG_IRQ_ENABLE);
+		free_irq(irq, NULL);
+	}
+err_chrdev:
+	unregister_chrdev(major_number, DEVICE_NAME);
+	iounmap(abacus_base);
+	return ret;
 }
 
 static void __exit abacus_exit(void) {
+	abacus_task_exit();
+	abacus_pmu_exit();
+	abacus_ring_exit();
+	abacus_sampler_exit();
+	abacus_alarm_exit();
+	if (irq >= 0) {
+		abacus_write_all_harts(0x0, ABACUS_REG_IRQ_ENABLE);
+		free_irq(irq, NULL);
+	}
 	unregister_chrdev(major_number, DEVICE_NAME);
+	iounmap(abacus_base);
 	pr_info("ABACUS unloaded\n");
 }
 
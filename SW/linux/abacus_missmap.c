@@ -0,0 +1,466 @@
+// Data cache miss heat map from the ABACUS miss sketch.
+//
+//   ./abacus_missmap record <seconds> <sketch.txt> [granule_shift] [low high] [hart]
+//       Counts the dcache misses of hart (default 0) from low to high (default every address) per
+//       granule of 1 << granule_shift bytes (default 6, a cache line, 12 for pages) and writes the
+//       sketch and its top-K table to sketch.txt. The workload runs unmodified.
+//
+//   ./abacus_missmap report <sketch.txt> [elf]
+//       Prints the most missed granules, and a heat map of the counted range split into equal
+//       regions. With an ELF file the misses are also folded into its data symbols, hottest first.
+//
+// Every granule estimate is the smallest of its counters in the sketch rows, which is never below its
+// real count but also holds the misses of the granules it collides with. Sums over many more granules
+// than the sketch is wide are therefore mostly collisions, narrow the range or widen the granule to
+// keep them meaningful. The cache sees physical addresses, so symbols only match data that runs at its
+// link address, such as the baremetal image.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "abacus_ioctl.h"
+
+#define DEVICE "/dev/abacus"
+#define DEFAULT_GRANULE_SHIFT 6
+#define REGIONS 32
+#define BAR_WIDTH 50
+#define MAX_GRANULES (1UL << 24) // Granules summed per report, beyond that a region or symbol is skipped
+#define MAX_SYMBOLS 40
+
+static const uint32_t hash[ABACUS_MS_ROWS] = ABACUS_MS_HASH;
+
+struct sketch {
+    uint32_t width;
+    uint32_t shift;  // log2(width)
+    uint32_t granule_shift;
+    uint32_t filter_low;
+    uint32_t filter_high;
+    uint32_t total;
+    uint32_t entries;
+    struct abacus_miss_entry entry[ABACUS_MS_MAX_ENTRIES];
+    uint32_t *counters; // ABACUS_MS_ROWS rows of width
+};
+
+struct symbol {
+    uint64_t addr;
+    uint64_t size;
+    const char *name;
+    uint64_t misses;
+};
+
+static int record(int argc, char **argv) {
+    struct abacus_miss_config config;
+    struct abacus_miss_sketch req;
+    struct timespec duration;
+    double seconds = strtod(argv[2], NULL);
+    uint32_t units = ABACUS_UNIT_MS;
+    uint32_t i, r;
+    FILE *out;
+    int ret = -1;
+    int fd;
+
+    memset(&config, 0, sizeof(config));
+    config.granule_shift = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : DEFAULT_GRANULE_SHIFT;
+    config.filter_low = argc > 6 ? (uint32_t)strtoul(argv[5], NULL, 0) : 0;
+    config.filter_high = argc > 6 ? (uint32_t)strtoul(argv[6], NULL, 0) : 0xFFFFFFFFU;
+
+    memset(&req, 0, sizeof(req));
+    req.hart = argc > 7 ? (uint32_t)strtoul(argv[7], NULL, 0) : 0;
+
+    fd = open(DEVICE, O_RDONLY);
+    if (fd < 0) {
+        printf("There was an error with opening the device\n");
+        return -1;
+    }
+
+    // The width comes first, to size the buffer
+    if (ioctl(fd, ABACUS_IOC_READ_MISS_SKETCH, &req) < 0) {
+        perror("ioctl");
+        close(fd);
+        return -1;
+    }
+    if (req.width == 0) {
+        printf("The hardware has no miss sketch\n");
+        close(fd);
+        return -1;
+    }
+
+    req.capacity = ABACUS_MS_ROWS * req.width;
+    req.counters = (uintptr_t)calloc(req.capacity, sizeof(uint32_t));
+    if (!req.counters) {
+        close(fd);
+        return -1;
+    }
+
+    // The sketch is paused while it is set up, setting it empties it and it is swept clear before misses are counted
+    if (ioctl(fd, ABACUS_IOC_DISABLE, &units) < 0 || ioctl(fd, ABACUS_IOC_SET_MISS_SKETCH, &config) < 0 ||
+        ioctl(fd, ABACUS_IOC_ENABLE, &units) < 0) {
+        perror("ioctl");
+        goto out;
+    }
+
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - (double)duration.tv_sec) * 1e9);
+    nanosleep(&duration, NULL);
+
+    if (ioctl(fd, ABACUS_IOC_READ_MISS_SKETCH, &req) < 0) {
+        perror("ioctl");
+        goto out;
+    }
+    ioctl(fd, ABACUS_IOC_DISABLE, &units);
+
+    out = fopen(argv[3], "w");
+    if (!out) {
+        perror(argv[3]);
+        goto out;
+    }
+
+    fprintf(out, "width %u\n", req.width);
+    fprintf(out, "granule_shift %u\n", req.config.granule_shift);
+    fprintf(out, "filter %08x %08x\n", req.config.filter_low, req.config.filter_high);
+    fprintf(out, "total %u\n", req.total);
+    for (i = 0; i < req.entries; i++) {
+        if (req.entry[i].count) {
+            fprintf(out, "entry %08x %u\n", req.entry[i].addr, req.entry[i].count);
+        }
+    }
+    for (r = 0; r < ABACUS_MS_ROWS; r++) {
+        fprintf(out, "row");
+        for (i = 0; i < req.width; i++) {
+            fprintf(out, " %u", ((const uint32_t *)(uintptr_t)req.counters)[r * req.width + i]);
+        }
+        fprintf(out, "\n");
+    }
+    fclose(out);
+
+    printf("%u misses counted, sketch written to %s\n", req.total, argv[3]);
+    ret = 0;
+out:
+    free((void *)(uintptr_t)req.counters);
+    close(fd);
+    return ret;
+}
+
+static int load_sketch(const char *path, struct sketch *sketch) {
+    char key[16];
+    uint32_t rows = 0, i;
+    FILE *in;
+
+    memset(sketch, 0, sizeof(*sketch));
+    in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return -1;
+    }
+
+    while (fscanf(in, "%15s", key) == 1) {
+        if (strcmp(key, "width") == 0 && fscanf(in, "%u", &sketch->width) == 1) {
+            if (sketch->width == 0 || sketch->width > ABACUS_MS_MAX_WIDTH || (sketch->width & (sketch->width - 1))) {
+                break;
+            }
+            sketch->counters = calloc(ABACUS_MS_ROWS * sketch->width, sizeof(uint32_t));
+            while ((1U << sketch->shift) < sketch->width) {
+                sketch->shift++;
+            }
+        } else if (strcmp(key, "granule_shift") == 0 && fscanf(in, "%u", &sketch->granule_shift) == 1) {
+            continue;
+        } else if (strcmp(key, "filter") == 0 && fscanf(in, "%x %x", &sketch->filter_low, &sketch->filter_high) == 2) {
+            continue;
+        } else if (strcmp(key, "total") == 0 && fscanf(in, "%u", &sketch->total) == 1) {
+            continue;
+        } else if (strcmp(key, "entry") == 0 && sketch->entries < ABACUS_MS_MAX_ENTRIES &&
+                   fscanf(in, "%x %u", &sketch->entry[sketch->entries].addr, &sketch->entry[sketch->entries].count) == 2) {
+            sketch->entries++;
+        } else if (strcmp(key, "row") == 0 && sketch->counters && rows < ABACUS_MS_ROWS) {
+            for (i = 0; i < sketch->width; i++) {
+                if (fscanf(in, "%u", &sketch->counters[rows * sketch->width + i]) != 1) {
+                    break;
+                }
+            }
+            rows++;
+        } else {
+            break;
+        }
+    }
+    fclose(in);
+
+    if (!sketch->counters || rows != ABACUS_MS_ROWS || sketch->granule_shift > 31) {
+        printf("%s is not a miss sketch\n", path);
+        free(sketch->counters);
+        return -1;
+    }
+    return 0;
+}
+
+// Estimated misses of one granule, computed like the hardware does
+static uint32_t estimate(const struct sketch *sketch, uint32_t granule) {
+    uint32_t best = UINT32_MAX;
+    uint32_t column, value, r;
+
+    for (r = 0; r < ABACUS_MS_ROWS; r++) {
+        column = (uint32_t)(granule * hash[r]) >> (32 - sketch->shift);
+        value = sketch->counters[r * sketch->width + column];
+        if (value < best) {
+            best = value;
+        }
+    }
+    return best;
+}
+
+// Misses from address low to high, clipped to the counted range, or UINT64_MAX if it spans too many granules
+static uint64_t range_misses(const struct sketch *sketch, uint64_t low, uint64_t high) {
+    uint64_t first, last, g, sum = 0;
+
+    if (low < sketch->filter_low) {
+        low = sketch->filter_low;
+    }
+    if (high > sketch->filter_high) {
+        high = sketch->filter_high;
+    }
+    if (low > high) {
+        return 0;
+    }
+
+    first = low >> sketch->granule_shift;
+    last = high >> sketch->granule_shift;
+    if (last - first >= MAX_GRANULES) {
+        return UINT64_MAX;
+    }
+    for (g = first; g <= last; g++) {
+        sum += estimate(sketch, (uint32_t)g);
+    }
+    return sum < sketch->total ? sum : sketch->total;
+}
+
+// Maps the ELF file and collects its data symbols, from .symtab or, for stripped files, .dynsym
+static struct symbol *load_symbols(const char *path, size_t *count) {
+    struct symbol *symbols = NULL;
+    const unsigned char *image;
+    const char *strtab;
+    uint64_t shoff, sh_offset, sh_size, sh_entsize, sym_value, sym_size;
+    uint32_t sh_type, sh_link, sym_name;
+    unsigned int shnum, shentsize, i, pass;
+    unsigned char sym_type;
+    size_t n, j;
+    struct stat st;
+    int is64;
+    int fd;
+
+    *count = 0;
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    if (st.st_size < (off_t)sizeof(Elf64_Ehdr) || memcmp(image, ELFMAG, SELFMAG) != 0) {
+        printf("%s is not an ELF file\n", path);
+        munmap((void *)image, st.st_size);
+        return NULL;
+    }
+
+    is64 = image[EI_CLASS] == ELFCLASS64;
+    shoff = is64 ? ((const Elf64_Ehdr *)image)->e_shoff : ((const Elf32_Ehdr *)image)->e_shoff;
+    shnum = is64 ? ((const Elf64_Ehdr *)image)->e_shnum : ((const Elf32_Ehdr *)image)->e_shnum;
+    shentsize = is64 ? ((const Elf64_Ehdr *)image)->e_shentsize : ((const Elf32_Ehdr *)image)->e_shentsize;
+    if (shoff + (uint64_t)shnum * shentsize > (uint64_t)st.st_size) {
+        printf("%s has a truncated section header table\n", path);
+        munmap((void *)image, st.st_size);
+        return NULL;
+    }
+
+    // The image stays mapped for the life of the process, symbol names point into it
+    for (pass = 0; pass < 2 && *count == 0; pass++) {
+        for (i = 0; i < shnum; i++) {
+            const unsigned char *sh = image + shoff + (uint64_t)i * shentsize;
+            const unsigned char *link_sh;
+
+            sh_type = is64 ? ((const Elf64_Shdr *)sh)->sh_type : ((const Elf32_Shdr *)sh)->sh_type;
+            if (sh_type != (pass == 0 ? SHT_SYMTAB : SHT_DYNSYM)) {
+                continue;
+            }
+
+            sh_offset = is64 ? ((const Elf64_Shdr *)sh)->sh_offset : ((const Elf32_Shdr *)sh)->sh_offset;
+            sh_size = is64 ? ((const Elf64_Shdr *)sh)->sh_size : ((const Elf32_Shdr *)sh)->sh_size;
+            sh_entsize = is64 ? ((const Elf64_Shdr *)sh)->sh_entsize : ((const Elf32_Shdr *)sh)->sh_entsize;
+            sh_link = is64 ? ((const Elf64_Shdr *)sh)->sh_link : ((const Elf32_Shdr *)sh)->sh_link;
+            if (sh_entsize == 0) {
+                continue;
+            }
+
+            link_sh = image + shoff + (uint64_t)sh_link * shentsize;
+            strtab = (const char *)image + (is64 ? ((const Elf64_Shdr *)link_sh)->sh_offset : ((const Elf32_Shdr *)link_sh)->sh_offset);
+
+            n = sh_size / sh_entsize;
+            symbols = realloc(symbols, (*count + n) * sizeof(*symbols));
+            for (j = 0; j < n; j++) {
+                const unsigned char *sym = image + sh_offset + j * sh_entsize;
+
+                if (is64) {
+                    sym_type = ELF64_ST_TYPE(((const Elf64_Sym *)sym)->st_info);
+                    sym_value = ((const Elf64_Sym *)sym)->st_value;
+                    sym_size = ((const Elf64_Sym *)sym)->st_size;
+                    sym_name = ((const Elf64_Sym *)sym)->st_name;
+                } else {
+                    sym_type = ELF32_ST_TYPE(((const Elf32_Sym *)sym)->st_info);
+                    sym_value = ((const Elf32_Sym *)sym)->st_value;
+                    sym_size = ((const Elf32_Sym *)sym)->st_size;
+                    sym_name = ((const Elf32_Sym *)sym)->st_name;
+                }
+
+                // Data has a size, a miss is only attributed to the object it falls in
+                if (sym_type != STT_OBJECT || sym_value == 0 || sym_size == 0) {
+                    continue;
+                }
+                symbols[*count].addr = sym_value;
+                symbols[*count].size = sym_size;
+                symbols[*count].name = strtab + sym_name;
+                symbols[*count].misses = 0;
+                (*count)++;
+            }
+        }
+    }
+
+    return symbols;
+}
+
+static int by_misses(const void *a, const void *b) {
+    const struct symbol *x = a, *y = b;
+    return (y->misses > x->misses) - (y->misses < x->misses);
+}
+
+static const struct symbol *find_symbol(const struct symbol *symbols, size_t count, uint64_t addr) {
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (addr >= symbols[i].addr && addr < symbols[i].addr + symbols[i].size) {
+            return &symbols[i];
+        }
+    }
+    return NULL;
+}
+
+static void print_bar(uint64_t value, uint64_t max) {
+    int n = max ? (int)(value * BAR_WIDTH / max) : 0;
+
+    printf(" %.*s\n", n, "##################################################");
+}
+
+static void report_regions(const struct sketch *sketch) {
+    uint64_t span = (uint64_t)sketch->filter_high - sketch->filter_low + 1;
+    uint64_t granule = 1ULL << sketch->granule_shift;
+    uint64_t step = (span / REGIONS + granule - 1) & ~(granule - 1);
+    uint64_t misses[REGIONS];
+    uint64_t low, max = 0;
+    unsigned int i;
+
+    if (step < granule) {
+        step = granule;
+    }
+    for (i = 0; i < REGIONS; i++) {
+        low = sketch->filter_low + i * step;
+        misses[i] = low <= sketch->filter_high ? range_misses(sketch, low, low + step - 1) : 0;
+        if (misses[i] == UINT64_MAX) {
+            printf("\nThe counted range is too large for a region heat map, record with a narrower one\n");
+            return;
+        }
+        if (misses[i] > max) {
+            max = misses[i];
+        }
+    }
+
+    printf("\nHeat map, %llu bytes per region:\n\n", (unsigned long long)step);
+    for (i = 0; i < REGIONS && sketch->filter_low + i * step <= sketch->filter_high; i++) {
+        printf("  %08llx %10llu", (unsigned long long)(sketch->filter_low + i * step), (unsigned long long)misses[i]);
+        print_bar(misses[i], max);
+    }
+}
+
+static int report(const char *sketch_path, const char *elf_path) {
+    struct symbol *symbols = NULL;
+    const struct symbol *sym;
+    struct sketch sketch;
+    size_t count = 0, i;
+    uint64_t misses;
+
+    if (load_sketch(sketch_path, &sketch) < 0) {
+        return -1;
+    }
+    if (elf_path) {
+        symbols = load_symbols(elf_path, &count);
+        if (!symbols) {
+            printf("No data symbols found in %s\n", elf_path);
+            free(sketch.counters);
+            return -1;
+        }
+    }
+
+    printf("%u misses from %08x to %08x, %u-byte granules\n\n", sketch.total, sketch.filter_low, sketch.filter_high,
+           1U << sketch.granule_shift);
+    printf("  address      misses       %%  symbol\n");
+    for (i = 0; i < sketch.entries; i++) {
+        sym = find_symbol(symbols, count, sketch.entry[i].addr);
+        printf("  %08x %10u  %6.2f  ", sketch.entry[i].addr, sketch.entry[i].count,
+               sketch.total ? 100.0 * sketch.entry[i].count / sketch.total : 0.0);
+        if (sym) {
+            printf("%s+0x%llx\n", sym->name, (unsigned long long)(sketch.entry[i].addr - sym->addr));
+        } else {
+            printf("\n");
+        }
+    }
+
+    report_regions(&sketch);
+
+    if (symbols) {
+        for (i = 0; i < count; i++) {
+            misses = range_misses(&sketch, symbols[i].addr, symbols[i].addr + symbols[i].size - 1);
+            symbols[i].misses = misses == UINT64_MAX ? 0 : misses;
+        }
+        qsort(symbols, count, sizeof(*symbols), by_misses);
+
+        printf("\nMisses by symbol:\n\n");
+        printf("      misses       %%  size      name\n");
+        for (i = 0; i < count && i < MAX_SYMBOLS && symbols[i].misses; i++) {
+            printf("  %10llu  %6.2f  %-8llu  %s\n", (unsigned long long)symbols[i].misses,
+                   sketch.total ? 100.0 * symbols[i].misses / sketch.total : 0.0, (unsigned long long)symbols[i].size,
+                   symbols[i].name);
+        }
+    }
+
+    free(symbols);
+    free(sketch.counters);
+    return 0;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s record <seconds> <sketch.txt> [granule_shift] [low high] [hart]\n", name);
+    printf("       %s report <sketch.txt> [elf]\n", name);
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && argc <= 8 && argc != 6 && strcmp(argv[1], "record") == 0) {
+        return record(argc, argv);
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "report") == 0) {
+        return report(argv[2], argc > 3 ? argv[3] : NULL);
+    }
+
+    usage(argv[0]);
+    return -1;
+}
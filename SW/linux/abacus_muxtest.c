@@ -0,0 +1,165 @@
+// Checks that the perf PMU rotates more programmable events than there are event counters.
+//
+//   ./abacus_muxtest [extra_events] [milliseconds]
+//
+// Opens NUM_EVENT_COUNTERS + extra_events (default 2) abacus/sel_cycle/ events on itself, pinned to
+// CPU 0, spins for milliseconds (default 200) and reads them back. Each event counts the same
+// cycles, so every scaled count must be nonzero and close to the others, and each event must have
+// been reported running for as long as it was enabled. Exits with 1 when a check fails.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "abacus_ioctl.h"
+
+#define DEVICE "/dev/abacus"
+#define PMU_TYPE "/sys/bus/event_source/devices/abacus/type"
+#define PMU_PROGRAMMABLE (1ULL << 12) // The prog and sel format fields of the PMU
+#define PMU_SELECT_SHIFT 16
+#define MAX_EVENTS 32
+#define TOLERANCE_PERCENT 25
+
+struct reading {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+};
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int read_pmu_type(void) {
+    FILE *f = fopen(PMU_TYPE, "r");
+    int type = -1;
+
+    if (!f) {
+        perror(PMU_TYPE);
+        return -1;
+    }
+    if (fscanf(f, "%d", &type) != 1)
+        type = -1;
+    fclose(f);
+    return type;
+}
+
+// The register is constant, so reading it through the mapping has no side effect
+static int read_num_counters(void) {
+    volatile const uint32_t *regs;
+    int fd, num;
+
+    fd = open(DEVICE, O_RDONLY);
+    if (fd < 0) {
+        perror(DEVICE);
+        return -1;
+    }
+    regs = mmap(NULL, ABACUS_MMAP_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (regs == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return -1;
+    }
+    num = regs[ABACUS_REG_EVENT_NUM_COUNTERS / 4];
+    munmap((void *)regs, ABACUS_MMAP_SIZE);
+    close(fd);
+    return num;
+}
+
+int main(int argc, char **argv) {
+    int extra = argc > 1 ? atoi(argv[1]) : 2;
+    uint64_t duration_ns = (argc > 2 ? strtoull(argv[2], NULL, 0) : 200) * 1000000ULL;
+    struct perf_event_attr attr;
+    struct reading reading[MAX_EVENTS];
+    int fd[MAX_EVENTS];
+    int type, counters, events, i, failed = 0;
+    uint64_t start, sum = 0, mean;
+    cpu_set_t cpus;
+
+    type = read_pmu_type();
+    counters = read_num_counters();
+    if (type < 0 || counters < 0)
+        return 1;
+    events = counters + extra;
+    if (extra < 1 || events > MAX_EVENTS) {
+        fprintf(stderr, "Open between 1 and %d events more than the %d counters\n", MAX_EVENTS - counters, counters);
+        return 1;
+    }
+
+    // The counters are rotated per hart, keep every event on the same one
+    CPU_ZERO(&cpus);
+    CPU_SET(0, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+        perror("sched_setaffinity");
+        return 1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = PMU_PROGRAMMABLE | ((uint64_t)ABACUS_EVENT_CYCLE << PMU_SELECT_SHIFT);
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = 1;
+
+    for (i = 0; i < events; i++) {
+        fd[i] = perf_event_open(&attr, 0, -1, -1, 0);
+        if (fd[i] < 0) {
+            perror("perf_event_open");
+            return 1;
+        }
+    }
+
+    for (i = 0; i < events; i++)
+        ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    start = now_ns();
+    while (now_ns() - start < duration_ns)
+        ;
+    for (i = 0; i < events; i++)
+        ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (i = 0; i < events; i++) {
+        if (read(fd[i], &reading[i], sizeof(reading[i])) != sizeof(reading[i])) {
+            perror("read");
+            return 1;
+        }
+        sum += reading[i].value;
+        close(fd[i]);
+    }
+    mean = sum / events;
+
+    printf("%d sel_cycle events on %d counters for %llu ms\n", events, counters, (unsigned long long)(duration_ns / 1000000));
+    for (i = 0; i < events; i++) {
+        uint64_t diff = reading[i].value > mean ? reading[i].value - mean : mean - reading[i].value;
+        const char *verdict = "ok";
+
+        if (!reading[i].value)
+            verdict = "never counted";
+        else if (diff * 100 > mean * TOLERANCE_PERCENT)
+            verdict = "too far from the mean";
+        else if (reading[i].time_running != reading[i].time_enabled)
+            verdict = "not scaled by the driver";
+        if (strcmp(verdict, "ok"))
+            failed = 1;
+        printf("  %2d: %12llu cycles, enabled %llu ns, running %llu ns: %s\n", i, (unsigned long long)reading[i].value,
+               (unsigned long long)reading[i].time_enabled, (unsigned long long)reading[i].time_running, verdict);
+    }
+
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed;
+}
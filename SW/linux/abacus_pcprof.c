@@ -0,0 +1,320 @@
+// Flat profile from the ABACUS PC sampler.
+//
+//   ./abacus_pcprof record <seconds> <samples.txt> [period]
+//       Samples the PC of the issuing instruction every period cycles (default 4096) and
+//       writes one hex PC per line. The workload runs unmodified.
+//
+//   ./abacus_pcprof report <elf> <samples.txt>
+//       Folds the samples into functions using the symbol table of the ELF file, and
+//       prints them hottest first, like the flat profile of gprof. The samples file can
+//       also come from the baremetal get_pc_samples command.
+//
+// The sampler sees every privilege level, so only samples that fall inside the given ELF
+// are attributed: use vmlinux for the kernel, a statically linked binary for a process,
+// or the baremetal image.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "abacus_ioctl.h"
+
+#define DEVICE "/dev/abacus"
+#define DEFAULT_PERIOD 4096
+#define DRAIN_BATCH 4096
+#define DRAIN_INTERVAL_NS 10000000 // Drain often enough that the FIFO does not fill at short periods
+
+struct symbol {
+    uint64_t addr;
+    uint64_t size;
+    const char *name;
+    unsigned long samples;
+};
+
+static int record(const char *seconds_arg, const char *path, const char *period_arg) {
+    struct abacus_pc_samples req;
+    uint32_t buffer[DRAIN_BATCH];
+    uint32_t period = period_arg ? (uint32_t)strtoul(period_arg, NULL, 0) : DEFAULT_PERIOD;
+    uint32_t units = ABACUS_UNIT_PC;
+    struct timespec interval = { 0, DRAIN_INTERVAL_NS };
+    struct timespec start, now;
+    unsigned long total = 0;
+    double seconds = strtod(seconds_arg, NULL);
+    int stopping = 0;
+    uint32_t i;
+    FILE *out;
+    int fd;
+
+    fd = open(DEVICE, O_RDONLY);
+    if (fd < 0) {
+        printf("There was an error with opening the device\n");
+        return -1;
+    }
+
+    out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    // Samples left in the FIFO by an earlier run are cleared, a paused sampler keeps them
+    if (ioctl(fd, ABACUS_IOC_SET_PC_SAMPLE_PERIOD, &period) < 0 || ioctl(fd, ABACUS_IOC_CLEAR, &units) < 0 ||
+        ioctl(fd, ABACUS_IOC_ENABLE, &units) < 0) {
+        perror("ioctl");
+        fclose(out);
+        close(fd);
+        return -1;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.samples = (uintptr_t)buffer;
+    req.capacity = DRAIN_BATCH;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        nanosleep(&interval, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (!stopping && (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 >= seconds) {
+            // Disabling pauses the sampler and keeps its FIFO, which is drained below
+            ioctl(fd, ABACUS_IOC_DISABLE, &units);
+            stopping = 1;
+        }
+
+        do {
+            if (ioctl(fd, ABACUS_IOC_READ_PC_SAMPLES, &req) < 0) {
+                perror("ioctl");
+                stopping = 1;
+                req.pending = 0;
+                break;
+            }
+            for (i = 0; i < req.count; i++) {
+                fprintf(out, "%08x\n", buffer[i]);
+            }
+            total += req.count;
+        } while (req.pending);
+
+        if (stopping) {
+            break;
+        }
+    }
+
+    printf("%lu samples written to %s, %u dropped\n", total, path, req.dropped);
+
+    ioctl(fd, ABACUS_IOC_DISABLE, &units);
+    fclose(out);
+    close(fd);
+    return 0;
+}
+
+// Maps the ELF file and collects its function symbols, from .symtab or, for stripped files, .dynsym
+static struct symbol *load_symbols(const char *path, size_t *count) {
+    struct symbol *symbols = NULL;
+    const unsigned char *image;
+    const char *strtab;
+    uint64_t shoff, sh_offset, sh_size, sh_entsize, sym_value, sym_size;
+    uint32_t sh_type, sh_link, sym_name;
+    unsigned int shnum, shentsize, i, pass;
+    unsigned char sym_type;
+    size_t n, j;
+    struct stat st;
+    int is64;
+    int fd;
+
+    *count = 0;
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    if (st.st_size < (off_t)sizeof(Elf64_Ehdr) || memcmp(image, ELFMAG, SELFMAG) != 0) {
+        printf("%s is not an ELF file\n", path);
+        munmap((void *)image, st.st_size);
+        return NULL;
+    }
+
+    is64 = image[EI_CLASS] == ELFCLASS64;
+    shoff = is64 ? ((const Elf64_Ehdr *)image)->e_shoff : ((const Elf32_Ehdr *)image)->e_shoff;
+    shnum = is64 ? ((const Elf64_Ehdr *)image)->e_shnum : ((const Elf32_Ehdr *)image)->e_shnum;
+    shentsize = is64 ? ((const Elf64_Ehdr *)image)->e_shentsize : ((const Elf32_Ehdr *)image)->e_shentsize;
+    if (shoff + (uint64_t)shnum * shentsize > (uint64_t)st.st_size) {
+        printf("%s has a truncated section header table\n", path);
+        munmap((void *)image, st.st_size);
+        return NULL;
+    }
+
+    // The image stays mapped for the life of the process, symbol names point into it
+    for (pass = 0; pass < 2 && *count == 0; pass++) {
+        for (i = 0; i < shnum; i++) {
+            const unsigned char *sh = image + shoff + (uint64_t)i * shentsize;
+            const unsigned char *link_sh;
+
+            sh_type = is64 ? ((const Elf64_Shdr *)sh)->sh_type : ((const Elf32_Shdr *)sh)->sh_type;
+            if (sh_type != (pass == 0 ? SHT_SYMTAB : SHT_DYNSYM)) {
+                continue;
+            }
+
+            sh_offset = is64 ? ((const Elf64_Shdr *)sh)->sh_offset : ((const Elf32_Shdr *)sh)->sh_offset;
+            sh_size = is64 ? ((const Elf64_Shdr *)sh)->sh_size : ((const Elf32_Shdr *)sh)->sh_size;
+            sh_entsize = is64 ? ((const Elf64_Shdr *)sh)->sh_entsize : ((const Elf32_Shdr *)sh)->sh_entsize;
+            sh_link = is64 ? ((const Elf64_Shdr *)sh)->sh_link : ((const Elf32_Shdr *)sh)->sh_link;
+            if (sh_entsize == 0) {
+                continue;
+            }
+
+            link_sh = image + shoff + (uint64_t)sh_link * shentsize;
+            strtab = (const char *)image + (is64 ? ((const Elf64_Shdr *)link_sh)->sh_offset : ((const Elf32_Shdr *)link_sh)->sh_offset);
+
+            n = sh_size / sh_entsize;
+            symbols = realloc(symbols, (*count + n) * sizeof(*symbols));
+            for (j = 0; j < n; j++) {
+                const unsigned char *sym = image + sh_offset + j * sh_entsize;
+
+                if (is64) {
+                    sym_type = ELF64_ST_TYPE(((const Elf64_Sym *)sym)->st_info);
+                    sym_value = ((const Elf64_Sym *)sym)->st_value;
+                    sym_size = ((const Elf64_Sym *)sym)->st_size;
+                    sym_name = ((const Elf64_Sym *)sym)->st_name;
+                } else {
+                    sym_type = ELF32_ST_TYPE(((const Elf32_Sym *)sym)->st_info);
+                    sym_value = ((const Elf32_Sym *)sym)->st_value;
+                    sym_size = ((const Elf32_Sym *)sym)->st_size;
+                    sym_name = ((const Elf32_Sym *)sym)->st_name;
+                }
+
+                if (sym_type != STT_FUNC || sym_value == 0) {
+                    continue;
+                }
+                symbols[*count].addr = sym_value;
+                symbols[*count].size = sym_size;
+                symbols[*count].name = strtab + sym_name;
+                symbols[*count].samples = 0;
+                (*count)++;
+            }
+        }
+    }
+
+    return symbols;
+}
+
+static int by_address(const void *a, const void *b) {
+    const struct symbol *x = a, *y = b;
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static int by_samples(const void *a, const void *b) {
+    const struct symbol *x = a, *y = b;
+    return (y->samples > x->samples) - (y->samples < x->samples);
+}
+
+// Function containing pc, symbols without a size extend to the next symbol
+static struct symbol *find_symbol(struct symbol *symbols, size_t count, uint64_t pc) {
+    size_t lo = 0, hi = count;
+    size_t mid;
+    uint64_t end;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (symbols[mid].addr <= pc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return NULL;
+    }
+
+    end = symbols[lo - 1].size ? symbols[lo - 1].addr + symbols[lo - 1].size : (lo < count ? symbols[lo].addr : UINT64_MAX);
+    return pc < end ? &symbols[lo - 1] : NULL;
+}
+
+static int report(const char *elf_path, const char *samples_path) {
+    struct symbol *symbols, *sym;
+    unsigned long total = 0, unknown = 0;
+    unsigned long long pc;
+    double self, cumulative = 0;
+    size_t count, i;
+    FILE *in;
+
+    symbols = load_symbols(elf_path, &count);
+    if (!symbols) {
+        printf("No function symbols found in %s\n", elf_path);
+        return -1;
+    }
+    qsort(symbols, count, sizeof(*symbols), by_address);
+
+    in = fopen(samples_path, "r");
+    if (!in) {
+        perror(samples_path);
+        free(symbols);
+        return -1;
+    }
+
+    while (fscanf(in, "%llx", &pc) == 1) {
+        sym = find_symbol(symbols, count, pc);
+        if (sym) {
+            sym->samples++;
+        } else {
+            unknown++;
+        }
+        total++;
+    }
+    fclose(in);
+
+    if (total == 0) {
+        printf("No samples in %s\n", samples_path);
+        free(symbols);
+        return -1;
+    }
+
+    qsort(symbols, count, sizeof(*symbols), by_samples);
+
+    printf("Flat profile, %lu samples:\n\n", total);
+    printf("  %%       cumulative  self\n");
+    printf(" time     %%          samples  name\n");
+    for (i = 0; i < count && symbols[i].samples; i++) {
+        self = 100.0 * symbols[i].samples / total;
+        cumulative += self;
+        printf("%6.2f   %6.2f   %10lu  %s\n", self, cumulative, symbols[i].samples, symbols[i].name);
+    }
+    if (unknown) {
+        printf("%6.2f            %10lu  <outside %s>\n", 100.0 * unknown / total, unknown, elf_path);
+    }
+
+    free(symbols);
+    return 0;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s record <seconds> <samples.txt> [period]\n", name);
+    printf("       %s report <elf> <samples.txt>\n", name);
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "record") == 0) {
+        return record(argv[2], argv[3], argc > 4 ? argv[4] : NULL);
+    }
+    if (argc == 4 && strcmp(argv[1], "report") == 0) {
+        return report(argv[2], argv[3]);
+    }
+
+    usage(argv[0]);
+    return -1;
+}
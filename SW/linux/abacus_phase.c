@@ -0,0 +1,171 @@
+// Counter time series from the ABACUS timer sampler.
+//
+//   ./abacus_phase <seconds> <samples.csv> [period_us] [units] [hart]
+//       Has the driver read the counters of units (an ABACUS_UNIT_* mask, default every unit) every
+//       period_us microseconds (default 100) and writes one CSV row per sample: the sequence, the
+//       CLOCK_MONOTONIC timestamp in nanoseconds, then what every counter gained since the previous
+//       row, in the order of struct abacus_counters. hart chooses the hart of a multi-hart build,
+//       all of them summed by default.
+//
+// Unlike abacus_timeline this needs no snapshot ring in the hardware, the samples are taken by a kernel
+// timer and read from /dev/abacus_samples in batches. A row whose sequence jumps also covers the
+// samples skipped before it because this tool fell behind.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "abacus_ioctl.h"
+
+#define DEVICE "/dev/abacus_samples"
+#define DEFAULT_PERIOD_US 100
+#define ENTRIES 4096
+#define BATCH 256
+#define POLL_TIMEOUT_MS 100
+
+static struct abacus_sample batch[BATCH];
+
+static void usage(const char *name) {
+    printf("Usage: %s <seconds> <samples.csv> [period_us] [units] [hart]\n", name);
+}
+
+static void write_header(FILE *out) {
+    unsigned int i;
+
+    fprintf(out, "sequence,timestamp_ns");
+    for (i = 0; i < ABACUS_IP_NUM_COUNTERS; i++) {
+        fprintf(out, ",ip%u", i);
+    }
+    for (i = 0; i < ABACUS_CP_NUM_COUNTERS; i++) {
+        fprintf(out, ",cp%u", i);
+    }
+    for (i = 0; i < ABACUS_SU_NUM_COUNTERS; i++) {
+        fprintf(out, ",su%u", i);
+    }
+    fprintf(out, "\n");
+}
+
+static void write_sample(FILE *out, const struct abacus_sample *sample) {
+    const __u64 *delta = (const __u64 *)&sample->ip; // ip, cp and su follow each other
+    unsigned int i;
+
+    fprintf(out, "%u,%llu", sample->sequence, (unsigned long long)sample->timestamp);
+    for (i = 0; i < ABACUS_IP_NUM_COUNTERS + ABACUS_CP_NUM_COUNTERS + ABACUS_SU_NUM_COUNTERS; i++) {
+        fprintf(out, ",%llu", (unsigned long long)delta[i]);
+    }
+    fprintf(out, "\n");
+}
+
+// Writes out every queued sample, returns how many or -1 on an error
+static long drain(int fd, FILE *out) {
+    long total = 0;
+    ssize_t n;
+    size_t i;
+
+    while ((n = read(fd, batch, sizeof(batch))) > 0) {
+        for (i = 0; i < (size_t)n / sizeof(batch[0]); i++) {
+            write_sample(out, &batch[i]);
+        }
+        total += n / (ssize_t)sizeof(batch[0]);
+    }
+    if (n < 0 && errno != EAGAIN) {
+        perror("read");
+        return -1;
+    }
+    return total;
+}
+
+int main(int argc, char **argv) {
+    struct abacus_sampler_config config;
+    struct abacus_sampler_status status;
+    struct timespec start, now;
+    struct pollfd pfd;
+    unsigned long total = 0;
+    double seconds;
+    long count;
+    FILE *out;
+    int ret = 0;
+    int fd;
+
+    if (argc < 3 || argc > 6) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    seconds = strtod(argv[1], NULL);
+    memset(&config, 0, sizeof(config));
+    config.period_ns = (argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : DEFAULT_PERIOD_US) * 1000;
+    config.units = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : (ABACUS_UNIT_IP | ABACUS_UNIT_CP | ABACUS_UNIT_SU);
+    config.hart = argc > 5 ? (uint32_t)strtoul(argv[5], NULL, 0) : ABACUS_HART_ALL;
+    config.entries = ENTRIES;
+    config.wakeup = BATCH;
+
+    // Non-blocking, so the run ends on time even when fewer than a batch are queued
+    fd = open(DEVICE, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        printf("There was an error with opening the device\n");
+        return -1;
+    }
+
+    out = fopen(argv[2], "w");
+    if (!out) {
+        perror(argv[2]);
+        close(fd);
+        return -1;
+    }
+
+    if (ioctl(fd, ABACUS_IOC_SAMPLER_START, &config) < 0) {
+        perror("ioctl");
+        fclose(out);
+        close(fd);
+        return -1;
+    }
+
+    write_header(out);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        if (poll(&pfd, 1, POLL_TIMEOUT_MS) < 0) {
+            perror("poll");
+            ret = -1;
+            break;
+        }
+        if (pfd.revents & POLLIN) {
+            count = drain(fd, out);
+            if (count < 0) {
+                ret = -1;
+                break;
+            }
+            total += count;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 >= seconds) {
+            break;
+        }
+    }
+
+    // Samples queued before the stop are still written out
+    ioctl(fd, ABACUS_IOC_SAMPLER_STOP);
+    count = drain(fd, out);
+    if (count > 0) {
+        total += count;
+    }
+
+    memset(&status, 0, sizeof(status));
+    ioctl(fd, ABACUS_IOC_SAMPLER_STATUS, &status);
+    printf("%lu samples written to %s, %u skipped\n", total, argv[2], status.skipped);
+
+    fclose(out);
+    close(fd);
+    return ret;
+}
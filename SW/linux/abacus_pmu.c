@@ -0,0 +1,652 @@
+// perf_event PMU for ABACUS, so the counters can be used with the standard perf tools:
+//
+//   perf stat -e abacus/dcache_miss/,abacus/branch_mispredict/ ./workload
+//
+// Each counter is an event whose config is the offset of its register, the named events are
+// listed in /sys/bus/event_source/devices/abacus/events. ABACUS has no sampling interrupt,
+// so only counting events are supported.
+//
+// Events with prog=1 count any core event on the programmable counters instead, sel is its
+// ABACUS_EVENT_* number and edge=1 counts its rising edges rather than its cycles:
+//
+//   perf stat -e abacus/sel_dcache_request/,abacus/sel_branch_mispredict,edge=1/ ./workload
+//
+// A counter is taken when the event is scheduled in and given back when it is scheduled out. perf
+// never rotates the events of a software context PMU, so with more programmable events than counters
+// the driver rotates them itself: the events left without a counter wait, and a timer of the hart
+// hands the counters to the next events every ABACUS_PMU_ROTATE_NS. Each event reports what it
+// counted scaled by the time it was started over the time it held a counter, so perf sees it running
+// the whole time and prints the estimate. The events of a group rotate like the others, so ratios
+// within a group are estimates too once they have to share the counters.
+//
+// On a multi-hart build every CPU with a profiler block is a perf CPU of its own, an event counts
+// on the block of the hart it is scheduled in on, and perf stat -a -A shows the harts side by side.
+
+#include <linux/kernel.h>
+#include <linux/perf_event.h>
+#include <linux/cpumask.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/device.h>
+#include <linux/sysfs.h>
+
+#include "abacus_driver.h"
+
+// CPUs whose hart has a profiler block, every CPU of abacus_num_harts
+static struct cpumask abacus_pmu_cpus;
+
+#define ABACUS_PMU_PROGRAMMABLE (1ULL << 12)
+#define ABACUS_PMU_SELECT_SHIFT 16
+#define ABACUS_PMU_EDGE (1ULL << 24)
+#define ABACUS_PMU_PROGRAMMABLE_CONFIG \
+	(ABACUS_PMU_PROGRAMMABLE | ((u64)ABACUS_EVENT_SELECT_EVENT << ABACUS_PMU_SELECT_SHIFT) | ABACUS_PMU_EDGE)
+
+struct abacus_pmu_unit {
+	unsigned int base;
+	unsigned int enable;
+	unsigned int num_counters;
+};
+
+static const struct abacus_pmu_unit abacus_pmu_units[] = {
+	{ ABACUS_REG_IP_BASE, ABACUS_REG_IP_ENABLE, ABACUS_IP_NUM_COUNTERS },
+	{ ABACUS_REG_CP_BASE, ABACUS_REG_CP_ENABLE, ABACUS_CP_NUM_COUNTERS },
+	{ ABACUS_REG_SU_BASE, ABACUS_REG_SU_ENABLE, ABACUS_SU_NUM_COUNTERS },
+};
+
+// A unit only counts while it is enabled, so it is turned on when its first event starts and paused
+// again when its last event stops, unless it was already enabled through /dev/abacus.
+// Every hart has its own units and programmable counters.
+static DEFINE_RAW_SPINLOCK(abacus_pmu_lock);
+static unsigned int unit_users[ABACUS_MAX_HARTS][ARRAY_SIZE(abacus_pmu_units)];
+static unsigned int units_enabled_by_pmu[ABACUS_MAX_HARTS];
+
+// Programmable counters in the hardware, and those taken by scheduled events
+static unsigned int num_event_counters;
+static unsigned long event_counters_used[ABACUS_MAX_HARTS];
+
+#define ABACUS_PMU_MAX_PROGRAMMABLE 32 // Programmable events scheduled in on a hart at once
+#define ABACUS_PMU_ROTATE_NS (4 * NSEC_PER_MSEC)
+
+// A programmable event while it is scheduled in, in the slot given by its hw.idx
+struct abacus_pmu_prog {
+	struct perf_event *event; // NULL for a free slot
+	int counter;              // -1 while the event waits for a counter
+	bool counting;            // Between start() and stop()
+	u64 stamp;                // Time the fields below were last brought up to
+	u64 enabled;              // Nanoseconds the event was started
+	u64 running;              // Nanoseconds of those it held a counter
+	u64 raw;                  // Counts seen while it held a counter
+	u64 reported;             // Scaled count already added to event->count
+};
+
+// Guarded by abacus_pmu_lock
+static struct abacus_pmu_prog prog_events[ABACUS_MAX_HARTS][ABACUS_PMU_MAX_PROGRAMMABLE];
+static unsigned int prog_next[ABACUS_MAX_HARTS]; // Slot given the first counter at the next rotation
+static bool prog_rotating[ABACUS_MAX_HARTS];     // The rotation timer of the hart is running
+static struct hrtimer rotate_timer[ABACUS_MAX_HARTS];
+
+static bool abacus_pmu_is_programmable(struct perf_event *event) {
+	return event->attr.config & ABACUS_PMU_PROGRAMMABLE;
+}
+
+// The register page of the hart is chosen when the event is scheduled in
+static unsigned int abacus_pmu_hart(struct perf_event *event) {
+	return event->hw.event_base / ABACUS_HART_STRIDE;
+}
+
+static int abacus_pmu_event_unit(u64 config) {
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(abacus_pmu_units); i++) {
+		if (config >= abacus_pmu_units[i].base &&
+		    config < abacus_pmu_units[i].base + 4 * abacus_pmu_units[i].num_counters &&
+		    !(config & 0x3))
+			return i;
+	}
+	return -1;
+}
+
+static void abacus_pmu_unit_get(unsigned int hart, int unit) {
+	void __iomem *enable = abacus_base + ABACUS_HART_OFFSET(hart) + abacus_pmu_units[unit].enable;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&abacus_pmu_lock, flags);
+	if (unit_users[hart][unit]++ == 0 && !(ioread32(enable) & 0x1)) {
+		iowrite32(0x1, enable);
+		units_enabled_by_pmu[hart] |= 1U << unit;
+	}
+	raw_spin_unlock_irqrestore(&abacus_pmu_lock, flags);
+}
+
+static void abacus_pmu_unit_put(unsigned int hart, int unit) {
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&abacus_pmu_lock, flags);
+	if (--unit_users[hart][unit] == 0 && (units_enabled_by_pmu[hart] & (1U << unit))) {
+		iowrite32(0x0, abacus_base + ABACUS_HART_OFFSET(hart) + abacus_pmu_units[unit].enable);
+		units_enabled_by_pmu[hart] &= ~(1U << unit);
+	}
+	raw_spin_unlock_irqrestore(&abacus_pmu_lock, flags);
+}
+
+// A group is scheduled in all at once, so it cannot hold more programmable events than there are counters
+static bool abacus_pmu_validate_group(struct perf_event *event) {
+	struct perf_event *leader = event->group_leader;
+	struct perf_event *sibling;
+	unsigned int counters = 1;
+
+	if (leader != event && leader->pmu == event->pmu && abacus_pmu_is_programmable(leader))
+		counters++;
+	for_each_sibling_event(sibling, leader) {
+		if (sibling->pmu == event->pmu && abacus_pmu_is_programmable(sibling))
+			counters++;
+	}
+	return counters <= num_event_counters;
+}
+
+static u64 abacus_pmu_read_counter(struct perf_event *event) {
+	unsigned int hart = abacus_pmu_hart(event);
+	unsigned long flags;
+	u64 value;
+
+	// A snapshot replaces the window frozen by a rate alarm, so any crossing is logged first
+	abacus_alarm_collect();
+
+	raw_spin_lock_irqsave(&abacus_read_lock, flags);
+	// The counter registers only follow the live counters on a snapshot
+	abacus_snapshot_hold(hart);
+	value = abacus_read_counter64(event->hw.event_base + event->hw.config_base);
+	abacus_snapshot_release(hart);
+	raw_spin_unlock_irqrestore(&abacus_read_lock, flags);
+
+	return value;
+}
+
+// Brings the times and the count of a programmable event up to now and adds its new scaled count,
+// with abacus_pmu_lock held like the two helpers after it
+static void abacus_pmu_prog_update(struct abacus_pmu_prog *prog, u64 now) {
+	struct hw_perf_event *hwc = &prog->event->hw;
+	u64 elapsed = now - prog->stamp;
+	u64 value, scaled;
+
+	prog->stamp = now;
+	if (!prog->counting)
+		return;
+
+	prog->enabled += elapsed;
+	if (prog->counter >= 0) {
+		prog->running += elapsed;
+		value = abacus_pmu_read_counter(prog->event);
+		prog->raw += abacus_counter_delta(value, local64_read(&hwc->prev_count));
+		local64_set(&hwc->prev_count, value);
+	}
+
+	// The estimate may drop a little as the share of time settles, the difference is signed
+	scaled = prog->running ? mul_u64_u64_div_u64(prog->raw, prog->enabled, prog->running) : 0;
+	local64_add(scaled - prog->reported, &prog->event->count);
+	prog->reported = scaled;
+}
+
+// Points a free counter at the event, which restarts it from zero
+static void abacus_pmu_prog_attach(unsigned int hart, struct abacus_pmu_prog *prog, unsigned int counter) {
+	struct hw_perf_event *hwc = &prog->event->hw;
+
+	__set_bit(counter, &event_counters_used[hart]);
+	iowrite32(hwc->config, abacus_base + ABACUS_HART_OFFSET(hart) + ABACUS_REG_EVENT_SELECT(counter));
+	prog->counter = counter;
+	hwc->config_base = ABACUS_REG_EVENT_COUNTER(counter);
+	local64_set(&hwc->prev_count, abacus_pmu_read_counter(prog->event));
+}
+
+static void abacus_pmu_prog_detach(unsigned int hart, struct abacus_pmu_prog *prog) {
+	iowrite32(0x0, abacus_base + ABACUS_HART_OFFSET(hart) + ABACUS_REG_EVENT_SELECT(prog->counter));
+	__clear_bit(prog->counter, &event_counters_used[hart]);
+	prog->counter = -1;
+}
+
+// Hands every counter to the next events in slot order, starting after those that held them
+static enum hrtimer_restart abacus_pmu_rotate(struct hrtimer *timer) {
+	unsigned int hart = timer - rotate_timer;
+	struct abacus_pmu_prog *prog;
+	unsigned long flags;
+	unsigned int i, slot, events = 0, given = 0;
+	bool rotating;
+	u64 now = ktime_get_ns();
+
+	raw_spin_lock_irqsave(&abacus_pmu_lock, flags);
+	for (i = 0; i < ABACUS_PMU_MAX_PROGRAMMABLE; i++) {
+		prog = &prog_events[hart][i];
+		if (!prog->event)
+			continue;
+		events++;
+		abacus_pmu_prog_update(prog, now);
+		if (prog->counter >= 0)
+			abacus_pmu_prog_detach(hart, prog);
+	}
+
+	for (i = 0; i < ABACUS_PMU_MAX_PROGRAMMABLE && given < num_event_counters; i++) {
+		slot = (prog_next[hart] + i) % ABACUS_PMU_MAX_PROGRAMMABLE;
+		prog = &prog_events[hart][slot];
+		if (!prog->event)
+			continue;
+		abacus_pmu_prog_attach(hart, prog, given++);
+		prog_next[hart] = (slot + 1) % ABACUS_PMU_MAX_PROGRAMMABLE;
+	}
+
+	// Once every event has a counter they keep it, add() starts the timer again
+	rotating = prog_rotating[hart] = events > num_event_counters;
+	raw_spin_unlock_irqrestore(&abacus_pmu_lock, flags);
+
+	if (!rotating)
+		return HRTIMER_NORESTART;
+	hrtimer_forward_now(timer, ns_to_ktime(ABACUS_PMU_ROTATE_NS));
+	return HRTIMER_RESTART;
+}
+
+// Takes a slot for the event and a counter if one is free, otherwise the event waits for a rotation
+static int abacus_pmu_prog_add(unsigned int hart, struct perf_event *event) {
+	struct abacus_pmu_prog *prog = NULL;
+	unsigned long flags;
+	unsigned int i, counter;
+
+	raw_spin_lock_irqsave(&abacus_pmu_lock, flags);
+	for (i = 0; i < ABACUS_PMU_MAX_PROGRAMMABLE; i++) {
+		if (!prog_events[hart][i].event) {
+			prog = &prog_events[hart][i];
+			break;
+		}
+	}
+	if (!prog) {
+		raw_spin_unlock_irqrestore(&abacus_pmu_lock, flags);
+		return -EAGAIN;
+	}
+
+	memset(prog, 0, sizeof(*prog));
+	prog->event = event;
+	prog->counter = -1;
+	prog->stamp = ktime_get_ns();
+	event->hw.idx = i;
+
+	counter = find_first_zero_bit(&event_counters_used[hart], num_event_counters);
+	if (counter < num_event_counters) {
+		abacus_pmu_prog_attach(hart, prog, counter);
+	} else if (!prog_rotating[hart]) {
+		prog_rotating[hart] = true;
+		hrtimer_start(&rotate_timer[hart], ns_to_ktime(ABACUS_PMU_ROTATE_NS), HRTIMER_MODE_REL);
+	}
+	raw_spin_unlock_irqrestore(&abacus_pmu_lock, flags);
+	return 0;
+}
+
+static void abacus_pmu_prog_del(unsigned int hart, struct perf_event *event) {
+	struct abacus_pmu_prog *prog = &prog_events[hart][event->hw.idx];
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&abacus_pmu_lock, flags);
+	if (prog->counter >= 0)
+		abacus_pmu_prog_detach(hart, prog);
+	prog->event = NULL;
+	raw_spin_unlock_irqrestore(&abacus_pmu_lock, flags);
+	event->hw.idx = -1;
+}
+
+static void abacus_pmu_prog_set_counting(struct perf_event *event, bool counting) {
+	struct abacus_pmu_prog *prog = &prog_events[abacus_pmu_hart(event)][event->hw.idx];
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&abacus_pmu_lock, flags);
+	abacus_pmu_prog_update(prog, ktime_get_ns());
+	prog->counting = counting;
+	raw_spin_unlock_irqrestore(&abacus_pmu_lock, flags);
+}
+
+static void abacus_pmu_event_update(struct perf_event *event) {
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now;
+
+	if (abacus_pmu_is_programmable(event)) {
+		abacus_pmu_prog_set_counting(event, !(hwc->state & PERF_HES_STOPPED));
+		return;
+	}
+
+	do {
+		prev = local64_read(&hwc->prev_count);
+		now = abacus_pmu_read_counter(event);
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	// A unit cleared through /dev/abacus restarts from zero, count what it has seen since
+	local64_add(abacus_counter_delta(now, prev), &event->count);
+}
+
+static int abacus_pmu_event_init(struct perf_event *event) {
+	int unit;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event))
+		return -EOPNOTSUPP;
+
+	if (event->cpu >= 0 && !cpumask_test_cpu(event->cpu, &abacus_pmu_cpus))
+		return -EINVAL;
+
+	if (abacus_pmu_is_programmable(event)) {
+		u64 config = event->attr.config;
+		u32 select = (config >> ABACUS_PMU_SELECT_SHIFT) & ABACUS_EVENT_SELECT_EVENT;
+
+		if ((config & ~ABACUS_PMU_PROGRAMMABLE_CONFIG) || select >= ABACUS_NUM_EVENTS)
+			return -EINVAL;
+		if (!abacus_pmu_validate_group(event))
+			return -EINVAL;
+
+		event->hw.config = select | ABACUS_EVENT_SELECT_ENABLE | ((config & ABACUS_PMU_EDGE) ? ABACUS_EVENT_SELECT_EDGE : 0);
+		event->hw.idx = -1; // The counter is chosen when the event is scheduled in
+		return 0;
+	}
+
+	unit = abacus_pmu_event_unit(event->attr.config);
+	if (unit < 0)
+		return -EINVAL;
+
+	event->hw.config_base = event->attr.config;
+	event->hw.idx = unit;
+	return 0;
+}
+
+static void abacus_pmu_start(struct perf_event *event, int flags) {
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (abacus_pmu_is_programmable(event)) {
+		abacus_pmu_prog_set_counting(event, true);
+	} else {
+		abacus_pmu_unit_get(abacus_pmu_hart(event), hwc->idx);
+		local64_set(&hwc->prev_count, abacus_pmu_read_counter(event));
+	}
+	hwc->state = 0;
+}
+
+static void abacus_pmu_stop(struct perf_event *event, int flags) {
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	// Read before the unit is paused, so the count ends where the event stopped
+	if (abacus_pmu_is_programmable(event)) {
+		abacus_pmu_prog_set_counting(event, false);
+	} else {
+		abacus_pmu_event_update(event);
+		abacus_pmu_unit_put(abacus_pmu_hart(event), hwc->idx);
+	}
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int abacus_pmu_add(struct perf_event *event, int flags) {
+	struct hw_perf_event *hwc = &event->hw;
+	unsigned int hart = abacus_cpu_hart(smp_processor_id());
+	int ret;
+
+	// A task event does not count while its task runs on a CPU without a profiler block
+	if (hart >= abacus_num_harts)
+		return -ENODEV;
+	hwc->event_base = ABACUS_HART_OFFSET(hart);
+
+	if (abacus_pmu_is_programmable(event)) {
+		ret = abacus_pmu_prog_add(hart, event);
+		if (ret)
+			return ret;
+	}
+
+	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (flags & PERF_EF_START)
+		abacus_pmu_start(event, PERF_EF_RELOAD);
+	return 0;
+}
+
+static void abacus_pmu_del(struct perf_event *event, int flags) {
+	abacus_pmu_stop(event, PERF_EF_UPDATE);
+	if (abacus_pmu_is_programmable(event))
+		abacus_pmu_prog_del(abacus_pmu_hart(event), event);
+}
+
+static void abacus_pmu_read(struct perf_event *event) {
+	abacus_pmu_event_update(event);
+}
+
+PMU_FORMAT_ATTR(event, "config:0-11");
+PMU_FORMAT_ATTR(prog, "config:12");
+PMU_FORMAT_ATTR(sel, "config:16-23");
+PMU_FORMAT_ATTR(edge, "config:24");
+
+static struct attribute *abacus_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	&format_attr_prog.attr,
+	&format_attr_sel.attr,
+	&format_attr_edge.attr,
+	NULL,
+};
+
+static const struct attribute_group abacus_pmu_format_group = {
+	.name = "format",
+	.attrs = abacus_pmu_format_attrs,
+};
+
+#define ABACUS_PMU_EVENT(_name, _offset) \
+	PMU_EVENT_ATTR_STRING(_name, event_attr_##_name, "event=" __stringify(_offset))
+
+ABACUS_PMU_EVENT(load_word, 0x100);
+ABACUS_PMU_EVENT(store_word, 0x104);
+ABACUS_PMU_EVENT(addition, 0x108);
+ABACUS_PMU_EVENT(subtraction, 0x10c);
+ABACUS_PMU_EVENT(branch, 0x110);
+ABACUS_PMU_EVENT(jump, 0x114);
+ABACUS_PMU_EVENT(system_privilege, 0x118);
+ABACUS_PMU_EVENT(atomic, 0x11c);
+ABACUS_PMU_EVENT(logical, 0x120);
+ABACUS_PMU_EVENT(shift, 0x124);
+ABACUS_PMU_EVENT(compare, 0x128);
+ABACUS_PMU_EVENT(upper_immediate, 0x12c);
+ABACUS_PMU_EVENT(multiply, 0x130);
+ABACUS_PMU_EVENT(divide, 0x134);
+ABACUS_PMU_EVENT(csr, 0x138);
+ABACUS_PMU_EVENT(fence, 0x13c);
+ABACUS_PMU_EVENT(fp_load, 0x140);
+ABACUS_PMU_EVENT(fp_store, 0x144);
+ABACUS_PMU_EVENT(fp_arithmetic, 0x148);
+ABACUS_PMU_EVENT(fp_fused_multiply_add, 0x14c);
+ABACUS_PMU_EVENT(fp_divide_sqrt, 0x150);
+ABACUS_PMU_EVENT(other, 0x154);
+ABACUS_PMU_EVENT(instructions, 0x158);
+
+ABACUS_PMU_EVENT(icache_request, 0x200);
+ABACUS_PMU_EVENT(icache_hit, 0x204);
+ABACUS_PMU_EVENT(icache_miss, 0x208);
+ABACUS_PMU_EVENT(icache_line_fill_latency, 0x20c);
+ABACUS_PMU_EVENT(dcache_request, 0x210);
+ABACUS_PMU_EVENT(dcache_hit, 0x214);
+ABACUS_PMU_EVENT(dcache_miss, 0x218);
+ABACUS_PMU_EVENT(dcache_line_fill_latency, 0x21c);
+ABACUS_PMU_EVENT(line_fill_occupancy, 0x220);
+ABACUS_PMU_EVENT(line_fill_active, 0x224);
+
+ABACUS_PMU_EVENT(branch_mispredict, 0x300);
+ABACUS_PMU_EVENT(ras_mispredict, 0x304);
+ABACUS_PMU_EVENT(issue_no_instruction, 0x308);
+ABACUS_PMU_EVENT(issue_no_id, 0x30c);
+ABACUS_PMU_EVENT(issue_flush, 0x310);
+ABACUS_PMU_EVENT(issue_unit_busy, 0x314);
+ABACUS_PMU_EVENT(issue_operands_not_ready, 0x318);
+ABACUS_PMU_EVENT(issue_hold, 0x31c);
+ABACUS_PMU_EVENT(issue_multi_source, 0x320);
+ABACUS_PMU_EVENT(cycles, 0x324);
+ABACUS_PMU_EVENT(instructions_issued, 0x328);
+ABACUS_PMU_EVENT(cpi_flush, 0x32c);
+ABACUS_PMU_EVENT(cpi_frontend_empty, 0x330);
+ABACUS_PMU_EVENT(cpi_hold, 0x334);
+ABACUS_PMU_EVENT(cpi_operand_dependency, 0x338);
+ABACUS_PMU_EVENT(cpi_unit_busy, 0x33c);
+ABACUS_PMU_EVENT(cpi_other, 0x340);
+
+#define ABACUS_PMU_SELECT_EVENT(_name, _event) \
+	PMU_EVENT_ATTR_STRING(sel_##_name, event_attr_sel_##_name, "prog=1,sel=" __stringify(_event))
+
+ABACUS_PMU_SELECT_EVENT(instruction_issued, 0);
+ABACUS_PMU_SELECT_EVENT(icache_request, 1);
+ABACUS_PMU_SELECT_EVENT(dcache_request, 2);
+ABACUS_PMU_SELECT_EVENT(icache_miss, 3);
+ABACUS_PMU_SELECT_EVENT(dcache_hit, 4);
+ABACUS_PMU_SELECT_EVENT(icache_line_fill, 5);
+ABACUS_PMU_SELECT_EVENT(dcache_line_fill, 6);
+ABACUS_PMU_SELECT_EVENT(branch_mispredict, 7);
+ABACUS_PMU_SELECT_EVENT(ras_mispredict, 8);
+ABACUS_PMU_SELECT_EVENT(issue_no_instruction, 9);
+ABACUS_PMU_SELECT_EVENT(issue_no_id, 10);
+ABACUS_PMU_SELECT_EVENT(issue_flush, 11);
+ABACUS_PMU_SELECT_EVENT(issue_unit_busy, 12);
+ABACUS_PMU_SELECT_EVENT(issue_operands_not_ready, 13);
+ABACUS_PMU_SELECT_EVENT(issue_hold, 14);
+ABACUS_PMU_SELECT_EVENT(issue_multi_source, 15);
+ABACUS_PMU_SELECT_EVENT(cycle, 16);
+
+static struct attribute *abacus_pmu_event_attrs[] = {
+	&event_attr_load_word.attr.attr,
+	&event_attr_store_word.attr.attr,
+	&event_attr_addition.attr.attr,
+	&event_attr_subtraction.attr.attr,
+	&event_attr_branch.attr.attr,
+	&event_attr_jump.attr.attr,
+	&event_attr_system_privilege.attr.attr,
+	&event_attr_atomic.attr.attr,
+	&event_attr_logical.attr.attr,
+	&event_attr_shift.attr.attr,
+	&event_attr_compare.attr.attr,
+	&event_attr_upper_immediate.attr.attr,
+	&event_attr_multiply.attr.attr,
+	&event_attr_divide.attr.attr,
+	&event_attr_csr.attr.attr,
+	&event_attr_fence.attr.attr,
+	&event_attr_fp_load.attr.attr,
+	&event_attr_fp_store.attr.attr,
+	&event_attr_fp_arithmetic.attr.attr,
+	&event_attr_fp_fused_multiply_add.attr.attr,
+	&event_attr_fp_divide_sqrt.attr.attr,
+	&event_attr_other.attr.attr,
+	&event_attr_instructions.attr.attr,
+	&event_attr_icache_request.attr.attr,
+	&event_attr_icache_hit.attr.attr,
+	&event_attr_icache_miss.attr.attr,
+	&event_attr_icache_line_fill_latency.attr.attr,
+	&event_attr_dcache_request.attr.attr,
+	&event_attr_dcache_hit.attr.attr,
+	&event_attr_dcache_miss.attr.attr,
+	&event_attr_dcache_line_fill_latency.attr.attr,
+	&event_attr_line_fill_occupancy.attr.attr,
+	&event_attr_line_fill_active.attr.attr,
+	&event_attr_branch_mispredict.attr.attr,
+	&event_attr_ras_mispredict.attr.attr,
+	&event_attr_issue_no_instruction.attr.attr,
+	&event_attr_issue_no_id.attr.attr,
+	&event_attr_issue_flush.attr.attr,
+	&event_attr_issue_unit_busy.attr.attr,
+	&event_attr_issue_operands_not_ready.attr.attr,
+	&event_attr_issue_hold.attr.attr,
+	&event_attr_issue_multi_source.attr.attr,
+	&event_attr_cycles.attr.attr,
+	&event_attr_instructions_issued.attr.attr,
+	&event_attr_cpi_flush.attr.attr,
+	&event_attr_cpi_frontend_empty.attr.attr,
+	&event_attr_cpi_hold.attr.attr,
+	&event_attr_cpi_operand_dependency.attr.attr,
+	&event_attr_cpi_unit_busy.attr.attr,
+	&event_attr_cpi_other.attr.attr,
+	&event_attr_sel_instruction_issued.attr.attr,
+	&event_attr_sel_icache_request.attr.attr,
+	&event_attr_sel_dcache_request.attr.attr,
+	&event_attr_sel_icache_miss.attr.attr,
+	&event_attr_sel_dcache_hit.attr.attr,
+	&event_attr_sel_icache_line_fill.attr.attr,
+	&event_attr_sel_dcache_line_fill.attr.attr,
+	&event_attr_sel_branch_mispredict.attr.attr,
+	&event_attr_sel_ras_mispredict.attr.attr,
+	&event_attr_sel_issue_no_instruction.attr.attr,
+	&event_attr_sel_issue_no_id.attr.attr,
+	&event_attr_sel_issue_flush.attr.attr,
+	&event_attr_sel_issue_unit_busy.attr.attr,
+	&event_attr_sel_issue_operands_not_ready.attr.attr,
+	&event_attr_sel_issue_hold.attr.attr,
+	&event_attr_sel_issue_multi_source.attr.attr,
+	&event_attr_sel_cycle.attr.attr,
+	NULL,
+};
+
+static const struct attribute_group abacus_pmu_events_group = {
+	.name = "events",
+	.attrs = abacus_pmu_event_attrs,
+};
+
+// Tells perf stat -a to open system-wide events on the profiled harts only
+static ssize_t cpumask_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	return cpumap_print_to_pagebuf(true, buf, &abacus_pmu_cpus);
+}
+
+static DEVICE_ATTR_RO(cpumask);
+
+static struct attribute *abacus_pmu_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL,
+};
+
+static const struct attribute_group abacus_pmu_cpumask_group = {
+	.attrs = abacus_pmu_cpumask_attrs,
+};
+
+static const struct attribute_group *abacus_pmu_attr_groups[] = {
+	&abacus_pmu_format_group,
+	&abacus_pmu_events_group,
+	&abacus_pmu_cpumask_group,
+	NULL,
+};
+
+// The core PMU owns perf_hw_context, so ABACUS uses the software context like other auxiliary
+// PMUs. Per-task events are still scheduled in and out on every context switch.
+static struct pmu abacus_pmu = {
+	.module = THIS_MODULE,
+	.task_ctx_nr = perf_sw_context,
+	.attr_groups = abacus_pmu_attr_groups,
+	.capabilities = PERF_PMU_CAP_NO_INTERRUPT | PERF_PMU_CAP_NO_EXCLUDE,
+	.event_init = abacus_pmu_event_init,
+	.add = abacus_pmu_add,
+	.del = abacus_pmu_del,
+	.start = abacus_pmu_start,
+	.stop = abacus_pmu_stop,
+	.read = abacus_pmu_read,
+};
+
+int abacus_pmu_init(void) {
+	unsigned int cpu, h, i;
+
+	for_each_possible_cpu(cpu) {
+		if (abacus_cpu_hart(cpu) < abacus_num_harts)
+			cpumask_set_cpu(cpu, &abacus_pmu_cpus);
+	}
+
+	num_event_counters = min_t(unsigned int, ioread32(abacus_base + ABACUS_REG_EVENT_NUM_COUNTERS), ABACUS_EVENT_MAX_COUNTERS);
+	for (h = 0; h < abacus_num_harts; h++) {
+		for (i = 0; i < num_event_counters; i++)
+			iowrite32(0x0, abacus_base + ABACUS_HART_OFFSET(h) + ABACUS_REG_EVENT_SELECT(i));
+		hrtimer_init(&rotate_timer[h], CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		rotate_timer[h].function = abacus_pmu_rotate;
+	}
+
+	return perf_pmu_register(&abacus_pmu, DEVICE_NAME, -1);
+}
+
+void abacus_pmu_exit(void) {
+	unsigned int h;
+
+	perf_pmu_unregister(&abacus_pmu);
+	for (h = 0; h < abacus_num_harts; h++)
+		hrtimer_cancel(&rotate_timer[h]);
+}
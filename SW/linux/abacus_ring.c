@@ -0,0 +1,242 @@
+// Snapshot ring of the ABACUS counters.
+//
+// While the ring runs, snapshot_dma in abacus_top writes a struct abacus_ring_record into a ring in
+// memory at every automatic snapshot, so a timeline of the counters costs no bus reads at all. The
+// ring is a coherent DMA buffer owned by the driver. Userspace maps it read-only at
+// ABACUS_MMAP_RING_OFFSET, sleeps in poll() until records are ready and hands them back with
+// ABACUS_IOC_RING_CONSUME. Without the interrupt line, a timer wakes poll() instead.
+//
+// There is one ring and one consumer, the process that started the ring.
+
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/platform_device.h>
+#include <linux/poll.h>
+#include <linux/timer.h>
+#include <linux/wait.h>
+
+#include "abacus_driver.h"
+
+#define ABACUS_RING_POLL_PERIOD (HZ / 100)
+#define ABACUS_RING_STOP_TIMEOUT_US 1000 // A record is 160 bus writes
+
+// The ring needs a struct device to allocate DMA memory against
+static struct platform_device *ring_pdev;
+
+static DEFINE_MUTEX(ring_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ring_wait);
+static struct timer_list ring_timer;
+static bool ring_use_irq;
+static bool ring_running;
+static u32 ring_saved_interval; // Snapshot interval before the ring started, put back when it stops
+
+static void *ring_buffer;
+static dma_addr_t ring_dma;
+static size_t ring_size;
+static u32 ring_entries;
+static u32 ring_tail;
+static atomic_t ring_maps; // The buffer cannot be reallocated while it is mapped
+
+static bool abacus_ring_ready(void) {
+	return ioread32(abacus_base + ABACUS_REG_RING_HEAD) != READ_ONCE(ring_tail);
+}
+
+static void abacus_ring_timer(struct timer_list *timer) {
+	if (abacus_ring_ready())
+		wake_up_interruptible(&ring_wait);
+	if (READ_ONCE(ring_running))
+		mod_timer(&ring_timer, jiffies + ABACUS_RING_POLL_PERIOD);
+}
+
+// Must be called with ring_lock held. The record being written is finished before the unit stops.
+static void abacus_ring_halt(void) {
+	unsigned int i;
+
+	iowrite32(0x0, abacus_base + ABACUS_REG_RING_CONTROL);
+	for (i = 0; i < ABACUS_RING_STOP_TIMEOUT_US; i++) {
+		if (!(ioread32(abacus_base + ABACUS_REG_RING_STATUS) & ABACUS_RING_STATUS_BUSY))
+			break;
+		udelay(1);
+	}
+
+	if (ring_running)
+		abacus_write_all_harts(ring_saved_interval, ABACUS_REG_SNAPSHOT_INTERVAL);
+	WRITE_ONCE(ring_running, false);
+	del_timer_sync(&ring_timer);
+}
+
+int abacus_ring_start(const struct abacus_ring_config *config) {
+	size_t size;
+	int ret = 0;
+
+	if (config->entries < 2 || config->entries > ABACUS_RING_MAX_ENTRIES || config->interval == 0 || config->reserved)
+		return -EINVAL;
+	size = PAGE_ALIGN(config->entries * sizeof(struct abacus_ring_record));
+
+	mutex_lock(&ring_lock);
+	abacus_ring_halt();
+
+	if (ring_buffer && size != ring_size) {
+		if (atomic_read(&ring_maps)) {
+			ret = -EBUSY;
+			goto out;
+		}
+		dma_free_coherent(&ring_pdev->dev, ring_size, ring_buffer, ring_dma);
+		ring_buffer = NULL;
+	}
+	if (!ring_buffer) {
+		ring_buffer = dma_alloc_coherent(&ring_pdev->dev, size, &ring_dma, GFP_KERNEL);
+		if (!ring_buffer) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		ring_size = size;
+	}
+
+	// Sequence numbers left from the previous run would pass for new records
+	memset(ring_buffer, 0, ring_size);
+	ring_entries = config->entries;
+	WRITE_ONCE(ring_tail, 0);
+
+	iowrite32(lower_32_bits(ring_dma), abacus_base + ABACUS_REG_RING_ADDRESS);
+	iowrite32(config->entries, abacus_base + ABACUS_REG_RING_ENTRIES);
+	iowrite32(config->irq_threshold, abacus_base + ABACUS_REG_RING_IRQ_THRESHOLD);
+	iowrite32(ABACUS_RING_STATUS_IRQ, abacus_base + ABACUS_REG_RING_STATUS);
+	// Every hart snapshots on the interval, as with ABACUS_IOC_SET_SNAPSHOT_INTERVAL
+	ring_saved_interval = ioread32(abacus_base + ABACUS_REG_SNAPSHOT_INTERVAL);
+	abacus_write_all_harts(config->interval, ABACUS_REG_SNAPSHOT_INTERVAL);
+	iowrite32(0x1, abacus_base + ABACUS_REG_RING_CONTROL); // Also clears the tail and the head
+
+	WRITE_ONCE(ring_running, true);
+	if (!ring_use_irq)
+		mod_timer(&ring_timer, jiffies + ABACUS_RING_POLL_PERIOD);
+out:
+	mutex_unlock(&ring_lock);
+	return ret;
+}
+
+void abacus_ring_stop(void) {
+	mutex_lock(&ring_lock);
+	abacus_ring_halt();
+	mutex_unlock(&ring_lock);
+	wake_up_interruptible(&ring_wait);
+}
+
+void abacus_ring_status(struct abacus_ring_status *status) {
+	memset(status, 0, sizeof(*status));
+	mutex_lock(&ring_lock);
+	status->head = ioread32(abacus_base + ABACUS_REG_RING_HEAD);
+	status->tail = ring_tail;
+	status->dropped = ioread32(abacus_base + ABACUS_REG_RING_DROPPED);
+	status->status = ioread32(abacus_base + ABACUS_REG_RING_STATUS);
+	mutex_unlock(&ring_lock);
+}
+
+// The new tail must lie between the current tail and the head, records past the head are not written yet
+int abacus_ring_consume(u32 tail) {
+	u32 head;
+	int ret = 0;
+
+	mutex_lock(&ring_lock);
+	head = ioread32(abacus_base + ABACUS_REG_RING_HEAD);
+	if (!ring_entries || tail >= ring_entries ||
+	    (tail + ring_entries - ring_tail) % ring_entries > (head + ring_entries - ring_tail) % ring_entries) {
+		ret = -EINVAL;
+	} else {
+		iowrite32(tail, abacus_base + ABACUS_REG_RING_TAIL);
+		WRITE_ONCE(ring_tail, tail);
+	}
+	mutex_unlock(&ring_lock);
+	return ret;
+}
+
+static void abacus_ring_vm_open(struct vm_area_struct *vma) {
+	atomic_inc(&ring_maps);
+}
+
+static void abacus_ring_vm_close(struct vm_area_struct *vma) {
+	atomic_dec(&ring_maps);
+}
+
+static const struct vm_operations_struct abacus_ring_vm_ops = {
+	.open = abacus_ring_vm_open,
+	.close = abacus_ring_vm_close,
+};
+
+// Called by device_mmap for the ring offset, with writes already refused
+int abacus_ring_mmap(struct vm_area_struct *vma) {
+	unsigned long size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	mutex_lock(&ring_lock);
+	if (!ring_buffer || size > ring_size) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	vma->vm_pgoff = 0;
+	ret = dma_mmap_coherent(&ring_pdev->dev, vma, ring_buffer, ring_dma, size);
+	if (ret)
+		goto out;
+
+	vma->vm_ops = &abacus_ring_vm_ops;
+	abacus_ring_vm_open(vma);
+out:
+	mutex_unlock(&ring_lock);
+	return ret;
+}
+
+__poll_t abacus_ring_poll(struct file *file, poll_table *wait) {
+	__poll_t mask = 0;
+
+	poll_wait(file, &ring_wait, wait);
+	if (abacus_ring_ready())
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (ioread32(abacus_base + ABACUS_REG_RING_STATUS) & ABACUS_RING_STATUS_BUS_ERROR)
+		mask |= EPOLLERR;
+	return mask;
+}
+
+// Called from the interrupt handler, returns true if the ring raised the interrupt
+bool abacus_ring_interrupt(void) {
+	if (!(ioread32(abacus_base + ABACUS_REG_RING_STATUS) & ABACUS_RING_STATUS_IRQ))
+		return false;
+
+	iowrite32(ABACUS_RING_STATUS_IRQ, abacus_base + ABACUS_REG_RING_STATUS);
+	wake_up_interruptible(&ring_wait);
+	return true;
+}
+
+int abacus_ring_init(bool use_irq) {
+	int ret;
+
+	ring_use_irq = use_irq;
+	timer_setup(&ring_timer, abacus_ring_timer, 0);
+
+	ring_pdev = platform_device_register_simple(DEVICE_NAME, PLATFORM_DEVID_NONE, NULL, 0);
+	if (IS_ERR(ring_pdev))
+		return PTR_ERR(ring_pdev);
+
+	// snapshot_dma drives 32-bit bus addresses
+	ret = dma_coerce_mask_and_coherent(&ring_pdev->dev, DMA_BIT_MASK(32));
+	if (ret) {
+		platform_device_unregister(ring_pdev);
+		return ret;
+	}
+	return 0;
+}
+
+// The open file of a mapping holds a reference to the module, so the ring is not mapped here
+void abacus_ring_exit(void) {
+	mutex_lock(&ring_lock);
+	abacus_ring_halt();
+	if (ring_buffer)
+		dma_free_coherent(&ring_pdev->dev, ring_size, ring_buffer, ring_dma);
+	ring_buffer = NULL;
+	mutex_unlock(&ring_lock);
+	platform_device_unregister(ring_pdev);
+}
@@ -0,0 +1,261 @@
+// Timer sampler of the ABACUS counters.
+//
+// While the sampler runs, an hrtimer reads the counters of the chosen units every period and queues a
+// struct abacus_sample holding what each counter gained since the previous sample, stamped with the
+// time of the read. Userspace reads the samples in batches from the sampler device, sleeping in read()
+// or poll() until enough are queued, so a time series costs no syscall per sample and its spacing does
+// not depend on when the reader is scheduled.
+//
+// The queue is a ring with one producer, the timer, and one consumer, the reader, so neither takes a
+// lock: the timer only writes the head and the reader only writes the tail. There is one reader at a
+// time.
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/sched/signal.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+#include "abacus_driver.h"
+
+struct abacus_sampler_unit {
+	unsigned int unit;  // ABACUS_UNIT_* bit
+	unsigned int first; // First counter of the unit in the snapshot window
+	unsigned int count;
+};
+
+static const struct abacus_sampler_unit sampler_units[] = {
+	{ ABACUS_UNIT_IP, 0, ABACUS_IP_NUM_COUNTERS },
+	{ ABACUS_UNIT_CP, ABACUS_IP_NUM_COUNTERS, ABACUS_CP_NUM_COUNTERS },
+	{ ABACUS_UNIT_SU, ABACUS_IP_NUM_COUNTERS + ABACUS_CP_NUM_COUNTERS, ABACUS_SU_NUM_COUNTERS },
+};
+
+static DEFINE_MUTEX(sampler_lock); // Serialises start, stop and the reader
+static DECLARE_WAIT_QUEUE_HEAD(sampler_wait);
+static struct hrtimer sampler_timer;
+static bool sampler_running;
+
+static struct abacus_sampler_config sampler_config;
+static ktime_t sampler_period;
+static struct abacus_sample *sampler_ring;
+static u32 sampler_entries;
+static u32 sampler_head; // Written by the timer only
+static u32 sampler_tail; // Written by the reader only
+static u32 sampler_sequence;
+static u32 sampler_skipped;
+
+// Only the timer touches these once a run has started
+static u64 sampler_last[ABACUS_NUM_COUNTERS];
+static u64 sampler_now[ABACUS_NUM_COUNTERS];
+
+// Reads the counters of the sampled units into counts, in one snapshot
+static void abacus_sampler_read_counters(u64 *counts) {
+	void __iomem *window;
+	unsigned long flags;
+	unsigned int i;
+
+	raw_spin_lock_irqsave(&abacus_read_lock, flags);
+	window = abacus_snapshot_hold(sampler_config.hart);
+	for (i = 0; i < ARRAY_SIZE(sampler_units); i++) {
+		if (sampler_config.units & sampler_units[i].unit)
+			memcpy_fromio(counts + sampler_units[i].first, window + sampler_units[i].first * sizeof(u64),
+				      sampler_units[i].count * sizeof(u64));
+	}
+	abacus_snapshot_release(sampler_config.hart);
+	raw_spin_unlock_irqrestore(&abacus_read_lock, flags);
+}
+
+static enum hrtimer_restart abacus_sampler_timer(struct hrtimer *timer) {
+	struct abacus_sample *sample;
+	u64 *delta;
+	u32 head = sampler_head;
+	u32 tail = smp_load_acquire(&sampler_tail);
+	unsigned int i;
+
+	hrtimer_forward_now(timer, sampler_period);
+	sampler_sequence++;
+
+	// The queue is full, the next sample covers this period as well
+	if (head - tail >= sampler_entries) {
+		sampler_skipped++;
+		return HRTIMER_RESTART;
+	}
+
+	abacus_sampler_read_counters(sampler_now);
+
+	sample = &sampler_ring[head & (sampler_entries - 1)];
+	sample->timestamp = ktime_get_ns();
+	sample->sequence = sampler_sequence;
+	sample->reserved = 0;
+	delta = (u64 *)&sample->ip; // ip, cp and su follow each other
+	for (i = 0; i < ABACUS_NUM_COUNTERS; i++) {
+		delta[i] = abacus_counter_delta(sampler_now[i], sampler_last[i]);
+		sampler_last[i] = sampler_now[i];
+	}
+
+	// The sample is written before the reader can see it
+	smp_store_release(&sampler_head, head + 1);
+	if (head + 1 - tail >= sampler_config.wakeup)
+		wake_up_interruptible(&sampler_wait);
+
+	return HRTIMER_RESTART;
+}
+
+// Must be called with sampler_lock held
+static void abacus_sampler_halt(void) {
+	hrtimer_cancel(&sampler_timer);
+	WRITE_ONCE(sampler_running, false);
+}
+
+int abacus_sampler_start(const struct abacus_sampler_config *config) {
+	int ret = 0;
+
+	if (config->period_ns < ABACUS_SAMPLER_MIN_PERIOD_NS || !config->entries ||
+	    config->entries > ABACUS_SAMPLER_MAX_ENTRIES || !is_power_of_2(config->entries) ||
+	    !config->units || (config->units & ~(ABACUS_UNIT_IP | ABACUS_UNIT_CP | ABACUS_UNIT_SU)) ||
+	    (config->hart != ABACUS_HART_ALL && config->hart >= abacus_num_harts) || config->reserved)
+		return -EINVAL;
+
+	mutex_lock(&sampler_lock);
+	abacus_sampler_halt();
+
+	if (sampler_ring && config->entries != sampler_entries) {
+		vfree(sampler_ring);
+		sampler_ring = NULL;
+	}
+	if (!sampler_ring) {
+		sampler_ring = vmalloc(array_size(config->entries, sizeof(*sampler_ring)));
+		if (!sampler_ring) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		sampler_entries = config->entries;
+	}
+
+	sampler_config = *config;
+	if (!sampler_config.wakeup)
+		sampler_config.wakeup = 1;
+	sampler_config.wakeup = min(sampler_config.wakeup, sampler_entries);
+	if (sampler_config.hart == ABACUS_HART_ALL && abacus_num_harts == 1)
+		sampler_config.hart = 0;
+	sampler_period = ns_to_ktime(config->period_ns);
+
+	// Samples left from the previous run are dropped, the timer is stopped so nothing races with this
+	sampler_head = 0;
+	WRITE_ONCE(sampler_tail, 0);
+	sampler_sequence = 0;
+	sampler_skipped = 0;
+	memset(sampler_last, 0, sizeof(sampler_last));
+	memset(sampler_now, 0, sizeof(sampler_now));
+	abacus_sampler_read_counters(sampler_last);
+
+	WRITE_ONCE(sampler_running, true);
+	hrtimer_start(&sampler_timer, sampler_period, HRTIMER_MODE_REL);
+out:
+	mutex_unlock(&sampler_lock);
+	return ret;
+}
+
+void abacus_sampler_stop(void) {
+	mutex_lock(&sampler_lock);
+	abacus_sampler_halt();
+	mutex_unlock(&sampler_lock);
+	wake_up_interruptible(&sampler_wait);
+}
+
+void abacus_sampler_status(struct abacus_sampler_status *status) {
+	memset(status, 0, sizeof(*status));
+	mutex_lock(&sampler_lock);
+	status->running = READ_ONCE(sampler_running);
+	status->queued = smp_load_acquire(&sampler_head) - sampler_tail;
+	status->skipped = READ_ONCE(sampler_skipped);
+	status->period_ns = sampler_config.period_ns;
+	mutex_unlock(&sampler_lock);
+}
+
+static u32 abacus_sampler_queued(void) {
+	return smp_load_acquire(&sampler_head) - READ_ONCE(sampler_tail);
+}
+
+// Wakes up once wakeup samples are queued, or when the run ends with fewer
+static bool abacus_sampler_ready(void) {
+	u32 queued = abacus_sampler_queued();
+
+	return queued >= sampler_config.wakeup || (queued && !READ_ONCE(sampler_running));
+}
+
+// Copies as many whole samples as fit in len, blocking until some are queued unless O_NONBLOCK is set.
+// Returns 0 once the sampler is stopped and every sample has been read.
+ssize_t abacus_sampler_read(struct file *file, char __user *buffer, size_t len, loff_t *offset) {
+	u32 head, tail, count, first, n;
+	bool nonblock = file->f_flags & O_NONBLOCK;
+	ssize_t ret;
+
+	if (len < sizeof(struct abacus_sample))
+		return -EINVAL;
+
+	for (;;) {
+		mutex_lock(&sampler_lock);
+		if (abacus_sampler_queued() && (nonblock || abacus_sampler_ready()))
+			break;
+		if (!abacus_sampler_queued() && !READ_ONCE(sampler_running)) {
+			mutex_unlock(&sampler_lock);
+			return 0;
+		}
+		mutex_unlock(&sampler_lock);
+
+		if (nonblock)
+			return -EAGAIN;
+		if (wait_event_interruptible(sampler_wait, abacus_sampler_ready() || !READ_ONCE(sampler_running)))
+			return -ERESTARTSYS;
+	}
+
+	// The samples from tail to head are complete, the timer only writes past head
+	head = smp_load_acquire(&sampler_head);
+	tail = sampler_tail;
+	count = min_t(u32, head - tail, len / sizeof(struct abacus_sample));
+
+	// At most two copies, the second from the start of the ring after wrapping
+	first = tail & (sampler_entries - 1);
+	n = min(count, sampler_entries - first);
+	ret = count * sizeof(struct abacus_sample);
+	if (copy_to_user(buffer, &sampler_ring[first], n * sizeof(struct abacus_sample)) ||
+	    copy_to_user(buffer + n * sizeof(struct abacus_sample), sampler_ring, (count - n) * sizeof(struct abacus_sample)))
+		ret = -EFAULT;
+	else
+		smp_store_release(&sampler_tail, tail + count); // The timer may now reuse the slots
+
+	mutex_unlock(&sampler_lock);
+	return ret;
+}
+
+__poll_t abacus_sampler_poll(struct file *file, poll_table *wait) {
+	__poll_t mask = 0;
+
+	poll_wait(file, &sampler_wait, wait);
+	if (abacus_sampler_ready())
+		mask |= EPOLLIN | EPOLLRDNORM;
+	else if (!abacus_sampler_queued() && !READ_ONCE(sampler_running))
+		mask |= EPOLLHUP;
+	return mask;
+}
+
+void abacus_sampler_init(void) {
+	BUILD_BUG_ON(sizeof(struct abacus_sample) != 2 * sizeof(__u64) + ABACUS_NUM_COUNTERS * sizeof(__u64));
+
+	hrtimer_init(&sampler_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sampler_timer.function = abacus_sampler_timer;
+}
+
+void abacus_sampler_exit(void) {
+	mutex_lock(&sampler_lock);
+	abacus_sampler_halt();
+	vfree(sampler_ring);
+	sampler_ring = NULL;
+	mutex_unlock(&sampler_lock);
+}
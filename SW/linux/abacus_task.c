@@ -0,0 +1,220 @@
+// Per-process attribution of the ABACUS counters.
+//
+// The counters in abacus_top count for one hart. While attribution is on, the counters of the hart
+// of the switching CPU are read at each context switch and the delta since the previous switch on
+// that hart is added to the process that was running. Totals are kept per thread group, so the
+// threads of a process are counted together wherever they run, and are exposed in /proc/abacus_tasks
+// and through ABACUS_IOC_READ_TASK_COUNTERS.
+//
+// Each switch costs a snapshot and a copy of the snapshot window, ABACUS_NUM_COUNTERS 64-bit bus
+// reads, so attribution is only on between ABACUS_IOC_TASK_ATTRIBUTION calls.
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/tracepoint.h>
+#include <linux/version.h>
+
+#include "abacus_driver.h"
+
+#define ABACUS_TASK_HASH_BITS 8
+#define ABACUS_TASK_SLOTS (1 << ABACUS_TASK_HASH_BITS)
+#define ABACUS_TASK_OTHER (-1) // Processes that did not fit in the table
+
+struct abacus_task_entry {
+	pid_t tgid; // 0 is the idle task
+	bool used;
+	char comm[TASK_COMM_LEN];
+	u64 counts[ABACUS_NUM_COUNTERS];
+};
+
+// The table is allocated up front, the switch probe runs under the runqueue lock and cannot allocate.
+// The last entry collects every process that did not get a slot.
+static struct abacus_task_entry task_table[ABACUS_TASK_SLOTS + 1];
+static u64 last_counts[ABACUS_MAX_HARTS][ABACUS_NUM_COUNTERS];
+static u64 switch_counts[ABACUS_NUM_COUNTERS]; // Scratch for the switch probe, too large for its stack
+static DEFINE_RAW_SPINLOCK(abacus_task_lock);
+
+static struct tracepoint *sched_switch_tp;
+static DEFINE_MUTEX(abacus_task_mutex);
+static bool attributing;
+
+static const char *const abacus_counter_names[ABACUS_NUM_COUNTERS] = {
+	"load_word", "store_word", "addition", "subtraction", "branch", "jump", "system_privilege", "atomic",
+	"logical", "shift", "compare", "upper_immediate", "multiply", "divide", "csr", "fence",
+	"fp_load", "fp_store", "fp_arithmetic", "fp_fused_multiply_add", "fp_divide_sqrt", "other", "instructions",
+	"icache_request", "icache_hit", "icache_miss", "icache_line_fill_latency",
+	"dcache_request", "dcache_hit", "dcache_miss", "dcache_line_fill_latency",
+	"line_fill_occupancy", "line_fill_active",
+	"icache_fill_1", "icache_fill_2", "icache_fill_4", "icache_fill_8", "icache_fill_16", "icache_fill_32",
+	"icache_fill_64", "icache_fill_128", "icache_fill_256", "icache_fill_512", "icache_fill_1024", "icache_fill_2048+",
+	"dcache_fill_1", "dcache_fill_2", "dcache_fill_4", "dcache_fill_8", "dcache_fill_16", "dcache_fill_32",
+	"dcache_fill_64", "dcache_fill_128", "dcache_fill_256", "dcache_fill_512", "dcache_fill_1024", "dcache_fill_2048+",
+	"branch_mispredict", "ras_mispredict", "issue_no_instruction", "issue_no_id", "issue_flush",
+	"issue_unit_busy", "issue_operands_not_ready", "issue_hold", "issue_multi_source",
+	"cycles", "instructions_issued", "cpi_flush", "cpi_frontend_empty", "cpi_hold", "cpi_operand_dependency",
+	"cpi_unit_busy", "cpi_other",
+};
+
+// Must be called with abacus_task_lock held
+static void abacus_task_read_all(u64 *counts, unsigned int hart) {
+	raw_spin_lock(&abacus_read_lock);
+	abacus_read_snapshot(counts, ABACUS_NUM_COUNTERS * sizeof(u64), hart);
+	raw_spin_unlock(&abacus_read_lock);
+}
+
+// Must be called with abacus_task_lock held. Returns the slot of tgid, claiming a free one if needed.
+static struct abacus_task_entry *abacus_task_slot(pid_t tgid, bool create) {
+	u32 hash = hash_32(tgid, ABACUS_TASK_HASH_BITS);
+	u32 i, slot;
+
+	for (i = 0; i < ABACUS_TASK_SLOTS; i++) {
+		slot = (hash + i) & (ABACUS_TASK_SLOTS - 1);
+		if (task_table[slot].used && task_table[slot].tgid == tgid)
+			return &task_table[slot];
+		if (!task_table[slot].used)
+			return create ? &task_table[slot] : NULL;
+	}
+	return create ? &task_table[ABACUS_TASK_SLOTS] : NULL;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0)
+static void abacus_task_switch(void *data, bool preempt, struct task_struct *prev,
+			       struct task_struct *next, unsigned int prev_state)
+#else
+static void abacus_task_switch(void *data, bool preempt, struct task_struct *prev,
+			       struct task_struct *next)
+#endif
+{
+	struct abacus_task_entry *entry;
+	u64 *now = switch_counts;
+	u64 *last;
+	unsigned long flags;
+	unsigned int hart = abacus_cpu_hart(smp_processor_id());
+	unsigned int i;
+
+	// CPUs without a profiler block are not attributed
+	if (hart >= abacus_num_harts)
+		return;
+	last = last_counts[hart];
+
+	raw_spin_lock_irqsave(&abacus_task_lock, flags);
+
+	abacus_task_read_all(now, hart);
+
+	entry = abacus_task_slot(prev->tgid, true);
+	if (!entry->used) {
+		entry->used = true;
+		entry->tgid = entry == &task_table[ABACUS_TASK_SLOTS] ? ABACUS_TASK_OTHER : prev->tgid;
+		strscpy(entry->comm, entry->tgid == ABACUS_TASK_OTHER ? "<other>" : prev->group_leader->comm, TASK_COMM_LEN);
+	}
+
+	// Narrow counters may have wrapped, and a unit cleared in between restarted from zero
+	for (i = 0; i < ABACUS_NUM_COUNTERS; i++) {
+		entry->counts[i] += abacus_counter_delta(now[i], last[i]);
+		last[i] = now[i];
+	}
+
+	raw_spin_unlock_irqrestore(&abacus_task_lock, flags);
+}
+
+int abacus_task_attribution(bool enable) {
+	unsigned long flags;
+	unsigned int h;
+	int ret = 0;
+
+	if (!sched_switch_tp)
+		return -ENODEV;
+
+	mutex_lock(&abacus_task_mutex);
+
+	if (enable && !attributing) {
+		raw_spin_lock_irqsave(&abacus_task_lock, flags);
+		memset(task_table, 0, sizeof(task_table));
+		for (h = 0; h < abacus_num_harts; h++)
+			abacus_task_read_all(last_counts[h], h);
+		raw_spin_unlock_irqrestore(&abacus_task_lock, flags);
+
+		ret = tracepoint_probe_register(sched_switch_tp, abacus_task_switch, NULL);
+		attributing = !ret;
+	} else if (!enable && attributing) {
+		tracepoint_probe_unregister(sched_switch_tp, abacus_task_switch, NULL);
+		tracepoint_synchronize_unregister();
+		attributing = false;
+	}
+
+	mutex_unlock(&abacus_task_mutex);
+	return ret;
+}
+
+int abacus_task_read(struct abacus_task_counters *counters) {
+	struct abacus_task_entry *entry;
+	unsigned long flags;
+	int ret = 0;
+
+	raw_spin_lock_irqsave(&abacus_task_lock, flags);
+	entry = abacus_task_slot(counters->pid, false);
+	if (entry)
+		memcpy(&counters->ip, entry->counts, sizeof(entry->counts));
+	else
+		ret = -ENOENT;
+	raw_spin_unlock_irqrestore(&abacus_task_lock, flags);
+
+	return ret;
+}
+
+// One line per process: pid, command, then every counter in register order
+static int abacus_task_show(struct seq_file *m, void *v) {
+	struct abacus_task_entry entry;
+	unsigned long flags;
+	unsigned int i, j;
+
+	seq_puts(m, "pid comm");
+	for (j = 0; j < ABACUS_NUM_COUNTERS; j++)
+		seq_printf(m, " %s", abacus_counter_names[j]);
+	seq_putc(m, '\n');
+
+	for (i = 0; i <= ABACUS_TASK_SLOTS; i++) {
+		raw_spin_lock_irqsave(&abacus_task_lock, flags);
+		entry = task_table[i];
+		raw_spin_unlock_irqrestore(&abacus_task_lock, flags);
+
+		if (!entry.used)
+			continue;
+
+		seq_printf(m, "%d %s", entry.tgid, entry.comm);
+		for (j = 0; j < ABACUS_NUM_COUNTERS; j++)
+			seq_printf(m, " %llu", entry.counts[j]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static void abacus_find_sched_switch(struct tracepoint *tp, void *priv) {
+	if (strcmp(tp->name, "sched_switch") == 0)
+		sched_switch_tp = tp;
+}
+
+int abacus_task_init(void) {
+	BUILD_BUG_ON(ARRAY_SIZE(abacus_counter_names) != ABACUS_NUM_COUNTERS);
+	BUILD_BUG_ON(offsetof(struct abacus_task_counters, su) + sizeof(struct abacus_su_counters) -
+		     offsetof(struct abacus_task_counters, ip) != ABACUS_NUM_COUNTERS * sizeof(__u64));
+
+	// The sched_switch tracepoint is not exported to modules by name, look it up instead
+	for_each_kernel_tracepoint(abacus_find_sched_switch, NULL);
+	if (!sched_switch_tp)
+		pr_warn("sched_switch tracepoint not found, per-process attribution is unavailable\n");
+
+	if (!proc_create_single("abacus_tasks", 0444, NULL, abacus_task_show))
+		return -ENOMEM;
+	return 0;
+}
+
+void abacus_task_exit(void) {
+	abacus_task_attribution(false);
+	remove_proc_entry("abacus_tasks", NULL);
+}
@@ -0,0 +1,175 @@
+// Counter timeline from the ABACUS snapshot ring.
+//
+//   ./abacus_timeline <seconds> <timeline.csv> [interval] [entries]
+//       Has the hardware write a snapshot of every counter into a ring in memory every interval
+//       cycles (default 1000000), and writes one CSV row per snapshot: the sequence, the cycle
+//       timestamp, the torn flag, the snapshots dropped before it, then every counter in the order
+//       of struct abacus_counters. The ring holds entries records (default 256).
+//
+// The records are read straight from the mapped ring, so no counter is read over the bus. Sampling
+// faster than this tool can write the file drops snapshots, which the drops column shows.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "abacus_ioctl.h"
+
+#define DEVICE "/dev/abacus"
+#define DEFAULT_INTERVAL 1000000
+#define DEFAULT_ENTRIES 256
+#define POLL_TIMEOUT_MS 100
+
+static void usage(const char *name) {
+    printf("Usage: %s <seconds> <timeline.csv> [interval] [entries]\n", name);
+}
+
+static void write_header(FILE *out) {
+    unsigned int i;
+
+    fprintf(out, "sequence,timestamp,torn,drops");
+    for (i = 0; i < ABACUS_IP_NUM_COUNTERS; i++) {
+        fprintf(out, ",ip%u", i);
+    }
+    for (i = 0; i < ABACUS_CP_NUM_COUNTERS; i++) {
+        fprintf(out, ",cp%u", i);
+    }
+    for (i = 0; i < ABACUS_SU_NUM_COUNTERS; i++) {
+        fprintf(out, ",su%u", i);
+    }
+    fprintf(out, ",icache_line_fill_min,icache_line_fill_max,dcache_line_fill_min,dcache_line_fill_max\n");
+}
+
+static void write_record(FILE *out, const volatile struct abacus_ring_record *record) {
+    struct abacus_ring_record copy;
+    const __u64 *counters = (const __u64 *)&copy.ip; // ip, cp and su follow each other
+    unsigned int i;
+
+    memcpy(&copy, (const void *)record, sizeof(copy));
+    fprintf(out, "%u,%llu,%u,%u", copy.sequence, (unsigned long long)copy.timestamp,
+            copy.flags & ABACUS_RING_TORN, ABACUS_RING_DROPS(copy.flags));
+    for (i = 0; i < ABACUS_IP_NUM_COUNTERS + ABACUS_CP_NUM_COUNTERS + ABACUS_SU_NUM_COUNTERS; i++) {
+        fprintf(out, ",%llu", (unsigned long long)counters[i]);
+    }
+    fprintf(out, ",%u,%u,%u,%u\n", copy.icache_line_fill_min, copy.icache_line_fill_max,
+            copy.dcache_line_fill_min, copy.dcache_line_fill_max);
+}
+
+// Writes out every complete record from tail on and hands them back to the driver. The sequence word
+// lands last, so once it reads as the expected one the rest of the record is in memory.
+static unsigned long drain(int fd, FILE *out, const struct abacus_ring_record *ring, uint32_t entries,
+                           uint32_t *tail, uint32_t *expected) {
+    unsigned long count = 0;
+
+    while (__atomic_load_n(&ring[*tail].sequence, __ATOMIC_ACQUIRE) == *expected) {
+        write_record(out, &ring[*tail]);
+        *tail = (*tail + 1) % entries;
+        (*expected)++;
+        count++;
+    }
+    if (count && ioctl(fd, ABACUS_IOC_RING_CONSUME, tail) < 0) {
+        perror("ioctl");
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    struct abacus_ring_config config;
+    struct abacus_ring_status status;
+    const struct abacus_ring_record *ring;
+    struct timespec start, now;
+    struct pollfd pfd;
+    unsigned long total = 0;
+    uint32_t tail = 0;
+    uint32_t expected = 1;
+    size_t size;
+    double seconds;
+    FILE *out;
+    int ret = 0;
+    int fd;
+
+    if (argc < 3 || argc > 5) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    seconds = strtod(argv[1], NULL);
+    memset(&config, 0, sizeof(config));
+    config.interval = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : DEFAULT_INTERVAL;
+    config.entries = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : DEFAULT_ENTRIES;
+    config.irq_threshold = config.entries / 4;
+
+    fd = open(DEVICE, O_RDONLY);
+    if (fd < 0) {
+        printf("There was an error with opening the device\n");
+        return -1;
+    }
+
+    out = fopen(argv[2], "w");
+    if (!out) {
+        perror(argv[2]);
+        close(fd);
+        return -1;
+    }
+
+    if (ioctl(fd, ABACUS_IOC_RING_START, &config) < 0) {
+        perror("ioctl");
+        fclose(out);
+        close(fd);
+        return -1;
+    }
+
+    size = (size_t)config.entries * sizeof(struct abacus_ring_record);
+    ring = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, ABACUS_MMAP_RING_OFFSET);
+    if (ring == MAP_FAILED) {
+        perror("mmap");
+        ioctl(fd, ABACUS_IOC_RING_STOP);
+        fclose(out);
+        close(fd);
+        return -1;
+    }
+
+    write_header(out);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        if (poll(&pfd, 1, POLL_TIMEOUT_MS) < 0) {
+            perror("poll");
+            ret = -1;
+            break;
+        }
+        if (pfd.revents & POLLERR) {
+            printf("The snapshot ring stopped on a bus error\n");
+            ret = -1;
+            break;
+        }
+        total += drain(fd, out, ring, config.entries, &tail, &expected);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 >= seconds) {
+            break;
+        }
+    }
+
+    // Records that landed before the stop are still written out
+    ioctl(fd, ABACUS_IOC_RING_STOP);
+    total += drain(fd, out, ring, config.entries, &tail, &expected);
+
+    memset(&status, 0, sizeof(status));
+    ioctl(fd, ABACUS_IOC_RING_STATUS, &status);
+    printf("%lu snapshots written to %s, %u dropped\n", total, argv[2], status.dropped);
+
+    munmap((void *)ring, size);
+    fclose(out);
+    close(fd);
+    return ret;
+}
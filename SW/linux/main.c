@@ -1,98 +1,712 @@
 #include <stdio.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "abacus_ioctl.h"
 
 #define DEVICE "/dev/abacus"
 
-void enable_ip(int fd) {
-    char cmd[16] = "enable_ip";
-    write(fd, cmd, strlen(cmd) + 1); //string literal has automatic null character at the end,
-				     //but strlen returns the size of char[] not including the null character
+// Register page mapped read-only by the driver, counters are read from here without a syscall
+static volatile const uint32_t *abacus_regs;
+
+// Register of a counter field, the fields are 64 bits and the registers 4 bytes apart
+#define COUNTER_REG(base, type, field) ((base) + offsetof(struct type, field) / 2)
+
+// Word of a struct abacus_counters field in the snapshot window, which starts at its ip member
+#define WINDOW_WORD(field) \
+    ((ABACUS_REG_SNAPSHOT_WINDOW + offsetof(struct abacus_counters, field) - offsetof(struct abacus_counters, ip)) / sizeof(uint32_t))
+
+// Low word of the counter at a register offset in the snapshot window, where the counters of the
+// three blocks follow each other as 64-bit pairs
+static unsigned int window_word(unsigned int offset) {
+    unsigned int index;
+
+    if (offset >= ABACUS_REG_SU_BASE) {
+        index = ABACUS_IP_NUM_COUNTERS + ABACUS_CP_NUM_COUNTERS + (offset - ABACUS_REG_SU_BASE) / 4;
+    } else if (offset >= ABACUS_REG_CP_BASE) {
+        index = ABACUS_IP_NUM_COUNTERS + (offset - ABACUS_REG_CP_BASE) / 4;
+    } else {
+        index = (offset - ABACUS_REG_IP_BASE) / 4;
+    }
+    return ABACUS_REG_SNAPSHOT_WINDOW / sizeof(uint32_t) + 2 * index;
+}
+
+// Counters are read from the snapshot window, a counter register would latch ABACUS_REG_COUNTER_HI
+// under a read of the driver. The upper word is read on both sides of the lower one, so a pair
+// split by a snapshot is read again.
+static unsigned long long read_counter(unsigned int offset) {
+    unsigned int word = window_word(offset);
+    uint32_t lo, hi;
+
+    do {
+        hi = abacus_regs[word + 1];
+        lo = abacus_regs[word];
+    } while (abacus_regs[word + 1] != hi);
+
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+void set_units(int fd, unsigned long request, uint32_t units) {
+    if (ioctl(fd, request, &units) < 0) {
+        perror("ioctl");
+    }
+}
+
+void set_snapshot_interval(int fd, const char *arg) {
+    uint32_t cycles = (uint32_t)strtoul(arg, NULL, 0);
+
+    if (ioctl(fd, ABACUS_IOC_SET_SNAPSHOT_INTERVAL, &cycles) < 0) {
+        perror("ioctl");
+    }
+}
+
+// Instruction classes in register order, the same order as struct abacus_ip_counters
+static const char *const ip_class_names[ABACUS_IP_NUM_COUNTERS] = {
+    "Load Word", "Store Word", "Addition", "Subtraction", "Branches", "Jumps", "System Privilege", "Atomic",
+    "Logical", "Shift", "Compare", "Upper Immediate", "Multiply", "Divide", "CSR", "Fence",
+    "FP Load", "FP Store", "FP Arithmetic", "FP Fused Multiply-Add", "FP Divide/Sqrt", "Other", "Total Instructions",
+};
+
+void get_ip_stats(void) {
+    unsigned int i;
+
+    for (i = 0; i < ABACUS_IP_NUM_COUNTERS; i++) {
+        printf("%s: %llu\n", ip_class_names[i], read_counter(ABACUS_REG_IP_BASE + 4 * i));
+    }
+}
+
+// Smallest histogram bucket that holds the given fraction of the events
+static unsigned int histogram_percentile(const unsigned long long *histogram, unsigned long long fills, double fraction) {
+    unsigned long long seen = 0;
+    unsigned int b;
+
+    for (b = 0; b < ABACUS_LATENCY_BUCKETS - 1; b++) {
+        seen += histogram[b];
+        if (seen >= fraction * fills) {
+            break;
+        }
+    }
+    return b;
+}
+
+// The histogram only resolves a percentile to its bucket, so the upper bound of the bucket is
+// printed, capped by the longest event actually seen. Pass min > max when the extremes are unknown.
+static void print_latency(const char *what, const char *events, const unsigned long long *histogram,
+                          unsigned long long total_cycles, unsigned int min, unsigned int max) {
+    static const double fractions[] = { 0.5, 0.9, 0.99 };
+    static const char *labels[] = { "p50", "p90", "p99" };
+    unsigned long long fills = 0, bound;
+    unsigned int b, i;
+
+    for (b = 0; b < ABACUS_LATENCY_BUCKETS; b++) {
+        fills += histogram[b];
+    }
+    if (fills == 0) {
+        printf("%s Latency: no completed %s\n", what, events);
+        return;
+    }
+
+    printf("%s Latency: mean %.1f", what, (double)total_cycles / fills);
+    if (min <= max) {
+        printf(", min %u, max %u", min, max);
+    }
+    printf(" cycles");
+    for (i = 0; i < sizeof(fractions) / sizeof(fractions[0]); i++) {
+        b = histogram_percentile(histogram, fills, fractions[i]);
+        if (b == ABACUS_LATENCY_BUCKETS - 1 && min > max) {
+            printf(", %s >= %llu", labels[i], 1ULL << b);
+            continue;
+        }
+        bound = b == ABACUS_LATENCY_BUCKETS - 1 ? max : (2ULL << b) - 1;
+        printf(", %s <= %llu", labels[i], min <= max && max < bound ? (unsigned long long)max : bound);
+    }
+    printf("\n");
+
+    printf("%s Histogram (cycles: %s):", what, events);
+    for (b = 0; b < ABACUS_LATENCY_BUCKETS; b++) {
+        if (histogram[b] && b == ABACUS_LATENCY_BUCKETS - 1) {
+            printf(" %llu+: %llu", 1ULL << b, histogram[b]);
+        } else if (histogram[b]) {
+            printf(" %llu-%llu: %llu", 1ULL << b, (2ULL << b) - 1, histogram[b]);
+        }
+    }
+    printf("\n");
+}
+
+static void print_memory_level_parallelism(unsigned long long occupancy, unsigned long long active) {
+    printf("Memory-Level Parallelism: %.2f fills in flight over %llu busy cycles\n",
+           active ? (double)occupancy / active : 0.0, active);
+}
+
+static void read_line_fill_histogram(unsigned int offset, unsigned long long *histogram) {
+    unsigned int b;
+
+    for (b = 0; b < ABACUS_LATENCY_BUCKETS; b++) {
+        histogram[b] = read_counter(offset + 4 * b);
+    }
+}
+
+void get_icp_stats(void) {
+    unsigned long long histogram[ABACUS_LATENCY_BUCKETS];
+
+    printf("ICache Requests: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x00));
+    printf("ICache Hits: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x04));
+    printf("ICache Misses: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x08));
+    printf("ICache Line Fill Latency Count: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x0C));
+
+    read_line_fill_histogram(COUNTER_REG(ABACUS_REG_CP_BASE, abacus_cp_counters, icache_line_fill_histogram), histogram);
+    print_latency("ICache Line Fill", "fills", histogram, read_counter(ABACUS_REG_CP_BASE + 0x0C),
+                  abacus_regs[WINDOW_WORD(icache_line_fill_min)],
+                  abacus_regs[WINDOW_WORD(icache_line_fill_max)]);
+}
+
+void get_dcp_stats(void) {
+    unsigned long long histogram[ABACUS_LATENCY_BUCKETS];
+
+    printf("DCache Requests: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x10));
+    printf("DCache Hits: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x14));
+    printf("DCache Misses: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x18));
+    printf("DCache Line Fill Latency Count: %llu\n", read_counter(ABACUS_REG_CP_BASE + 0x1C));
+
+    read_line_fill_histogram(COUNTER_REG(ABACUS_REG_CP_BASE, abacus_cp_counters, dcache_line_fill_histogram), histogram);
+    print_latency("DCache Line Fill", "fills", histogram, read_counter(ABACUS_REG_CP_BASE + 0x1C),
+                  abacus_regs[WINDOW_WORD(dcache_line_fill_min)],
+                  abacus_regs[WINDOW_WORD(dcache_line_fill_max)]);
+    print_memory_level_parallelism(read_counter(COUNTER_REG(ABACUS_REG_CP_BASE, abacus_cp_counters, line_fill_occupancy)),
+                                   read_counter(COUNTER_REG(ABACUS_REG_CP_BASE, abacus_cp_counters, line_fill_active)));
+}
+
+// CPI stack categories in register order, the same order as the cpi_* fields of struct abacus_su_counters
+static const char *const cpi_stall_names[ABACUS_CPI_STALLS] = {
+    "Flush", "Frontend Empty", "Hold", "Operand Dependency", "Unit Busy", "Other",
+};
+
+// Top-down CPI stack: each issue cycle adds 1 to the CPI of its instruction, and every stall
+// category adds its cycles per instruction on top, so the rows add up to the total CPI
+static void print_cpi_stack(unsigned long long cycles, unsigned long long instructions, const unsigned long long *stalls) {
+    unsigned int i;
+
+    if (instructions == 0) {
+        printf("CPI Stack: no instructions issued in %llu cycles\n", cycles);
+        return;
+    }
+
+    printf("CPI Stack: CPI %.3f (IPC %.3f) over %llu instructions, %llu cycles\n",
+           (double)cycles / instructions, (double)instructions / cycles, instructions, cycles);
+    printf("  %-20s %.3f (%.1f%%)\n", "Issue", 1.0, 100.0 * instructions / cycles);
+    for (i = 0; i < ABACUS_CPI_STALLS; i++) {
+        printf("  %-20s %.3f (%.1f%%)\n", cpi_stall_names[i], (double)stalls[i] / instructions, 100.0 * stalls[i] / cycles);
+    }
+}
+
+void get_cpi_stack(void) {
+    unsigned long long stalls[ABACUS_CPI_STALLS];
+    unsigned int i;
+
+    for (i = 0; i < ABACUS_CPI_STALLS; i++) {
+        stalls[i] = read_counter(COUNTER_REG(ABACUS_REG_SU_BASE, abacus_su_counters, cpi_flush) + 4 * i);
+    }
+    print_cpi_stack(read_counter(COUNTER_REG(ABACUS_REG_SU_BASE, abacus_su_counters, cycles)),
+                    read_counter(COUNTER_REG(ABACUS_REG_SU_BASE, abacus_su_counters, instructions)), stalls);
+}
+
+void set_su_level_mode(int fd, const char *arg) {
+    uint32_t mask = (uint32_t)strtoul(arg, NULL, 0);
+
+    if (ioctl(fd, ABACUS_IOC_SET_SU_LEVEL_MODE, &mask) < 0) {
+        perror("ioctl");
+    }
+}
+
+void get_su_stats(void) {
+    printf("Branch Mispredictions: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x00));
+    printf("RAS Mispredictions: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x04));
+    printf("Issue No Instruction: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x08));
+    printf("Issue No ID: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x0C));
+    printf("Issue Flush: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x10));
+    printf("Issue Unit Busy: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x14));
+    printf("Issue Operands Not Ready: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x18));
+    printf("Issue Hold: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x1C));
+    printf("Issue Multi Source: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x20));
+    printf("Cycles: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x24));
+    printf("Instructions Issued: %llu\n", read_counter(ABACUS_REG_SU_BASE + 0x28));
+    get_cpi_stack();
+}
+
+// Reads every unit with a single ioctl
+void get_all_stats(int fd) {
+    struct abacus_counters c;
+    unsigned int i;
+
+    if (ioctl(fd, ABACUS_IOC_READ_COUNTERS, &c) < 0) {
+        perror("ioctl");
+        return;
+    }
+
+    printf("Enabled units: %s%s%s%s%s%s%s\n", (c.enabled & ABACUS_UNIT_IP) ? "ip " : "",
+           (c.enabled & ABACUS_UNIT_CP) ? "cp " : "", (c.enabled & ABACUS_UNIT_SU) ? "su " : "",
+           (c.enabled & ABACUS_UNIT_PC) ? "pc " : "", (c.enabled & ABACUS_UNIT_BH) ? "bh " : "",
+           (c.enabled & ABACUS_UNIT_MS) ? "ms " : "", (c.enabled & ABACUS_UNIT_BUS) ? "bus" : "");
+
+    if (c.ip_overflow | c.cp_overflow | c.su_overflow) {
+        printf("Overflowed counters: ip 0x%x cp 0x%x su 0x%x\n", c.ip_overflow, c.cp_overflow, c.su_overflow);
+    }
+
+    for (i = 0; i < ABACUS_IP_NUM_COUNTERS; i++) {
+        printf("%s: %llu\n", ip_class_names[i], ((const unsigned long long *)&c.ip)[i]);
+    }
+
+    printf("ICache Requests: %llu\nICache Hits: %llu\nICache Misses: %llu\nICache Line Fill Latency Count: %llu\n",
+           c.cp.icache_request, c.cp.icache_hit, c.cp.icache_miss, c.cp.icache_line_fill_latency);
+    printf("DCache Requests: %llu\nDCache Hits: %llu\nDCache Misses: %llu\nDCache Line Fill Latency Count: %llu\n",
+           c.cp.dcache_request, c.cp.dcache_hit, c.cp.dcache_miss, c.cp.dcache_line_fill_latency);
+    print_latency("ICache Line Fill", "fills", (const unsigned long long *)c.cp.icache_line_fill_histogram,
+                  c.cp.icache_line_fill_latency, c.icache_line_fill_min, c.icache_line_fill_max);
+    print_latency("DCache Line Fill", "fills", (const unsigned long long *)c.cp.dcache_line_fill_histogram,
+                  c.cp.dcache_line_fill_latency, c.dcache_line_fill_min, c.dcache_line_fill_max);
+    print_memory_level_parallelism(c.cp.line_fill_occupancy, c.cp.line_fill_active);
+
+    printf("Branch Mispredictions: %llu\nRAS Mispredictions: %llu\nIssue No Instruction: %llu\n"
+           "Issue No ID: %llu\nIssue Flush: %llu\nIssue Unit Busy: %llu\nIssue Operands Not Ready: %llu\n"
+           "Issue Hold: %llu\nIssue Multi Source: %llu\n",
+           c.su.branch_misprediction, c.su.ras_misprediction, c.su.issue_no_instruction,
+           c.su.issue_no_id, c.su.issue_flush, c.su.issue_unit_busy, c.su.issue_operands_not_ready,
+           c.su.issue_hold, c.su.issue_multi_source);
+    print_cpi_stack(c.su.cycles, c.su.instructions, (const unsigned long long *)&c.su.cpi_flush);
+}
+
+static int print_hart_summary(int fd, uint32_t hart, const char *name) {
+    struct abacus_hart_counters h;
+    const struct abacus_counters *c = &h.counters;
+
+    memset(&h, 0, sizeof(h));
+    h.hart = hart;
+    if (ioctl(fd, ABACUS_IOC_READ_HART_COUNTERS, &h) < 0) {
+        perror("ioctl");
+        return -1;
+    }
+    printf("%-6s %16llu %16llu %6.3f %9.2f%%\n", name, c->su.instructions, c->su.cycles,
+           c->su.cycles ? (double)c->su.instructions / c->su.cycles : 0.0,
+           c->cp.dcache_request ? 100.0 * c->cp.dcache_miss / c->cp.dcache_request : 0.0);
+    return (int)h.num_harts;
+}
+
+// One line per hart, to spot an unbalanced load, then the sum over every hart
+void get_hart_stats(int fd) {
+    char name[12];
+    int num_harts = 1;
+    int i;
+
+    printf("%-6s %16s %16s %6s %10s\n", "Hart", "Instructions", "Cycles", "IPC", "DCache Miss");
+    for (i = 0; i < num_harts; i++) {
+        snprintf(name, sizeof(name), "%d", i);
+        num_harts = print_hart_summary(fd, (uint32_t)i, name);
+        if (num_harts < 0) {
+            return;
+        }
+    }
+    if (num_harts > 1) {
+        print_hart_summary(fd, ABACUS_HART_ALL, "all");
+    }
+}
+
+static int compare_mispredicts(const void *a, const void *b) {
+    const struct abacus_branch_entry *x = a;
+    const struct abacus_branch_entry *y = b;
+
+    return (x->mispredicts < y->mispredicts) - (x->mispredicts > y->mispredicts);
+}
+
+// Most mispredicted branches of a hart, worst first. The guaranteed column is a lower bound on the
+// mispredictions, the rate is against the executions since the branch took its entry.
+void get_branch_hotlist(int fd, const char *arg) {
+    struct abacus_branch_hotlist h;
+    const struct abacus_branch_entry *e;
+    uint32_t i;
+
+    memset(&h, 0, sizeof(h));
+    h.hart = arg ? (uint32_t)strtoul(arg, NULL, 0) : 0;
+    if (ioctl(fd, ABACUS_IOC_READ_BRANCH_HOTLIST, &h) < 0) {
+        perror("ioctl");
+        return;
+    }
+    if (h.entries == 0) {
+        printf("No branch hot list in this build\n");
+        return;
+    }
+
+    qsort(h.entry, h.entries, sizeof(h.entry[0]), compare_mispredicts);
+    printf("Branches: %u, mispredicted: %u (%.2f%%)\n", h.branches, h.mispredicts,
+           h.branches ? 100.0 * h.mispredicts / h.branches : 0.0);
+    printf("%-10s %12s %12s %12s %8s %8s\n", "PC", "Mispredicts", "Guaranteed", "Executions", "Rate", "Share");
+    for (i = 0; i < h.entries && h.entry[i].mispredicts; i++) {
+        e = &h.entry[i];
+        printf("0x%08x %12u %12u %12u %7.2f%% %7.2f%%\n", e->pc, e->mispredicts, e->mispredicts - e->error,
+               e->executions, e->executions ? 100.0 * (e->mispredicts - e->error) / e->executions : 0.0,
+               h.mispredicts ? 100.0 * e->mispredicts / h.mispredicts : 0.0);
+    }
+}
+
+static int compare_miss_count(const void *a, const void *b) {
+    const struct abacus_miss_entry *x = a, *y = b;
+    return (x->count < y->count) - (x->count > y->count);
 }
 
-void disable_ip(int fd) {
-    char cmd[16] = "disable_ip";
-    write(fd, cmd, strlen(cmd) + 1);
+// Most missed granules of a hart from the top-K table, abacus_missmap dumps the whole sketch
+void get_miss_hotspots(int fd, const char *arg) {
+    struct abacus_miss_sketch m;
+    uint32_t i;
+
+    memset(&m, 0, sizeof(m));
+    m.hart = arg ? (uint32_t)strtoul(arg, NULL, 0) : 0;
+    if (ioctl(fd, ABACUS_IOC_READ_MISS_SKETCH, &m) < 0) {
+        perror("ioctl");
+        return;
+    }
+    if (m.width == 0) {
+        printf("No miss sketch in this build\n");
+        return;
+    }
+
+    qsort(m.entry, m.entries, sizeof(m.entry[0]), compare_miss_count);
+    printf("DCache misses from 0x%08x to 0x%08x: %u%s\n", m.config.filter_low, m.config.filter_high, m.total,
+           (m.status & ABACUS_MS_STATUS_CLEARING) ? " (clearing)" : "");
+    printf("%-10s %12s %8s\n", "Address", "Misses", "Share");
+    for (i = 0; i < m.entries && m.entry[i].count; i++) {
+        printf("0x%08x %12u %7.2f%%\n", m.entry[i].addr, m.entry[i].count,
+               m.total ? 100.0 * m.entry[i].count / m.total : 0.0);
+    }
+}
+
+// Memory bus traffic. The bus carries one word per cycle with one request outstanding at most, so the
+// occupied fraction of the cycles is how close it is to saturation. A bus that is mostly idle while
+// its requests wait long for their first word limits the program by latency, not by bandwidth.
+void get_bus_stats(int fd) {
+    struct abacus_bus_counters b;
+    unsigned long long transactions, data_cycles;
+    double occupied, mean_latency;
+
+    memset(&b, 0, sizeof(b));
+    if (ioctl(fd, ABACUS_IOC_READ_BUS_COUNTERS, &b) < 0) {
+        perror("ioctl");
+        return;
+    }
+    if (b.cycles == 0) {
+        printf("The bus profiler has not counted any cycle\n");
+        return;
+    }
+
+    transactions = b.reads + b.writes;
+    data_cycles = b.occupancy - b.wait;
+    occupied = (double)b.occupancy / b.cycles;
+    mean_latency = transactions ? (double)b.latency / transactions : 0.0;
+
+    printf("Bus Cycles: %llu\n", b.cycles);
+    printf("Bus Reads: %llu (%llu bytes)\nBus Writes: %llu (%llu bytes)\n", b.reads, b.read_bytes, b.writes,
+           b.write_bytes);
+    printf("Bus Busy Cycles: %llu (%.2f%%)\n", b.busy, 100.0 * b.busy / b.cycles);
+    printf("Bus Occupancy: %.2f%% of cycles with a request outstanding\n", 100.0 * occupied);
+    printf("Bus Data Cycles: %llu (%.2f%%), %.2f bytes per cycle\n", data_cycles, 100.0 * data_cycles / b.cycles,
+           (double)(b.read_bytes + b.write_bytes) / b.cycles);
+    printf("Bus Wait States: %llu (%.2f%% of the occupied cycles)\n", b.wait,
+           b.occupancy ? 100.0 * b.wait / b.occupancy : 0.0);
+    print_latency("Bus First Word", "transactions", (const unsigned long long *)b.latency_histogram, b.latency,
+                  b.latency_min, b.latency_max);
+    if (b.overflow) {
+        printf("Overflowed counters: bus 0x%x\n", b.overflow);
+    }
+
+    if (occupied >= 0.8) {
+        printf("The bus is near saturation, the program is bandwidth-bound\n");
+    } else if (b.occupancy && b.wait * 2 > b.occupancy) {
+        printf("The bus waits on memory more than it moves data at a %.1f cycle mean latency, "
+               "the program is latency-bound\n", mean_latency);
+    } else {
+        printf("The bus has headroom, memory traffic is not the bottleneck\n");
+    }
 }
 
-void enable_cp(int fd) {
-    char cmd[16] = "enable_cp";
-    write(fd, cmd, strlen(cmd) + 1);
+void set_task_attribution(int fd, uint32_t enable) {
+    if (ioctl(fd, ABACUS_IOC_TASK_ATTRIBUTION, &enable) < 0) {
+        perror("ioctl");
+    }
 }
 
-void disable_cp(int fd) {
-    char cmd[16] = "disable_cp";
-    write(fd, cmd, strlen(cmd) + 1);
+// Totals of one process, accumulated by the driver at each context switch
+void get_task_stats(int fd, const char *arg) {
+    struct abacus_task_counters t;
+    const unsigned long long *cp = (const unsigned long long *)&t.cp;
+    const unsigned long long *su = (const unsigned long long *)&t.su;
+    static const char *cp_names[] = {
+        "ICache Requests", "ICache Hits", "ICache Misses", "ICache Line Fill Latency Count",
+        "DCache Requests", "DCache Hits", "DCache Misses", "DCache Line Fill Latency Count",
+        "Line Fill Occupancy", "Line Fill Active Cycles",
+    };
+    static const char *su_names[ABACUS_SU_NUM_COUNTERS] = {
+        "Branch Mispredictions", "RAS Mispredictions", "Issue No Instruction", "Issue No ID", "Issue Flush",
+        "Issue Unit Busy", "Issue Operands Not Ready", "Issue Hold", "Issue Multi Source", "Cycles",
+        "Instructions Issued", "CPI Flush", "CPI Frontend Empty", "CPI Hold", "CPI Operand Dependency",
+        "CPI Unit Busy", "CPI Other",
+    };
+    size_t i;
+
+    memset(&t, 0, sizeof(t));
+    t.pid = (uint32_t)strtoul(arg, NULL, 0);
+    if (ioctl(fd, ABACUS_IOC_READ_TASK_COUNTERS, &t) < 0) {
+        perror("ioctl");
+        return;
+    }
+
+    for (i = 0; i < ABACUS_IP_NUM_COUNTERS; i++) {
+        printf("%s: %llu\n", ip_class_names[i], ((const unsigned long long *)&t.ip)[i]);
+    }
+    for (i = 0; i < sizeof(cp_names) / sizeof(cp_names[0]); i++) {
+        printf("%s: %llu\n", cp_names[i], cp[i]);
+    }
+    // Min and max are not attributed, the percentiles of the process come from its histogram deltas
+    print_latency("ICache Line Fill", "fills", (const unsigned long long *)t.cp.icache_line_fill_histogram,
+                  t.cp.icache_line_fill_latency, UINT32_MAX, 0);
+    print_latency("DCache Line Fill", "fills", (const unsigned long long *)t.cp.dcache_line_fill_histogram,
+                  t.cp.dcache_line_fill_latency, UINT32_MAX, 0);
+    for (i = 0; i < ABACUS_SU_NUM_COUNTERS; i++) {
+        printf("%s: %llu\n", su_names[i], su[i]);
+    }
+    print_cpi_stack(t.su.cycles, t.su.instructions, (const unsigned long long *)&t.su.cpi_flush);
+}
+
+// Only count inside a region, the markers are ABACUS_ROI_START() and ABACUS_ROI_STOP()
+void set_trigger(int fd, uint32_t control, const char *arg) {
+    struct abacus_trigger t;
+    char *end;
+
+    memset(&t, 0, sizeof(t));
+    t.control = control;
+    // Ranges that never match unless given, as start_low start_high stop_low stop_high
+    t.start_pc_low = t.stop_pc_low = UINT32_MAX;
+    if (arg) {
+        t.start_pc_low = (uint32_t)strtoul(arg, &end, 0);
+        t.start_pc_high = (uint32_t)strtoul(end, &end, 0);
+        t.stop_pc_low = (uint32_t)strtoul(end, &end, 0);
+        t.stop_pc_high = (uint32_t)strtoul(end, &end, 0);
+    }
+    if (ioctl(fd, ABACUS_IOC_SET_TRIGGER, &t) < 0) {
+        perror("ioctl");
+    }
 }
 
-void enable_su(int fd) {
-    char cmd[16] = "enable_su";
-    write(fd, cmd, strlen(cmd) + 1);
+void get_trigger(int fd) {
+    struct abacus_trigger t;
+
+    if (ioctl(fd, ABACUS_IOC_GET_TRIGGER, &t) < 0) {
+        perror("ioctl");
+        return;
+    }
+    printf("PC Range Trigger: %s\nMarker Trigger: %s\n",
+           (t.control & ABACUS_TRIGGER_PC_RANGE) ? "on" : "off", (t.control & ABACUS_TRIGGER_MARKER) ? "on" : "off");
+    printf("Start PC Range: 0x%08x-0x%08x\nStop PC Range: 0x%08x-0x%08x\n",
+           t.start_pc_low, t.start_pc_high, t.stop_pc_low, t.stop_pc_high);
+    printf("Inside Region: %s\nRegions Entered: %u\n", t.active ? "yes" : "no", t.region_count);
 }
 
-void disable_su(int fd) {
-    char cmd[16] = "disable_su";
-    write(fd, cmd, strlen(cmd) + 1);
+// Units of the mask only count in the modes given (1 user, 2 supervisor, 8 machine) and, when an ASID
+// is given, in that address space. "self" stands for the address space of this process.
+void set_filter(int fd, const char *arg) {
+    struct abacus_filter f;
+    char *end;
+
+    memset(&f, 0, sizeof(f));
+    f.units = (uint32_t)strtoul(arg, &end, 0);
+    f.modes = (uint32_t)strtoul(end, &end, 0);
+    while (*end == ' ') {
+        end++;
+    }
+    if (strcmp(end, "self") == 0) {
+        f.flags = ABACUS_FILTER_CALLER_ASID;
+    } else if (*end) {
+        f.flags = ABACUS_FILTER_MATCH_ASID;
+        f.asid = (uint32_t)strtoul(end, NULL, 0);
+    }
+    if (ioctl(fd, ABACUS_IOC_SET_FILTER, &f) < 0) {
+        perror("ioctl");
+        return;
+    }
+    if (f.flags) {
+        printf("Counting in ASID %u\n", f.asid);
+    }
 }
 
-void get_ip_stats(int fd) {
-    char buffer[512] = "get_ip_stats";
-    read(fd, buffer, sizeof(buffer));
-    printf("%s\n", buffer);
+// The filters of hart 0, and the mode and ASID this process runs in
+void get_filters(void) {
+    static const char *const unit_names[ABACUS_UNIT_FILTERS] = { "ip", "cp", "su", "pc", "bh", "ms", "bus", "events" };
+    uint32_t filter, mode;
+    unsigned int n;
+
+    for (n = 0; n < ABACUS_UNIT_FILTERS; n++) {
+        filter = abacus_regs[ABACUS_REG_UNIT_FILTER(n) / sizeof(uint32_t)];
+        printf("%-7s %s%s%s", unit_names[n], (filter & ABACUS_FILTER_USER) ? "user " : "",
+               (filter & ABACUS_FILTER_SUPERVISOR) ? "supervisor " : "", (filter & ABACUS_FILTER_MACHINE) ? "machine " : "");
+        if (filter & ABACUS_FILTER_ASID_MATCH) {
+            printf("asid %u", (filter & ABACUS_FILTER_ASID) >> ABACUS_FILTER_ASID_SHIFT);
+        }
+        printf("\n");
+    }
+    mode = abacus_regs[ABACUS_REG_CORE_MODE / sizeof(uint32_t)];
+    printf("This process runs in mode %u, ASID %u\n", mode & 0x3, (mode & ABACUS_FILTER_ASID) >> ABACUS_FILTER_ASID_SHIFT);
 }
 
-void get_icp_stats(int fd) {
-    char buffer[512] = "get_icp_stats";
-    read(fd, buffer, sizeof(buffer));
-    printf("%s\n", buffer);
+// Alarm n fires when a window of <window> counted cycles has more than <threshold> of the ABACUS_EVENT_*
+// <event>, and freezes the snapshot of the crossing for the driver to record
+void set_alarm(int fd, const char *arg) {
+    struct abacus_alarm_config a;
+    char *end;
+
+    memset(&a, 0, sizeof(a));
+    a.index = (uint32_t)strtoul(arg, &end, 0);
+    a.select = ((uint32_t)strtoul(end, &end, 0) & ABACUS_EVENT_SELECT_EVENT) | ABACUS_ALARM_SELECT_FREEZE |
+               ABACUS_EVENT_SELECT_ENABLE;
+    a.window = (uint32_t)strtoul(end, &end, 0);
+    a.threshold = (uint32_t)strtoul(end, &end, 0);
+    if (ioctl(fd, ABACUS_IOC_SET_ALARM, &a) < 0) {
+        perror("ioctl");
+    }
 }
 
-void get_dcp_stats(int fd) {
-    char buffer[512] = "get_dcp_stats";
-    read(fd, buffer, sizeof(buffer));
-    printf("%s\n", buffer);
+void clear_alarm(int fd, const char *arg) {
+    struct abacus_alarm_config a;
+
+    memset(&a, 0, sizeof(a));
+    a.index = (uint32_t)strtoul(arg, NULL, 0);
+    if (ioctl(fd, ABACUS_IOC_SET_ALARM, &a) < 0) {
+        perror("ioctl");
+    }
 }
 
-void get_su_stats(int fd) {
-    char buffer[512] = "get_su_stats";
-    read(fd, buffer, sizeof(buffer));
-    printf("%s\n", buffer);
+// Crossings recorded by the driver since the last call, with the counters frozen at each one
+void get_alarms(int fd) {
+    struct abacus_alarm_event events[8];
+    struct abacus_alarm_events req;
+    const struct abacus_alarm_event *e;
+    uint32_t i;
+
+    do {
+        memset(&req, 0, sizeof(req));
+        req.events = (uint64_t)(uintptr_t)events;
+        req.capacity = sizeof(events) / sizeof(events[0]);
+        if (ioctl(fd, ABACUS_IOC_READ_ALARMS, &req) < 0) {
+            perror("ioctl");
+            return;
+        }
+        for (i = 0; i < req.count; i++) {
+            e = &events[i];
+            printf("Hart %u alarms 0x%x at cycle %llu (%llu.%09llu s) PC 0x%08x\n", e->hart, e->status,
+                   (unsigned long long)e->timestamp, (unsigned long long)(e->time_ns / 1000000000ULL),
+                   (unsigned long long)(e->time_ns % 1000000000ULL), e->pc);
+            if (e->frozen) {
+                printf("  Cycles: %llu, Instructions: %llu, DCache Misses: %llu, Branch Mispredictions: %llu, Flushes: %llu\n",
+                       (unsigned long long)e->su.cycles, (unsigned long long)e->su.instructions,
+                       (unsigned long long)e->cp.dcache_miss, (unsigned long long)e->su.branch_misprediction,
+                       (unsigned long long)e->su.issue_flush);
+            }
+        }
+    } while (req.pending);
+
+    if (req.dropped) {
+        printf("Alarms lost to a full log: %u\n", req.dropped);
+    }
 }
 
 void help() {
 	printf("Available commands:\n");
 	printf("help               - Print help screen (this)\n");
 	printf("exit               - Exit software\n");
-    
+
 	printf("enable_ip          - Enable instruction profiling\n");
-	printf("disable_ip         - Disable instruction profiling\n");
+	printf("disable_ip         - Pause instruction profiling, keeping the counters\n");
 	printf("get_ip_stats       - Show instruction profiling stats\n");
 
 	printf("enable_cp          - Enable cache profiling\n");
-	printf("disable_cp         - Disable cache profiling\n");
+	printf("disable_cp         - Pause cache profiling, keeping the counters\n");
 	printf("get_icp_stats      - Show instruction cache profiling stats\n");
 	printf("get_dcp_stats      - Show data cache profiling stats\n");
 
 	printf("enable_su	       - Enable the stall unit profiler\n");
-	printf("disable_su	       - Disable the stall unit profiler\n");
+	printf("disable_su	       - Pause the stall unit profiler, keeping the counters\n");
 	printf("get_su_stats	   - Show stall unit stats\n");
+	printf("cpi_stack          - Show the top-down CPI stack\n");
+	printf("su_level_mode <mask> - Stall counters whose bit is set count cycles instead of events (0x1fc = every issue stall)\n");
+
+	printf("get_all_stats      - Show the stats of every unit in one read\n");
+	printf("get_hart_stats     - Show instructions, IPC and dcache miss rate of every hart and of all of them\n");
+
+	printf("enable_bh          - Enable the branch misprediction hot list\n");
+	printf("disable_bh         - Pause the branch misprediction hot list\n");
+	printf("get_branch_hotlist [hart] - Show the most mispredicted branches of a hart\n");
+
+	printf("enable_ms          - Enable the dcache miss sketch\n");
+	printf("disable_ms         - Pause the dcache miss sketch\n");
+	printf("get_miss_hotspots [hart] - Show the most missed dcache granules of a hart\n");
+
+	printf("enable_bus         - Enable the memory bus profiler\n");
+	printf("disable_bus        - Pause the memory bus profiler, keeping the counters\n");
+	printf("get_bus_stats      - Show memory bus traffic, latency and saturation\n");
+
+	printf("snapshot           - Latch every counter on the same clock edge\n");
+	printf("snapshot_interval <cycles> - Cycles between automatic snapshots (0 = only on snapshot)\n");
+	printf("clear_overflow     - Clear the overflow status of every counter\n");
+	printf("clear_units [mask] - Empty the units of an ABACUS_UNIT_* mask on every hart (all of them by default)\n");
+
+	printf("task_attribution_on  - Start attributing counts to processes at each context switch\n");
+	printf("task_attribution_off - Stop attributing counts to processes\n");
+	printf("get_task_stats <pid> - Show the counts attributed to a process (all of them are in /proc/abacus_tasks)\n");
+
+	printf("roi_markers        - Only count between the start and stop marker instructions\n");
+	printf("roi_pc <start_lo> <start_hi> <stop_lo> <stop_hi> - Only count from the start PC range to the stop PC range\n");
+	printf("roi_off            - Count everywhere\n");
+	printf("roi_status         - Show the region-of-interest trigger\n");
+
+	printf("set_filter <mask> <modes> [asid|self] - Units of an ABACUS_UNIT_* mask only count in modes (1 user, 2 supervisor, 8 machine) and in one address space\n");
+	printf("filter_off         - Count every unit in every mode and address space\n");
+	printf("get_filters        - Show the unit filters and the mode and ASID of this process\n");
+
+	printf("set_alarm <n> <event> <window> <threshold> - Record a crossing when a window of cycles has more than threshold events\n");
+	printf("clear_alarm <n>    - Stop alarm n\n");
+	printf("get_alarms         - Show the recorded alarm crossings and their frozen counters\n");
 }
 
 int main() {
 
-    /*  In order for this not to return an error eventually, 
+    /*  In order for this not to return an error eventually,
     we need to ensure that we have loaded the kernel module with
     `insmod abacus.ko`, and also create a character device that populates
     /dev/abacus with `mknod /dev/abacus c 28 0`   */
-    int fd = open(DEVICE, O_RDWR);
+    int fd = open(DEVICE, O_RDONLY);
     char input[128];
+    uint32_t version = 0;
 
     if (fd < 0) {
         printf("There was an error with opening the device\n");
         return -1;
     }
 
+    if (ioctl(fd, ABACUS_IOC_GET_VERSION, &version) < 0 || version != ABACUS_ABI_VERSION) {
+        printf("Driver ABI version %u does not match the expected version %u\n", version, ABACUS_ABI_VERSION);
+        close(fd);
+        return -1;
+    }
+
+    abacus_regs = mmap(NULL, ABACUS_MMAP_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (abacus_regs == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return -1;
+    }
+
     while (1) {
         printf("abacus-linux-demo> ");
         if (fgets(input, sizeof(input), stdin) != NULL) {
@@ -106,46 +720,160 @@ int main() {
 
             /*Enable profiling units*/
             else if (strcmp(input, "enable_ip") == 0) {
-                enable_ip(fd);
+                set_units(fd, ABACUS_IOC_ENABLE, ABACUS_UNIT_IP);
             }
              else if (strcmp(input, "disable_ip") == 0) {
-                disable_ip(fd);
+                set_units(fd, ABACUS_IOC_DISABLE, ABACUS_UNIT_IP);
             }
 
              else if (strcmp(input, "enable_cp") == 0) {
-                enable_cp(fd);
+                set_units(fd, ABACUS_IOC_ENABLE, ABACUS_UNIT_CP);
             }
              else if (strcmp(input, "disable_cp") == 0) {
-                disable_cp(fd);
+                set_units(fd, ABACUS_IOC_DISABLE, ABACUS_UNIT_CP);
             }
 
              else if (strcmp(input, "enable_su") == 0) {
-                enable_su(fd);
+                set_units(fd, ABACUS_IOC_ENABLE, ABACUS_UNIT_SU);
             }
              else if (strcmp(input, "disable_su") == 0) {
-                disable_su(fd);
+                set_units(fd, ABACUS_IOC_DISABLE, ABACUS_UNIT_SU);
             }
 
             /*Collect profiling unit data*/
              else if (strcmp(input, "get_ip_stats") == 0) {
-                get_ip_stats(fd);
+                get_ip_stats();
             }
              else if (strcmp(input, "get_icp_stats") == 0) {
-                get_icp_stats(fd);
+                get_icp_stats();
             }
              else if (strcmp(input, "get_dcp_stats") == 0) {
-                get_dcp_stats(fd);
+                get_dcp_stats();
             }
              else if (strcmp(input, "get_su_stats") == 0) {
-                get_su_stats(fd);
-            } 
-            
+                get_su_stats();
+            }
+             else if (strcmp(input, "cpi_stack") == 0) {
+                get_cpi_stack();
+            }
+             else if (strncmp(input, "su_level_mode ", 14) == 0) {
+                set_su_level_mode(fd, input + 14);
+            }
+             else if (strcmp(input, "get_all_stats") == 0) {
+                get_all_stats(fd);
+            }
+
+             else if (strcmp(input, "get_hart_stats") == 0) {
+                get_hart_stats(fd);
+            }
+             else if (strcmp(input, "enable_bh") == 0) {
+                set_units(fd, ABACUS_IOC_ENABLE, ABACUS_UNIT_BH);
+            }
+             else if (strcmp(input, "disable_bh") == 0) {
+                set_units(fd, ABACUS_IOC_DISABLE, ABACUS_UNIT_BH);
+            }
+             else if (strcmp(input, "get_branch_hotlist") == 0) {
+                get_branch_hotlist(fd, NULL);
+            }
+             else if (strncmp(input, "get_branch_hotlist ", 19) == 0) {
+                get_branch_hotlist(fd, input + 19);
+            }
+             else if (strcmp(input, "enable_ms") == 0) {
+                set_units(fd, ABACUS_IOC_ENABLE, ABACUS_UNIT_MS);
+            }
+             else if (strcmp(input, "disable_ms") == 0) {
+                set_units(fd, ABACUS_IOC_DISABLE, ABACUS_UNIT_MS);
+            }
+             else if (strcmp(input, "get_miss_hotspots") == 0) {
+                get_miss_hotspots(fd, NULL);
+            }
+             else if (strncmp(input, "get_miss_hotspots ", 18) == 0) {
+                get_miss_hotspots(fd, input + 18);
+            }
+             else if (strcmp(input, "enable_bus") == 0) {
+                set_units(fd, ABACUS_IOC_ENABLE, ABACUS_UNIT_BUS);
+            }
+             else if (strcmp(input, "disable_bus") == 0) {
+                set_units(fd, ABACUS_IOC_DISABLE, ABACUS_UNIT_BUS);
+            }
+             else if (strcmp(input, "get_bus_stats") == 0) {
+                get_bus_stats(fd);
+            }
+             else if (strcmp(input, "snapshot") == 0) {
+                if (ioctl(fd, ABACUS_IOC_SNAPSHOT) < 0) {
+                    perror("ioctl");
+                }
+            }
+             else if (strcmp(input, "clear_overflow") == 0) {
+                if (ioctl(fd, ABACUS_IOC_CLEAR_OVERFLOW) < 0) {
+                    perror("ioctl");
+                }
+            }
+             else if (strcmp(input, "clear_units") == 0) {
+                set_units(fd, ABACUS_IOC_CLEAR, ABACUS_UNIT_ALL | ABACUS_UNIT_EVENTS);
+            }
+             else if (strncmp(input, "clear_units ", 12) == 0) {
+                set_units(fd, ABACUS_IOC_CLEAR, (uint32_t)strtoul(input + 12, NULL, 0));
+            }
+             else if (strncmp(input, "snapshot_interval ", 18) == 0) {
+                set_snapshot_interval(fd, input + 18);
+            }
+
+             else if (strcmp(input, "task_attribution_on") == 0) {
+                set_task_attribution(fd, 1);
+            }
+             else if (strcmp(input, "task_attribution_off") == 0) {
+                set_task_attribution(fd, 0);
+            }
+             else if (strncmp(input, "get_task_stats ", 15) == 0) {
+                get_task_stats(fd, input + 15);
+            }
+
+             else if (strcmp(input, "roi_markers") == 0) {
+                set_trigger(fd, ABACUS_TRIGGER_MARKER, NULL);
+            }
+             else if (strncmp(input, "roi_pc ", 7) == 0) {
+                set_trigger(fd, ABACUS_TRIGGER_PC_RANGE, input + 7);
+            }
+             else if (strcmp(input, "roi_off") == 0) {
+                set_trigger(fd, 0, NULL);
+            }
+             else if (strcmp(input, "roi_status") == 0) {
+                get_trigger(fd);
+            }
+
+             else if (strncmp(input, "set_filter ", 11) == 0) {
+                set_filter(fd, input + 11);
+            }
+             else if (strcmp(input, "filter_off") == 0) {
+                struct abacus_filter f = { ABACUS_UNIT_ALL | ABACUS_UNIT_EVENTS, ABACUS_FILTER_MODES, 0, 0 };
+
+                if (ioctl(fd, ABACUS_IOC_SET_FILTER, &f) < 0) {
+                    perror("ioctl");
+                }
+            }
+             else if (strcmp(input, "get_filters") == 0) {
+                get_filters();
+            }
+
+             else if (strncmp(input, "set_alarm ", 10) == 0) {
+                set_alarm(fd, input + 10);
+            }
+             else if (strncmp(input, "clear_alarm ", 12) == 0) {
+                clear_alarm(fd, input + 12);
+            }
+             else if (strcmp(input, "get_alarms") == 0) {
+                get_alarms(fd);
+            }
+
             else {
                 printf("Unknown command \n"); //No valid command passed to fgets from stdin
             }
         }
     }
 
+    munmap((void *)abacus_regs, ABACUS_MMAP_SIZE);
+    close(fd);
     printf("Goodbye \n");
     return 0;
 }